@@ -0,0 +1,99 @@
+#include "Arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------ Arena.c -------------------
+ |
+ |  Purpose: Chunked bump allocator with marks,
+ |		and the fixed-size object pool built
+ |		on it.
+ |
+ *----------------------------------------------*/
+
+void arenaInit(Arena *arena) {
+	memset(arena, 0, sizeof(*arena));
+}
+
+void arenaFree(Arena *arena) {
+	ArenaChunk *chunk = arena->first;
+
+	while (chunk) {
+		ArenaChunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	memset(arena, 0, sizeof(*arena));
+}
+
+static ArenaChunk *newChunk(size_t size) {
+	ArenaChunk *chunk;
+
+	if (posix_memalign((void **)&chunk, ARENA_ALIGN, sizeof(ArenaChunk) + size) != 0) {
+		fprintf(stderr, "Arena: out of memory allocating %zu bytes.\n", size);
+		exit(EXIT_FAILURE);
+	}
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	return chunk;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+	ArenaChunk *chunk = arena->current;
+	void *ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	// Move on to the next kept chunk that fits, or add one
+	while (chunk == NULL || chunk->used + size > chunk->size) {
+		if (chunk && chunk->next) {
+			chunk = chunk->next;
+			chunk->used = 0;
+			continue;
+		}
+		ArenaChunk *fresh = newChunk(size > ARENA_CHUNK ? size : ARENA_CHUNK);
+		if (chunk) {
+			// Keep any chunks after this one in the list
+			fresh->next = chunk->next;
+			chunk->next = fresh;
+		} else {
+			arena->first = fresh;
+		}
+		arena->chunks++;
+		chunk = fresh;
+	}
+	arena->current = chunk;
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+ArenaMark arenaMark(const Arena *arena) {
+	ArenaMark mark = { arena->current, arena->current ? arena->current->used : 0 };
+	return mark;
+}
+
+void arenaRewind(Arena *arena, ArenaMark mark) {
+	if (mark.chunk == NULL) {
+		// Back to empty: start again from the first chunk
+		arena->current = arena->first;
+		if (arena->current) {
+			arena->current->used = 0;
+		}
+		return;
+	}
+	arena->current = mark.chunk;
+	mark.chunk->used = mark.used;
+}
+
+void poolInit(Pool *pool, Arena *arena, size_t object_size) {
+	memset(pool, 0, sizeof(*pool));
+	pool->arena = arena;
+	// Room for the free-list link, and keep objects aligned
+	if (object_size < sizeof(void *)) {
+		object_size = sizeof(void *);
+	}
+	pool->object_size = (object_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
@@ -0,0 +1,94 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------ Arena.h -------------------
+ |
+ |  Bump allocator for everything a simulation
+ |  keeps until it ends: the Core, the out-of-
+ |  order queues, the fetch footprint map and
+ |  the pipeline-entry pool below. Memory comes
+ |  in chunks that are never handed back while
+ |  the arena lives; arenaRewind returns to an
+ |  earlier mark so the next run reuses the same
+ |  chunks, and arenaFree releases it all.
+ |
+ |  A Pool hands out fixed-size objects from an
+ |  arena and keeps the returned ones on a free
+ |  list, so objects created and retired every
+ |  cycle cost no heap calls at all.
+ |
+ *----------------------------------------------*/
+
+#define ARENA_CHUNK (64 * 1024)
+#define ARENA_ALIGN 64 // cache line; covers the 32-byte aligned vector registers
+#define POOL_BATCH 32  // objects carved from the arena at a time
+
+typedef struct ArenaChunk
+{
+	struct ArenaChunk *next;
+	size_t size;
+	size_t used;
+	uint8_t data[] __attribute__((aligned(ARENA_ALIGN)));
+}ArenaChunk;
+
+typedef struct Arena
+{
+	ArenaChunk *first;
+	ArenaChunk *current;  // chunks after it are empty, kept for reuse
+	size_t chunks;
+}Arena;
+
+typedef struct ArenaMark
+{
+	ArenaChunk *chunk;
+	size_t used;
+}ArenaMark;
+
+void arenaInit(Arena *arena);
+void arenaFree(Arena *arena);
+
+// Zeroed, ARENA_ALIGN aligned; exits if the host is out of memory
+void *arenaAlloc(Arena *arena, size_t size);
+
+// Everything allocated after the mark is dropped by arenaRewind
+ArenaMark arenaMark(const Arena *arena);
+void arenaRewind(Arena *arena, ArenaMark mark);
+
+typedef struct Pool
+{
+	Arena *arena;
+	size_t object_size;
+	void *free_list;
+	uint64_t allocated;   // objects carved so far
+	uint64_t in_use;
+}Pool;
+
+void poolInit(Pool *pool, Arena *arena, size_t object_size);
+
+static inline void *poolGet(Pool *pool) {
+	void *obj = pool->free_list;
+	if (obj == NULL) {
+		int i;
+		uint8_t *batch = arenaAlloc(pool->arena, POOL_BATCH * pool->object_size);
+		for (i=POOL_BATCH-1; i>=0; i--) {
+			*(void **)(batch + i * pool->object_size) = pool->free_list;
+			pool->free_list = batch + i * pool->object_size;
+		}
+		pool->allocated += POOL_BATCH;
+		obj = pool->free_list;
+	}
+	pool->free_list = *(void **)obj;
+	pool->in_use++;
+	return obj;
+}
+
+static inline void poolPut(Pool *pool, void *obj) {
+	*(void **)obj = pool->free_list;
+	pool->free_list = obj;
+	pool->in_use--;
+}
+
+#endif
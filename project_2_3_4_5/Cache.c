@@ -0,0 +1,363 @@
+#include "Cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------ Cache.c -------------------
+ |
+ |  Purpose: L1D and L2 tag arrays, the fill and
+ |		write-back paths, the prefetch issue
+ |		and the statistics.
+ |
+ *----------------------------------------------*/
+
+// What a demand access brings down the hierarchy
+typedef struct Request
+{
+	Addr pc;
+	Addr addr;
+	bool store;
+}Request;
+
+void cacheConfigDefaults(CacheConfig *cfg) {
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->l1d_kb = 32;
+	cfg->l1d_ways = 8;
+	cfg->l2_kb = 256;
+	cfg->l2_ways = 8;
+	cfg->l2_latency = 12;
+	cfg->mem_latency = 100;
+	dramConfigDefaults(&cfg->dram_cfg);
+	cfg->l1d_degree = cfg->l2_degree = 2;
+	cfg->l1d_distance = cfg->l2_distance = 1;
+}
+
+// Up to max colon-separated numbers after "name="; how many were read
+static int numbers(const char *value, int *out, int max) {
+	char *end;
+	int n = 0;
+
+	while (n < max) {
+		out[n++] = strtol(value, &end, 0);
+		if (end == value || (*end != ':' && *end != '\0')) {
+			return -1;
+		}
+		if (*end == '\0') {
+			return n;
+		}
+		value = end + 1;
+	}
+	return -1;
+}
+
+bool parseCacheSpec(const char *spec, CacheConfig *cfg) {
+	char buf[128];
+	char *save = NULL;
+	char *item;
+	int v[3];
+
+	snprintf(buf, sizeof(buf), "%s", spec);
+	for (item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+		if (strcmp(item, "default") == 0) {
+			continue;
+		}
+		if (strncmp(item, "l1d=", 4) == 0 && numbers(item + 4, v, 2) == 2 && v[0] > 0 && v[1] > 0) {
+			cfg->l1d_kb = v[0];
+			cfg->l1d_ways = v[1];
+		} else if (strcmp(item, "l2=0") == 0) {
+			cfg->l2_kb = 0;
+		} else if (strncmp(item, "l2=", 3) == 0 && numbers(item + 3, v, 3) == 3 && v[0] > 0 && v[1] > 0 && v[2] >= 1) {
+			cfg->l2_kb = v[0];
+			cfg->l2_ways = v[1];
+			cfg->l2_latency = v[2];
+		} else if (strncmp(item, "mem=", 4) == 0 && numbers(item + 4, v, 1) == 1 && v[0] >= 1) {
+			cfg->mem_latency = v[0];
+		} else {
+			printf("Bad --dcache item %s (default, l1d=KB:WAYS, l2=KB:WAYS:LATENCY, l2=0 or mem=LATENCY).\n", item);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool parsePrefetchSpec(const char *spec, CacheConfig *cfg) {
+	char buf[128];
+	char *save = NULL;
+	char *item;
+
+	snprintf(buf, sizeof(buf), "%s", spec);
+	for (item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+		bool l2 = strncmp(item, "l2=", 3) == 0;
+		char *name = item + (l2 ? 3 : 4);
+		char *params = strchr(name, ':');
+		const PrefetcherKind *kind;
+		int v[2] = { 2, 1 }, n = 0;
+
+		if (!l2 && strncmp(item, "l1d=", 4) != 0) {
+			printf("Bad --prefetch item %s (l1d=NAME[:DEGREE[:DISTANCE]] or l2=...).\n", item);
+			return false;
+		}
+		if (params) {
+			*params++ = '\0';
+			n = numbers(params, v, 2);
+			if (n < 1 || v[0] < 1 || v[0] > PREFETCH_MAX_DEGREE || (n == 2 && v[1] < 1)) {
+				printf("Bad --prefetch parameters %s (degree 1 to %d, distance >= 1).\n", params, PREFETCH_MAX_DEGREE);
+				return false;
+			}
+		}
+		if ((kind = findPrefetcher(name)) == NULL) {
+			printf("Unknown prefetcher: %s (try --prefetch list)\n", name);
+			return false;
+		}
+		if (l2) {
+			cfg->l2_pf = kind;
+			cfg->l2_degree = v[0];
+			cfg->l2_distance = v[1];
+		} else {
+			cfg->l1d_pf = kind;
+			cfg->l1d_degree = v[0];
+			cfg->l1d_distance = v[1];
+		}
+	}
+	return true;
+}
+
+static void initCache(Cache *c, const char *name, int kb, int ways, int latency, Arena *arena) {
+	int lines = (kb << 10) >> CACHE_LINE_SHIFT;
+
+	c->name = name;
+	c->ways = ways > lines ? lines : ways;
+	c->sets = lines / c->ways;
+	c->latency = latency;
+	c->lines = arenaAlloc(arena, (size_t)c->sets * c->ways * sizeof(CacheLine));
+}
+
+DataCache *initDataCache(Core *core, const CacheConfig *cfg) {
+	DataCache *dc = arenaAlloc(core->arena, sizeof(DataCache));
+
+	initCache(&dc->l1d, "L1D", cfg->l1d_kb, cfg->l1d_ways, 0, core->arena);
+	if (cfg->l1d_pf) {
+		dc->l1d.pf = newPrefetcher(cfg->l1d_pf, cfg->l1d_degree, cfg->l1d_distance, core->arena);
+	}
+	if (cfg->l2_kb > 0) {
+		initCache(&dc->l2, "L2", cfg->l2_kb, cfg->l2_ways, cfg->l2_latency, core->arena);
+		if (cfg->l2_pf) {
+			dc->l2.pf = newPrefetcher(cfg->l2_pf, cfg->l2_degree, cfg->l2_distance, core->arena);
+		}
+	}
+	dc->mem_latency = cfg->mem_latency;
+	if (cfg->dram) {
+		dc->dram = initDRAM(&cfg->dram_cfg, core->arena);
+	}
+	dc->mem_lines = (core->mem_size + (1 << CACHE_LINE_SHIFT) - 1) >> CACHE_LINE_SHIFT;
+	return dc;
+}
+
+static CacheWait memoryRead(DataCache *dc, uint64_t line, Tick at) {
+	CacheWait w = { at + dc->mem_latency, 0 };
+
+	dc->mem_reads++;
+	if (dc->dram) {
+		w.fill = dramRequest(dc->dram, line, false, at);
+	}
+	return w;
+}
+
+// Nothing waits for a write-back
+static void memoryWrite(DataCache *dc, uint64_t line, Tick at) {
+	dc->mem_writes++;
+	if (dc->dram) {
+		dramRequest(dc->dram, line, true, at);
+	}
+}
+
+Tick dataCacheReady(DataCache *dc, CacheWait *w, Tick now) {
+	if (w->fill) {
+		Tick done = dramDone(dc->dram, w->fill, now);
+		if (done == TICK_FOREVER) {
+			return TICK_FOREVER;
+		}
+		w->ready = done;
+		w->fill = 0;
+	}
+	return w->ready;
+}
+
+static CacheLine *lookup(Cache *c, uint64_t line) {
+	CacheLine *set = &c->lines[(line % c->sets) * c->ways];
+	int w;
+
+	for (w=0; w<c->ways; w++) {
+		if (set[w].valid && set[w].line == line) {
+			return &set[w];
+		}
+	}
+	return NULL;
+}
+
+// The way line replaces in its set, written back if dirty
+static CacheLine *evict(DataCache *dc, Cache *c, uint64_t line, Tick now) {
+	CacheLine *set = &c->lines[(line % c->sets) * c->ways];
+	CacheLine *victim = &set[0];
+	int w;
+
+	for (w=0; w<c->ways && victim->valid; w++) {
+		if (!set[w].valid || set[w].used < victim->used) {
+			victim = &set[w];
+		}
+	}
+	if (!victim->valid) {
+		return victim;
+	}
+	if (victim->prefetched) {
+		c->pf->unused++;
+	}
+	if (victim->dirty) {
+		CacheLine *below = c == &dc->l1d && dc->l2.sets ? lookup(&dc->l2, victim->line) : NULL;
+		c->writebacks++;
+		if (below) {
+			below->dirty = true;
+		} else {
+			memoryWrite(dc, victim->line, now);
+		}
+	}
+	return victim;
+}
+
+static CacheLine *lineAccess(DataCache *dc, Cache *c, uint64_t line, Tick now, const Request *rq, CacheWait *w);
+
+static void prefetch(DataCache *dc, Cache *c, const Request *rq, bool miss, Tick now) {
+	uint64_t lines[PREFETCH_MAX_DEGREE];
+	int i, n = c->pf->kind->train(c->pf, rq->pc, rq->addr, miss, lines);
+	CacheWait w;
+
+	for (i=0; i<n; i++) {
+		if (lines[i] >= dc->mem_lines) {
+			continue;
+		}
+		if (lookup(c, lines[i])) {
+			c->pf->redundant++;
+			continue;
+		}
+		lineAccess(dc, c, lines[i], now, NULL, &w)->prefetched = true;
+		c->pf->issued++;
+	}
+}
+
+// The line in c, filled from below on a miss; *w: when its data is
+// there for an access starting at now. rq is NULL for a prefetch fill,
+// which is neither counted nor trained on.
+static CacheLine *lineAccess(DataCache *dc, Cache *c, uint64_t line, Tick now, const Request *rq, CacheWait *w) {
+	CacheLine *l = lookup(c, line);
+	bool trigger = l == NULL;
+
+	now += c->latency;
+	if (l) {
+		Tick ready = dataCacheReady(dc, &l->arrival, now);
+		*w = l->arrival;
+		if (ready < now) {
+			w->ready = now;
+		}
+		if (rq && l->prefetched) {
+			l->prefetched = false;
+			c->pf->useful++;
+			if (ready > now) {
+				c->pf->late++;
+			}
+			trigger = true;  // what tagged prefetching runs on
+		}
+	} else {
+		if (c == &dc->l1d && dc->l2.sets) {
+			Request below;
+			if (rq) {
+				below = *rq;
+				below.store = false;  // the dirty copy is the L1D's
+			}
+			lineAccess(dc, &dc->l2, line, now, rq ? &below : NULL, w);
+		} else {
+			*w = memoryRead(dc, line, now);
+		}
+		l = evict(dc, c, line, now);
+		l->line = line;
+		l->arrival = *w;
+		l->valid = true;
+		l->dirty = false;
+		l->prefetched = false;
+		if (rq) {
+			c->misses++;
+		}
+	}
+	l->used = now;
+	if (rq) {
+		c->accesses++;
+		l->dirty |= rq->store;
+		if (c->pf) {
+			prefetch(dc, c, rq, trigger, now);
+		}
+	}
+	return l;
+}
+
+CacheWait dataCacheAccess(DataCache *dc, Addr addr, Addr pc, bool store, Tick now) {
+	Request rq = { pc, addr, store };
+	CacheWait w;
+
+	lineAccess(dc, &dc->l1d, addr >> CACHE_LINE_SHIFT, now, &rq, &w);
+	return w;
+}
+
+int dataCacheBlocks(DataCache *dc, Core *core, const PipeInstr *PI, Addr addr) {
+	if (dc->pending_seq != PI->seq) {
+		dc->pending_seq = PI->seq;
+		dc->pending = dataCacheAccess(dc, addr, PI->pc, PI->dec->ctrl_signals.MemWrite, core->clk);
+		if (dataCacheReady(dc, &dc->pending, core->clk) > core->clk) {
+			dc->waits++;
+		}
+	}
+	if (dataCacheReady(dc, &dc->pending, core->clk) > core->clk) {
+		dc->wait_cycles++;
+		return STALL_CACHE;
+	}
+	return 0;
+}
+
+static void printCache(const Cache *c) {
+	const Prefetcher *pf = c->pf;
+
+	printf("%s: %d KiB, %d-way, %d sets", c->name, (c->sets * c->ways) >> (10 - CACHE_LINE_SHIFT), c->ways, c->sets);
+	if (c->latency) {
+		printf(", %d-cycle lookup", c->latency);
+	}
+	printf(": %" PRIu64 " accesses, %" PRIu64 " misses (%.2f%% miss rate), %" PRIu64 " write-backs\n",
+		c->accesses, c->misses, c->accesses ? 100.0 * c->misses / c->accesses : 0.0, c->writebacks);
+	if (pf == NULL) {
+		return;
+	}
+	// Coverage: the misses prefetching removed, out of the ones there
+	// would have been
+	printf("%s prefetcher %s (degree %d, distance %d): %" PRIu64 " issued, %" PRIu64 " redundant, %" PRIu64
+		" useful, %" PRIu64 " late, %" PRIu64 " evicted unused\n", c->name, pf->kind->name, pf->degree, pf->distance,
+		pf->issued, pf->redundant, pf->useful, pf->late, pf->unused);
+	printf("%s prefetcher %s: accuracy %.1f%%, coverage %.1f%%, lateness %.1f%%\n", c->name, pf->kind->name,
+		pf->issued ? 100.0 * pf->useful / pf->issued : 0.0,
+		pf->useful + c->misses ? 100.0 * pf->useful / (pf->useful + c->misses) : 0.0,
+		pf->useful ? 100.0 * pf->late / pf->useful : 0.0);
+}
+
+void printDataCacheStats(const DataCache *dc, Tick cycles) {
+	printCache(&dc->l1d);
+	if (dc->l2.sets) {
+		printCache(&dc->l2);
+	}
+	printf("MEM waited for the data cache %" PRIu64 " times, %.1f cycles each on average\n",
+		dc->waits, dc->waits ? (double)dc->wait_cycles / dc->waits : 0.0);
+	if (dc->dram) {
+		printf("Memory: %" PRIu64 " lines read, %" PRIu64 " written back\n", dc->mem_reads, dc->mem_writes);
+		printDRAMStats(dc->dram, cycles);
+	} else {
+		printf("Memory: %d-cycle latency, %" PRIu64 " lines read, %" PRIu64 " written back\n",
+			dc->mem_latency, dc->mem_reads, dc->mem_writes);
+	}
+}
@@ -0,0 +1,138 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "DRAM.h"
+#include "Pipeline.h"
+#include "Prefetch.h"
+
+/*------------------ Cache.h -------------------
+ |
+ |  --dcache: a timing model of the data side for
+ |  the in-order pipelines, an L1D and an optional
+ |  L2 in front of memory. Both are set-associative
+ |  with 64-byte lines, LRU replacement, write-
+ |  allocate and write-back; data memory still
+ |  holds the values, the caches only hold tags.
+ |
+ |  A load or store reaching MEM looks its line
+ |  up in the L1D. A hit costs nothing beyond the
+ |  stage; a miss holds MEM, and everything behind
+ |  it, until the line arrives: the L2 lookup
+ |  latency, plus, if the L2 misses too, the
+ |  memory latency or whatever the DRAM model
+ |  (--dram, see DRAM.h) takes. A line already on
+ |  its way (from a prefetch) is waited for, not
+ |  asked for again.
+ |  With a store buffer the stores go through the
+ |  L1D as they drain instead, so a store miss
+ |  only lengthens the drain. Vector loads and
+ |  stores bypass the model.
+ |
+ |  Each level can have a prefetcher (--prefetch,
+ |  see Prefetch.h), trained on that level's
+ |  demand accesses; for the L2 those are the L1D
+ |  misses. Prefetched lines fill the level from
+ |  the one below with the same latencies, and
+ |  the first demand use of one counts as useful,
+ |  or late if it had not arrived yet.
+ |
+ *----------------------------------------------*/
+
+#define CACHE_LINE_SHIFT 6   // 64-byte lines
+
+// When data is there: from cycle ready, or, if fill is set, once that
+// DRAM request has been scheduled
+typedef struct CacheWait
+{
+	Tick ready;
+	uint64_t fill;
+}CacheWait;
+
+typedef struct CacheLine
+{
+	uint64_t line;    // address >> CACHE_LINE_SHIFT
+	Tick used;        // last access, for LRU
+	CacheWait arrival; // of the fill
+	bool valid;
+	bool dirty;
+	bool prefetched;  // brought in by a prefetch, no demand use yet
+}CacheLine;
+
+typedef struct Cache
+{
+	const char *name;
+	CacheLine *lines;   // sets * ways, a set's ways together
+	int sets;           // 0: the level is left out
+	int ways;
+	int latency;        // lookup cycles, 0 for the L1D (part of MEM)
+	Prefetcher *pf;     // NULL if none
+
+	// Statistics, demand accesses only
+	uint64_t accesses;
+	uint64_t misses;
+	uint64_t writebacks;   // dirty lines evicted
+}Cache;
+
+// Sizes in KiB; --dcache and --prefetch fill this in
+typedef struct CacheConfig
+{
+	int l1d_kb, l1d_ways;
+	int l2_kb, l2_ways, l2_latency;  // l2_kb 0: no L2
+	int mem_latency;
+	bool dram;                       // dram_cfg instead of mem_latency
+	DRAMConfig dram_cfg;
+	const PrefetcherKind *l1d_pf, *l2_pf;
+	int l1d_degree, l1d_distance;
+	int l2_degree, l2_distance;
+}CacheConfig;
+
+typedef struct DataCache
+{
+	Cache l1d;
+	Cache l2;
+	int mem_latency;
+	DRAM *dram;              // NULL: memory takes mem_latency
+	uint64_t mem_lines;      // lines of data memory, prefetches past it are dropped
+
+	// The access of the instruction in MEM
+	uint64_t pending_seq;
+	CacheWait pending;
+
+	// Statistics
+	uint64_t mem_reads;      // lines read from memory
+	uint64_t mem_writes;     // dirty lines written back to memory
+	uint64_t waits;          // MEM accesses that had to wait
+	uint64_t wait_cycles;    // ... and the cycles they waited
+}DataCache;
+
+// 32 KiB 8-way L1D, 256 KiB 8-way L2 with a 12-cycle lookup,
+// 100-cycle memory, no prefetchers, and the DRAM defaults for --dram
+void cacheConfigDefaults(CacheConfig *cfg);
+
+// "default", or a comma-separated list of l1d=KB:WAYS, l2=KB:WAYS:LATENCY
+// (l2=0 for none) and mem=LATENCY; false (and a message) if malformed
+bool parseCacheSpec(const char *spec, CacheConfig *cfg);
+
+// Comma-separated l1d=NAME[:DEGREE[:DISTANCE]] and l2=...; false (and a
+// message) if malformed or the name is unknown
+bool parsePrefetchSpec(const char *spec, CacheConfig *cfg);
+
+// From the arena, for the core's current data memory
+DataCache *initDataCache(Core *core, const CacheConfig *cfg);
+
+// Demand access at cycle now
+CacheWait dataCacheAccess(DataCache *dc, Addr addr, Addr pc, bool store, Tick now);
+
+// The cycle w's data is there, TICK_FOREVER if DRAM has not said yet
+Tick dataCacheReady(DataCache *dc, CacheWait *w, Tick now);
+
+// MEM: STALL_CACHE while the load or store at addr (physical) waits
+// for its line, 0 once it has it
+int dataCacheBlocks(DataCache *dc, Core *core, const PipeInstr *PI, Addr addr);
+
+void printDataCacheStats(const DataCache *dc, Tick cycles);
+
+#endif
@@ -0,0 +1,253 @@
+#include "Check.h"
+
+#include <inttypes.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Core.h"
+
+/*------------------ Check.c -------------------
+ |
+ |  Purpose: The --check ring, the checker
+ |		thread and the comparison of each
+ |		retired instruction with the
+ |		reference model.
+ |
+ *----------------------------------------------*/
+
+#define SPINS_BEFORE_YIELD 64
+
+static void cpuRelax(int *spins) {
+	if (++*spins < SPINS_BEFORE_YIELD) {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	} else {
+		sched_yield();
+	}
+}
+
+static const char *instrText(const Checker *ck, Addr pc) {
+	const Instruction *instr = instructionAt(ck->ref.i_mem, pc);
+	return instr ? instr->text : "?";
+}
+
+// Keeps the first report only
+static void stopChecking(Checker *ck, CheckState state, const RetireRecord *rec, const char *fmt, ...) {
+	va_list ap;
+	int n = 0;
+
+	if (rec) {
+		n = snprintf(ck->report, sizeof(ck->report), "retired instruction [%" PRIu64 "] at cycle %" PRIu64
+			", PC %" PRIu64 " (%s): ", rec->seq, rec->cycle, rec->pc, instrText(ck, rec->pc));
+	}
+	va_start(ap, fmt);
+	vsnprintf(ck->report + n, sizeof(ck->report) - n, fmt, ap);
+	va_end(ap);
+	__atomic_store_n(&ck->state, state, __ATOMIC_RELEASE);
+}
+
+static const char *regName(int rd, char *buf) {
+	if (rd < 0) {
+		return "no register";
+	}
+	sprintf(buf, "x%d", rd);
+	return buf;
+}
+
+static void checkRecord(Checker *ck, const RetireRecord *rec) {
+	RefModel *ref = &ck->ref;
+	RefEffect eff, tail;
+	RefStatus status;
+	char a[16], b[16];
+
+	if (rec->vector) {
+		stopChecking(ck, CHECK_GAVE_UP, rec, "vector instructions are not modelled");
+		return;
+	}
+	if (rec->pc != ref->pc) {
+		stopChecking(ck, CHECK_DIVERGED, rec, "the reference is at PC %" PRIu64, ref->pc);
+		return;
+	}
+	status = refStep(ref, &eff);
+	if (status == REF_OK && rec->fused) {
+		// The pair writes one register, with the value it has after both
+		status = refStep(ref, &tail);
+		if (eff.rd < 0) {
+			eff.rd = tail.rd;
+		}
+		if (eff.rd >= 0) {
+			eff.rd_val = ref->x[eff.rd];
+		}
+	}
+	switch (status) {
+		case REF_OK:
+			break;
+		case REF_UNSUPPORTED:
+			stopChecking(ck, CHECK_GAVE_UP, rec, "the reference does not model instruction 0x%08x", eff.instruction);
+			return;
+		case REF_BAD_ADDRESS:
+			stopChecking(ck, CHECK_DIVERGED, rec, "the reference accesses memory outside the %zu-byte data memory",
+				ref->mem_size);
+			return;
+		case REF_END:
+			stopChecking(ck, CHECK_DIVERGED, rec, "the reference has no instruction there");
+			return;
+	}
+
+	if (rec->rd != eff.rd) {
+		stopChecking(ck, CHECK_DIVERGED, rec, "wrote %s, the reference writes %s",
+			regName(rec->rd, a), regName(eff.rd, b));
+	} else if (eff.rd >= 0 && rec->rd_val != eff.rd_val) {
+		stopChecking(ck, CHECK_DIVERGED, rec, "x%d = %" PRId64 ", the reference has %" PRId64,
+			eff.rd, rec->rd_val, eff.rd_val);
+	} else if (rec->store != eff.store) {
+		stopChecking(ck, CHECK_DIVERGED, rec, rec->store ? "stored, the reference does not"
+			: "did not store, the reference does");
+	} else if (eff.store && rec->store_addr != eff.store_addr) {
+		stopChecking(ck, CHECK_DIVERGED, rec, "stored to address %" PRIu64 ", the reference to %" PRIu64,
+			rec->store_addr, eff.store_addr);
+	} else if (eff.store && rec->store_len != eff.store_len) {
+		stopChecking(ck, CHECK_DIVERGED, rec, "stored %u bytes, the reference %u",
+			rec->store_len, eff.store_len);
+	} else if (eff.store && rec->store_data != eff.store_data) {
+		stopChecking(ck, CHECK_DIVERGED, rec, "stored %" PRId64 ", the reference %" PRId64,
+			(int64_t)rec->store_data, (int64_t)eff.store_data);
+	} else {
+		ck->checked += rec->fused ? 2 : 1;
+	}
+}
+
+static void *checkerThread(void *arg) {
+	Checker *ck = arg;
+	uint64_t tail = 0;
+	int spins = 0;
+
+	for (;;) {
+		if (tail == ck->head_cache) {
+			bool done = __atomic_load_n(&ck->done, __ATOMIC_ACQUIRE);
+			ck->head_cache = __atomic_load_n(&ck->head, __ATOMIC_ACQUIRE);
+			if (tail == ck->head_cache) {
+				if (done) {
+					break;
+				}
+				cpuRelax(&spins);
+				continue;
+			}
+		}
+		spins = 0;
+		// After a divergence the rest is only drained
+		if (ck->state == CHECK_RUNNING) {
+			checkRecord(ck, &ck->ring[tail & (CHECK_RING - 1)]);
+		}
+		__atomic_store_n(&ck->tail, ++tail, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+Checker *startChecker(Core *core) {
+	Checker *ck = arenaAlloc(core->arena, sizeof(Checker));
+
+	if (!initRef(&ck->ref, core->instr_mem, core->reg_file, core->PC, core->data_mem, core->mem_size)) {
+		printf("Check: not enough memory for the reference model.\n");
+		return NULL;
+	}
+	if (pthread_create(&ck->thread, NULL, checkerThread, ck) != 0) {
+		perror("Cannot start the checker thread");
+		freeRef(&ck->ref);
+		return NULL;
+	}
+	return ck;
+}
+
+void checkRetire(Checker *ck, const RetireRecord *rec) {
+	uint64_t head = ck->head;
+	int spins = 0;
+
+	if (__atomic_load_n(&ck->state, __ATOMIC_RELAXED) != CHECK_RUNNING) {
+		return;
+	}
+	// Full: wait for the checker to catch up
+	while (head - ck->tail_cache == CHECK_RING) {
+		ck->tail_cache = __atomic_load_n(&ck->tail, __ATOMIC_ACQUIRE);
+		if (head - ck->tail_cache == CHECK_RING) {
+			cpuRelax(&spins);
+		}
+	}
+	ck->ring[head & (CHECK_RING - 1)] = *rec;
+	__atomic_store_n(&ck->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void checkRetireInstr(Core *core, const PipeInstr *PI) {
+	Checker *ck = core->checker;
+	RetireRecord rec;
+
+	rec.seq = PI->seq;
+	rec.cycle = core->clk;
+	rec.pc = PI->pc;
+	rec.rd = PI->dec->ctrl_signals.RegWrite && PI->dec->rd != 0 ? PI->dec->rd : -1;
+	rec.rd_val = PI->mem_res;
+	rec.store = PI->dec->ctrl_signals.MemWrite;
+	// What memAccess wrote: the low bytes of rs2 at the ALU result
+	rec.store_len = memWidth(PI->dec->funct3);
+	rec.store_addr = PI->ex->ALU_result;
+	rec.store_data = rec.store_len == 8 ? (uint64_t)PI->dec->reg2_val
+		: (uint64_t)PI->dec->reg2_val & ((1ull << (8 * rec.store_len)) - 1);
+	rec.fused = PI->dec->fuse != FUSE_NONE;
+	rec.vector = PI->dec->ctrl_signals.Vector;
+	checkRetire(ck, &rec);
+
+	// Stop the run at the first divergence the checker has seen
+	if (__atomic_load_n(&ck->state, __ATOMIC_RELAXED) == CHECK_DIVERGED) {
+		core->break_hit = true;
+	}
+}
+
+// After a complete run the end states must agree as well
+static void compareFinal(Checker *ck, const Core *core) {
+	const RefModel *ref = &ck->ref;
+	size_t addr;
+	int i;
+
+	for (i=1; i<32; i++) {
+		if (core->reg_file[i] != ref->x[i]) {
+			stopChecking(ck, CHECK_DIVERGED, NULL, "after the run x%d = %" PRId64 ", the reference has %" PRId64,
+				i, core->reg_file[i], ref->x[i]);
+			return;
+		}
+	}
+	if (memcmp(core->data_mem, ref->mem, core->mem_size) != 0) {
+		for (addr=0; core->data_mem[addr] == ref->mem[addr]; addr++) {
+		}
+		stopChecking(ck, CHECK_DIVERGED, NULL, "after the run byte %zu = %u, the reference has %u",
+			addr, core->data_mem[addr], ref->mem[addr]);
+	}
+}
+
+bool finishChecker(Checker *ck, Core *core, bool finished) {
+	bool ok;
+
+	__atomic_store_n(&ck->done, true, __ATOMIC_RELEASE);
+	pthread_join(ck->thread, NULL);
+	if (ck->state == CHECK_RUNNING && finished) {
+		compareFinal(ck, core);
+	}
+
+	switch (ck->state) {
+		case CHECK_DIVERGED:
+			printf("\nCheck: DIVERGED after %" PRIu64 " matching instructions, %s\n", ck->checked, ck->report);
+			break;
+		case CHECK_GAVE_UP:
+			printf("\nCheck: stopped after %" PRIu64 " matching instructions, %s\n", ck->checked, ck->report);
+			break;
+		default:
+			printf("\nCheck: %" PRIu64 " instructions match the reference model%s.\n", ck->checked,
+				finished ? ", and so do the final registers and memory" : "");
+			break;
+	}
+	ok = ck->state != CHECK_DIVERGED;
+	freeRef(&ck->ref);
+	return ok;
+}
@@ -0,0 +1,98 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Instruction.h"
+#include "Ref.h"
+
+/*------------------ Check.h -------------------
+ |
+ |  --check: lockstep differential checking of
+ |  the in-order pipeline against the reference
+ |  model (Ref.h). Every instruction the pipeline
+ |  retires is sent as a RetireRecord through a
+ |  single-producer single-consumer ring to a
+ |  checker thread, which steps the reference
+ |  model once per record and compares the PC,
+ |  the register written and its value, and the
+ |  store address and data.
+ |
+ |  The first divergence is kept and the core is
+ |  stopped at its next retire; the pipeline may
+ |  be up to a ring's worth of instructions ahead
+ |  by then, but the report names the first bad
+ |  instruction. When the run ends the final
+ |  registers and memory are compared as well.
+ |
+ |  The ring is the only thing the two threads
+ |  share while running: each side writes only
+ |  its own index and caches the other's, so
+ |  the producer pays one store per record.
+ |
+ *----------------------------------------------*/
+
+#define CHECK_RING 4096  // records in flight, a power of two
+
+typedef struct RetireRecord
+{
+	uint64_t seq;
+	Tick cycle;
+	Addr pc;
+	int64_t rd_val;
+	Addr store_addr;
+	uint64_t store_data;
+	int8_t rd;           // -1 if no register was written
+	uint8_t store_len;
+	bool store;
+	bool fused;          // the head of a fused pair; covers two instructions
+	bool vector;
+}RetireRecord;
+
+typedef enum CheckState
+{
+	CHECK_RUNNING,
+	CHECK_DIVERGED,
+	CHECK_GAVE_UP        // met something the reference does not model
+}CheckState;
+
+typedef struct Checker
+{
+	// Producer side
+	uint64_t head __attribute__((aligned(64)));
+	uint64_t tail_cache;
+
+	// Consumer side
+	uint64_t tail __attribute__((aligned(64)));
+	uint64_t head_cache;
+
+	int state __attribute__((aligned(64)));  // CheckState
+	bool done;                               // no more records coming
+	RetireRecord ring[CHECK_RING];
+
+	RefModel ref;
+	uint64_t checked;    // instructions compared
+	pthread_t thread;
+	char report[512];    // what diverged, or why checking stopped
+}Checker;
+
+struct Core;
+struct PipeInstr;
+
+// Takes the reference's starting point from the core, before it runs
+Checker *startChecker(struct Core *core);
+
+// Called at retire, on the core's thread
+void checkRetire(Checker *ck, const RetireRecord *rec);
+
+// The record for an in-order PipeInstr; stops the core once the
+// checker has found a divergence
+void checkRetireInstr(struct Core *core, const struct PipeInstr *PI);
+
+// Waits for the checker, compares the final state if the program
+// finished, and prints the verdict; false on a divergence
+bool finishChecker(Checker *ck, struct Core *core, bool finished);
+
+#endif
@@ -1,78 +1,121 @@
 #include "Core.h"
+#include "Pipeline.h"
+#include "Cache.h"
+#include "StoreBuffer.h"
+#include "VirtualMemory.h"
 #include <inttypes.h>
+#include <string.h>
 
-Core *initCore(Instruction_Memory *i_mem)
+// Pipeline entry with its decode and execute records, one pool object
+typedef struct PipeSlot
 {
-	int i;
+	PipeInstr instr;
+	Decode dec;
+	Exec ex;
+}PipeSlot;
 
-    Core *core = (Core *)malloc(sizeof(Core));
+Core *initCore(Instruction_Memory *i_mem, Arena *arena)
+{
+    Core *core = (Core *)arenaAlloc(arena, sizeof(Core));
+    core->arena = arena;
+    poolInit(&core->pipe_pool, arena, sizeof(PipeSlot));
     core->clk = 0;
     core->PC = 0;
     core->instr_mem = i_mem;
     core->tick = tickFunc;
-
-    // initialize register file here.
-    // core->data_mem[0] = ...
-	for (i=0; i<1024; i++) {
-		core->data_mem[i] = 0;
-	}
-
-    // initialize data memory here.
-    // core->reg_file[0] = ...
-	for (i=0; i<32; i++) {
-		core->reg_file[i] = 0;
-	}
-
-	/* ../cpu_traces/project_four  *
-	storeDataMem(core, -63, 40);
-	storeDataMem(core, 63, 48);
-
-	core->reg_file[1] = 0;
-	core->reg_file[2] = 10;
-	core->reg_file[3] = -15;
-	core->reg_file[4] = 20;
-	core->reg_file[5] = 30;
-	core->reg_file[6] = -35;
-	********************************/
-
-	/* ../cpu_traces/project_five  */
-	storeDataMem(core, 100, 40);
-
-	core->reg_file[1] = 0;
-	core->reg_file[5] = 26;
-	core->reg_file[6] = -27;
-	/*******************************/
+    core->run = runCore;
+    core->ooo = NULL;
+    core->pipeline = findPipeline(5);
+    core->konata = NULL;
+    core->fusion = 0;
+    core->profile = NULL;
+    core->quiet = false;
+    core->counters = NULL;
+    core->pipe = (PipeState *)arenaAlloc(arena, sizeof(PipeState));
+    core->break_pc = NO_BREAK;
+    core->break_hit = false;
+    core->checker = NULL;
+    core->sb = NULL;
+    core->satp = 0;
+    core->vm = NULL;
+    core->dcache = NULL;
+    core->retired = 0;
+    core->fused_pairs = 0;
+
+	// Multi-cycle functional units: a pipelined 3-cycle multiplier and
+	// an iterative 20-cycle divider
+	core->fu[FU_ALU].latency = 1;
+	core->fu[FU_ALU].pipelined = true;
+	core->fu[FU_MUL].latency = 3;
+	core->fu[FU_MUL].pipelined = true;
+	core->fu[FU_DIV].latency = 20;
+	core->fu[FU_DIV].pipelined = false;
+	core->fu[FU_VEC].latency = 1;
+	core->fu[FU_VEC].pipelined = false;
+
+	initVectorUnit(&core->vec);
+	initFetchBuffer(&core->fetch_buf, i_mem, arena);
+	initLoopDetector(&core->loop);
+
+	// Registers start at zero and memory zeroed (the arena clears what
+	// it hands out); a state file given with --init replaces either.
+	setDataMemory(core, arenaAlloc(arena, DATA_MEM_SIZE), DATA_MEM_SIZE);
 
     return core;
 }
 
-void storeDataMem(Core *core, int64_t data, int start) {
-	int mask = 0;
-	int i;
+void setDataMemory(Core *core, Byte *mem, size_t size) {
+	freeCheckpoint(&core->initial);
+	core->data_mem = mem;
+	core->mem_size = size;
+	initDirtyMap(&core->loaded, core->arena, size);
+	initCheckpoint(&core->initial, core->arena, size);
+}
+
+// Outside the data memory a store is dropped and a load reads 0, as in
+// the lane-parallel core
+void storeDataMem(Core *core, int64_t data, Addr addr, Signal funct3) {
+	unsigned len = memWidth(funct3);
+	unsigned i;
 
-	for (i=start; i<start+8; i++) {
-		core->data_mem[i] = (data >> mask) &0xff;
-		mask+=8;
+	if (addr > core->mem_size || len > core->mem_size - addr) {
+		return;
+	}
+	memWrite(core, addr, len);
+	for (i=0; i<len; i++) {
+		core->data_mem[addr + i] = (data >> (8 * i)) & 0xff;
 	}
 }
 
-int64_t loadDataMem(Core *core, int start) {
-	int64_t result=0;
-	int i;
-	int32_t mask = 0;
+int64_t loadDataMem(Core *core, Addr addr, Signal funct3) {
+	unsigned len = memWidth(funct3);
+	uint64_t raw = 0;
+	unsigned i;
 
-	for (i=start; i<start+8; i++) {
-		result |= ((int64_t) core->data_mem[i]) << mask;
-		mask+=8;
+	if (addr > core->mem_size || len > core->mem_size - addr) {
+		return 0;
 	}
-	
-	return result;
+	for (i=0; i<len; i++) {
+		raw |= (uint64_t)core->data_mem[addr + i] << (8 * i);
+	}
+	return extendLoad(raw, funct3);
 }
 
 // Instruction Fetch
 void fetch(Core *core, PipeInstr *PI) {
-	PI->instruction = core->instr_mem->instructions[core->PC/4].instruction;
-	core->PC += 4;
+	unsigned size;
+	uint64_t block_reads = core->fetch_buf.block_reads;
+
+	PI->instruction = fetchInstruction(&core->fetch_buf, core->instr_mem, core->PC, &size);
+	core->PC += size;
+	fetchFusedTail(core, PI->instruction, size, &PI->fused);
+	PI->next_pc = core->PC;
+	if (core->profile && core->fetch_buf.block_reads != block_reads) {
+		ProfileEntry *e = profileEntry(core->profile, PI->pc);
+		if (e) {
+			e->misses += core->fetch_buf.block_reads - block_reads;
+		}
+	}
 }
 
 // Instruction Decode/Register File Read
@@ -87,6 +130,9 @@ void decode(Core* core, PipeInstr *PI) {
 
 	// Generate control signals
 	ControlUnit(PI->dec->opcode, &PI->dec->ctrl_signals);
+	if (PI->dec->ctrl_signals.Vector) {
+		vectorDecode(PI->dec);
+	}
 
 	// ALU Control unit
 	PI->dec->ALU_ctrl_signal = ALUControlUnit(PI->dec->ctrl_signals.ALUOp, PI->dec->funct7, PI->dec->funct3);
@@ -97,206 +143,211 @@ void decode(Core* core, PipeInstr *PI) {
 
 	// Generate immediate
 	PI->dec->immediate = ImmeGen(PI->instruction);
+
+	PI->dec->fuse = FUSE_NONE;
+	if (PI->fused.kind != FUSE_NONE) {
+		fuseDecode(PI->dec, &PI->fused);
+		PI->dec->reg2_val = core->reg_file[PI->dec->rs2];
+	}
 }
 
-// Execute stage
-void execute(Core *core, PipeInstr *PI, int pipe_idx) {
-	// Read values from register files
-	PI->dec->reg1_val = core->reg_file[PI->dec->rs1];
-	PI->dec->reg2_val = core->reg_file[PI->dec->rs2];
+// Execute stage. val1/val2 are the rs1/rs2 values after forwarding.
+void execute(Core *core, PipeInstr *PI, Signal val1, Signal val2) {
+	PI->dec->reg1_val = val1;
+	PI->dec->reg2_val = val2;
+	PI->ex->branch_taken = 0;
 
-	// Forward signals
-	Signal forwardA = 0;
-	Signal forwardB = 0;
-	Signal val1 = PI->dec->reg1_val;
-	Signal val2 = PI->dec->reg2_val;
-	
-	if (PI->dec->rs1 != 0) {
-		if (pipe_idx >= 1) { 
-			if (core->pipe[pipe_idx-1]->dec->ctrl_signals.RegWrite 
-				&& core->pipe[pipe_idx-1]->dec->rd == PI->dec->rs1) {	
-				// Forward from execute stage
-				forwardA = 2;
-				if (core->pipe[pipe_idx-1]->dec->opcode == 3) { // previous instr was a load type
-					val1 = core->pipe[pipe_idx-1]->mem_res;
-				} else { 
-					val1 = core->pipe[pipe_idx-1]->ex->ALU_result;	
-				}
-			}
-		} 
-		if (pipe_idx >= 2) {	
-			if (core->pipe[pipe_idx-2]->dec->ctrl_signals.RegWrite 
-					&& core->pipe[pipe_idx-2]->dec->rd == PI->dec->rs1) {	
-				forwardA = 1;
-				// Forward from memory stage
-				val1 = core->pipe[pipe_idx-2]->mem_res;
-			}
-		}
+	if (PI->dec->ctrl_signals.Vector) {
+		vectorExecute(core, PI, val1, val2);
+		return;
 	}
-
-	if (PI->dec->rs2 != 0) {
-		if (pipe_idx >= 1) { 
-			if (core->pipe[pipe_idx-1]->dec->ctrl_signals.RegWrite 
-				&& core->pipe[pipe_idx-1]->dec->rd == PI->dec->rs2) {	
-				// Forward from execute stage
-				forwardB = 2;
-				if (core->pipe[pipe_idx-1]->dec->opcode == 3) { // previous instr was a load type
-					val2 = core->pipe[pipe_idx-1]->mem_res;
-				} else { 
-					val2 = core->pipe[pipe_idx-1]->ex->ALU_result;	
-				}
-			}
-		} 
-		if (pipe_idx >= 2) {	
-			if (core->pipe[pipe_idx-2]->dec->ctrl_signals.RegWrite 
-					&& core->pipe[pipe_idx-2]->dec->rd == PI->dec->rs2) {	
-				// Forward from memory stage
-				forwardB = 1;
-				val2 = core->pipe[pipe_idx-2]->mem_res;
-			}
-		}
+	if (PI->dec->fuse != FUSE_NONE) {
+		fusedExecute(PI->dec, PI->pc, val1, val2, &PI->ex->ALU_result,
+			&PI->ex->branch_taken, &PI->ex->branch_target);
+		return;
 	}
 
 	// ALU operation
 	PI->ex->ALU_2nd_val = MUX(PI->dec->ctrl_signals.ALUSrc, val2, PI->dec->immediate);
 	ALU(val1, PI->ex->ALU_2nd_val, PI->dec->ALU_ctrl_signal, &(PI->ex->ALU_result), &(PI->ex->zero), &(PI->ex->neg));
 
-	if (forwardA) {
-		printf("In execute stage of instruction [%d], forwardA = %ld.\n", pipe_idx + 1, forwardA);
-	} 
-	if (forwardB) {
-		printf("In execute stage of instruction [%d], forwardB = %ld.\n", pipe_idx + 1, forwardB);
+	// Branch resolution
+	if (PI->dec->ctrl_signals.Branch) {
+		PI->ex->branch_taken = BranchUnit(PI->dec->funct3, val1, val2, PI->ex->zero, PI->ex->neg);
+		PI->ex->branch_target = Add(PI->pc, ShiftLeft1(PI->dec->immediate));
 	}
 }
 
 // Memory access stage
 void memAccess(Core *core, PipeInstr *PI) {
-	int64_t mem_dat = loadDataMem(core, PI->ex->ALU_result);
+	if (PI->dec->ctrl_signals.Vector && !PI->dec->ctrl_signals.RegWrite) {
+		if (PI->dec->opcode != OPCODE_OP_V) {
+			vectorMemAccess(core, PI);
+		}
+		return;
+	}
+
+	// The address the ALU computed, translated by memStageBlocks
+	Addr addr = core->vm ? PI->mem_addr : (Addr)PI->ex->ALU_result;
+	int64_t mem_dat = 0;
+	if (PI->dec->ctrl_signals.MemRead) {
+		mem_dat = core->sb ? storeBufferLoad(core->sb, core, addr, PI->dec->funct3)
+			: loadDataMem(core, addr, PI->dec->funct3);
+	}
 	PI->mem_res = MUX(PI->dec->ctrl_signals.MemtoReg, PI->ex->ALU_result, mem_dat);
 
-	// write to memory (store)
+	// write to memory (store): rs2 at the address, or into the store
+	// buffer, which writes it later
 	if (PI->dec->ctrl_signals.MemWrite) {
-		storeDataMem(core, PI->mem_res, PI->dec->reg2_val);
+		if (core->sb) {
+			storeBufferPush(core->sb, core, PI->dec->reg2_val, addr, PI->dec->funct3, PI->pc);
+		} else {
+			storeDataMem(core, PI->dec->reg2_val, addr, PI->dec->funct3);
+		}
 	}
 }
+
+int memStageBlocks(Core *core, PipeInstr *PI) {
+	Addr addr = PI->ex->ALU_result;
+	bool vector_mem = PI->dec->ctrl_signals.Vector
+		&& (PI->dec->opcode == OPCODE_VLOAD || PI->dec->opcode == OPCODE_VSTORE);
+	int cause;
+
+	if (core->vm && (PI->dec->ctrl_signals.MemRead || PI->dec->ctrl_signals.MemWrite || vector_mem)) {
+		if ((cause = vmDataBlocks(core->vm, core, PI))) {
+			return cause;
+		}
+		addr = PI->mem_addr;
+	}
+	// Buffered stores reach the cache as they drain
+	if (core->dcache && (PI->dec->ctrl_signals.MemRead || (PI->dec->ctrl_signals.MemWrite && !core->sb))) {
+		if ((cause = dataCacheBlocks(core->dcache, core, PI, addr))) {
+			return cause;
+		}
+	}
+	return core->sb ? storeBufferBlocks(core->sb, PI->dec, addr) : 0;
+}
 	
 // Write back stage
 void writeBack(Core *core, PipeInstr *PI) { 
-	if (PI->dec->ctrl_signals.RegWrite) {
+	if (PI->dec->ctrl_signals.RegWrite && PI->dec->rd != 0) {
 		core->reg_file[PI->dec->rd] = PI->mem_res;
 	}
 }
 
-// implement this function
-bool tickFunc(Core *core)
-{
-	int fetch_instr = 0;
-	int decode_instr = -1;
-	int exec_instr = -2;
-	int mem_instr = -3;
-	int wb_instr = -4;
-	int num_instr = core->instr_mem->last->addr / 4 + 1;
-	int stall_ex = 0;
-	int stall_mem = 0;
-	int stall_wb = 0;
-	int i;
-	// create a new pipe
-	core->pipe = malloc(num_instr * sizeof(PipeInstr));
-	
-	// pipeline
-	while (wb_instr < num_instr) {
-		printf("======================== Clock cycle %ld ========================\n", core->clk+1);
-
-		if (fetch_instr < num_instr) {
-			core->pipe[fetch_instr] = malloc(sizeof(PipeInstr));
-			core->pipe[fetch_instr]->dec = malloc(sizeof(Decode));
-			core->pipe[fetch_instr]->ex = malloc(sizeof(Exec));
-			fetch(core, core->pipe[fetch_instr]);
-			printf("Fetched instruction [%d].\n", fetch_instr + 1);
-				printf("-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-\n");
-		}
+// Static instruction at pc (binary search, addresses are increasing)
+const Instruction *instructionAt(const Instruction_Memory *i_mem, Addr pc) {
+	long lo = 0;
+	const Instruction *last = __atomic_load_n(&i_mem->last, __ATOMIC_ACQUIRE);
+	long hi = last ? last - i_mem->instructions : -1;
 
-		if (decode_instr >= 0 && decode_instr < num_instr) {
-			decode(core, core->pipe[decode_instr]);
-			if (decode_instr >= 1) {
-				if ((core->pipe[decode_instr-1]->dec->opcode == 3)
-					&& (core->pipe[decode_instr-1]->dec->rd == core->pipe[decode_instr]->dec->rs1 || core->pipe[decode_instr-1]->dec->rd == core->pipe[decode_instr]->dec->rs2)) {
-					// insert a bubble if the previous instruction is a load type and introduces data hazards
-					stall_ex = 1;
-					printf("Inserting a bubble in the next clock cycle because of data hazard.\n");
-				}
-			}
-			printf("Decoded instruction [%d].\n", decode_instr + 1);
-				printf("-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-\n");
-		}	
-
-		if ((exec_instr < num_instr) && (exec_instr >= 0)) {
-			if (!stall_mem) { 
-				execute(core, core->pipe[exec_instr], exec_instr);
-				printf("Executed instruction [%d].\n", exec_instr + 1);
-				printf("-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-\n");
-			} 
+	while (lo <= hi) {
+		long mid = lo + (hi - lo) / 2;
+		if (i_mem->instructions[mid].addr == pc) {
+			return &i_mem->instructions[mid];
 		}
-
-		if ((mem_instr < num_instr) && (mem_instr >= 0)) {
-			if (!stall_wb) {
-				memAccess(core, core->pipe[mem_instr]);
-				printf("Accessed memory for instruction [%d].\n", mem_instr + 1);
-				printf("-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-\n");
-			}
+		if (i_mem->instructions[mid].addr < pc) {
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
 		}
+	}
+	return NULL;
+}
 
-		if (wb_instr >= 0) {  
-			writeBack(core, core->pipe[wb_instr]);	
-			printf("Wrote back to register for instruction [%d].\n", wb_instr + 1);
-			if (core->pipe[wb_instr]->dec->ctrl_signals.RegWrite) {
-				printf("New register value: x[%ld] = %ld.\n", core->pipe[wb_instr]->dec->rd, core->pipe[wb_instr]->mem_res);
-				printf("-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-\n");
-			}
-		}
+PipeInstr *newPipeInstr(Core *core, uint64_t seq, Addr pc) {
+	PipeSlot *slot = poolGet(&core->pipe_pool);
+	PipeInstr *PI = &slot->instr;
+	PI->dec = &slot->dec;
+	PI->ex = &slot->ex;
+	PI->seq = seq;
+	PI->pc = pc;
+	PI->done = -1;
+	PI->stage = NULL;
+	PI->predicted_taken = false;
+	PI->fetch_fault = false;
+	PI->fused.kind = FUSE_NONE;
+	return PI;
+}
 
-		printf("\n");
-		// ensuring that the bubble is inserted for every instruction afterwards
-		if (stall_ex) {
-			exec_instr--;
-			stall_ex = 0;
-			stall_mem = 1;
-		} else if (stall_mem) {
-			mem_instr--;
-			stall_mem = 0;
-			stall_wb = 1;
-		} else if (stall_wb) {
-			wb_instr--;
-			stall_wb = 0;
-		}
+// PI is the first member of its PipeSlot
+void freePipeInstr(Core *core, PipeInstr *PI) {
+	poolPut(&core->pipe_pool, PI);
+}
 
-		fetch_instr++;
-		decode_instr++;
-		exec_instr++;
-		mem_instr++;
-		wb_instr++;
-    	++core->clk;
-	}
+// Vector .vv/.vs forms name a vector register in the rs1 field
+bool usesRs1(Decode *dec) {
+	return !dec->ctrl_signals.Vector || vectorUsesRs1(dec);
+}
 
-    // Are we reaching the final instruction?
-    if (core->PC > core->instr_mem->last->addr)
-    {
-        return false;
-    }
+// R-type, store and branch instructions read rs2; for the others those
+// bits belong to the immediate.
+bool usesRs2(Decode *dec) {
+	if (dec->ctrl_signals.Vector) {
+		return vectorUsesRs2(dec);
+	}
+	return dec->ctrl_signals.ALUSrc == 0 || dec->ctrl_signals.MemWrite;
+}
 
-	// free memory
-	for (i=0; i<num_instr; i++) {
-		free(core->pipe[i]->dec);
-		free(core->pipe[i]->ex);
-		free(core->pipe[i]);
+// Run the program on the selected in-order pipeline (see Pipeline.c),
+// using the least instrumented run loop that still does what was asked
+bool runCore(Core *core, Tick until)
+{
+	if (!core->quiet) {
+		return core->pipeline->run(core, until);
+	}
+	if (core->konata || core->profile || core->loop.confirm || core->counters || core->checker) {
+		return core->pipeline->run_silent(core, until);
 	}
-    return true;
+	return core->pipeline->run_quiet(core, until);
+}
+
+bool tickFunc(Core *core)
+{
+	return core->run(core, core->clk + 1);
+}
+
+bool tickCycles(Core *core, Tick n)
+{
+	return core->run(core, n > TICK_FOREVER - core->clk ? TICK_FOREVER : core->clk + n);
+}
 
-	/*
-	free(PI->dec);
-	free(PI->ex);
-	free(PI);
-	*/
+bool coreFinished(Core *core)
+{
+	// A run with no cycles to go only checks whether anything is left
+	return !core->run(core, core->clk);
+}
+
+void restartCore(Core *core)
+{
+	PipeState *ps = core->pipe;
+	MemCheckpoint undo = core->loop.undo;
+	int confirm = core->loop.confirm;
+	int s;
+
+	for (s=0; s<MAX_STAGES; s++) {
+		if (ps->stage[s]) {
+			freePipeInstr(core, ps->stage[s]);
+		}
+	}
+	memset(ps, 0, sizeof(*ps));
+	// Retired stores are part of the state that stays
+	if (core->sb) {
+		storeBufferFlush(core->sb, core);
+	}
+	if (core->dcache) {
+		core->dcache->pending_seq = 0;
+	}
+	core->clk = 0;
+	core->retired = 0;
+	core->fused_pairs = 0;
+	core->break_hit = false;
+	resetFetchBuffer(&core->fetch_buf);
+
+	// Start the detector over, keeping its rollback checkpoint
+	initLoopDetector(&core->loop);
+	core->loop.confirm = confirm;
+	core->loop.undo = undo;
 }
 
 // (1). Control Unit. Refer to Figure 4.18.
@@ -311,6 +362,16 @@ void ControlUnit(Signal input,
         signals->MemWrite = 0;
         signals->Branch = 0;
         signals->ALUOp = 2;
+        signals->Vector = 0;
+    } else if (input == 59) { // R-Type word (RV64M *w)
+        signals->ALUSrc = 0;
+        signals->MemtoReg = 0;
+        signals->RegWrite = 1;
+        signals->MemRead = 0;
+        signals->MemWrite = 0;
+        signals->Branch = 0;
+        signals->ALUOp = 3;
+        signals->Vector = 0;
     } else if (input == 3) { // Load 
         signals->ALUSrc = 1;
         signals->MemtoReg = 1;
@@ -319,6 +380,7 @@ void ControlUnit(Signal input,
         signals->MemWrite = 0;
         signals->Branch = 0;
         signals->ALUOp = 0;
+        signals->Vector = 0;
     } else if (input == 19) { // I-Type 
         signals->ALUSrc = 1;
         signals->MemtoReg = 0;
@@ -326,7 +388,17 @@ void ControlUnit(Signal input,
         signals->MemRead = 0;
         signals->MemWrite = 0;
         signals->Branch = 0;
-        signals->ALUOp = 0;
+        signals->ALUOp = 5;
+        signals->Vector = 0;
+    } else if (input == 27) { // I-Type word (addiw, slliw, srliw, sraiw)
+        signals->ALUSrc = 1;
+        signals->MemtoReg = 0;
+        signals->RegWrite = 1;
+        signals->MemRead = 0;
+        signals->MemWrite = 0;
+        signals->Branch = 0;
+        signals->ALUOp = 6;
+        signals->Vector = 0;
     } else if (input == 35) { // Store 
         signals->ALUSrc = 1;
         signals->MemtoReg = 0;
@@ -335,6 +407,7 @@ void ControlUnit(Signal input,
         signals->MemWrite = 1;
         signals->Branch = 0;
         signals->ALUOp = 0;
+        signals->Vector = 0;
     } else if (input == 99) { // Branch 
         signals->ALUSrc = 0;
         signals->MemtoReg = 0;
@@ -343,6 +416,16 @@ void ControlUnit(Signal input,
         signals->MemWrite = 0;
         signals->Branch = 1;
         signals->ALUOp = 1;
+        signals->Vector = 0;
+    } else if (input == OPCODE_OP_V || input == OPCODE_VLOAD || input == OPCODE_VSTORE) { // Vector
+        signals->ALUSrc = 1;
+        signals->MemtoReg = 0;
+        signals->RegWrite = 0;
+        signals->MemRead = 0;
+        signals->MemWrite = 0;
+        signals->Branch = 0;
+        signals->ALUOp = 4;
+        signals->Vector = 1;
     } else { // Default case
         signals->ALUSrc = 0;
         signals->MemtoReg = 0;
@@ -351,54 +434,52 @@ void ControlUnit(Signal input,
         signals->MemWrite = 0;
         signals->Branch = 0;
         signals->ALUOp = 0;
+        signals->Vector = 0;
 	}
 }
 
 // (2). ALU Control Unit. Refer to Figure 4.12.
+// ALUOp 0 is the address add of loads and stores; I-type (5, 6) decodes
+// funct3 like R-type, with funct7 only telling srai/sraiw from srli/srliw
 Signal ALUControlUnit(Signal ALUOp,
                       Signal Funct7,
                       Signal Funct3) 
 {
 	if (ALUOp == 0) {
-		if (Funct7 == 0) {
-			if (Funct3 == 1) { // shift left
-				return 4;
-			} else if (Funct3 == 5) { // shift right
-				return 5;
-			} else if (Funct3 == 0) { // add 
-				return 2; // add
-			} else if (Funct3 == 7) {
-				return 0; // AND 
-			} else if (Funct3 == 6) {
-				return 1; // OR
-			} else {
-				return 2;
-			}
-		} else if (Funct7 == 32) { // subtract
-			return 6; // subtract
-		} else {
-			return 2;
-		}
+		return 2; // add
 	} else if (ALUOp == 1) {
 		return 6; // subtract
-	} else if (ALUOp == 2) {
-		if (Funct7 == 0) {
-			if (Funct3 == 0) {
-				return 2; // add 
-			} else if (Funct3 == 7) {
-				return 0; // AND 
-			} else if (Funct3 == 6) {
-				return 1; // OR
-			} else if (Funct3 == 1) { // shift left
-				return 4;
-			} else if (Funct3 == 5) { // shift right
-				return 5;
-			}
-		} else if (Funct7 == 32) {
-			if (Funct3 == 0) { 
-				return 6; // subtract
-			}
+	} else if (ALUOp == 2 || ALUOp == 5) {
+		bool imm = ALUOp == 5;
+		if (!imm && Funct7 == 1) {
+			return 8 + Funct3; // mul, mulh, mulhsu, mulhu, div, divu, rem, remu
+		}
+		if (!imm && Funct7 != 0 && Funct7 != 32) {
+			return -1;
 		}
+		switch (Funct3) {
+			case 0: return (!imm && Funct7 == 32) ? 6 : 2; // subtract, add
+			case 1: return 4;  // shift left
+			case 2: return 7;  // set less than
+			case 3: return 24; // set less than unsigned
+			case 4: return 3;  // XOR
+			case 5: // shift right; bit 25 of an RV64 shift immediate is shamt[5]
+				return (imm ? (Funct7 >> 1) == 16 : Funct7 == 32) ? 25 : 5;
+			case 6: return 1;  // OR
+			case 7: return 0;  // AND
+		}
+	} else if (ALUOp == 3 || ALUOp == 6) {
+		bool imm = ALUOp == 6;
+		if (!imm && Funct7 == 1) {
+			return 16 + Funct3; // mulw, divw, divuw, remw, remuw
+		}
+		switch (Funct3) {
+			case 0: return (!imm && Funct7 == 32) ? 30 : 26; // subw, addw
+			case 1: return 27; // shift left word
+			case 5: return Funct7 == 32 ? 29 : 28; // shift right word, arithmetic or logical
+		}
+	} else if (ALUOp == 4) {
+		return 32; // vector unit
 	}
 	return -1;
 }
@@ -406,16 +487,16 @@ Signal ALUControlUnit(Signal ALUOp,
 // (3). Imme. Generator
 Signal ImmeGen(Signal input)
 {
-	Signal imm_12_0;
+	Signal imm_12_0 = 0;
 	unsigned opcode = input & 0x7f;
 
 	// R-type 
-	if (opcode == 51) {
+	if (opcode == 51 || opcode == 59) {
 		return 0;
 	}
 
 	// I-type and Load type
-	if (opcode == 3 || opcode == 19) {
+	if (opcode == 3 || opcode == 19 || opcode == 27) {
 		// Shift input 20 bits to the right to get the 12 immediate bits
 		imm_12_0 = (input >> 20) & 0xfff;
 	} else if (opcode == 35) { // Store type
@@ -446,24 +527,122 @@ void ALU(Signal input_0,
          Signal *zero,
 		 Signal *neg)
 {
-    if (ALU_ctrl_signal == 2) { // add
-        *ALU_result = (input_0 + input_1);
+    if (ALU_ctrl_signal == 2) { // add (wraps, like every ALU operation)
+        *ALU_result = (Signal)((uint64_t)input_0 + (uint64_t)input_1);
     } else if (ALU_ctrl_signal == 0) { // AND
 		*ALU_result = (input_0 & input_1);
 	} else if (ALU_ctrl_signal == 1) { // OR
 		*ALU_result = input_0 | input_1;
 	} else if (ALU_ctrl_signal == 6) { // subtract
-		*ALU_result = input_0 - input_1;
-	} else if (ALU_ctrl_signal == 4) { // shift left
-		*ALU_result = input_0 << input_1;
-	} else if (ALU_ctrl_signal == 5) { // shift right
-		*ALU_result = input_0 >> input_1;
+		*ALU_result = (Signal)((uint64_t)input_0 - (uint64_t)input_1);
+	} else if (ALU_ctrl_signal == 4) { // shift left (RV64 uses the low 6 bits)
+		*ALU_result = (Signal)((uint64_t)input_0 << (input_1 & 63));
+	} else if (ALU_ctrl_signal == 5) { // shift right logical
+		*ALU_result = (uint64_t)input_0 >> (input_1 & 63);
+	} else if (ALU_ctrl_signal == 25) { // shift right arithmetic
+		*ALU_result = input_0 >> (input_1 & 63);
+	} else if (ALU_ctrl_signal == 3) { // XOR
+		*ALU_result = input_0 ^ input_1;
+	} else if (ALU_ctrl_signal == 7) { // set less than
+		*ALU_result = input_0 < input_1;
+	} else if (ALU_ctrl_signal == 24) { // set less than unsigned
+		*ALU_result = (uint64_t)input_0 < (uint64_t)input_1;
+	} else if (ALU_ctrl_signal >= 26 && ALU_ctrl_signal <= 30) { // RV64 word operations
+		*ALU_result = WordOp(input_0, input_1, ALU_ctrl_signal);
+	} else if (ALU_ctrl_signal >= 8 && ALU_ctrl_signal < 24) { // M extension
+		*ALU_result = MulDiv(input_0, input_1, ALU_ctrl_signal);
 	}	
 	
 	if (*ALU_result == 0) { *zero = 1; } else { *zero = 0; }
 	if (*ALU_result < 0) { *neg = 1; } else { *neg = 0; }
 }
 
+// addw, sllw, srlw, sraw, subw: 32-bit results, sign-extended
+Signal WordOp(Signal input_0,
+              Signal input_1,
+              Signal ALU_ctrl_signal)
+{
+	uint32_t w0 = (uint32_t)input_0, w1 = (uint32_t)input_1;
+	unsigned sh = input_1 & 31;
+
+	switch (ALU_ctrl_signal) {
+		case 26: return (int32_t)(w0 + w1);        // addw
+		case 27: return (int32_t)(w0 << sh);       // sllw
+		case 28: return (int32_t)(w0 >> sh);       // srlw
+		case 29: return (int32_t)w0 >> sh;         // sraw
+		case 30: return (int32_t)(w0 - w1);        // subw
+	}
+	return 0;
+}
+
+// Multiply/divide with the RISC-V results for division by zero
+// and overflow (no traps)
+Signal MulDiv(Signal input_0,
+              Signal input_1,
+              Signal ALU_ctrl_signal)
+{
+	uint64_t u0 = input_0, u1 = input_1;
+	int32_t w0 = (int32_t)input_0, w1 = (int32_t)input_1;
+	uint32_t uw0 = (uint32_t)input_0, uw1 = (uint32_t)input_1;
+
+	switch (ALU_ctrl_signal) {
+		case 8:  // mul
+			return (Signal)(u0 * u1);
+		case 9:  // mulh
+			return (Signal)(((__int128)input_0 * (__int128)input_1) >> 64);
+		case 10: // mulhsu
+			return (Signal)(((__int128)input_0 * (unsigned __int128)u1) >> 64);
+		case 11: // mulhu
+			return (Signal)(((unsigned __int128)u0 * (unsigned __int128)u1) >> 64);
+		case 12: // div
+			if (input_1 == 0) { return -1; }
+			if (input_0 == INT64_MIN && input_1 == -1) { return INT64_MIN; }
+			return input_0 / input_1;
+		case 13: // divu
+			if (u1 == 0) { return -1; }
+			return (Signal)(u0 / u1);
+		case 14: // rem
+			if (input_1 == 0) { return input_0; }
+			if (input_0 == INT64_MIN && input_1 == -1) { return 0; }
+			return input_0 % input_1;
+		case 15: // remu
+			if (u1 == 0) { return input_0; }
+			return (Signal)(u0 % u1);
+		case 16: // mulw
+			return (int32_t)(uw0 * uw1);
+		case 20: // divw
+			if (w1 == 0) { return -1; }
+			if (w0 == INT32_MIN && w1 == -1) { return INT32_MIN; }
+			return w0 / w1;
+		case 21: // divuw
+			if (uw1 == 0) { return -1; }
+			return (int32_t)(uw0 / uw1);
+		case 22: // remw
+			if (w1 == 0) { return w0; }
+			if (w0 == INT32_MIN && w1 == -1) { return 0; }
+			return w0 % w1;
+		case 23: // remuw
+			if (uw1 == 0) { return (int32_t)uw0; }
+			return (int32_t)(uw0 % uw1);
+	}
+	return 0;
+}
+
+// Which functional unit executes an ALU control signal
+FUType FunctionalUnitOf(Signal ALU_ctrl_signal)
+{
+	if ((ALU_ctrl_signal >= 8 && ALU_ctrl_signal <= 11) || ALU_ctrl_signal == 16) {
+		return FU_MUL;
+	}
+	if (ALU_ctrl_signal == 32) {
+		return FU_VEC;
+	}
+	if ((ALU_ctrl_signal >= 12 && ALU_ctrl_signal <= 15) || (ALU_ctrl_signal >= 20 && ALU_ctrl_signal <= 23)) {
+		return FU_DIV;
+	}
+	return FU_ALU;
+}
+
 // (4). MUX
 Signal MUX(Signal sel,
            Signal input_0,
@@ -497,3 +676,21 @@ Signal ShiftLeft1(Signal input)
 {
     return input << 1;
 }
+
+// (7). Branch Unit
+Signal BranchUnit(Signal funct3,
+                  Signal input_0,
+                  Signal input_1,
+                  Signal zero,
+                  Signal neg)
+{
+	switch (funct3) {
+		case 0: return zero;  // beq
+		case 1: return !zero; // bne
+		case 4: return input_0 < input_1;  // blt (the sign of a - b is wrong on overflow)
+		case 5: return input_0 >= input_1; // bge
+		case 6: return (uint64_t)input_0 < (uint64_t)input_1;  // bltu
+		case 7: return (uint64_t)input_0 >= (uint64_t)input_1; // bgeu
+	}
+	return 0;
+}
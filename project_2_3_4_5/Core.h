@@ -1,7 +1,15 @@
 #ifndef __CORE_H__
 #define __CORE_H__
 
+#include "Arena.h"
+#include "Dirty.h"
+#include "Fetch.h"
+#include "Fusion.h"
 #include "Instruction_Memory.h"
+#include "Konata.h"
+#include "Loop.h"
+#include "Profile.h"
+#include "Vector.h"
 
 #include <stdbool.h>
 #include <stdlib.h>
@@ -9,6 +17,10 @@
 #include <stdint.h>
 
 #define BOOL bool
+#define DATA_MEM_SIZE 1024 // bytes, unless a state file sets size=
+#define TICK_FOREVER UINT64_MAX
+#define NO_BREAK UINT64_MAX // break_pc when no breakpoint is set
+#define TICK_QUANTUM 4096   // cycles per tickCycles call in a quiet run
 
 typedef uint8_t Byte;
 typedef int64_t Signal;
@@ -27,6 +39,7 @@ typedef struct ControlSignals
     Signal MemWrite;
     Signal ALUSrc;
     Signal RegWrite;
+    Signal Vector;
 }ControlSignals;
 
 typedef struct Decode
@@ -47,6 +60,11 @@ typedef struct Decode
 	Signal reg1_val;
 	Signal reg2_val;
 	Signal immediate;
+
+	// Fused pair (Fusion.c), fuse is FUSE_NONE otherwise
+	Signal fuse;
+	Signal fuse_imm;     // the head's immediate
+	Signal fuse_offset;  // tail PC - head PC
 }Decode;
 
 typedef struct Exec
@@ -58,16 +76,46 @@ typedef struct Exec
 	Signal ALU_result;
 	Signal zero;
 	Signal neg;
+
+	// Branch outcome, resolved in execute
+	Signal branch_taken;
+	Addr branch_target;
 }Exec;
 
 typedef struct PipeInstr
 {
 	Signal instruction;
+	FusedTail fused; // instruction fetched together with this one
 	Decode *dec;
 	Exec *ex;
 	Signal mem_res;
+
+	uint64_t seq; // dynamic instruction number
+	Addr pc;
+	Addr next_pc; // fall-through PC, past a fused tail
+	bool predicted_taken; // fetch was redirected to the branch target
+	bool fetch_fault; // --vm: the PC did not translate
+	Addr mem_addr;    // --vm: physical address of a load or store
+	int done;     // last stage whose work has been done, -1 if none
+	const char *stage; // stage last written to the Konata log
 }PipeInstr;
 
+// Functional units in the execute stage
+typedef enum FUType
+{
+	FU_ALU,
+	FU_MUL,
+	FU_DIV,
+	FU_VEC,   // vector unit, busy for vl/lanes cycles
+	NUM_FU
+}FUType;
+
+typedef struct FunctionalUnit
+{
+	int latency;     // cycles until the result can be used
+	bool pipelined;  // accepts a new operation every cycle
+}FunctionalUnit;
+
 typedef struct Core
 {
     Tick clk; // Keep track of core clock
@@ -75,25 +123,122 @@ typedef struct Core
 
     // What else you need? Data memory? Register file?
     Instruction_Memory *instr_mem;
+    FetchBuffer fetch_buf;
    
-    Byte data_mem[1024]; // data memory
+    Byte *data_mem;    // data memory, from the arena or a state image
+    size_t mem_size;
+    bool mem_mapped;   // data_mem is a mapped binary image
+    bool mem_image;    // it came from a binary image, which dumps skip
+    DirtyMap loaded;   // lines a text state file set
+    MemCheckpoint initial;    // lines written by the run, as they started
+    MemCheckpoint *rollback;  // an open checkpoint to undo writes, if any
 
     Register reg_file[32]; // register file.
 
-    bool (*tick)(Core *core);
-	PipeInstr **pipe;
+    VectorState vec; // vector register file and vl/vtype
+
+    FunctionalUnit fu[NUM_FU];
+
+    Arena *arena;   // owns the Core and its per-run allocations
+    Pool pipe_pool; // in-flight pipeline entries
+
+    bool (*tick)(Core *core);            // one clock cycle
+    bool (*run)(Core *core, Tick until); // the in-order pipeline or the OoO core
+    struct OoOCore *ooo;                 // NULL for the in-order pipeline
+	const struct PipelineVariant *pipeline; // in-order pipeline run by tick
+	KonataWriter *konata; // pipeline trace, NULL if off
+
+	unsigned fusion;       // enabled fusion rules, 0 if off
+	uint64_t retired;      // instructions retired, both halves of a pair
+	uint64_t fused_pairs;  // ... of which retired as fused pairs
+
+	LoopDetector loop;     // steady-state loop extrapolation
+	Profiler *profile;     // per-PC counters, NULL if off
+
+	bool quiet;            // no cycle-by-cycle log
+	struct PipeState *pipe; // in-order pipeline contents between runs
+	Addr break_pc;         // stop once the instruction here retires
+	bool break_hit;        // the run loop returns at once while set
+	struct Checker *checker; // --check, NULL if off
+	struct EventCounters *counters; // hook event totals, NULL if off
+	struct StoreBuffer *sb;  // --store-buffer, NULL if MEM writes memory itself
+	uint64_t satp;           // Sv39 root table, from a state file or --satp
+	struct VirtualMemory *vm; // --vm, NULL if addresses are physical
+	struct DataCache *dcache; // --dcache, NULL if memory answers at once
 }Core;
 
-void storeDataMem(Core *core, int64_t data, int start);
-int64_t loadDataMem(Core *core, int start);
+// Bytes a scalar load or store moves, from its funct3
+static inline unsigned memWidth(Signal funct3) {
+	return 1u << (funct3 & 3);
+}
+
+// lb/lh/lw sign-extend, lbu/lhu/lwu zero-extend
+static inline int64_t extendLoad(uint64_t raw, Signal funct3) {
+	unsigned bits = 8 * memWidth(funct3);
+
+	if (bits == 64) {
+		return (int64_t)raw;
+	}
+	raw &= (1ull << bits) - 1;
+	return (funct3 & 4) ? (int64_t)raw : (int64_t)(raw << (64 - bits)) >> (64 - bits);
+}
+
+void storeDataMem(Core *core, int64_t data, Addr addr, Signal funct3);
+
+// Replace the data memory; tracking starts over with no lines written
+void setDataMemory(Core *core, Byte *mem, size_t size);
+
+// A store into a page the Sv39 walker has read (VirtualMemory.c)
+void vmWrite(struct VirtualMemory *vm, size_t addr, size_t len);
+
+// Every store calls this before it changes data_mem
+static inline void memWrite(Core *core, size_t addr, size_t len) {
+	if (len == 0 || addr > core->mem_size || len > core->mem_size - addr) {
+		return;
+	}
+	checkpointTouch(&core->initial, core->data_mem, addr, len);
+	if (core->rollback) {
+		checkpointTouch(core->rollback, core->data_mem, addr, len);
+	}
+	if (core->vm) {
+		vmWrite(core->vm, addr, len);
+	}
+}
+int64_t loadDataMem(Core *core, Addr addr, Signal funct3);
 void fetch(Core *core, PipeInstr *PI);
 void decode(Core *core, PipeInstr *PI);
-void execute(Core *core, PipeInstr *PI, int pipe_idx);
+void execute(Core *core, PipeInstr *PI, Signal val1, Signal val2);
 void memAccess(Core *core, PipeInstr *PI);
+
+// With a store buffer or virtual memory: why the instruction in MEM
+// cannot access memory this cycle (a StallCause), 0 if it can
+int memStageBlocks(Core *core, PipeInstr *PI);
 void writeBack(Core *core, PipeInstr *PI);
 
-Core *initCore(Instruction_Memory *i_mem);
+const Instruction *instructionAt(const Instruction_Memory *i_mem, Addr pc);
+PipeInstr *newPipeInstr(Core *core, uint64_t seq, Addr pc);
+void freePipeInstr(Core *core, PipeInstr *PI);
+bool usesRs1(Decode *dec);
+bool usesRs2(Decode *dec);
+
+// The Core and everything it allocates live in the arena
+Core *initCore(Instruction_Memory *i_mem, Arena *arena);
+
+// Advance one clock cycle, or up to n; false once the program has
+// finished. Whatever is in flight stays in the core between calls.
 bool tickFunc(Core *core);
+bool tickCycles(Core *core, Tick n);
+
+// Nothing left to fetch, nothing in flight
+bool coreFinished(Core *core);
+
+// In-order core->run: until the program finishes (false), the clock
+// reaches until or the breakpoint retires (true). The pipeline stays in
+// core->pipe, so a later call carries on where this one stopped.
+bool runCore(Core *core, Tick until);
+
+// Back to cycle 0 with an empty pipeline; registers and memory stay
+void restartCore(Core *core);
 
 void ControlUnit(Signal input,
                  ControlSignals *signals);
@@ -114,6 +259,35 @@ void ALU(Signal input_0,
          Signal *zero,
 		 Signal *neg);
 
+// Vector unit (Vector.c)
+void vectorDecode(Decode *dec);
+bool vectorUsesRs1(Decode *dec);
+bool vectorUsesRs2(Decode *dec);
+int vectorSources(Decode *dec, Signal src[3]);
+Signal vectorDest(Decode *dec);
+int vectorOccupancy(Core *core, Decode *dec);
+void vectorExecute(Core *core, PipeInstr *PI, Signal val1, Signal val2);
+void vectorMemAccess(Core *core, PipeInstr *PI);
+
+// Macro-op fusion (Fusion.c)
+bool fetchFusedTail(Core *core, unsigned int head, unsigned head_size, FusedTail *tail);
+void fuseDecode(Decode *dec, const FusedTail *tail);
+void fusedExecute(Decode *dec, Addr pc, Signal val1, Signal val2,
+                  Signal *result, Signal *taken, Addr *target);
+
+// Loop extrapolation (Loop.c)
+bool loopBoundary(Core *core, Addr branch_pc, uint64_t state);
+Tick loopExtrapolate(Core *core, Addr target);
+
+// RV64 word and M extension parts of the ALU
+Signal WordOp(Signal input_0,
+              Signal input_1,
+              Signal ALU_ctrl_signal);
+Signal MulDiv(Signal input_0,
+              Signal input_1,
+              Signal ALU_ctrl_signal);
+FUType FunctionalUnitOf(Signal ALU_ctrl_signal);
+
 // (4). MUX
 Signal MUX(Signal sel,
            Signal input_0,
@@ -132,4 +306,11 @@ Signal Add(Signal input_0,
 // (6). ShiftLeft1
 Signal ShiftLeft1(Signal input);
 
+// (7). Branch condition from the ALU flags of input_0 - input_1
+Signal BranchUnit(Signal funct3,
+                  Signal input_0,
+                  Signal input_1,
+                  Signal zero,
+                  Signal neg);
+
 #endif
@@ -0,0 +1,294 @@
+#include "DRAM.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Cache.h"
+
+/*------------------ DRAM.c --------------------
+ |
+ |  Purpose: Address mapping, the FR-FCFS
+ |		controllers and their bank and bus
+ |		timing, caught up on demand.
+ |
+ *----------------------------------------------*/
+
+void dramConfigDefaults(DRAMConfig *cfg) {
+	cfg->channels = 1;
+	cfg->ranks = 1;
+	cfg->banks = 8;
+	cfg->row_bytes = 2048;
+	cfg->tRCD = cfg->tCAS = cfg->tRP = 42;
+	cfg->burst = 8;
+	cfg->queue = 32;
+	cfg->policy = ROW_OPEN;
+}
+
+bool parseDRAMSpec(const char *spec, DRAMConfig *cfg) {
+	static const struct { const char *name; size_t offset; int min, max; } keys[] = {
+		{ "channels", offsetof(DRAMConfig, channels),  1, 16 },
+		{ "ranks",    offsetof(DRAMConfig, ranks),     1, 16 },
+		{ "banks",    offsetof(DRAMConfig, banks),     1, 64 },
+		{ "row",      offsetof(DRAMConfig, row_bytes), 1 << CACHE_LINE_SHIFT, 1 << 20 },
+		{ "tRCD",     offsetof(DRAMConfig, tRCD),      1, 1000 },
+		{ "tCAS",     offsetof(DRAMConfig, tCAS),      1, 1000 },
+		{ "tRP",      offsetof(DRAMConfig, tRP),       1, 1000 },
+		{ "burst",    offsetof(DRAMConfig, burst),     1, 1000 },
+		{ "queue",    offsetof(DRAMConfig, queue),     1, 256 },
+	};
+	char buf[256];
+	char *save = NULL;
+	char *item;
+	int i;
+
+	snprintf(buf, sizeof(buf), "%s", spec);
+	for (item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+		char *value = strchr(item, '=');
+		char *end;
+		long v;
+
+		if (strcmp(item, "default") == 0) {
+			continue;
+		}
+		if (value == NULL) {
+			break;
+		}
+		*value++ = '\0';
+		if (strcmp(item, "policy") == 0) {
+			if (strcmp(value, "open") == 0) {
+				cfg->policy = ROW_OPEN;
+			} else if (strcmp(value, "closed") == 0) {
+				cfg->policy = ROW_CLOSED;
+			} else {
+				printf("Unknown row policy: %s (open or closed)\n", value);
+				return false;
+			}
+			continue;
+		}
+		for (i=0; i<(int)(sizeof(keys) / sizeof(keys[0])); i++) {
+			if (strcmp(item, keys[i].name) == 0) {
+				break;
+			}
+		}
+		if (i == (int)(sizeof(keys) / sizeof(keys[0]))) {
+			break;
+		}
+		v = strtol(value, &end, 0);
+		if (end == value || *end != '\0' || v < keys[i].min || v > keys[i].max) {
+			printf("--dram %s must be from %d to %d.\n", keys[i].name, keys[i].min, keys[i].max);
+			return false;
+		}
+		*(int *)((char *)cfg + keys[i].offset) = v;
+	}
+	if (item) {
+		printf("Bad --dram item %s (default, channels=, ranks=, banks=, row=BYTES, tRCD=, tCAS=, tRP=, burst=,"
+			" queue= or policy=open|closed).\n", item);
+		return false;
+	}
+	if (cfg->row_bytes % (1 << CACHE_LINE_SHIFT)) {
+		printf("--dram row must be a multiple of %d bytes.\n", 1 << CACHE_LINE_SHIFT);
+		return false;
+	}
+	return true;
+}
+
+DRAM *initDRAM(const DRAMConfig *cfg, Arena *arena) {
+	DRAM *d = arenaAlloc(arena, sizeof(DRAM));
+	int c;
+
+	d->cfg = *cfg;
+	d->channels = arenaAlloc(arena, cfg->channels * sizeof(Channel));
+	for (c=0; c<cfg->channels; c++) {
+		d->channels[c].queue = arenaAlloc(arena, cfg->queue * sizeof(DRAMRequest));
+		d->channels[c].banks = arenaAlloc(arena, cfg->ranks * cfg->banks * sizeof(Bank));
+	}
+	d->lines_per_row = cfg->row_bytes >> CACHE_LINE_SHIFT;
+	d->next_event = TICK_FOREVER;
+	for (d->ring = 64; d->ring < 4ull * cfg->channels * cfg->queue; d->ring <<= 1)
+		;
+	d->done = arenaAlloc(arena, d->ring * sizeof(Tick));
+	d->done_id = arenaAlloc(arena, d->ring * sizeof(uint64_t));
+	return d;
+}
+
+// When r could be issued: arrived, and its bank free
+static Tick readyAt(const Channel *ch, const DRAMRequest *r) {
+	Tick bank = ch->banks[r->bank].ready;
+	return bank > r->arrival ? bank : r->arrival;
+}
+
+// The channel's next decision, TICK_FOREVER if its queue is empty
+static Tick nextDecision(const Channel *ch) {
+	Tick t = TICK_FOREVER;
+	int i;
+
+	for (i=0; i<ch->count; i++) {
+		Tick r = readyAt(ch, &ch->queue[i]);
+		if (r < t) {
+			t = r;
+		}
+	}
+	return t != TICK_FOREVER && t < ch->cmd_free ? ch->cmd_free : t;
+}
+
+static void updateNextEvent(DRAM *d) {
+	int c;
+
+	d->next_event = TICK_FOREVER;
+	for (c=0; c<d->cfg.channels; c++) {
+		Tick t = nextDecision(&d->channels[c]);
+		if (t < d->next_event) {
+			d->next_event = t;
+		}
+	}
+}
+
+// Schedule one request at cycle t, the channel's next decision. A
+// request half a ring old goes before row hits, so none starves.
+static void issue(DRAM *d, Channel *ch, Tick t) {
+	DRAMRequest *pick = NULL;
+	bool pick_first = false, pick_hit = false;
+	Bank *b;
+	Tick col, data, done;
+	int i;
+
+	for (i=0; i<ch->count; i++) {
+		DRAMRequest *r = &ch->queue[i];
+		bool hit, first;
+		if (readyAt(ch, r) > t) {
+			continue;
+		}
+		hit = ch->banks[r->bank].open && ch->banks[r->bank].row == r->row;
+		first = hit || d->next_id - r->id >= d->ring / 2;
+		if (pick == NULL || (first && !pick_first) || (first == pick_first && r->id < pick->id)) {
+			pick = r;
+			pick_first = first;
+			pick_hit = hit;
+		}
+	}
+
+	b = &ch->banks[pick->bank];
+	if (pick_hit) {
+		col = t;
+		d->row_hits++;
+	} else if (!b->open) {
+		col = t + d->cfg.tRCD;
+		d->row_empty++;
+	} else {
+		col = t + d->cfg.tRP + d->cfg.tRCD;
+		d->row_conflicts++;
+	}
+	data = col + d->cfg.tCAS;
+	if (data < ch->bus_free) {
+		data = ch->bus_free;
+	}
+	done = data + d->cfg.burst;
+	ch->bus_free = done;
+	ch->cmd_free = t + 1;
+	if (d->cfg.policy == ROW_OPEN) {
+		b->open = true;
+		b->row = pick->row;
+		b->ready = col + d->cfg.burst;
+	} else {
+		b->open = false;
+		b->ready = done + d->cfg.tRP;
+	}
+
+	d->done[pick->id & (d->ring - 1)] = done;
+	if (!pick->write) {
+		d->reads_served++;
+		d->read_cycles += done - pick->arrival;
+		d->queue_cycles += t - pick->arrival;
+	}
+	d->bus_cycles += d->cfg.burst;
+	d->decisions++;
+	if (done > d->last_done) {
+		d->last_done = done;
+	}
+	*pick = ch->queue[--ch->count];
+}
+
+static void advance(DRAM *d, Tick now) {
+	int c;
+
+	if (now < d->next_event) {
+		return;
+	}
+	for (c=0; c<d->cfg.channels; c++) {
+		Channel *ch = &d->channels[c];
+		Tick t;
+		while ((t = nextDecision(ch)) <= now) {
+			issue(d, ch, t);
+		}
+	}
+	updateNextEvent(d);
+}
+
+uint64_t dramRequest(DRAM *d, uint64_t line, bool write, Tick at) {
+	Channel *ch = &d->channels[line % d->cfg.channels];
+	uint64_t rest = line / d->cfg.channels / d->lines_per_row;
+	DRAMRequest *r;
+
+	advance(d, at);
+	if (ch->count == d->cfg.queue) {
+		d->full_waits++;
+		do {
+			Tick t = nextDecision(ch);
+			issue(d, ch, t);
+			if (t > at) {
+				at = t;
+			}
+		} while (ch->count == d->cfg.queue);
+	}
+	r = &ch->queue[ch->count++];
+	r->id = ++d->next_id;
+	r->bank = (rest / d->cfg.banks % d->cfg.ranks) * d->cfg.banks + rest % d->cfg.banks;
+	r->row = rest / d->cfg.banks / d->cfg.ranks;
+	r->write = write;
+	r->arrival = at;
+	d->done_id[r->id & (d->ring - 1)] = r->id;
+	d->done[r->id & (d->ring - 1)] = TICK_FOREVER;
+	if (write) {
+		d->writes++;
+	} else {
+		d->reads++;
+	}
+	if (ch->count > d->max_queue) {
+		d->max_queue = ch->count;
+	}
+	updateNextEvent(d);
+	return r->id;
+}
+
+Tick dramDone(DRAM *d, uint64_t id, Tick now) {
+	uint64_t slot = id & (d->ring - 1);
+
+	advance(d, now);
+	// The ring outlives every queued request, so a newer id in the
+	// slot means this one finished long ago
+	return d->done_id[slot] == id ? d->done[slot] : 0;
+}
+
+void printDRAMStats(const DRAM *d, Tick cycles) {
+	const DRAMConfig *cfg = &d->cfg;
+	uint64_t accesses = d->row_hits + d->row_empty + d->row_conflicts;
+
+	if (d->last_done > cycles) {
+		cycles = d->last_done;
+	}
+	printf("DRAM: %d channel%s, %d rank%s of %d banks, %d-byte rows, %s rows, tRCD %d, tCAS %d, tRP %d,"
+		" %d-cycle bursts, %d-entry queues\n", cfg->channels, cfg->channels == 1 ? "" : "s", cfg->ranks,
+		cfg->ranks == 1 ? "" : "s", cfg->banks, cfg->row_bytes, cfg->policy == ROW_OPEN ? "open" : "closed",
+		cfg->tRCD, cfg->tCAS, cfg->tRP, cfg->burst, cfg->queue);
+	printf("DRAM: %" PRIu64 " reads, %" PRIu64 " writes; %.1f%% row hits, %.1f%% closed rows, %.1f%% row conflicts\n",
+		d->reads, d->writes, accesses ? 100.0 * d->row_hits / accesses : 0.0,
+		accesses ? 100.0 * d->row_empty / accesses : 0.0, accesses ? 100.0 * d->row_conflicts / accesses : 0.0);
+	printf("DRAM: %.1f cycles per read (%.1f of them queued), data bus %.1f%% busy, %" PRIu64 " full-queue waits"
+		" (max %d queued), %" PRIu64 " scheduler decisions\n",
+		d->reads_served ? (double)d->read_cycles / d->reads_served : 0.0,
+		d->reads_served ? (double)d->queue_cycles / d->reads_served : 0.0,
+		cycles ? 100.0 * d->bus_cycles / cycles / cfg->channels : 0.0, d->full_waits, d->max_queue, d->decisions);
+}
@@ -0,0 +1,141 @@
+#ifndef __DRAM_H__
+#define __DRAM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Arena.h"
+#include "Core.h"
+
+/*------------------ DRAM.h --------------------
+ |
+ |  --dram: the memory behind the data cache
+ |  model (see Cache.h), in place of its fixed
+ |  latency. Lines are spread over channels,
+ |  then row-buffer columns, banks and ranks:
+ |
+ |	channel = line % channels
+ |	column, bank, rank, row from the rest,
+ |	in that order, least significant first
+ |
+ |  Each channel has its own controller with a
+ |  request queue, scheduled FR-FCFS: among the
+ |  requests whose bank can take a command, row
+ |  hits go first, then the oldest (a request
+ |  starved for long enough counts as a hit, so
+ |  it is taken oldest first). One command
+ |  issues per cycle; the access then takes
+ |
+ |	row hit       tCAS
+ |	row closed    tRCD + tCAS
+ |	row conflict  tRP + tRCD + tCAS
+ |
+ |  and the line a burst on the channel's data
+ |  bus, which transfers one line at a time. An
+ |  open-row bank keeps the row for the next
+ |  access; a closed-row bank precharges after
+ |  every access. Times are in core cycles.
+ |
+ |  Event-driven: nothing runs per cycle. The
+ |  controllers catch up to the current cycle
+ |  only when someone asks whether a request is
+ |  done, and return at once if no scheduling
+ |  decision has come due, so idle and hit
+ |  cycles cost nothing. A request arriving at a
+ |  full queue makes its controller decide ahead
+ |  until a slot is free, and waits that long.
+ |
+ *----------------------------------------------*/
+
+typedef enum RowPolicy
+{
+	ROW_OPEN,
+	ROW_CLOSED
+}RowPolicy;
+
+typedef struct DRAMConfig
+{
+	int channels, ranks, banks;  // banks per rank
+	int row_bytes;               // row buffer, a multiple of the line size
+	int tRCD, tCAS, tRP;
+	int burst;                   // data bus cycles per line
+	int queue;                   // requests per channel controller
+	RowPolicy policy;
+}DRAMConfig;
+
+typedef struct DRAMRequest
+{
+	uint64_t id;
+	uint64_t row;
+	int bank;        // rank * banks + bank
+	bool write;
+	Tick arrival;
+}DRAMRequest;
+
+typedef struct Bank
+{
+	uint64_t row;    // the open row, if open
+	bool open;
+	Tick ready;      // takes its next command from this cycle
+}Bank;
+
+typedef struct Channel
+{
+	DRAMRequest *queue;  // unordered; ids give the age
+	int count;
+	Bank *banks;
+	Tick cmd_free;       // command bus
+	Tick bus_free;       // data bus
+}Channel;
+
+typedef struct DRAM
+{
+	DRAMConfig cfg;
+	Channel *channels;
+	int lines_per_row;
+	uint64_t next_id;
+	Tick next_event;     // earliest scheduling decision still to make
+
+	// Completion by id, for the requests of the last ring entries;
+	// TICK_FOREVER while queued
+	Tick *done;
+	uint64_t *done_id;
+	uint64_t ring;       // a power of two, 4 times what the queues hold
+
+	// Statistics
+	uint64_t reads;
+	uint64_t writes;
+	uint64_t row_hits;
+	uint64_t row_empty;
+	uint64_t row_conflicts;
+	uint64_t reads_served;   // scheduled; the rest were never waited for
+	uint64_t read_cycles;    // ... from arrival to the last data beat
+	uint64_t queue_cycles;   // ... from arrival to the first command
+	uint64_t bus_cycles;     // data bus busy
+	uint64_t full_waits;     // requests that found their queue full
+	uint64_t decisions;      // scheduler runs, the host work done
+	Tick last_done;
+	int max_queue;
+}DRAM;
+
+// 1 channel, 1 rank, 8 banks, 2 KiB rows, tRCD = tCAS = tRP = 42,
+// 8-cycle bursts, 32-entry queues, open rows
+void dramConfigDefaults(DRAMConfig *cfg);
+
+// "default", or a comma-separated list of channels=, ranks=, banks=,
+// row=BYTES, tRCD=, tCAS=, tRP=, burst=, queue= and policy=open|closed;
+// false (and a message) if malformed
+bool parseDRAMSpec(const char *spec, DRAMConfig *cfg);
+
+DRAM *initDRAM(const DRAMConfig *cfg, Arena *arena);
+
+// A line read or write reaching the controller at cycle at; its id
+uint64_t dramRequest(DRAM *dram, uint64_t line, bool write, Tick at);
+
+// The cycle request id has its data, TICK_FOREVER if it has not been
+// scheduled by cycle now
+Tick dramDone(DRAM *dram, uint64_t id, Tick now);
+
+void printDRAMStats(const DRAM *dram, Tick cycles);
+
+#endif
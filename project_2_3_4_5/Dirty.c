@@ -0,0 +1,117 @@
+#include "Dirty.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*------------------ Dirty.c -------------------
+ |
+ |  Purpose: Written-line bitmaps and the line
+ |		checkpoints built on them.
+ |
+ *----------------------------------------------*/
+
+void initDirtyMap(DirtyMap *map, Arena *arena, size_t mem_size) {
+	memset(map, 0, sizeof(*map));
+	map->num_lines = (mem_size + LINE_SIZE - 1) >> LINE_SHIFT;
+	map->num_pages = (map->num_lines + LINES_PER_PAGE - 1) / LINES_PER_PAGE;
+	map->lines = arenaAlloc(arena, ((map->num_lines + 63) / 64) * sizeof(uint64_t));
+	map->pages = arenaAlloc(arena, ((map->num_pages + 63) / 64) * sizeof(uint64_t));
+}
+
+void dirtySetAll(DirtyMap *map) {
+	size_t line;
+
+	for (line=0; line<map->num_lines; line++) {
+		dirtyTestSet(map, line);
+	}
+}
+
+void dirtyClear(DirtyMap *map) {
+	size_t line;
+
+	// Only the words of dirty pages can be non-zero
+	for (line = dirtyNext(map, NULL, 0); line < map->num_lines; line = dirtyNext(map, NULL, line)) {
+		map->lines[line >> 6] = 0;
+		line = ((line >> 6) + 1) << 6;
+	}
+	memset(map->pages, 0, ((map->num_pages + 63) / 64) * sizeof(uint64_t));
+	map->dirty_lines = 0;
+	map->dirty_pages = 0;
+}
+
+size_t dirtyNext(const DirtyMap *a, const DirtyMap *b, size_t line) {
+	size_t page = line >> 6;
+
+	while (page < a->num_pages) {
+		uint64_t pages = a->pages[page >> 6] | (b ? b->pages[page >> 6] : 0);
+
+		// Skip clean pages a word at a time
+		pages &= ~0ull << (page & 63);
+		if (pages == 0) {
+			page = (page | 63) + 1;
+			line = page << 6;
+			continue;
+		}
+		page = (page & ~(size_t)63) + __builtin_ctzll(pages);
+		if (line < page << 6) {
+			line = page << 6;
+		}
+
+		uint64_t lines = a->lines[page] | (b ? b->lines[page] : 0);
+		lines &= ~0ull << (line & 63);
+		if (lines) {
+			line = (page << 6) + __builtin_ctzll(lines);
+			return line < a->num_lines ? line : a->num_lines;
+		}
+		page++;
+		line = page << 6;
+	}
+	return a->num_lines;
+}
+
+void initCheckpoint(MemCheckpoint *cp, Arena *arena, size_t mem_size) {
+	initDirtyMap(&cp->map, arena, mem_size);
+	cp->saved = NULL;
+	cp->mem_size = mem_size;
+}
+
+void freeCheckpoint(MemCheckpoint *cp) {
+	if (cp->saved) {
+		munmap(cp->saved, cp->map.num_lines << LINE_SHIFT);
+		cp->saved = NULL;
+	}
+}
+
+void checkpointSave(MemCheckpoint *cp, const uint8_t *mem, size_t line) {
+	size_t addr = line << LINE_SHIFT;
+	size_t bytes = cp->mem_size - addr < LINE_SIZE ? cp->mem_size - addr : LINE_SIZE;
+
+	// Anonymous pages cost nothing until a line lands in them, so the
+	// copy of a large memory only grows with what the program writes
+	if (cp->saved == NULL) {
+		cp->saved = mmap(NULL, cp->map.num_lines << LINE_SHIFT, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (cp->saved == MAP_FAILED) {
+			fprintf(stderr, "Checkpoint: out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(cp->saved + addr, mem + addr, bytes);
+}
+
+void checkpointRestore(MemCheckpoint *cp, uint8_t *mem) {
+	size_t line;
+
+	for (line = dirtyNext(&cp->map, NULL, 0); line < cp->map.num_lines; line = dirtyNext(&cp->map, NULL, line + 1)) {
+		size_t addr = line << LINE_SHIFT;
+		size_t bytes = cp->mem_size - addr < LINE_SIZE ? cp->mem_size - addr : LINE_SIZE;
+		memcpy(mem + addr, cp->saved + addr, bytes);
+	}
+	dirtyClear(&cp->map);
+}
+
+void checkpointReset(MemCheckpoint *cp) {
+	dirtyClear(&cp->map);
+}
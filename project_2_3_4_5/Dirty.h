@@ -0,0 +1,111 @@
+#ifndef __DIRTY_H__
+#define __DIRTY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Arena.h"
+
+/*------------------ Dirty.h -------------------
+ |
+ |  Which parts of the data memory were written,
+ |  kept as a bitmap at cache-line granularity
+ |  with a page bitmap above it, so walking the
+ |  written lines of a large memory skips clean
+ |  pages 64 at a time (one page holds exactly
+ |  one 64-bit word of line bits).
+ |
+ |  A MemCheckpoint adds the contents every line
+ |  had before its first write. The core keeps
+ |  one for the whole run, which gives the diff
+ |  against the initial image; loop extrapolation
+ |  keeps another to roll an iteration back.
+ |  Either way only the lines actually written
+ |  are copied, saved or restored.
+ |
+ *----------------------------------------------*/
+
+#define LINE_SHIFT 6   // 64-byte cache lines
+#define PAGE_SHIFT 12  // 4 KiB pages
+#define LINE_SIZE (1u << LINE_SHIFT)
+#define LINES_PER_PAGE (1u << (PAGE_SHIFT - LINE_SHIFT))
+
+typedef struct DirtyMap
+{
+	uint64_t *lines;       // one bit per line
+	uint64_t *pages;       // one bit per page with any line set
+	size_t num_lines;
+	size_t num_pages;
+	size_t dirty_lines;
+	size_t dirty_pages;
+}DirtyMap;
+
+typedef struct MemCheckpoint
+{
+	DirtyMap map;
+	uint8_t *saved;        // old line contents, mapped on first use
+	size_t mem_size;
+}MemCheckpoint;
+
+void initDirtyMap(DirtyMap *map, Arena *arena, size_t mem_size);
+void dirtySetAll(DirtyMap *map);
+void dirtyClear(DirtyMap *map);
+
+// First line at or after line that is set in a or b (b may be NULL),
+// or a->num_lines if there is none
+size_t dirtyNext(const DirtyMap *a, const DirtyMap *b, size_t line);
+
+// Sets the bit; returns true if it was clear
+static inline bool dirtyTestSet(DirtyMap *map, size_t line) {
+	uint64_t bit = 1ull << (line & 63);
+	uint64_t *word = &map->lines[line >> 6];
+
+	if (*word & bit) {
+		return false;
+	}
+	if (*word == 0) {
+		map->pages[line >> 12] |= 1ull << ((line >> 6) & 63);
+		map->dirty_pages++;
+	}
+	*word |= bit;
+	map->dirty_lines++;
+	return true;
+}
+
+static inline bool dirtyTest(const DirtyMap *map, size_t line) {
+	return (map->lines[line >> 6] >> (line & 63)) & 1;
+}
+
+// Mark [addr, addr + len) written
+static inline void dirtyMark(DirtyMap *map, size_t addr, size_t len) {
+	size_t line, last = (addr + len - 1) >> LINE_SHIFT;
+
+	for (line = addr >> LINE_SHIFT; line <= last; line++) {
+		dirtyTestSet(map, line);
+	}
+}
+
+void initCheckpoint(MemCheckpoint *cp, Arena *arena, size_t mem_size);
+void freeCheckpoint(MemCheckpoint *cp);
+void checkpointSave(MemCheckpoint *cp, const uint8_t *mem, size_t line);
+
+// Put every line written since the checkpoint back and start over
+void checkpointRestore(MemCheckpoint *cp, uint8_t *mem);
+
+// Forget the saved lines, keeping the memory as it is
+void checkpointReset(MemCheckpoint *cp);
+
+// Call before writing [addr, addr + len): saves each line the first
+// time it is written after the checkpoint
+static inline void checkpointTouch(MemCheckpoint *cp, const uint8_t *mem, size_t addr, size_t len) {
+	size_t line, last = (addr + len - 1) >> LINE_SHIFT;
+
+	for (line = addr >> LINE_SHIFT; line <= last; line++) {
+		if (dirtyTestSet(&cp->map, line)) {
+			checkpointSave(cp, mem, line);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "Fetch.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------ Fetch.c -------------------
+ |
+ |  Purpose: Fetch buffer and RVC expansion. The
+ |		expansion covers the compressed forms of
+ |		the instructions the core executes:
+ |		c.addi/c.nop, c.li, c.slli, c.srli, c.srai,
+ |		c.andi, c.mv, c.add, c.sub, c.xor, c.or,
+ |		c.and, c.lw, c.ld, c.sw, c.sd, c.ldsp,
+ |		c.sdsp, c.beqz and c.bnez.
+ |
+ *----------------------------------------------*/
+
+void initFetchBuffer(FetchBuffer *fb, const Instruction_Memory *i_mem, Arena *arena) {
+	memset(fb, 0, sizeof(*fb));
+	fb->lines = (i_mem->image_size + ICACHE_LINE - 1) / ICACHE_LINE;
+	fb->line_seen = arenaAlloc(arena, fb->lines);
+}
+
+void resetFetchBuffer(FetchBuffer *fb) {
+	uint8_t *line_seen = fb->line_seen;
+	size_t lines = fb->lines;
+
+	memset(fb, 0, sizeof(*fb));
+	memset(line_seen, 0, lines);
+	fb->line_seen = line_seen;
+	fb->lines = lines;
+}
+
+// Read one halfword through the buffer, refilling it on a miss
+static uint16_t fetchHalf(FetchBuffer *fb, const Instruction_Memory *i_mem, Addr addr) {
+	// A block read while the parser was still writing it is read again
+	if (!fb->valid || fb->partial || addr < fb->block || addr >= fb->block + FETCH_BLOCK) {
+		bool complete = __atomic_load_n(&i_mem->complete, __ATOMIC_ACQUIRE);
+		Addr published = __atomic_load_n(&i_mem->published_bytes, __ATOMIC_ACQUIRE);
+		fb->block = addr & ~(Addr)(FETCH_BLOCK - 1);
+		memset(fb->bytes, 0, FETCH_BLOCK);
+		if (fb->block + FETCH_BLOCK <= i_mem->image_size) {
+			memcpy(fb->bytes, &i_mem->image[fb->block], FETCH_BLOCK);
+			fb->line_seen[fb->block / ICACHE_LINE] = 1;
+		}
+		fb->partial = !complete && fb->block + FETCH_BLOCK > published;
+		fb->valid = true;
+		fb->block_reads++;
+	}
+	return fb->bytes[addr - fb->block] | (fb->bytes[addr - fb->block + 1] << 8);
+}
+
+unsigned int peekInstruction(FetchBuffer *fb, const Instruction_Memory *i_mem, Addr pc, unsigned *size) {
+	uint16_t lo = fetchHalf(fb, i_mem, pc);
+
+	// The low two bits are 11 for 32-bit instructions
+	if ((lo & 3) != 3) {
+		*size = 2;
+		return expandCompressed(lo);
+	}
+	*size = 4;
+	return lo | ((unsigned int)fetchHalf(fb, i_mem, pc + 2) << 16);
+}
+
+unsigned int fetchInstruction(FetchBuffer *fb, const Instruction_Memory *i_mem, Addr pc, unsigned *size) {
+	unsigned int instruction = peekInstruction(fb, i_mem, pc, size);
+
+	fb->instructions++;
+	if (*size == 2) {
+		fb->compressed++;
+	}
+	return instruction;
+}
+
+/*------------------ RVC expansion -------------*/
+
+static unsigned bits(uint16_t c, int hi, int lo) {
+	return (c >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+// Sign-extend the low n bits
+static int sext(unsigned value, int n) {
+	return (int)(value << (32 - n)) >> (32 - n);
+}
+
+static unsigned int encR(unsigned opcode, unsigned rd, unsigned funct3, unsigned rs1, unsigned rs2, unsigned funct7) {
+	return opcode | (rd << 7) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20) | (funct7 << 25);
+}
+
+static unsigned int encI(unsigned opcode, unsigned rd, unsigned funct3, unsigned rs1, int imm) {
+	return opcode | (rd << 7) | (funct3 << 12) | (rs1 << 15) | (((unsigned)imm & 0xfff) << 20);
+}
+
+static unsigned int encS(unsigned funct3, unsigned rs1, unsigned rs2, int imm) {
+	unsigned u = (unsigned)imm & 0xfff;
+	return 35 | ((u & 0x1f) << 7) | (funct3 << 12) | (rs1 << 15) | (rs2 << 20) | ((u >> 5) << 25);
+}
+
+static unsigned int encB(unsigned funct3, unsigned rs1, unsigned rs2, int imm) {
+	unsigned u = (unsigned)imm & 0x1fff;
+	return 99 | (((u >> 11) & 1) << 7) | (((u >> 1) & 0xf) << 8) | (funct3 << 12)
+		| (rs1 << 15) | (rs2 << 20) | (((u >> 5) & 0x3f) << 25) | (((u >> 12) & 1) << 31);
+}
+
+unsigned int expandCompressed(uint16_t c) {
+	unsigned op = bits(c, 1, 0);
+	unsigned funct3 = bits(c, 15, 13);
+	unsigned rd = bits(c, 11, 7);
+	unsigned rs2 = bits(c, 6, 2);
+	unsigned rdp = 8 + bits(c, 4, 2);   // rd' / rs2' of the CL, CS formats
+	unsigned rs1p = 8 + bits(c, 9, 7);  // rs1' / rd'
+	int imm6 = sext((bits(c, 12, 12) << 5) | bits(c, 6, 2), 6);
+
+	if (op == 0) {
+		unsigned uimm_d = (bits(c, 12, 10) << 3) | (bits(c, 6, 5) << 6);
+		unsigned uimm_w = (bits(c, 12, 10) << 3) | (bits(c, 6, 6) << 2) | (bits(c, 5, 5) << 6);
+		switch (funct3) {
+			case 2: return encI(3, rdp, 2, rs1p, uimm_w);     // c.lw
+			case 3: return encI(3, rdp, 3, rs1p, uimm_d);     // c.ld
+			case 6: return encS(2, rs1p, rdp, uimm_w);        // c.sw
+			case 7: return encS(3, rs1p, rdp, uimm_d);        // c.sd
+		}
+	} else if (op == 1) {
+		switch (funct3) {
+			case 0: return encI(19, rd, 0, rd, imm6);         // c.addi, c.nop
+			case 2: return encI(19, rd, 0, 0, imm6);          // c.li
+			case 4:
+				switch (bits(c, 11, 10)) {
+					case 0: return encI(19, rs1p, 5, rs1p, imm6 & 0x3f);              // c.srli
+					case 1: return encI(19, rs1p, 5, rs1p, (imm6 & 0x3f) | (32 << 5)); // c.srai
+					case 2: return encI(19, rs1p, 7, rs1p, imm6);                     // c.andi
+				}
+				if (bits(c, 12, 12) == 0) {
+					switch (bits(c, 6, 5)) {
+						case 0: return encR(51, rs1p, 0, rs1p, rdp, 32);  // c.sub
+						case 1: return encR(51, rs1p, 4, rs1p, rdp, 0);   // c.xor
+						case 2: return encR(51, rs1p, 6, rs1p, rdp, 0);   // c.or
+						case 3: return encR(51, rs1p, 7, rs1p, rdp, 0);   // c.and
+					}
+				}
+				break;
+			case 6:
+			case 7: {
+				// c.beqz, c.bnez
+				int off = sext((bits(c, 12, 12) << 8) | (bits(c, 11, 10) << 3) | (bits(c, 6, 5) << 6)
+					| (bits(c, 4, 3) << 1) | (bits(c, 2, 2) << 5), 9);
+				return encB(funct3 == 6 ? 0 : 1, rs1p, 0, off);
+			}
+		}
+	} else if (op == 2) {
+		switch (funct3) {
+			case 0: return encI(19, rd, 1, rd, imm6 & 0x3f);  // c.slli
+			case 3:                                           // c.ldsp
+				return encI(3, rd, 3, 2, (bits(c, 12, 12) << 5) | (bits(c, 6, 5) << 3) | (bits(c, 4, 2) << 6));
+			case 4:
+				if (rs2 == 0) {
+					break; // c.jr, c.jalr, c.ebreak
+				}
+				return bits(c, 12, 12) ? encR(51, rd, 0, rd, rs2, 0)   // c.add
+					: encR(51, rd, 0, 0, rs2, 0);                    // c.mv
+			case 7:                                           // c.sdsp
+				return encS(3, 2, rs2, (bits(c, 12, 10) << 3) | (bits(c, 9, 7) << 6));
+		}
+	}
+	return 0;
+}
+
+void printFetchStats(const FetchBuffer *fb, const Instruction_Memory *i_mem) {
+	Addr code_size = i_mem->last ? i_mem->last->addr + i_mem->last->size : 0;
+	unsigned lines = 0;
+	size_t i;
+
+	for (i=0; i<fb->lines; i++) {
+		lines += fb->line_seen[i];
+	}
+	printf("Fetch: %" PRIu64 " instructions (%" PRIu64 " compressed), %" PRIu64 " %d-byte block reads\n",
+		fb->instructions, fb->compressed, fb->block_reads, FETCH_BLOCK);
+	printf("Code size: %" PRIu64 " bytes, %u %d-byte I-cache lines touched\n",
+		code_size, lines, ICACHE_LINE);
+}
@@ -0,0 +1,56 @@
+#ifndef __FETCH_H__
+#define __FETCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Arena.h"
+#include "Instruction_Memory.h"
+
+/*------------------ Fetch.h -------------------
+ |
+ |  Instruction-fetch buffer. Instruction memory
+ |  is read a whole aligned block at a time; the
+ |  buffer then hands out 16-bit (RVC) and 32-bit
+ |  instructions from it, expanding compressed
+ |  ones to their 32-bit equivalent so the rest
+ |  of the core only ever sees RV64 encodings.
+ |
+ *----------------------------------------------*/
+
+#define FETCH_BLOCK 16   // bytes per instruction-memory read
+#define ICACHE_LINE 64   // line size used for the footprint count
+
+typedef struct FetchBuffer
+{
+	Addr block;                 // address of the buffered block
+	bool valid;
+	bool partial;               // block was not fully parsed when read
+	uint8_t bytes[FETCH_BLOCK];
+
+	// Statistics
+	uint64_t instructions;      // instructions handed out
+	uint64_t compressed;        // ... of which were 16-bit
+	uint64_t block_reads;       // instruction-memory reads
+	uint8_t *line_seen;         // per I-cache line of the image
+	size_t lines;
+}FetchBuffer;
+
+// The footprint map is allocated from the arena
+void initFetchBuffer(FetchBuffer *fb, const Instruction_Memory *i_mem, Arena *arena);
+
+// Empty buffer and zero statistics, for a run starting over
+void resetFetchBuffer(FetchBuffer *fb);
+
+// Instruction at pc, expanded to 32 bits; *size is its length in bytes
+unsigned int fetchInstruction(FetchBuffer *fb, const Instruction_Memory *i_mem, Addr pc, unsigned *size);
+
+// Same, without counting it as fetched (decode looking one ahead)
+unsigned int peekInstruction(FetchBuffer *fb, const Instruction_Memory *i_mem, Addr pc, unsigned *size);
+
+// 32-bit equivalent of a compressed instruction, 0 if not supported
+unsigned int expandCompressed(uint16_t c);
+
+void printFetchStats(const FetchBuffer *fb, const Instruction_Memory *i_mem);
+
+#endif
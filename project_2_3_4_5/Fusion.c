@@ -0,0 +1,171 @@
+#include "Core.h"
+
+#include <string.h>
+
+/*------------------ Fusion.c ------------------
+ |
+ |  Purpose: Recognize fusible instruction pairs
+ |		and build/execute the fused micro-op.
+ |		The fused Decode keeps the head's rs1,
+ |		rd and ALU control and takes the tail's
+ |		other source as rs2; fuse_imm holds the
+ |		head's immediate and, for a branch,
+ |		immediate is the tail's offset.
+ |
+ *----------------------------------------------*/
+
+typedef struct FusionRule
+{
+	const char *name;
+	FuseKind kind;
+	unsigned head_funct3;
+	unsigned tail_opcode;
+	unsigned tail_funct3;
+}FusionRule;
+
+static const FusionRule fusion_rules[] = {
+	{"slli+add", FUSE_SHIFT_ADD,   1, 51, 0},
+	{"addi+bne", FUSE_ADDI_BRANCH, 0, 99, 1},
+	{"addi+beq", FUSE_ADDI_BRANCH, 0, 99, 0},
+};
+
+#define NUM_FUSION_RULES (int)(sizeof(fusion_rules) / sizeof(fusion_rules[0]))
+
+bool parseFusionRules(const char *list, unsigned *rules) {
+	char buf[128];
+	char *save = NULL;
+	char *name;
+	int i;
+
+	*rules = 0;
+	snprintf(buf, sizeof(buf), "%s", list);
+	for (name = strtok_r(buf, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+		if (strcmp(name, "all") == 0) {
+			*rules = (1u << NUM_FUSION_RULES) - 1;
+			continue;
+		}
+		if (strcmp(name, "none") == 0) {
+			*rules = 0;
+			continue;
+		}
+		for (i=0; i<NUM_FUSION_RULES; i++) {
+			if (strcmp(name, fusion_rules[i].name) == 0) {
+				*rules |= 1u << i;
+				break;
+			}
+		}
+		if (i == NUM_FUSION_RULES) {
+			printf("Unknown fusion pair %s (known: all, none", name);
+			for (i=0; i<NUM_FUSION_RULES; i++) {
+				printf(", %s", fusion_rules[i].name);
+			}
+			printf(").\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+void printFusionRules(unsigned rules) {
+	int i;
+	bool first = true;
+
+	for (i=0; i<NUM_FUSION_RULES; i++) {
+		if (rules & (1u << i)) {
+			printf(first ? "%s" : ", %s", fusion_rules[i].name);
+			first = false;
+		}
+	}
+}
+
+FuseKind fusePair(unsigned rules, unsigned int head, unsigned int tail) {
+	unsigned h_rd = (head >> 7) & 0x1f;
+	unsigned h_funct3 = (head >> 12) & 0x7;
+	unsigned t_opcode = tail & 0x7f;
+	unsigned t_rd = (tail >> 7) & 0x1f;
+	unsigned t_funct3 = (tail >> 12) & 0x7;
+	unsigned t_rs1 = (tail >> 15) & 0x1f;
+	unsigned t_rs2 = (tail >> 20) & 0x1f;
+	int i;
+
+	if ((head & 0x7f) != 19 || h_rd == 0) {
+		return FUSE_NONE;
+	}
+	for (i=0; i<NUM_FUSION_RULES; i++) {
+		const FusionRule *rule = &fusion_rules[i];
+		if (!(rules & (1u << i)) || rule->head_funct3 != h_funct3
+			|| rule->tail_opcode != t_opcode || rule->tail_funct3 != t_funct3) {
+			continue;
+		}
+		if (rule->kind == FUSE_SHIFT_ADD) {
+			unsigned shamt = (head >> 20) & 0xfff;
+			if (shamt >= 1 && shamt <= 3 && (tail >> 25) == 0
+				&& t_rd == h_rd && (t_rs1 == h_rd || t_rs2 == h_rd)) {
+				return FUSE_SHIFT_ADD;
+			}
+		} else if (t_rs1 == h_rd) {
+			return FUSE_ADDI_BRANCH;
+		}
+	}
+	return FUSE_NONE;
+}
+
+// Fetch stage: after head, also take the next instruction if the two fuse
+bool fetchFusedTail(Core *core, unsigned int head, unsigned head_size, FusedTail *tail) {
+	unsigned size;
+
+	tail->kind = FUSE_NONE;
+	if (core->fusion == 0 || !instructionReady(core->instr_mem, core->PC)) {
+		return false;
+	}
+	tail->instruction = peekInstruction(&core->fetch_buf, core->instr_mem, core->PC, &size);
+	tail->kind = fusePair(core->fusion, head, tail->instruction);
+	if (tail->kind == FUSE_NONE) {
+		return false;
+	}
+	fetchInstruction(&core->fetch_buf, core->instr_mem, core->PC, &size);
+	tail->offset = head_size;
+	core->PC += size;
+	return true;
+}
+
+// Merge the tail into the head's decode
+void fuseDecode(Decode *dec, const FusedTail *tail) {
+	Signal t_rs1 = (tail->instruction >> 15) & 0x1f;
+	Signal t_rs2 = (tail->instruction >> 20) & 0x1f;
+
+	dec->fuse = tail->kind;
+	dec->fuse_imm = dec->immediate;
+	dec->fuse_offset = tail->offset;
+	dec->opcode = tail->instruction & 0x7f;
+	dec->ctrl_signals.ALUSrc = 0;
+	if (tail->kind == FUSE_SHIFT_ADD) {
+		// The add's other operand; add rd, rd, rd reads the shifted value twice
+		dec->rs2 = t_rs1 == dec->rd ? t_rs2 : t_rs1;
+	} else {
+		dec->rs2 = t_rs2;
+		dec->funct3 = (tail->instruction >> 12) & 0x7;
+		dec->immediate = ImmeGen(tail->instruction);
+		dec->ctrl_signals.Branch = 1;
+	}
+}
+
+// Both halves in one pass: the head's result feeds the tail directly.
+// A tail source equal to rd reads the head's result, not the old value.
+void fusedExecute(Decode *dec, Addr pc, Signal val1, Signal val2,
+                  Signal *result, Signal *taken, Addr *target)
+{
+	Signal head, other, diff, zero, neg;
+
+	ALU(val1, dec->fuse_imm, dec->ALU_ctrl_signal, &head, &zero, &neg);
+	other = dec->rs2 == dec->rd ? head : val2;
+	*taken = 0;
+	if (dec->fuse == FUSE_SHIFT_ADD) {
+		ALU(head, other, 2, result, &zero, &neg);
+		return;
+	}
+	*result = head;
+	ALU(head, other, 6, &diff, &zero, &neg);
+	*taken = BranchUnit(dec->funct3, head, other, zero, neg);
+	*target = Add(pc + dec->fuse_offset, ShiftLeft1(dec->immediate));
+}
@@ -0,0 +1,49 @@
+#ifndef __FUSION_H__
+#define __FUSION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------ Fusion.h ------------------
+ |
+ |  Macro-op fusion. Decode recognizes common
+ |  instruction pairs as they come out of the
+ |  fetch buffer and merges them into a single
+ |  internal micro-op that takes one pipeline,
+ |  ROB and issue slot:
+ |
+ |	slli rd, rs1, 1..3 ; add rd, rd, rs2
+ |		shift-add (indexed address computation)
+ |	addi rd, rs1, imm ; bne/beq rd, rs2, off
+ |		increment-and-branch (loop counter)
+ |
+ |  The tail must read the head's rd; the pair
+ |  then writes only that register, so no value
+ |  has to be forwarded between the two halves.
+ |
+ *----------------------------------------------*/
+
+typedef enum FuseKind
+{
+	FUSE_NONE,
+	FUSE_SHIFT_ADD,
+	FUSE_ADDI_BRANCH
+}FuseKind;
+
+// Second instruction of a fused pair, as fetched
+typedef struct FusedTail
+{
+	FuseKind kind;            // FUSE_NONE if the head is on its own
+	unsigned int instruction; // tail encoding, expanded to 32 bits
+	unsigned offset;          // tail PC - head PC
+}FusedTail;
+
+// Pairs by name: "slli+add", "addi+bne", "addi+beq". A comma-separated
+// list, or "all"/"none", sets the enabled rules.
+bool parseFusionRules(const char *list, unsigned *rules);
+void printFusionRules(unsigned rules);
+
+// The pair (head, tail) fuses under the enabled rules into this kind
+FuseKind fusePair(unsigned rules, unsigned int head, unsigned int tail);
+
+#endif
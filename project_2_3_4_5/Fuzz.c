@@ -0,0 +1,647 @@
+#include "Fuzz.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Cache.h"
+#include "Core.h"
+#include "Parser.h"
+#include "Ref.h"
+#include "State.h"
+#include "StoreBuffer.h"
+
+/*------------------ Fuzz.c --------------------
+ |
+ |  Purpose: Random program generation, the
+ |		side-by-side run of the pipeline and
+ |		the reference model, and shrinking a
+ |		failing program to a reproducer.
+ |
+ *----------------------------------------------*/
+
+#define POOL_FIRST 5   // destinations come from x5-x12
+#define POOL_SIZE 8
+
+typedef enum FuzzFormat
+{
+	FMT_R,       // op rd, rs1, rs2
+	FMT_I,       // op rd, rs1, imm
+	FMT_SHIFT,   // op rd, rs1, shamt (0-63)
+	FMT_SHIFTW,  // op rd, rs1, shamt (0-31)
+	FMT_LOAD,    // op rd, imm(base)
+	FMT_STORE,   // op rs2, imm(base)
+	FMT_BRANCH   // op rs1, rs2, offset
+}FuzzFormat;
+
+typedef struct FuzzOp
+{
+	const char *name;
+	FuzzFormat format;
+	int width;           // bytes, loads and stores
+}FuzzOp;
+
+static const FuzzOp r_ops[] = {
+	{"add", FMT_R}, {"sub", FMT_R}, {"sll", FMT_R}, {"slt", FMT_R}, {"sltu", FMT_R},
+	{"xor", FMT_R}, {"srl", FMT_R}, {"sra", FMT_R}, {"or", FMT_R}, {"and", FMT_R},
+	{"addw", FMT_R}, {"subw", FMT_R}, {"sllw", FMT_R}, {"srlw", FMT_R}, {"sraw", FMT_R},
+};
+
+static const FuzzOp i_ops[] = {
+	{"addi", FMT_I}, {"slti", FMT_I}, {"sltiu", FMT_I}, {"xori", FMT_I}, {"ori", FMT_I},
+	{"andi", FMT_I}, {"addiw", FMT_I}, {"slli", FMT_SHIFT}, {"srli", FMT_SHIFT},
+	{"srai", FMT_SHIFT}, {"slliw", FMT_SHIFTW}, {"srliw", FMT_SHIFTW}, {"sraiw", FMT_SHIFTW},
+};
+
+static const FuzzOp load_ops[] = {
+	{"lb", FMT_LOAD, 1}, {"lh", FMT_LOAD, 2}, {"lw", FMT_LOAD, 4}, {"ld", FMT_LOAD, 8},
+	{"lbu", FMT_LOAD, 1}, {"lhu", FMT_LOAD, 2}, {"lwu", FMT_LOAD, 4},
+};
+
+static const FuzzOp store_ops[] = {
+	{"sb", FMT_STORE, 1}, {"sh", FMT_STORE, 2}, {"sw", FMT_STORE, 4}, {"sd", FMT_STORE, 8},
+};
+
+static const FuzzOp branch_ops[] = {
+	{"beq", FMT_BRANCH}, {"bne", FMT_BRANCH}, {"blt", FMT_BRANCH},
+	{"bge", FMT_BRANCH}, {"bltu", FMT_BRANCH}, {"bgeu", FMT_BRANCH},
+};
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+
+typedef struct FuzzInstr
+{
+	const FuzzOp *op;
+	int rd, rs1, rs2;
+	int imm;             // branches: the index of the target
+}FuzzInstr;
+
+// A program and everything it starts from. All instructions are 4
+// bytes, so instruction i is at PC 4 * i.
+typedef struct FuzzProgram
+{
+	FuzzInstr code[FUZZ_LENGTH];
+	int length;
+	int64_t regs[32];
+	Addr base;
+	uint8_t window[FUZZ_WINDOW];
+	const PipelineVariant *pipeline;
+	unsigned fusion;
+	int sb_entries;          // store buffer, 0 if none
+	DrainPolicy sb_policy;
+	int sb_latency;
+	int cache;               // fuzz_caches entry, 0 if none
+}FuzzProgram;
+
+// --dcache, --prefetch and --dram specs; the window is one line, so it
+// is the first miss and the timing around it that get exercised
+static const char *const fuzz_caches[][3] = {
+	{ NULL, NULL, NULL },
+	{ "l1d=1:1,l2=0,mem=5", NULL, NULL },
+	{ "l1d=1:2,l2=2:2:3,mem=9", "l1d=next", NULL },
+	{ "l1d=1:1,l2=4:4:2,mem=4", "l1d=stride:2:2,l2=stream", NULL },
+	{ "l1d=1:1,l2=0", "l1d=next:4", "banks=2,row=128,tRCD=3,tCAS=2,tRP=3,burst=2,queue=2" },
+	{ "l1d=1:2,l2=2:1:2", NULL, "channels=2,tRCD=4,tCAS=3,tRP=2,burst=1,policy=closed" },
+};
+
+typedef struct Fuzzer
+{
+	const FuzzConfig *cfg;
+	uint64_t rng;
+	int recent[3];       // the last destinations, newest first
+	unsigned all_fusion;
+
+	// Reused by every run
+	Arena arena;
+	ArenaMark empty;
+	char *text;
+	size_t text_size;
+
+	uint64_t runs;       // shrinking included
+	char why[256];       // what the last failing run got wrong
+}Fuzzer;
+
+/*------------------ Generation ----------------*/
+
+// splitmix64
+static uint64_t nextRandom(Fuzzer *fz) {
+	uint64_t z = (fz->rng += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static int below(Fuzzer *fz, int n) {
+	return nextRandom(fz) % n;
+}
+
+// Mostly the last three destinations, so results are read one, two and
+// three instructions after they are produced
+static int pickSource(Fuzzer *fz) {
+	int r = below(fz, 12);
+
+	if (r < 4) {
+		return fz->recent[0];
+	} else if (r < 6) {
+		return fz->recent[1];
+	} else if (r < 8) {
+		return fz->recent[2];
+	} else if (r == 8) {
+		return 0;
+	}
+	return POOL_FIRST + below(fz, POOL_SIZE);
+}
+
+static int pickDest(Fuzzer *fz) {
+	int rd;
+
+	if (below(fz, 32) == 0) {
+		return 0;
+	}
+	rd = POOL_FIRST + below(fz, POOL_SIZE);
+	fz->recent[2] = fz->recent[1];
+	fz->recent[1] = fz->recent[0];
+	fz->recent[0] = rd;
+	return rd;
+}
+
+// Register values around the edges the ALU cares about
+static int64_t pickValue(Fuzzer *fz) {
+	static const int64_t edges[] = {
+		0, 1, -1, 2, INT64_MIN, INT64_MAX, INT32_MIN, INT32_MAX,
+		0xffffffffll, 0x80000000ll, 63, 64, -2048, 2047,
+	};
+
+	switch (below(fz, 4)) {
+		case 0: return edges[below(fz, COUNT(edges))];
+		case 1: return below(fz, 64) - 32;
+		default: return (int64_t)nextRandom(fz);
+	}
+}
+
+static int pickImmediate(Fuzzer *fz) {
+	switch (below(fz, 4)) {
+		case 0: return below(fz, 2) ? -2048 : 2047;
+		case 1: return below(fz, 4096) - 2048;
+		default: return below(fz, 33) - 16;
+	}
+}
+
+static FuzzInstr *emit(FuzzProgram *p, const FuzzOp *op) {
+	FuzzInstr *in = &p->code[p->length++];
+
+	memset(in, 0, sizeof(*in));
+	in->op = op;
+	return in;
+}
+
+static void emitR(Fuzzer *fz, FuzzProgram *p) {
+	FuzzInstr *in = emit(p, &r_ops[below(fz, COUNT(r_ops))]);
+	in->rs1 = pickSource(fz);
+	in->rs2 = pickSource(fz);
+	in->rd = pickDest(fz);
+}
+
+static void emitI(Fuzzer *fz, FuzzProgram *p) {
+	FuzzInstr *in = emit(p, &i_ops[below(fz, COUNT(i_ops))]);
+	in->rs1 = pickSource(fz);
+	in->rd = pickDest(fz);
+	switch (in->op->format) {
+		case FMT_SHIFT: in->imm = below(fz, 64); break;
+		case FMT_SHIFTW: in->imm = below(fz, 32); break;
+		default: in->imm = pickImmediate(fz); break;
+	}
+}
+
+// Offsets are aligned to the width and stay inside the window
+static void emitMem(Fuzzer *fz, FuzzProgram *p, const FuzzOp *op, int offset) {
+	FuzzInstr *in = emit(p, op);
+	in->rs1 = FUZZ_BASE_REG;
+	in->imm = offset;
+	if (op->format == FMT_STORE) {
+		in->rs2 = pickSource(fz);
+	} else {
+		in->rd = pickDest(fz);
+	}
+}
+
+static int randomOffset(Fuzzer *fz, int width) {
+	return below(fz, FUZZ_WINDOW / width) * width;
+}
+
+// A load and, if there is room, an ALU operation that uses it at once
+static void emitLoadUse(Fuzzer *fz, FuzzProgram *p) {
+	const FuzzOp *op = &load_ops[below(fz, COUNT(load_ops))];
+
+	emitMem(fz, p, op, randomOffset(fz, op->width));
+	if (p->length < FUZZ_LENGTH && below(fz, 4) != 0) {
+		emitR(fz, p);
+	}
+}
+
+// A store and, often, a load that overlaps it: the same bytes, part of
+// them or more than them
+static void emitStoreLoad(Fuzzer *fz, FuzzProgram *p) {
+	const FuzzOp *st = &store_ops[below(fz, COUNT(store_ops))];
+	int offset = randomOffset(fz, st->width);
+
+	emitMem(fz, p, st, offset);
+	if (p->length < FUZZ_LENGTH && below(fz, 3) != 0) {
+		const FuzzOp *ld = &load_ops[below(fz, COUNT(load_ops))];
+		int at = offset & ~(ld->width - 1);
+		if (ld->width < st->width) {
+			at += below(fz, st->width / ld->width) * ld->width;
+		}
+		emitMem(fz, p, ld, at);
+	}
+}
+
+// One branch or two back to back, forward by one to six instructions
+// (the end of the program at most)
+static void emitBranches(Fuzzer *fz, FuzzProgram *p) {
+	int n = below(fz, 2) ? 2 : 1;
+
+	while (n-- > 0 && p->length < FUZZ_LENGTH) {
+		int at = p->length;
+		FuzzInstr *in = emit(p, &branch_ops[below(fz, COUNT(branch_ops))]);
+		in->rs1 = pickSource(fz);
+		in->rs2 = below(fz, 4) ? pickSource(fz) : in->rs1;
+		in->imm = at + 1 + below(fz, 6);
+		if (in->imm > FUZZ_LENGTH) {
+			in->imm = FUZZ_LENGTH;
+		}
+	}
+}
+
+static void generate(Fuzzer *fz, FuzzProgram *p) {
+	int i;
+
+	memset(p, 0, sizeof(*p));
+	for (i=0; i<3; i++) {
+		fz->recent[i] = POOL_FIRST + i;
+	}
+	for (i=POOL_FIRST; i<POOL_FIRST+POOL_SIZE; i++) {
+		p->regs[i] = pickValue(fz);
+	}
+	p->base = below(fz, DATA_MEM_SIZE / FUZZ_WINDOW) * FUZZ_WINDOW;
+	p->regs[FUZZ_BASE_REG] = p->base;
+	for (i=0; i<FUZZ_WINDOW; i++) {
+		p->window[i] = nextRandom(fz);
+	}
+
+	p->pipeline = fz->cfg->pipeline;
+	if (p->pipeline == NULL) {
+		p->pipeline = &pipeline_variants[below(fz, num_pipeline_variants)];
+	}
+	p->fusion = below(fz, 2) ? fz->all_fusion : 0;
+	// Small buffers, so full and overlapping stores are common
+	p->sb_entries = below(fz, 2) ? 1 + below(fz, 4) : 0;
+	p->sb_policy = below(fz, 2) ? DRAIN_LAZY : DRAIN_EAGER;
+	p->sb_latency = 1 + below(fz, 3);
+	p->cache = below(fz, 2) ? 1 + below(fz, 5) : 0;
+
+	while (p->length < FUZZ_LENGTH) {
+		int pick = below(fz, 100);
+		if (pick < 30) {
+			emitR(fz, p);
+		} else if (pick < 50) {
+			emitI(fz, p);
+		} else if (pick < 65) {
+			emitLoadUse(fz, p);
+		} else if (pick < 82) {
+			emitStoreLoad(fz, p);
+		} else {
+			emitBranches(fz, p);
+		}
+	}
+}
+
+/*------------------ Running -------------------*/
+
+static void appendText(Fuzzer *fz, size_t *len, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+static void appendText(Fuzzer *fz, size_t *len, const char *fmt, ...) {
+	va_list ap;
+	int n;
+
+	for (;;) {
+		va_start(ap, fmt);
+		n = vsnprintf(fz->text + *len, fz->text_size - *len, fmt, ap);
+		va_end(ap);
+		if (*len + n < fz->text_size) {
+			break;
+		}
+		fz->text_size = 2 * (*len + n + 1);
+		fz->text = realloc(fz->text, fz->text_size);
+		if (fz->text == NULL) {
+			printf("Fuzz: out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	*len += n;
+}
+
+// The program as a trace, in fz->text
+static size_t render(Fuzzer *fz, const FuzzProgram *p) {
+	size_t len = 0;
+	int i;
+
+	for (i=0; i<p->length; i++) {
+		const FuzzInstr *in = &p->code[i];
+		const char *name = in->op->name;
+		switch (in->op->format) {
+			case FMT_R:
+				appendText(fz, &len, "%s x%d, x%d, x%d\n", name, in->rd, in->rs1, in->rs2);
+				break;
+			case FMT_I:
+			case FMT_SHIFT:
+			case FMT_SHIFTW:
+				appendText(fz, &len, "%s x%d, x%d, %d\n", name, in->rd, in->rs1, in->imm);
+				break;
+			case FMT_LOAD:
+				appendText(fz, &len, "%s x%d, %d(x%d)\n", name, in->rd, in->imm, in->rs1);
+				break;
+			case FMT_STORE:
+				appendText(fz, &len, "%s x%d, %d(x%d)\n", name, in->rs2, in->imm, in->rs1);
+				break;
+			case FMT_BRANCH:
+				appendText(fz, &len, "%s x%d, x%d, %d\n", name, in->rs1, in->rs2, 4 * (in->imm - i));
+				break;
+		}
+	}
+	return len;
+}
+
+static bool failed(Fuzzer *fz, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static bool failed(Fuzzer *fz, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(fz->why, sizeof(fz->why), fmt, ap);
+	va_end(ap);
+	return false;
+}
+
+// Compare the end states; false with fz->why set if they differ
+static bool compare(Fuzzer *fz, const Core *core, const RefModel *ref) {
+	size_t addr;
+	int i;
+
+	for (i=1; i<32; i++) {
+		if (core->reg_file[i] != ref->x[i]) {
+			return failed(fz, "x%d = %" PRId64 ", the reference has %" PRId64, i, core->reg_file[i], ref->x[i]);
+		}
+	}
+	for (addr=0; addr<core->mem_size; addr++) {
+		if (core->data_mem[addr] != ref->mem[addr]) {
+			return failed(fz, "byte %zu = %u, the reference has %u", addr, core->data_mem[addr], ref->mem[addr]);
+		}
+	}
+	return true;
+}
+
+// Run p on the pipeline and on the reference; true if they end the same
+static bool runProgram(Fuzzer *fz, const FuzzProgram *p) {
+	Instruction_Memory i_mem;
+	RefModel ref;
+	RefEffect eff;
+	RefStatus status = REF_OK;
+	bool same;
+	int i;
+
+	loadInstructionsText(&i_mem, fz->text, render(fz, p));
+	arenaRewind(&fz->arena, fz->empty);
+	Core *core = initCore(&i_mem, &fz->arena);
+	core->pipeline = p->pipeline;
+	core->fusion = p->fusion;
+	core->quiet = true;
+	core->sb = initStoreBuffer(core, p->sb_entries, p->sb_policy, (p->sb_entries + 1) / 2, p->sb_latency);
+	if (p->cache) {
+		CacheConfig cache_cfg;
+		cacheConfigDefaults(&cache_cfg);
+		parseCacheSpec(fuzz_caches[p->cache][0], &cache_cfg);
+		if (fuzz_caches[p->cache][1]) {
+			parsePrefetchSpec(fuzz_caches[p->cache][1], &cache_cfg);
+		}
+		if (fuzz_caches[p->cache][2]) {
+			cache_cfg.dram = parseDRAMSpec(fuzz_caches[p->cache][2], &cache_cfg.dram_cfg);
+		}
+		core->dcache = initDataCache(core, &cache_cfg);
+	}
+	for (i=1; i<32; i++) {
+		core->reg_file[i] = p->regs[i];
+	}
+	memcpy(core->data_mem + p->base, p->window, FUZZ_WINDOW);
+	dirtyMark(&core->loaded, p->base, FUZZ_WINDOW);
+
+	if (!initRef(&ref, &i_mem, core->reg_file, core->PC, core->data_mem, core->mem_size)) {
+		printf("Fuzz: not enough memory for the reference model.\n");
+		exit(EXIT_FAILURE);
+	}
+	// Forward branches only: no more steps than instructions
+	for (i=0; i<=p->length && (status = refStep(&ref, &eff)) == REF_OK; i++) {
+	}
+
+	// A generous bound: every instruction stalled on a divide
+	Tick limit = 64 * (Tick)p->length + 64;
+	bool finished = !tickCycles(core, limit) || coreFinished(core);
+
+	if (status != REF_END) {
+		same = failed(fz, "the reference stopped at PC %" PRIu64 " (status %d), a generator bug", ref.pc, status);
+	} else if (!finished) {
+		same = failed(fz, "not finished after %" PRIu64 " cycles", limit);
+	} else {
+		same = compare(fz, core, &ref);
+	}
+
+	fz->runs++;
+	freeRef(&ref);
+	releaseState(core);
+	freeInstructions(&i_mem);
+	return same;
+}
+
+/*------------------ Shrinking -----------------*/
+
+// dst = src without instructions [from, from + count); branches into the
+// gap go to the first instruction after it
+static void removeRange(const FuzzProgram *src, int from, int count, FuzzProgram *dst) {
+	int i;
+
+	*dst = *src;
+	dst->length = 0;
+	for (i=0; i<src->length; i++) {
+		FuzzInstr in = src->code[i];
+		if (i >= from && i < from + count) {
+			continue;
+		}
+		if (in.op->format == FMT_BRANCH && in.imm > from) {
+			in.imm = in.imm < from + count ? from : in.imm - count;
+		}
+		dst->code[dst->length++] = in;
+	}
+}
+
+static void shrink(Fuzzer *fz, FuzzProgram *p) {
+	FuzzProgram trial;
+	bool progress = true;
+	int chunk, from, i;
+
+	// Halves, then quarters, ... then single instructions, until nothing
+	// more can go
+	while (progress) {
+		progress = false;
+		for (chunk = p->length / 2; chunk >= 1; chunk /= 2) {
+			for (from = 0; from < p->length; ) {
+				removeRange(p, from, chunk, &trial);
+				if (trial.length > 0 && !runProgram(fz, &trial)) {
+					*p = trial;
+					progress = true;
+				} else {
+					from += chunk;
+				}
+			}
+		}
+	}
+
+	// Registers and memory the failure does not need start at zero
+	for (i=1; i<32; i++) {
+		if (i != FUZZ_BASE_REG && p->regs[i] != 0) {
+			trial = *p;
+			trial.regs[i] = 0;
+			if (!runProgram(fz, &trial)) {
+				*p = trial;
+			}
+		}
+	}
+	trial = *p;
+	memset(trial.window, 0, FUZZ_WINDOW);
+	if (!runProgram(fz, &trial)) {
+		*p = trial;
+	}
+
+	// Leave fz->why describing the program as it is now
+	runProgram(fz, p);
+}
+
+/*------------------ Reproducers ---------------*/
+
+// The command-line options that run p's configuration
+static const char *options(const FuzzProgram *p, char *buf, size_t size) {
+	int n = snprintf(buf, size, "--config %s%s", p->pipeline->name, p->fusion ? " --fuse all" : "");
+
+	if (p->sb_entries) {
+		snprintf(buf + n, size - n, " --store-buffer %d --sb-drain %s --sb-latency %d", p->sb_entries,
+			p->sb_policy == DRAIN_LAZY ? "lazy" : "eager", p->sb_latency);
+		n += strlen(buf + n);
+	}
+	if (p->cache) {
+		n += snprintf(buf + n, size - n, " --dcache %s", fuzz_caches[p->cache][0]);
+		if (fuzz_caches[p->cache][1]) {
+			n += snprintf(buf + n, size - n, " --prefetch %s", fuzz_caches[p->cache][1]);
+		}
+		if (fuzz_caches[p->cache][2]) {
+			snprintf(buf + n, size - n, " --dram %s", fuzz_caches[p->cache][2]);
+		}
+	}
+	return buf;
+}
+
+// path.init alongside path, in the State.h text format
+static bool writeReproducer(Fuzzer *fz, const FuzzProgram *p, uint64_t number, char *path, size_t size) {
+	char init_path[4096 + 8], opts[256];
+	size_t len = render(fz, p);
+	FILE *fp;
+	int i;
+
+	snprintf(path, size, "%s/fuzz_%" PRIu64 "_%" PRIu64, fz->cfg->out_dir, fz->cfg->seed, number);
+	snprintf(init_path, sizeof(init_path), "%s.init", path);
+
+	fp = fopen(path, "w");
+	if (fp == NULL || fwrite(fz->text, 1, len, fp) != len) {
+		perror("Fuzz: cannot write the reproducer");
+		if (fp) {
+			fclose(fp);
+		}
+		return false;
+	}
+	fclose(fp);
+
+	fp = fopen(init_path, "w");
+	if (fp == NULL) {
+		perror("Fuzz: cannot write the reproducer state");
+		return false;
+	}
+	fprintf(fp, "# fuzz seed %" PRIu64 ", program %" PRIu64 ": %s\n",
+		fz->cfg->seed, number, options(p, opts, sizeof(opts)));
+	fprintf(fp, "# %s\n", fz->why);
+	for (i=1; i<32; i++) {
+		if (p->regs[i] != 0) {
+			fprintf(fp, "x%d=%" PRId64 "\n", i, p->regs[i]);
+		}
+	}
+	for (i=0; i<FUZZ_WINDOW && p->window[i] == 0; i++) {
+	}
+	if (i < FUZZ_WINDOW) {
+		fprintf(fp, "bytes%" PRIu64 "=", p->base);
+		for (i=0; i<FUZZ_WINDOW; i++) {
+			fprintf(fp, "%02x%s", p->window[i], i + 1 < FUZZ_WINDOW ? " " : "\n");
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+/*------------------ Driver --------------------*/
+
+static double seconds(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int fuzz(const FuzzConfig *cfg) {
+	Fuzzer fz;
+	FuzzProgram p;
+	uint64_t n, programs = 0;
+	int failures = 0;
+	double start = seconds(), elapsed;
+
+	memset(&fz, 0, sizeof(fz));
+	fz.cfg = cfg;
+	fz.rng = cfg->seed;
+	parseFusionRules("all", &fz.all_fusion);
+	arenaInit(&fz.arena);
+	fz.empty = arenaMark(&fz.arena);
+
+	printf("Fuzz: %" PRIu64 " programs of %d instructions, seed %" PRIu64 ", %s\n", cfg->programs, FUZZ_LENGTH,
+		cfg->seed, cfg->pipeline ? cfg->pipeline->name : "random configurations");
+	for (n=0; n<cfg->programs && failures < FUZZ_MAX_FAILURES; n++) {
+		generate(&fz, &p);
+		programs++;
+		if (runProgram(&fz, &p)) {
+			continue;
+		}
+
+		char path[4096], opts[256];
+		failures++;
+		printf("Fuzz: program %" PRIu64 " (%s) fails: %s\n", n, options(&p, opts, sizeof(opts)), fz.why);
+		shrink(&fz, &p);
+		if (writeReproducer(&fz, &p, n, path, sizeof(path))) {
+			printf("Fuzz:   shrunk to %d instructions (%s), reproducer %s\n", p.length, fz.why, path);
+			printf("Fuzz:   rerun with: RVSim %s --check %s\n", options(&p, opts, sizeof(opts)), path);
+		}
+	}
+	elapsed = seconds() - start;
+
+	printf("Fuzz: %" PRIu64 " programs, %d failed, %.2f s (%.0f programs/s, %" PRIu64 " runs in all)\n",
+		programs, failures, elapsed, elapsed > 0 ? programs / elapsed : 0.0, fz.runs);
+	free(fz.text);
+	arenaFree(&fz.arena);
+	return failures ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,55 @@
+#ifndef __FUZZ_H__
+#define __FUZZ_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Pipeline.h"
+
+/*------------------ Fuzz.h --------------------
+ |
+ |  --fuzz N: constrained-random RV64I programs
+ |  run through an in-order pipeline and the
+ |  reference model (Ref.h) in the same process,
+ |  and the final registers and data memory
+ |  compared.
+ |
+ |  The generator aims at the hazard logic: most
+ |  sources are the last few destinations (RAW
+ |  chains at distance 1, 2 and 3), loads are
+ |  often used by the next instruction, branches
+ |  come in back-to-back pairs, and every load
+ |  and store goes through one base register into
+ |  a 64-byte window, so accesses of all widths
+ |  alias each other. Branches only go forward,
+ |  so every program ends.
+ |
+ |  Each program runs on a random configuration
+ |  (or the one given with --config/--stages),
+ |  with or without fusion, a store buffer and a
+ |  data cache with prefetchers and DRAM. A
+ |  failing program is shrunk by deleting
+ |  instructions and then zeroing registers
+ |  while it still fails, and written out as a
+ |  trace and its .init file, ready for --check.
+ |
+ *----------------------------------------------*/
+
+#define FUZZ_LENGTH 48      // instructions per program
+#define FUZZ_BASE_REG 3     // holds the address of the load/store window
+#define FUZZ_WINDOW 64      // bytes the loads and stores share
+#define FUZZ_MAX_FAILURES 10
+
+typedef struct FuzzConfig
+{
+	uint64_t programs;
+	uint64_t seed;
+	const PipelineVariant *pipeline;  // NULL: a random configuration per program
+	const char *out_dir;              // reproducers go here
+}FuzzConfig;
+
+// Stops after FUZZ_MAX_FAILURES failures; returns the process exit
+// status, 1 if any program failed
+int fuzz(const FuzzConfig *cfg);
+
+#endif
@@ -14,6 +14,13 @@ typedef struct
     // This is the translated binary format of assembly input
     unsigned int instruction;
 
+    // Length in bytes: 2 for compressed (RVC) instructions, else 4
+    unsigned int size;
+
+    // Assembly source line, for traces
+    char text[48];
+    int line; // line number in the trace file
+
 }Instruction;
 
 #endif
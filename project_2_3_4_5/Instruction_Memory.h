@@ -1,14 +1,45 @@
 #ifndef __INSTRUCTION_MEMORY_H__
 #define __INSTRUCTION_MEMORY_H__
 
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
 #include "Instruction.h"
 
-#define IMEM_SIZE 256
+#define FETCH_PAD 16 // image slack so a fetch block never runs off the end
+
+// Sized from the trace when it is loaded. With a streaming load the parser
+// thread appends to the arrays while the core runs: "last" and
+// "published_bytes" only ever move forward and are written after the
+// instruction they cover, so anything at or below them is safe to read.
 typedef struct
 {
-    Instruction instructions[IMEM_SIZE];
+    Instruction *instructions;
+    size_t capacity;
+
+    // Program image as fetched: 16- and 32-bit encodings back to back
+    uint8_t *image;
+    size_t image_size;
 
     Instruction *last; // Points to the last instruction
+    Addr published_bytes; // image bytes written so far
+    bool complete;        // the whole trace has been parsed
+
+    // Streaming load
+    bool streaming;
+    bool quiet;           // no per-line echo from the parser
+    FILE *trace;
+    pthread_t parser;
+    pthread_mutex_t lock;
+    pthread_cond_t grown;
+    bool waiting;         // fetch is blocked on the parser
+    uint64_t fetch_waits;
 }Instruction_Memory;
 
+// Is there an instruction at pc? Waits for the parser if it has not got
+// that far yet; false once the trace is complete and pc is past its end.
+bool instructionReady(Instruction_Memory *i_mem, Addr pc);
+
 #endif
@@ -0,0 +1,62 @@
+#include "Konata.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*------------------ Konata.c ------------------
+ |
+ |  Purpose: Kanata 0004 records. I starts an
+ |		instruction, L labels it, S/E start and
+ |		end a stage, R retires (type 0) or flushes
+ |		(type 1) it and C advances the clock.
+ |
+ *----------------------------------------------*/
+
+KonataWriter *openKonata(const char *path) {
+	FILE *fp = fopen(path, "w");
+
+	if (fp == NULL) {
+		perror("Cannot open Konata output");
+		return NULL;
+	}
+	KonataWriter *kw = (KonataWriter *)calloc(1, sizeof(KonataWriter));
+	kw->fp = fp;
+	fprintf(fp, "Kanata\t0004\n");
+	fprintf(fp, "C=\t0\n");
+	return kw;
+}
+
+void closeKonata(KonataWriter *kw) {
+	fclose(kw->fp);
+	free(kw);
+}
+
+void konataCycle(KonataWriter *kw, Tick clk) {
+	if (clk > kw->cycle) {
+		fprintf(kw->fp, "C\t%" PRIu64 "\n", clk - kw->cycle);
+		kw->cycle = clk;
+	}
+}
+
+void konataFetch(KonataWriter *kw, uint64_t id, Addr pc, const char *text) {
+	fprintf(kw->fp, "I\t%" PRIu64 "\t%" PRIu64 "\t0\n", id, id);
+	fprintf(kw->fp, "L\t%" PRIu64 "\t0\t%" PRIu64 ": %s\n", id, pc, text ? text : "");
+}
+
+void konataStage(KonataWriter *kw, uint64_t id, const char *prev, const char *next) {
+	if (prev) {
+		fprintf(kw->fp, "E\t%" PRIu64 "\t0\t%s\n", id, prev);
+	}
+	fprintf(kw->fp, "S\t%" PRIu64 "\t0\t%s\n", id, next);
+}
+
+void konataNote(KonataWriter *kw, uint64_t id, const char *note) {
+	fprintf(kw->fp, "L\t%" PRIu64 "\t1\tcycle %" PRIu64 ": %s\\n\n", id, kw->cycle + 1, note);
+}
+
+void konataRetire(KonataWriter *kw, uint64_t id, const char *stage, bool flushed) {
+	if (stage) {
+		fprintf(kw->fp, "E\t%" PRIu64 "\t0\t%s\n", id, stage);
+	}
+	fprintf(kw->fp, "R\t%" PRIu64 "\t%" PRIu64 "\t%d\n", id, flushed ? 0 : kw->retired++, flushed ? 1 : 0);
+}
@@ -0,0 +1,46 @@
+#ifndef __KONATA_H__
+#define __KONATA_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Instruction.h"
+
+/*------------------ Konata.h ------------------
+ |
+ |  Streaming writer for the Kanata log format
+ |  read by the Konata pipeline viewer. Records
+ |  go straight to the file as the simulation
+ |  produces them; the writer only remembers the
+ |  current cycle and the retire count, so its
+ |  memory use does not grow with the run.
+ |
+ *----------------------------------------------*/
+
+typedef struct KonataWriter
+{
+	FILE *fp;
+	Tick cycle;         // cycle of the last C record
+	uint64_t retired;   // retire ids are sequential
+}KonataWriter;
+
+KonataWriter *openKonata(const char *path);
+void closeKonata(KonataWriter *kw);
+
+// Advance the log to cycle clk
+void konataCycle(KonataWriter *kw, Tick clk);
+
+// A new instruction enters the pipeline, labelled with its PC and text
+void konataFetch(KonataWriter *kw, uint64_t id, Addr pc, const char *text);
+
+// The instruction leaves stage prev (NULL if none) and enters next
+void konataStage(KonataWriter *kw, uint64_t id, const char *prev, const char *next);
+
+// Hover text for an event such as a stall
+void konataNote(KonataWriter *kw, uint64_t id, const char *note);
+
+// Leave the pipeline: retired in order, or squashed by a flush
+void konataRetire(KonataWriter *kw, uint64_t id, const char *stage, bool flushed);
+
+#endif
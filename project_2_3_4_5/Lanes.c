@@ -0,0 +1,546 @@
+#include "Lanes.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/*------------------ Lanes.c -------------------
+ |
+ |  Purpose: Lockstep execution of one program
+ |		over many harts. ALU operations, branch
+ |		conditions and loads run on AVX-512 or
+ |		AVX2 kernels with the lane mask applied
+ |		in the kernel; anything the host cannot
+ |		do in SIMD (multiply/divide, AVX2 64-bit
+ |		arithmetic shifts) and the lanes past the
+ |		last full host register go through the
+ |		scalar ALU, so every lane computes exactly
+ |		what the pipelined core would.
+ |
+ *----------------------------------------------*/
+
+#define LANE(k) ((LaneMask)1 << (k))
+
+/*------------------ Host kernels --------------*/
+
+// Each kernel handles whole host registers and returns how many lanes it
+// processed (0 if it cannot do the operation); the caller finishes the
+// rest one lane at a time. Results are only written for lanes in mask.
+typedef int (*AluKernel)(Signal code, int64_t *dst, const int64_t *a, const int64_t *b, LaneMask mask, int lanes);
+typedef int (*CompareKernel)(Signal funct3, const int64_t *a, const int64_t *b, int lanes, LaneMask *taken);
+typedef int (*LoadKernel)(int64_t *dst, const uint8_t *mem, const int64_t *addr, LaneMask mask, int lanes);
+
+static int aluScalar(Signal code, int64_t *dst, const int64_t *a, const int64_t *b, LaneMask mask, int lanes) {
+	return 0;
+}
+
+static int compareScalar(Signal funct3, const int64_t *a, const int64_t *b, int lanes, LaneMask *taken) {
+	return 0;
+}
+
+static int loadScalar(int64_t *dst, const uint8_t *mem, const int64_t *addr, LaneMask mask, int lanes) {
+	return 0;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx512f")))
+static int aluAVX512(Signal code, int64_t *dst, const int64_t *a, const int64_t *b, LaneMask mask, int lanes) {
+	const __m512i shamt = _mm512_set1_epi64(63);
+	int k;
+
+	if (code != 0 && code != 1 && code != 2 && code != 3 && code != 4 && code != 5 && code != 6 && code != 25) {
+		return 0;
+	}
+	for (k=0; k+8<=lanes; k+=8) {
+		__mmask8 m = (mask >> k) & 0xff;
+		__m512i x = _mm512_loadu_si512(a + k);
+		__m512i y = _mm512_loadu_si512(b + k);
+		__m512i r;
+		switch (code) {
+			case 0:  r = _mm512_and_si512(x, y); break;
+			case 1:  r = _mm512_or_si512(x, y); break;
+			case 2:  r = _mm512_add_epi64(x, y); break;
+			case 3:  r = _mm512_xor_si512(x, y); break;
+			case 4:  r = _mm512_sllv_epi64(x, _mm512_and_si512(y, shamt)); break;
+			case 5:  r = _mm512_srlv_epi64(x, _mm512_and_si512(y, shamt)); break;
+			case 25: r = _mm512_srav_epi64(x, _mm512_and_si512(y, shamt)); break;
+			default: r = _mm512_sub_epi64(x, y); break;
+		}
+		_mm512_mask_storeu_epi64(dst + k, m, r);
+	}
+	return k;
+}
+
+// beq/bne look at a - b, blt/bge compare signed, as the branch unit does
+__attribute__((target("avx512f")))
+static int compareAVX512(Signal funct3, const int64_t *a, const int64_t *b, int lanes, LaneMask *taken) {
+	const __m512i zero = _mm512_setzero_si512();
+	int k;
+
+	*taken = 0;
+	for (k=0; k+8<=lanes; k+=8) {
+		__m512i x = _mm512_loadu_si512(a + k);
+		__m512i y = _mm512_loadu_si512(b + k);
+		__m512i d = _mm512_sub_epi64(x, y);
+		__mmask8 t;
+		switch (funct3) {
+			case 0:  t = _mm512_cmpeq_epi64_mask(d, zero); break;
+			case 1:  t = _mm512_cmpneq_epi64_mask(d, zero); break;
+			case 4:  t = _mm512_cmplt_epi64_mask(x, y); break;
+			case 5:  t = _mm512_cmpge_epi64_mask(x, y); break;
+			case 6:  t = _mm512_cmplt_epu64_mask(x, y); break;
+			case 7:  t = _mm512_cmpge_epu64_mask(x, y); break;
+			default: t = 0; break;
+		}
+		*taken |= (LaneMask)t << k;
+	}
+	return k;
+}
+
+__attribute__((target("avx512f")))
+static int loadAVX512(int64_t *dst, const uint8_t *mem, const int64_t *addr, LaneMask mask, int lanes) {
+	const __m512i limit = _mm512_set1_epi64(LANE_MEM_SIZE - 8);
+	int k;
+
+	for (k=0; k+8<=lanes; k+=8) {
+		__mmask8 m = (mask >> k) & 0xff;
+		__m512i x = _mm512_loadu_si512(addr + k);
+		// Out-of-range addresses read as 0
+		__mmask8 ok = _mm512_cmple_epu64_mask(x, limit);
+		// index = lane * LANE_MEM_STRIDE + addr
+		__m512i lane = _mm512_set_epi64((k+7) * LANE_MEM_STRIDE, (k+6) * LANE_MEM_STRIDE,
+			(k+5) * LANE_MEM_STRIDE, (k+4) * LANE_MEM_STRIDE, (k+3) * LANE_MEM_STRIDE,
+			(k+2) * LANE_MEM_STRIDE, (k+1) * LANE_MEM_STRIDE, k * LANE_MEM_STRIDE);
+		__m512i idx = _mm512_add_epi64(x, lane);
+		__m512i r = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), m & ok, idx, (const void *)mem, 1);
+		_mm512_mask_storeu_epi64(dst + k, m, r);
+	}
+	return k;
+}
+
+// Lane mask bits as a vector of all-ones/all-zero 64-bit elements
+__attribute__((target("avx2")))
+static inline __m256i maskAVX2(LaneMask mask, int k) {
+	const __m256i sel = _mm256_set_epi64x(8, 4, 2, 1);
+	__m256i bits = _mm256_set1_epi64x((mask >> k) & 0xf);
+	return _mm256_cmpeq_epi64(_mm256_and_si256(bits, sel), sel);
+}
+
+__attribute__((target("avx2")))
+static int aluAVX2(Signal code, int64_t *dst, const int64_t *a, const int64_t *b, LaneMask mask, int lanes) {
+	const __m256i shamt = _mm256_set1_epi64x(63);
+	int k;
+
+	// No 64-bit arithmetic shift in AVX2
+	if (code != 0 && code != 1 && code != 2 && code != 3 && code != 4 && code != 5 && code != 6) {
+		return 0;
+	}
+	for (k=0; k+4<=lanes; k+=4) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + k));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + k));
+		__m256i r;
+		switch (code) {
+			case 0:  r = _mm256_and_si256(x, y); break;
+			case 1:  r = _mm256_or_si256(x, y); break;
+			case 2:  r = _mm256_add_epi64(x, y); break;
+			case 3:  r = _mm256_xor_si256(x, y); break;
+			case 4:  r = _mm256_sllv_epi64(x, _mm256_and_si256(y, shamt)); break;
+			case 5:  r = _mm256_srlv_epi64(x, _mm256_and_si256(y, shamt)); break;
+			default: r = _mm256_sub_epi64(x, y); break;
+		}
+		_mm256_maskstore_epi64((long long *)(dst + k), maskAVX2(mask, k), r);
+	}
+	return k;
+}
+
+__attribute__((target("avx2")))
+static int compareAVX2(Signal funct3, const int64_t *a, const int64_t *b, int lanes, LaneMask *taken) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+	int k;
+
+	*taken = 0;
+	for (k=0; k+4<=lanes; k+=4) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + k));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + k));
+		__m256i d = _mm256_sub_epi64(x, y);
+		__m256i t;
+		switch (funct3) {
+			case 0:  t = _mm256_cmpeq_epi64(d, zero); break;
+			case 1:  t = _mm256_xor_si256(_mm256_cmpeq_epi64(d, zero), _mm256_set1_epi64x(-1)); break;
+			case 4:  t = _mm256_cmpgt_epi64(y, x); break;
+			case 5:  t = _mm256_xor_si256(_mm256_cmpgt_epi64(y, x), _mm256_set1_epi64x(-1)); break;
+			case 6:  t = _mm256_cmpgt_epi64(_mm256_xor_si256(y, sign), _mm256_xor_si256(x, sign)); break;
+			case 7:  t = _mm256_xor_si256(_mm256_cmpgt_epi64(_mm256_xor_si256(y, sign), _mm256_xor_si256(x, sign)),
+					_mm256_set1_epi64x(-1)); break;
+			default: t = zero; break;
+		}
+		*taken |= (LaneMask)_mm256_movemask_pd(_mm256_castsi256_pd(t)) << k;
+	}
+	return k;
+}
+
+__attribute__((target("avx2")))
+static int loadAVX2(int64_t *dst, const uint8_t *mem, const int64_t *addr, LaneMask mask, int lanes) {
+	const __m256i limit = _mm256_set1_epi64x(LANE_MEM_SIZE - 8);
+	int k;
+
+	for (k=0; k+4<=lanes; k+=4) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(addr + k));
+		// Out-of-range addresses (negative ones included) read as 0
+		__m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(x, limit), _mm256_cmpgt_epi64(_mm256_setzero_si256(), x));
+		__m256i m = maskAVX2(mask, k);
+		__m256i lane = _mm256_set_epi64x((k+3) * LANE_MEM_STRIDE, (k+2) * LANE_MEM_STRIDE,
+			(k+1) * LANE_MEM_STRIDE, k * LANE_MEM_STRIDE);
+		__m256i r = _mm256_mask_i64gather_epi64(_mm256_setzero_si256(), (const long long *)mem,
+			_mm256_add_epi64(x, lane), _mm256_andnot_si256(bad, m), 1);
+		_mm256_maskstore_epi64((long long *)(dst + k), m, r);
+	}
+	return k;
+}
+#endif
+
+static AluKernel alu_kernel = aluScalar;
+static CompareKernel compare_kernel = compareScalar;
+static LoadKernel load_kernel = loadScalar;
+static const char *kernel_name = "scalar";
+
+static void selectKernels(void) {
+#ifdef HAVE_X86_KERNELS
+	if (__builtin_cpu_supports("avx512f")) {
+		alu_kernel = aluAVX512;
+		compare_kernel = compareAVX512;
+		load_kernel = loadAVX512;
+		kernel_name = "AVX-512";
+	} else if (__builtin_cpu_supports("avx2")) {
+		alu_kernel = aluAVX2;
+		compare_kernel = compareAVX2;
+		load_kernel = loadAVX2;
+		kernel_name = "AVX2";
+	}
+#endif
+}
+
+const char *laneKernelName(void) {
+	return kernel_name;
+}
+
+/*------------------ Setup ---------------------*/
+
+LaneCore *initLanes(Core *core, int lanes)
+{
+	Instruction_Memory *i_mem = core->instr_mem;
+	int i, k;
+
+	if (core->mem_size > LANE_MEM_SIZE) {
+		printf("Lanes hold %d bytes of data memory; the initial state has %zu.\n", LANE_MEM_SIZE, core->mem_size);
+		return NULL;
+	}
+	selectKernels();
+
+	LaneCore *lc = (LaneCore *)calloc(1, sizeof(LaneCore));
+	lc->lanes = lanes;
+	lc->reg = calloc(32, sizeof(*lc->reg));
+	lc->mem = calloc(lanes, LANE_MEM_STRIDE);
+
+	// Predecode the program once
+	lc->prog_len = i_mem->last ? i_mem->last - i_mem->instructions + 1 : 0;
+	lc->end = i_mem->last ? i_mem->last->addr + i_mem->last->size : 0;
+	lc->prog = calloc(lc->prog_len, sizeof(LaneOp));
+	lc->index_of = malloc((lc->end / 2 + 1) * sizeof(int));
+	for (i=0; i<=(int)(lc->end / 2); i++) {
+		lc->index_of[i] = -1;
+	}
+	for (i=0; i<lc->prog_len; i++) {
+		Instruction *instr = &i_mem->instructions[i];
+		PipeInstr PI;
+		Exec ex;
+		PI.instruction = instr->size == 2 ? expandCompressed(instr->instruction) : instr->instruction;
+		PI.fused.kind = FUSE_NONE;
+		PI.dec = &lc->prog[i].dec;
+		PI.ex = &ex;
+		lc->prog[i].size = instr->size;
+
+		// A fused pair runs as one step. The tail keeps its own entry for
+		// branches that land on it.
+		if (core->fusion && i + 1 < lc->prog_len) {
+			Instruction *next = &i_mem->instructions[i + 1];
+			unsigned int tail = next->size == 2 ? expandCompressed(next->instruction) : next->instruction;
+			PI.fused.kind = fusePair(core->fusion, PI.instruction, tail);
+			PI.fused.instruction = tail;
+			PI.fused.offset = instr->size;
+			if (PI.fused.kind != FUSE_NONE) {
+				lc->prog[i].size += next->size;
+			}
+		}
+		decode(core, &PI);
+		if (PI.dec->ctrl_signals.Vector) {
+			printf("Lane-parallel mode runs scalar code only (vector instruction at PC %" PRIu64 ").\n", instr->addr);
+			freeLanes(lc);
+			return NULL;
+		}
+		lc->prog[i].pc = instr->addr;
+		lc->index_of[instr->addr / 2] = i;
+	}
+
+	for (k=0; k<lanes; k++) {
+		for (i=0; i<32; i++) {
+			lc->reg[i][k] = core->reg_file[i];
+		}
+		memcpy(lc->mem + k * LANE_MEM_STRIDE, core->data_mem, core->mem_size);
+		lc->pc[k] = core->PC;
+	}
+	return lc;
+}
+
+void freeLanes(LaneCore *lc) {
+	free(lc->reg);
+	free(lc->mem);
+	free(lc->prog);
+	free(lc->index_of);
+	free(lc);
+}
+
+bool applySweep(LaneCore *lc, const char *spec) {
+	int r, k;
+	long long start, step = 0;
+
+	if (sscanf(spec, "x%d=%lld:%lld", &r, &start, &step) >= 2) {
+		if (r < 1 || r > 31) {
+			printf("Sweep register must be x1-x31: %s\n", spec);
+			return false;
+		}
+		for (k=0; k<lc->lanes; k++) {
+			lc->reg[r][k] = start + k * step;
+		}
+		return true;
+	}
+	if (sscanf(spec, "mem%d=%lld:%lld", &r, &start, &step) >= 2) {
+		if (r < 0 || r > LANE_MEM_SIZE - 8) {
+			printf("Sweep address must be 0-%d: %s\n", LANE_MEM_SIZE - 8, spec);
+			return false;
+		}
+		for (k=0; k<lc->lanes; k++) {
+			int64_t value = start + k * step;
+			memcpy(lc->mem + k * LANE_MEM_STRIDE + r, &value, 8);
+		}
+		return true;
+	}
+	printf("Sweep must look like x5=0:1 or mem40=100:8, got %s\n", spec);
+	return false;
+}
+
+/*------------------ Execution -----------------*/
+
+// ALU on the lanes in mask: host kernel first, scalar ALU for the rest
+static void laneAlu(Signal code, int64_t *dst, const int64_t *a, const int64_t *b, LaneMask mask, int lanes) {
+	Signal zero, neg;
+	int k = alu_kernel(code, dst, a, b, mask, lanes);
+
+	for (; k<lanes; k++) {
+		if (mask & LANE(k)) {
+			Signal r = 0;
+			ALU(a[k], b[k], code, &r, &zero, &neg);
+			dst[k] = r;
+		}
+	}
+}
+
+// Branch condition per lane, bit k set if lane k takes it
+static LaneMask laneCompare(Signal funct3, const int64_t *a, const int64_t *b, int lanes) {
+	LaneMask taken = 0;
+	Signal zero, neg;
+	int k = compare_kernel(funct3, a, b, lanes, &taken);
+
+	for (; k<lanes; k++) {
+		Signal r = 0;
+		ALU(a[k], b[k], 6, &r, &zero, &neg);
+		if (BranchUnit(funct3, a[k], b[k], zero, neg)) {
+			taken |= LANE(k);
+		}
+	}
+	return taken;
+}
+
+// Run the instruction at the lowest live PC on every lane sitting there.
+// Returns false once all lanes have run off the end of the program.
+static bool laneStep(LaneCore *lc) {
+	LaneMask live = 0, mask = 0;
+	Addr pc = ~(Addr)0;
+	int k;
+
+	for (k=0; k<lc->lanes; k++) {
+		if (lc->pc[k] < lc->end) {
+			live |= LANE(k);
+			if (lc->pc[k] < pc) {
+				pc = lc->pc[k];
+			}
+		}
+	}
+	if (live == 0) {
+		return false;
+	}
+	for (k=0; k<lc->lanes; k++) {
+		if ((live & LANE(k)) && lc->pc[k] == pc) {
+			mask |= LANE(k);
+		}
+	}
+
+	lc->steps++;
+	if (mask != live) {
+		lc->divergent_steps++;
+	}
+
+	int idx = lc->index_of[pc / 2];
+	if (idx < 0) {
+		printf("Lanes jumped into the middle of an instruction at PC %" PRIu64 ", stopping them.\n", pc);
+		for (k=0; k<lc->lanes; k++) {
+			if (mask & LANE(k)) {
+				lc->pc[k] = lc->end;
+			}
+		}
+		return true;
+	}
+
+	LaneOp *op = &lc->prog[idx];
+	Decode *d = &op->dec;
+	int64_t imm[MAX_LANES], result[MAX_LANES];
+	const int64_t *a = lc->reg[d->rs1];
+	const int64_t *b = lc->reg[d->rs2];
+	bool writes = d->ctrl_signals.RegWrite && d->rd != 0;
+	Addr next_pc = pc + op->size;
+
+	lc->lane_instructions += __builtin_popcountll(mask) * (d->fuse != FUSE_NONE ? 2 : 1);
+	if (d->fuse != FUSE_NONE) {
+		// Head into rd (fusion needs rd != 0), then the tail reads it
+		// through the register file, which also covers rs2 == rd
+		lc->fused_steps++;
+		for (k=0; k<lc->lanes; k++) {
+			imm[k] = d->fuse_imm;
+		}
+		if (d->fuse == FUSE_SHIFT_ADD) {
+			laneAlu(d->ALU_ctrl_signal, result, a, imm, mask, lc->lanes);
+			laneAlu(2, lc->reg[d->rd], result, d->rs2 == d->rd ? result : b, mask, lc->lanes);
+		} else {
+			laneAlu(d->ALU_ctrl_signal, lc->reg[d->rd], a, imm, mask, lc->lanes);
+			a = lc->reg[d->rd];
+			pc += d->fuse_offset;
+		}
+	}
+
+	if (d->ctrl_signals.Branch) {
+		LaneMask taken = laneCompare(d->funct3, a, b, lc->lanes);
+		for (k=0; k<lc->lanes; k++) {
+			if (mask & LANE(k)) {
+				lc->pc[k] = (taken & LANE(k)) ? pc + ShiftLeft1(d->immediate) : next_pc;
+			}
+		}
+		return true;
+	}
+
+	if (d->fuse == FUSE_NONE) {
+		if (d->ctrl_signals.ALUSrc) {
+			for (k=0; k<lc->lanes; k++) {
+				imm[k] = d->immediate;
+			}
+			b = imm;
+		}
+
+		// ALU straight into rd unless memory comes after it
+		int64_t *dst = writes && !d->ctrl_signals.MemRead && !d->ctrl_signals.MemWrite ? lc->reg[d->rd] : result;
+		laneAlu(d->ALU_ctrl_signal, dst, a, b, mask, lc->lanes);
+	}
+
+	if (d->ctrl_signals.MemRead) {
+		int64_t *load_dst = writes ? lc->reg[d->rd] : result;
+		int len = memWidth(d->funct3);
+		// The gather kernels only do ld
+		int done = len == 8 ? load_kernel(load_dst, lc->mem, result, mask, lc->lanes) : 0;
+		for (k=done; k<lc->lanes; k++) {
+			if (mask & LANE(k)) {
+				uint64_t raw = 0;
+				if (result[k] >= 0 && result[k] <= LANE_MEM_SIZE - len) {
+					memcpy(&raw, lc->mem + k * LANE_MEM_STRIDE + result[k], len);
+				}
+				load_dst[k] = extendLoad(raw, d->funct3);
+			}
+		}
+	} else if (d->ctrl_signals.MemWrite) {
+		// Same operands as memAccess: rs2 stored at the ALU result
+		int len = memWidth(d->funct3);
+		for (k=0; k<lc->lanes; k++) {
+			int64_t at = result[k];
+			if ((mask & LANE(k)) && at >= 0 && at <= LANE_MEM_SIZE - len) {
+				memcpy(lc->mem + k * LANE_MEM_STRIDE + at, &lc->reg[d->rs2][k], len);
+			}
+		}
+	}
+
+	for (k=0; k<lc->lanes; k++) {
+		if (mask & LANE(k)) {
+			lc->pc[k] = next_pc;
+		}
+	}
+	return true;
+}
+
+void runLanes(LaneCore *lc) {
+	while (laneStep(lc)) {
+		if (lc->steps >= LANE_MAX_STEPS) {
+			printf("Stopped after %d steps.\n", LANE_MAX_STEPS);
+			break;
+		}
+	}
+}
+
+void printLanes(LaneCore *lc) {
+	int r, k, a;
+
+	printf("Lane-parallel run: %d lanes, %s kernels\n", lc->lanes, kernel_name);
+	printf("Steps: %" PRIu64 ", lane instructions: %" PRIu64 " (%.2f active lanes per step), divergent steps: %" PRIu64 "\n",
+		lc->steps, lc->lane_instructions,
+		lc->steps ? (double)lc->lane_instructions / lc->steps : 0.0, lc->divergent_steps);
+	if (lc->fused_steps) {
+		printf("Fused-pair steps: %" PRIu64 "\n", lc->fused_steps);
+	}
+
+	printf("\nFinal register values per lane (only registers != 0 in some lane):\n");
+	for (r=1; r<32; r++) {
+		bool nonzero = false;
+		for (k=0; k<lc->lanes; k++) {
+			nonzero |= lc->reg[r][k] != 0;
+		}
+		if (!nonzero) {
+			continue;
+		}
+		printf("x[%d]:", r);
+		for (k=0; k<lc->lanes; k++) {
+			printf(" %ld", lc->reg[r][k]);
+		}
+		printf("\n");
+	}
+
+	printf("\nFinal memory doublewords per lane (only values != 0 in some lane):\n");
+	for (a=0; a<LANE_MEM_SIZE; a+=8) {
+		bool nonzero = false;
+		for (k=0; k<lc->lanes; k++) {
+			int64_t value;
+			memcpy(&value, lc->mem + k * LANE_MEM_STRIDE + a, 8);
+			nonzero |= value != 0;
+		}
+		if (!nonzero) {
+			continue;
+		}
+		printf("Mem[%d]:", a);
+		for (k=0; k<lc->lanes; k++) {
+			int64_t value;
+			memcpy(&value, lc->mem + k * LANE_MEM_STRIDE + a, 8);
+			printf(" %ld", value);
+		}
+		printf("\n");
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef __LANES_H__
+#define __LANES_H__
+
+#include "Core.h"
+
+/*------------------ Lanes.h -------------------
+ |
+ |  Lane-parallel functional simulation. One
+ |  program runs on K independent harts in
+ |  lockstep, each with its own registers, data
+ |  memory and PC. Registers are kept as
+ |  structure-of-arrays (reg[r][lane]) so every
+ |  instruction executes across all lanes at once
+ |  on host SIMD. Lanes whose PC differs are
+ |  masked off; each step runs the lowest PC, so
+ |  diverged lanes join up again where their
+ |  paths meet. No timing is modelled.
+ |
+ *----------------------------------------------*/
+
+#define MAX_LANES 64
+#define LANE_MEM_SIZE 1024
+#define LANE_MEM_STRIDE (LANE_MEM_SIZE + 8)  // padding for 8-byte gathers
+#define LANE_MAX_STEPS 100000000
+
+typedef uint64_t LaneMask;  // bit k set: lane k takes part
+
+// Predecoded static instruction
+typedef struct LaneOp
+{
+	Addr pc;
+	unsigned size;
+	Decode dec;
+}LaneOp;
+
+typedef struct LaneCore
+{
+	int lanes;
+	int64_t (*reg)[MAX_LANES];  // reg[r][lane]
+	uint8_t *mem;               // lane k at mem + k * LANE_MEM_STRIDE
+	Addr pc[MAX_LANES];
+
+	LaneOp *prog;               // a fused pair is one entry covering both
+	int prog_len;
+	int *index_of;              // instruction index by PC/2, -1 if none
+	Addr end;                   // first address past the program
+
+	// Statistics
+	uint64_t steps;             // instructions issued to the lanes
+	uint64_t lane_instructions; // ... summed over the active lanes
+	uint64_t divergent_steps;   // steps run with some live lanes masked off
+	uint64_t fused_steps;       // steps that ran a fused pair
+}LaneCore;
+
+// K copies of core's current register file and data memory, 1 <= K <= MAX_LANES
+LaneCore *initLanes(Core *core, int lanes);
+void freeLanes(LaneCore *lc);
+
+// Apply "xN=start:step" or "memA=start:step": lane k gets start + k * step
+bool applySweep(LaneCore *lc, const char *spec);
+
+void runLanes(LaneCore *lc);
+void printLanes(LaneCore *lc);
+
+// Name of the host kernels in use ("AVX-512", "AVX2" or "scalar")
+const char *laneKernelName(void);
+
+#endif
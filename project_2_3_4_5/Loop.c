@@ -0,0 +1,166 @@
+#include "Core.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+/*------------------ Loop.c --------------------
+ |
+ |  Purpose: Fingerprint loop iterations and
+ |		skip over them once the timing is in a
+ |		steady state. Skipped iterations still
+ |		run, one instruction at a time through
+ |		the datapath functions, so registers
+ |		and memory end up exactly where the
+ |		detailed model would have left them.
+ |
+ *----------------------------------------------*/
+
+void initLoopDetector(LoopDetector *ld) {
+	memset(ld, 0, sizeof(*ld));
+	ld->path = LOOP_HASH_INIT;
+	ld->events = LOOP_HASH_INIT;
+}
+
+static void counters(Core *core, LoopIteration *it) {
+	it->retired = core->retired;
+	it->fused_pairs = core->fused_pairs;
+	it->fetched = core->fetch_buf.instructions;
+	it->compressed = core->fetch_buf.compressed;
+	it->block_reads = core->fetch_buf.block_reads;
+}
+
+static void startIteration(Core *core, LoopDetector *ld) {
+	ld->start = core->clk;
+	ld->path = LOOP_HASH_INIT;
+	ld->events = LOOP_HASH_INIT;
+	ld->executed = 0;
+	counters(core, &ld->begin);
+}
+
+static bool sameIteration(const LoopIteration *a, const LoopIteration *b) {
+	return a->branch_pc == b->branch_pc && a->cycles == b->cycles && a->path == b->path
+		&& a->executed == b->executed && a->events == b->events && a->retired == b->retired
+		&& a->fused_pairs == b->fused_pairs && a->fetched == b->fetched
+		&& a->compressed == b->compressed && a->block_reads == b->block_reads;
+}
+
+// A backward branch at branch_pc was just taken; state hashes what the
+// pipeline looks like now. True once the loop is in a steady state.
+bool loopBoundary(Core *core, Addr branch_pc, uint64_t state) {
+	LoopDetector *ld = &core->loop;
+	LoopIteration it;
+
+	counters(core, &it);
+	it.branch_pc = branch_pc;
+	it.cycles = core->clk - ld->start;
+	it.path = ld->path;
+	it.executed = ld->executed;
+	it.events = loopHash(ld->events, state);
+	it.retired -= ld->begin.retired;
+	it.fused_pairs -= ld->begin.fused_pairs;
+	it.fetched -= ld->begin.fetched;
+	it.compressed -= ld->begin.compressed;
+	it.block_reads -= ld->begin.block_reads;
+
+	ld->matches = sameIteration(&it, &ld->last) ? ld->matches + 1 : 0;
+	ld->last = it;
+	startIteration(core, ld);
+	return ld->confirm > 1 && ld->matches + 1 >= ld->confirm;
+}
+
+// Run one more iteration from target functionally. False if it does not
+// follow the fingerprinted path back to the branch; the caller undoes it.
+static bool functionalIteration(Core *core, const LoopIteration *it, Addr target) {
+	Addr pc = target;
+	uint64_t path = LOOP_HASH_INIT;
+	uint64_t executed = 0;
+
+	for (;;) {
+		const Instruction *instr = instructionAt(core->instr_mem, pc);
+		PipeInstr PI;
+		Decode dec;
+		Exec ex;
+
+		if (instr == NULL || executed == it->executed) {
+			return false;
+		}
+		PI.instruction = instr->size == 2 ? expandCompressed(instr->instruction) : instr->instruction;
+		PI.fused.kind = FUSE_NONE;
+		PI.dec = &dec;
+		PI.ex = &ex;
+		PI.pc = pc;
+		decode(core, &PI);
+		execute(core, &PI, core->reg_file[dec.rs1], core->reg_file[dec.rs2]);
+		memAccess(core, &PI);
+		writeBack(core, &PI);
+
+		path = loopHash(path, pc);
+		executed++;
+		if (ex.branch_taken) {
+			if (pc == it->branch_pc) {
+				return ex.branch_target == target && executed == it->executed && path == it->path;
+			}
+			pc = ex.branch_target;
+		} else {
+			pc += instr->size;
+		}
+	}
+}
+
+// Skip steady-state iterations of the loop back to target. Returns the
+// cycles skipped; the caller shifts its own cycle-stamped state by that.
+Tick loopExtrapolate(Core *core, Addr target) {
+	LoopDetector *ld = &core->loop;
+	const LoopIteration *it = &ld->last;
+	Register reg_file[32];
+	VectorState vec;
+	uint64_t n = 0;
+
+	// Memory is rolled back through a checkpoint, which only saves and
+	// restores the lines an iteration writes
+	if (ld->undo.map.lines == NULL) {
+		initCheckpoint(&ld->undo, core->arena, core->mem_size);
+	}
+	core->rollback = &ld->undo;
+	for (;;) {
+		memcpy(reg_file, core->reg_file, sizeof(reg_file));
+		vec = core->vec;
+		if (!functionalIteration(core, it, target)) {
+			memcpy(core->reg_file, reg_file, sizeof(reg_file));
+			checkpointRestore(&ld->undo, core->data_mem);
+			core->vec = vec;
+			break;
+		}
+		checkpointReset(&ld->undo);
+		n++;
+	}
+	core->rollback = NULL;
+	if (n == 0) {
+		return 0;
+	}
+
+	Tick cycles = n * it->cycles;
+	core->clk += cycles;
+	core->retired += n * it->retired;
+	core->fused_pairs += n * it->fused_pairs;
+	core->fetch_buf.instructions += n * it->fetched;
+	core->fetch_buf.compressed += n * it->compressed;
+	core->fetch_buf.block_reads += n * it->block_reads;
+
+	ld->jumps++;
+	ld->skipped_iterations += n;
+	ld->skipped_cycles += cycles;
+	ld->matches = 0;
+	startIteration(core, ld);
+	if (!core->quiet) {
+		// Part of the cycle log, which it interrupts
+		printf("Steady state at branch PC %" PRIu64 ": extrapolated %" PRIu64 " iterations of %" PRIu64 " cycles.\n\n",
+			it->branch_pc, n, it->cycles);
+	}
+	return cycles;
+}
+
+void printLoopStats(const LoopDetector *ld) {
+	printf("Loop extrapolation: %" PRIu64 " iterations (%" PRIu64 " cycles) skipped in %" PRIu64 " jumps\n",
+		ld->skipped_iterations, ld->skipped_cycles, ld->jumps);
+}
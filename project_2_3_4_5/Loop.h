@@ -0,0 +1,91 @@
+#ifndef __LOOP_H__
+#define __LOOP_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Dirty.h"
+#include "Instruction.h"
+
+/*------------------ Loop.h --------------------
+ |
+ |  Steady-state loop extrapolation for the in-
+ |  order pipelines. Every taken backward branch
+ |  closes a loop iteration, which is summarised
+ |  by a fingerprint: the branch PC, the cycles
+ |  it took, the path it executed, the stall and
+ |  forwarding events along the way and the
+ |  pipeline/scoreboard state it ended in. Once
+ |  enough iterations in a row have the same
+ |  fingerprint the timing is periodic, so the
+ |  following iterations are run on a functional
+ |  engine and charged the same cycles each,
+ |  until one leaves that path (normally the
+ |  exit); that one is simulated in detail again.
+ |
+ *----------------------------------------------*/
+
+#define LOOP_HASH_INIT 14695981039346656037ull
+
+typedef struct LoopIteration
+{
+	Addr branch_pc;
+	Tick cycles;
+	uint64_t path;         // hash of the PCs executed
+	uint64_t executed;     // instructions executed
+	uint64_t events;       // hash of stalls, forwards and the end state
+
+	// Counter deltas over the iteration
+	uint64_t retired;
+	uint64_t fused_pairs;
+	uint64_t fetched;
+	uint64_t compressed;
+	uint64_t block_reads;
+}LoopIteration;
+
+typedef struct LoopDetector
+{
+	int confirm;           // identical iterations in a row needed, 0 if off
+
+	// Iteration in progress
+	Tick start;
+	uint64_t path;
+	uint64_t executed;
+	uint64_t events;
+	LoopIteration begin;   // counters when it started
+
+	LoopIteration last;    // previous iteration
+	int matches;           // iterations in a row equal to the one before
+
+	// Taken backward branch seen this cycle, handled when it ends
+	bool boundary;
+	Addr boundary_pc;
+	Addr boundary_target;
+
+	MemCheckpoint undo;    // memory written by a skipped iteration
+
+	// Statistics
+	uint64_t jumps;
+	uint64_t skipped_iterations;
+	Tick skipped_cycles;
+}LoopDetector;
+
+static inline uint64_t loopHash(uint64_t hash, uint64_t value) {
+	return (hash ^ value) * 1099511628211ull;
+}
+
+// Timing event inside the current iteration (stall, forward, ...)
+static inline void loopEvent(LoopDetector *ld, uint64_t event) {
+	ld->events = loopHash(ld->events, event);
+}
+
+// Instruction executed on the detailed path
+static inline void loopExecuted(LoopDetector *ld, Addr pc) {
+	ld->path = loopHash(ld->path, pc);
+	ld->executed++;
+}
+
+void initLoopDetector(LoopDetector *ld);
+void printLoopStats(const LoopDetector *ld);
+
+#endif
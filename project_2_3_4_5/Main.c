@@ -1,7 +1,22 @@
 #include <stdio.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "Check.h"
 #include "Core.h"
+#include "Fuzz.h"
+#include "Lanes.h"
+#include "OoO.h"
 #include "Parser.h"
+#include "Pipeline.h"
+#include "Serve.h"
+#include "State.h"
+#include "Cache.h"
+#include "StoreBuffer.h"
+#include "VirtualMemory.h"
 
 // Function to print out bytes in binary form
 void print_byte(Byte n) {
@@ -11,30 +26,425 @@ void print_byte(Byte n) {
 	}
 }
 
+// Non-zero bytes of the lines a state file set, and of those the run
+// wrote if written is given. Any other line is still zero or as the
+// binary image had it, so it is never scanned.
+void print_memory(const Core *core, const DirtyMap *written) {
+	size_t line, addr;
+
+	if (core->mem_image) {
+		printf("(%zu-byte binary image, only lines set or written since are listed)\n", core->mem_size);
+	}
+	for (line = dirtyNext(&core->loaded, written, 0); line < core->loaded.num_lines; line = dirtyNext(&core->loaded, written, line + 1)) {
+		size_t end = (line + 1) << LINE_SHIFT;
+		if (end > core->mem_size) {
+			end = core->mem_size;
+		}
+		for (addr = line << LINE_SHIFT; addr < end; addr++) {
+			if (core->data_mem[addr]) {
+				printf("Mem[%zu]: ", addr);
+				print_byte(core->data_mem[addr]);
+				printf("\n");
+			}
+		}
+	}
+}
+
+void print_usage(const char *prog) {
+	printf("Usage: %s [options] <trace-file>\n", prog);
+	printf("  --stages N          in-order pipeline depth: 5, 7, 9 or 12 (default 5)\n");
+	printf("  --config NAME       in-order pipeline configuration, 'list' shows them (default 5-stage)\n");
+	printf("  --ooo               run the out-of-order core instead of the in-order pipeline\n");
+	printf("  --rob N             reorder buffer entries (default 32)\n");
+	printf("  --iq N              issue queue entries (default 16)\n");
+	printf("  --lsq N             load-store queue entries (default 16)\n");
+	printf("  --prf N             physical registers (default 64)\n");
+	printf("  --width N           fetch/rename/commit width (default 2)\n");
+	printf("  --issue-width N     instructions issued per cycle (default 2)\n");
+	printf("  --alus N            number of ALUs (default 2)\n");
+	printf("  --lsus N            number of load/store units (default 1)\n");
+	printf("  --alu-latency N     ALU latency in cycles (default 1)\n");
+	printf("  --load-latency N    load latency in cycles (default 2)\n");
+	printf("  --muls N            number of multipliers (default 1)\n");
+	printf("  --divs N            number of dividers (default 1)\n");
+	printf("  --mul-latency N     multiply latency in cycles (default 3)\n");
+	printf("  --div-latency N     divide latency in cycles (default 20)\n");
+	printf("  --mul-pipelined 0|1 multiplier accepts an operation every cycle (default 1)\n");
+	printf("  --div-pipelined 0|1 divider accepts an operation every cycle (default 0)\n");
+	printf("  --vlanes N          vector elements processed per cycle (default 4)\n");
+	printf("  --konata FILE       stream a Konata pipeline trace to FILE\n");
+	printf("  --lanes K           run K copies of the program in lockstep on host SIMD (no timing)\n");
+	printf("  --sweep SPEC        per-lane initial value, xN=start:step or memA=start:step (repeatable)\n");
+	printf("  --stream            start simulating while the trace is still being parsed\n");
+	printf("  --extrapolate N     skip loop iterations once N in a row had identical timing (in-order only)\n");
+	printf("  --profile PREFIX    write a per-PC profile to PREFIX.annotated and PREFIX.folded\n");
+	printf("  --fuse LIST         fuse instruction pairs: all, none or any of slli+add,addi+bne,addi+beq\n");
+	printf("  --quiet             no cycle-by-cycle log\n");
+	printf("  --counters          count pipeline events and print the totals (in-order only)\n");
+	printf("  --init FILE         initial registers and memory, text or binary image (default TRACE.init if present);\n");
+	printf("                      repeatable, later files apply on top\n");
+	printf("  --save-init FILE    write the initial state as a binary image to FILE\n");
+	printf("  --serve SOCKET      run as a daemon taking JSON jobs on a Unix socket (no trace argument)\n");
+	printf("  --workers N         --serve worker threads (default: online CPUs)\n");
+	printf("  --cache N           --serve parsed programs kept (default 64)\n");
+	printf("  --max-cycles N      stop after N cycles, finished or not\n");
+	printf("  --store-buffer N    stores wait in an N-entry buffer after MEM, loads forward from it (in-order only)\n");
+	printf("  --sb-drain POLICY   when the buffer writes to memory: eager or lazy (default eager)\n");
+	printf("  --sb-watermark N    entries a lazy buffer collects before it writes (default half of it)\n");
+	printf("  --sb-latency N      cycles per store buffer write (default 1)\n");
+	printf("  --vm                Sv39 virtual memory, the page table from satp (in-order only)\n");
+	printf("  --satp N            satp value, instead of the state file's satp=\n");
+	printf("  --itlb N            instruction TLB entries (default 32)\n");
+	printf("  --dtlb N            data TLB entries (default 32)\n");
+	printf("  --walk-latency N    cycles per page-table entry read by the walker (default 20)\n");
+	printf("  --dcache SPEC       L1D/L2 timing model (in-order only): default, or any of l1d=KB:WAYS,\n");
+	printf("                      l2=KB:WAYS:LATENCY, l2=0, mem=LATENCY (default l1d=32:8,l2=256:8:12,mem=100)\n");
+	printf("  --prefetch SPEC     data prefetchers, l1d=NAME[:DEGREE[:DISTANCE]] and/or l2=...; 'list' shows them\n");
+	printf("  --dram SPEC         DRAM behind the data cache instead of mem=: default, or any of channels=N, ranks=N,\n");
+	printf("                      banks=N, row=BYTES, tRCD=N, tCAS=N, tRP=N, burst=N, queue=N, policy=open|closed\n");
+	printf("  --check             compare every retired instruction with a reference ISA model (in-order only)\n");
+	printf("  --fuzz N            run N random programs on the pipeline and the reference model (no trace argument);\n");
+	printf("                      a random configuration each unless --stages or --config is given\n");
+	printf("  --seed S            --fuzz random seed (default: the time)\n");
+	printf("  --fuzz-out DIR      where --fuzz writes shrunk failing programs (default .)\n");
+	printf("  --diff FILE         write the changes from the initial state instead of the final memory dump ('-' for stdout)\n");
+}
+
 int main(int argc, const char *argv[])
 {	
-    if (argc != 2)
+	static struct option long_options[] = {
+		{"stages",       required_argument, 0, 's'},
+		{"config",       required_argument, 0, 'c'},
+		{"ooo",          no_argument,       0, 'o'},
+		{"rob",          required_argument, 0, 'r'},
+		{"iq",           required_argument, 0, 'q'},
+		{"lsq",          required_argument, 0, 'l'},
+		{"prf",          required_argument, 0, 'p'},
+		{"width",        required_argument, 0, 'w'},
+		{"issue-width",  required_argument, 0, 'i'},
+		{"alus",         required_argument, 0, 'a'},
+		{"lsus",         required_argument, 0, 'm'},
+		{"alu-latency",  required_argument, 0, 'A'},
+		{"load-latency", required_argument, 0, 'L'},
+		{"muls",         required_argument, 0, 'u'},
+		{"divs",         required_argument, 0, 'd'},
+		{"mul-latency",  required_argument, 0, 'M'},
+		{"div-latency",  required_argument, 0, 'D'},
+		{"mul-pipelined", required_argument, 0, 'P'},
+		{"div-pipelined", required_argument, 0, 'Q'},
+		{"vlanes",       required_argument, 0, 'V'},
+		{"konata",       required_argument, 0, 'k'},
+		{"lanes",        required_argument, 0, 'K'},
+		{"sweep",        required_argument, 0, 'S'},
+		{"stream",       no_argument,       0, 'T'},
+		{"fuse",         required_argument, 0, 'F'},
+		{"extrapolate",  required_argument, 0, 'X'},
+		{"profile",      required_argument, 0, 'R'},
+		{"quiet",        no_argument,       0, 'E'},
+		{"counters",     no_argument,       0, 'C'},
+		{"init",         required_argument, 0, 'I'},
+		{"save-init",    required_argument, 0, 'W'},
+		{"diff",         required_argument, 0, 'f'},
+		{"serve",        required_argument, 0, 'Y'},
+		{"workers",      required_argument, 0, 'N'},
+		{"cache",        required_argument, 0, 'H'},
+		{"max-cycles",   required_argument, 0, 'G'},
+		{"check",        no_argument,       0, 'Z'},
+		{"fuzz",         required_argument, 0, 'J'},
+		{"seed",         required_argument, 0, 'O'},
+		{"fuzz-out",     required_argument, 0, 'U'},
+		{"store-buffer", required_argument, 0, 'b'},
+		{"sb-drain",     required_argument, 0, 'B'},
+		{"sb-watermark", required_argument, 0, 'e'},
+		{"sb-latency",   required_argument, 0, 'g'},
+		{"vm",           no_argument,       0, 'v'},
+		{"satp",         required_argument, 0, 'x'},
+		{"itlb",         required_argument, 0, 'y'},
+		{"dtlb",         required_argument, 0, 'z'},
+		{"walk-latency", required_argument, 0, 'j'},
+		{"dcache",       required_argument, 0, 'h'},
+		{"prefetch",     required_argument, 0, 'n'},
+		{"dram",         required_argument, 0, 't'},
+		{0, 0, 0, 0}
+	};
+	bool use_ooo = false;
+	const PipelineVariant *pipeline = findPipeline(5);
+	bool pipeline_given = false;
+	FuzzConfig fuzz_cfg = { 0, (uint64_t)time(NULL), NULL, "." };
+	OoOConfig ooo_cfg;
+	int mul_latency = 3, div_latency = 20;
+	bool mul_pipelined = true, div_pipelined = false;
+	int vector_lanes = 4;
+	int lanes = 0;
+	const char *konata_path = NULL;
+	const char *sweeps[16];
+	int num_sweeps = 0;
+	bool stream = false;
+	unsigned fusion = 0;
+	int extrapolate = 0;
+	const char *profile_prefix = NULL;
+	bool quiet = false;
+	EventCounters counters;
+	bool count_events = false;
+	const char *init_paths[8];
+	int num_inits = 0;
+	const char *save_init_path = NULL;
+	const char *diff_path = NULL;
+	Tick max_cycles = TICK_FOREVER;
+	bool check = false, check_failed = false;
+	int sb_entries = 0, sb_watermark = 0, sb_latency = 1;
+	DrainPolicy sb_policy = DRAIN_EAGER;
+	bool vm = false, satp_given = false;
+	uint64_t satp = 0;
+	int itlb_entries = 32, dtlb_entries = 32, walk_latency = 20;
+	CacheConfig cache_cfg;
+	bool dcache = false;
+	ServeConfig serve_cfg = { NULL, (int)sysconf(_SC_NPROCESSORS_ONLN), 64 };
+	char default_init[4096];
+	int opt;
+
+	OoOConfigDefaults(&ooo_cfg);
+	cacheConfigDefaults(&cache_cfg);
+	while ((opt = getopt_long(argc, (char * const *)argv, "", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 's':
+				pipeline = findPipeline(atoi(optarg));
+				if (pipeline == NULL) {
+					printf("Unsupported pipeline depth: %s\n", optarg);
+					return EXIT_FAILURE;
+				}
+				pipeline_given = true;
+				break;
+			case 'c':
+				if (strcmp(optarg, "list") == 0) {
+					listConfigs();
+					return 0;
+				}
+				pipeline = findConfig(optarg);
+				if (pipeline == NULL) {
+					printf("Unknown pipeline configuration: %s (try --config list)\n", optarg);
+					return EXIT_FAILURE;
+				}
+				pipeline_given = true;
+				break;
+			case 'o': use_ooo = true; break;
+			case 'r': ooo_cfg.rob_size = atoi(optarg); break;
+			case 'q': ooo_cfg.iq_size = atoi(optarg); break;
+			case 'l': ooo_cfg.lsq_size = atoi(optarg); break;
+			case 'p': ooo_cfg.phys_regs = atoi(optarg); break;
+			case 'w': ooo_cfg.width = atoi(optarg); break;
+			case 'i': ooo_cfg.issue_width = atoi(optarg); break;
+			case 'a': ooo_cfg.num_alu = atoi(optarg); break;
+			case 'm': ooo_cfg.num_lsu = atoi(optarg); break;
+			case 'A': ooo_cfg.alu_latency = atoi(optarg); break;
+			case 'L': ooo_cfg.load_latency = atoi(optarg); break;
+			case 'u': ooo_cfg.num_mul = atoi(optarg); break;
+			case 'd': ooo_cfg.num_div = atoi(optarg); break;
+			case 'M': mul_latency = atoi(optarg); break;
+			case 'D': div_latency = atoi(optarg); break;
+			case 'P': mul_pipelined = atoi(optarg) != 0; break;
+			case 'Q': div_pipelined = atoi(optarg) != 0; break;
+			case 'V': vector_lanes = atoi(optarg); break;
+			case 'k': konata_path = optarg; break;
+			case 'K': lanes = atoi(optarg); break;
+			case 'T': stream = true; break;
+			case 'X': extrapolate = atoi(optarg); break;
+			case 'R': profile_prefix = optarg; break;
+			case 'E': quiet = true; break;
+			case 'C': count_events = true; break;
+			case 'W': save_init_path = optarg; break;
+			case 'f': diff_path = optarg; break;
+			case 'Y': serve_cfg.socket_path = optarg; break;
+			case 'N': serve_cfg.workers = atoi(optarg); break;
+			case 'H': serve_cfg.cache_size = atoi(optarg); break;
+			case 'G': max_cycles = strtoull(optarg, NULL, 0); break;
+			case 'Z': check = true; break;
+			case 'J': fuzz_cfg.programs = strtoull(optarg, NULL, 0); break;
+			case 'O': fuzz_cfg.seed = strtoull(optarg, NULL, 0); break;
+			case 'U': fuzz_cfg.out_dir = optarg; break;
+			case 'b': sb_entries = atoi(optarg); break;
+			case 'e': sb_watermark = atoi(optarg); break;
+			case 'g': sb_latency = atoi(optarg); break;
+			case 'v': vm = true; break;
+			case 'x': satp = strtoull(optarg, NULL, 0); satp_given = true; break;
+			case 'y': itlb_entries = atoi(optarg); break;
+			case 'z': dtlb_entries = atoi(optarg); break;
+			case 'j': walk_latency = atoi(optarg); break;
+			case 'B':
+				if (!parseDrainPolicy(optarg, &sb_policy)) {
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'h':
+				if (!parseCacheSpec(optarg, &cache_cfg)) {
+					return EXIT_FAILURE;
+				}
+				dcache = true;
+				break;
+			case 't':
+				if (!parseDRAMSpec(optarg, &cache_cfg.dram_cfg)) {
+					return EXIT_FAILURE;
+				}
+				cache_cfg.dram = true;
+				dcache = true;
+				break;
+			case 'n':
+				if (strcmp(optarg, "list") == 0) {
+					listPrefetchers();
+					return 0;
+				}
+				if (!parsePrefetchSpec(optarg, &cache_cfg)) {
+					return EXIT_FAILURE;
+				}
+				dcache = true;
+				break;
+			case 'I':
+				if (num_inits == 8) {
+					printf("At most 8 --init options.\n");
+					return EXIT_FAILURE;
+				}
+				init_paths[num_inits++] = optarg;
+				break;
+			case 'F':
+				if (!parseFusionRules(optarg, &fusion)) {
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'S':
+				if (num_sweeps == 16) {
+					printf("At most 16 --sweep options.\n");
+					return EXIT_FAILURE;
+				}
+				sweeps[num_sweeps++] = optarg;
+				break;
+			default:
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (serve_cfg.socket_path) {
+		if (optind != argc) {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		return serve(&serve_cfg);
+	}
+	if (fuzz_cfg.programs > 0) {
+		if (optind != argc) {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		fuzz_cfg.pipeline = pipeline_given ? pipeline : NULL;
+		return fuzz(&fuzz_cfg);
+	}
+
+    if (optind != argc - 1)
     {
-        printf("Usage: %s %s\n", argv[0], "<trace-file>");
+        print_usage(argv[0]);
 
         return 0;
     }
+	if (lanes != 0 && (lanes < 1 || lanes > MAX_LANES)) {
+		printf("Lane count must be between 1 and %d.\n", MAX_LANES);
+		return EXIT_FAILURE;
+	}
+	if (num_sweeps > 0 && lanes == 0) {
+		printf("--sweep needs --lanes.\n");
+		return EXIT_FAILURE;
+	}
+	if (mul_latency < 1 || div_latency < 1 || vector_lanes < 1) {
+		printf("Functional unit latencies and vector lanes must be >= 1.\n");
+		return EXIT_FAILURE;
+	}
+	if (extrapolate != 0 && (extrapolate < 2 || use_ooo)) {
+		printf("--extrapolate needs N >= 2 and the in-order pipeline.\n");
+		return EXIT_FAILURE;
+	}
+	if (extrapolate != 0 && pipeline->predictor != PREDICT_NOT_TAKEN) {
+		printf("--extrapolate needs a configuration without branch prediction.\n");
+		return EXIT_FAILURE;
+	}
+	if (profile_prefix && (extrapolate || lanes)) {
+		printf("--profile needs every cycle simulated, it cannot be combined with --extrapolate or --lanes.\n");
+		return EXIT_FAILURE;
+	}
+	if (use_ooo && ooo_cfg.phys_regs < 33) {
+		printf("--prf needs at least 33 physical registers (got %d).\n", ooo_cfg.phys_regs);
+		return EXIT_FAILURE;
+	}
+	if (use_ooo && (ooo_cfg.rob_size < 1 || ooo_cfg.iq_size < 1 || ooo_cfg.lsq_size < 1 || ooo_cfg.width < 1
+			|| ooo_cfg.issue_width < 1 || ooo_cfg.num_alu < 1 || ooo_cfg.num_lsu < 1
+			|| ooo_cfg.num_mul < 1 || ooo_cfg.num_div < 1
+			|| ooo_cfg.alu_latency < 1 || ooo_cfg.load_latency < 1)) {
+		printf("--ooo queue sizes, widths, unit counts and latencies must be >= 1.\n");
+		return EXIT_FAILURE;
+	}
+	if (count_events && use_ooo) {
+		printf("--counters applies to the in-order pipeline.\n");
+		return EXIT_FAILURE;
+	}
+	if (check && (use_ooo || lanes || extrapolate)) {
+		printf("--check follows the in-order pipeline instruction by instruction, without --ooo, --lanes or --extrapolate.\n");
+		return EXIT_FAILURE;
+	}
+	if (sb_entries < 0 || sb_latency < 1) {
+		printf("--store-buffer needs N >= 0 and --sb-latency N >= 1.\n");
+		return EXIT_FAILURE;
+	}
+	if (sb_entries && (use_ooo || lanes || extrapolate)) {
+		printf("--store-buffer models the in-order MEM stage, without --ooo, --lanes or --extrapolate.\n");
+		return EXIT_FAILURE;
+	}
+	if (vm && (itlb_entries < 1 || dtlb_entries < 1 || walk_latency < 1)) {
+		printf("--itlb, --dtlb and --walk-latency need N >= 1.\n");
+		return EXIT_FAILURE;
+	}
+	if (vm && (use_ooo || lanes || extrapolate || check)) {
+		printf("--vm models the in-order pipeline, without --ooo, --lanes, --extrapolate or --check.\n");
+		return EXIT_FAILURE;
+	}
+	if (dcache && (use_ooo || lanes || extrapolate)) {
+		printf("--dcache, --prefetch and --dram model the in-order MEM stage, without --ooo, --lanes or --extrapolate.\n");
+		return EXIT_FAILURE;
+	}
+	if (cache_cfg.l2_pf && cache_cfg.l2_kb == 0) {
+		printf("--prefetch l2=... needs an L2.\n");
+		return EXIT_FAILURE;
+	}
+	if (count_events && extrapolate) {
+		printf("--counters needs every cycle simulated, it cannot be combined with --extrapolate.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Without --init, a state file next to the trace is picked up
+	if (num_inits == 0) {
+		snprintf(default_init, sizeof(default_init), "%s.init", argv[optind]);
+		if (access(default_init, R_OK) == 0) {
+			init_paths[num_inits++] = default_init;
+		}
+	}
 
 	int i;
 
     /* Task One */
     // (1) parse and translate all the assembly instructions into binary format;
     // (2) store the translated binary instructions into instruction memory.
+    // With --stream the trace is parsed on another thread and fetch waits
+    // for it when it catches up, so the binary listing is skipped.
     Instruction_Memory instr_mem;
-    instr_mem.last = NULL;
-    loadInstructions(&instr_mem, argv[1]);
-    unsigned PC = 0;
-    while (1)
+    if (stream) {
+        startLoadInstructions(&instr_mem, argv[optind]);
+    } else {
+        loadInstructions(&instr_mem, argv[optind]);
+    }
+    Instruction *instr = instr_mem.instructions;
+    while (!stream && instr_mem.last)  // none in a trace of only comments
     {
-        Instruction *instr = &(instr_mem.instructions[PC / 4]);
-        printf("\nInstruction at PC: %u\n", PC);
-        unsigned mask = (1 << 31);
-        for (int i = 31; i >= 0; i--)
+        printf("\nInstruction at PC: %lu\n", instr->addr);
+        // Compressed instructions are printed as 16 bits
+        unsigned mask = 1u << (instr->size * 8 - 1);
+        for (int i = instr->size * 8 - 1; i >= 0; i--)
         {
             if (instr->instruction & mask) { printf("1");}
             else { printf("0"); }
@@ -43,13 +453,65 @@ int main(int argc, const char *argv[])
         }
         printf("\n");
         if (instr == instr_mem.last) { break; }
-        PC += 4;
+        instr++;
     }
 
 	printf("\n*----------------------------------------------*\n");
     /* Task Two */
     // implement Core.{h,c}
-    Core *core = initCore(&instr_mem);
+    // Everything the run allocates comes from the arena and goes with it
+    Arena arena;
+    arenaInit(&arena);
+    Core *core = initCore(&instr_mem, &arena);
+	core->pipeline = pipeline;
+	core->fu[FU_MUL].latency = mul_latency;
+	core->fu[FU_MUL].pipelined = mul_pipelined;
+	core->fu[FU_DIV].latency = div_latency;
+	core->fu[FU_DIV].pipelined = div_pipelined;
+	core->vec.lanes = vector_lanes;
+	core->fusion = fusion;
+	core->loop.confirm = extrapolate;
+	if (profile_prefix) {
+		core->profile = openProfiler(&instr_mem);
+	}
+	core->quiet = quiet;
+	if (count_events) {
+		memset(&counters, 0, sizeof(counters));
+		core->counters = &counters;
+	}
+	if (sb_entries) {
+		core->sb = initStoreBuffer(core, sb_entries, sb_policy,
+			sb_watermark ? sb_watermark : (sb_entries + 1) / 2, sb_latency);
+	}
+	for (i=0; i<num_inits; i++) {
+		printf("\nInitial state from %s\n", init_paths[i]);
+		char err[256];
+		if (!loadState(core, init_paths[i], err, sizeof(err))) {
+			printf("%s\n", err);
+			releaseState(core);
+			arenaFree(&arena);
+			freeInstructions(&instr_mem);
+			return EXIT_FAILURE;
+		}
+	}
+	if (satp_given) {
+		core->satp = satp;
+	}
+	if (vm && (core->vm = initVirtualMemory(core, core->satp, itlb_entries, dtlb_entries, walk_latency)) == NULL) {
+		releaseState(core);
+		arenaFree(&arena);
+		freeInstructions(&instr_mem);
+		return EXIT_FAILURE;
+	}
+	if (dcache) {
+		core->dcache = initDataCache(core, &cache_cfg);
+	}
+	if (save_init_path && saveState(core, save_init_path)) {
+		printf("Initial state written to %s\n", save_init_path);
+	}
+	Register initial_regs[32];
+	Addr initial_pc = core->PC;
+	memcpy(initial_regs, core->reg_file, sizeof(initial_regs));
 
 	// Print original values
 	printf("\nOriginal register values (only values != 0):\n");
@@ -61,21 +523,113 @@ int main(int argc, const char *argv[])
 	}
 
 	printf("\nOriginal memory bytes (only values != 0):\n");
-	for (i=0; i<1024; i++) {
-		if (core->data_mem[i]) {
-			printf("Mem[%d]: ", i);
-			print_byte(core->data_mem[i]);
-			printf("\n");
-		}
-	}
+	print_memory(core, NULL);
 
 	printf("\n*----------------------------------------------*\n");
     /* Task Three - Simulation */
 	printf("\nPROGRAM STARTED\n\n");
-    while (core->tick(core)) {
+	if (lanes != 0) {
+		// Lanes predecode the whole program up front
+		finishLoadInstructions(&instr_mem);
+		LaneCore *lc = initLanes(core, lanes);
+		for (i=0; lc && i<num_sweeps; i++) {
+			if (!applySweep(lc, sweeps[i])) {
+				freeLanes(lc);
+				lc = NULL;
+			}
+		}
+		bool ran = lc != NULL;
+		if (lc) {
+			runLanes(lc);
+			printLanes(lc);
+			freeLanes(lc);
+			printf("\nSimulation is finished.\n");
+		}
+		releaseState(core);
+		arenaFree(&arena);
+		freeInstructions(&instr_mem);
+		return ran ? 0 : EXIT_FAILURE;
+	}
+
+	if (konata_path) {
+		core->konata = openKonata(konata_path);
+		if (core->konata == NULL) {
+			releaseState(core);
+			arenaFree(&arena);
+			freeInstructions(&instr_mem);
+			return EXIT_FAILURE;
+		}
+	}
+
+	OoOCore *ooo = NULL;
+	if (use_ooo) {
+		ooo = initOoO(core, &ooo_cfg);
+	} else {
+		pipeline->describe();
+		printf("\n");
+	}
+	if (check) {
+		core->checker = startChecker(core);
+	}
+	// Cycle by cycle while the log is on; in quanta otherwise, which
+	// costs nothing next to simulating them. The checker stops the core
+	// at a divergence.
+	bool running = true;
+	while (running && core->clk < max_cycles && !core->break_hit) {
+		Tick left = max_cycles - core->clk;
+		running = core->quiet ? tickCycles(core, left < TICK_QUANTUM ? left : TICK_QUANTUM) : core->tick(core);
+	}
+	if (running && !core->break_hit && !coreFinished(core)) {
+		printf("\nStopped at --max-cycles %" PRIu64 " before the program finished.\n", max_cycles);
+	}
+	if (core->checker) {
+		check_failed = !finishChecker(core->checker, core, !running);
+		core->checker = NULL;
+	}
+	if (ooo) {
+		printOoOStats(ooo);
 	}
 
+	if (core->konata) {
+		closeKonata(core->konata);
+		core->konata = NULL;
+	}
+
+	finishLoadInstructions(&instr_mem);
 	printf("\nNumber of clock cycles: %ld\n", core->clk);
+	printFetchStats(&core->fetch_buf, &instr_mem);
+	if (stream) {
+		printf("Fetch waited for the parser %" PRIu64 " times\n", instr_mem.fetch_waits);
+	}
+	if (core->loop.confirm) {
+		printLoopStats(&core->loop);
+	}
+	if (core->profile) {
+		if (writeProfile(core->profile, profile_prefix, argv[optind], core->clk)) {
+			printf("Profile written to %s.annotated and %s.folded\n", profile_prefix, profile_prefix);
+		}
+		freeProfiler(core->profile);
+		core->profile = NULL;
+	}
+	if (core->counters) {
+		printEventCounters(core->counters, pipeline);
+	}
+	if (core->sb) {
+		printStoreBufferStats(core->sb);
+	}
+	if (core->vm) {
+		printVirtualMemoryStats(core->vm);
+	}
+	if (core->dcache) {
+		printDataCacheStats(core->dcache, core->clk);
+	}
+	if (core->fusion) {
+		printf("Macro-op fusion (");
+		printFusionRules(core->fusion);
+		printf("): %" PRIu64 " of %" PRIu64 " instructions retired as %" PRIu64 " fused pairs, IPC %.3f\n",
+			2 * core->fused_pairs, core->retired, core->fused_pairs,
+			core->clk ? (double)core->retired / core->clk : 0.0);
+	}
 	printf("\n");
 	printf("*----------------------------------------------*\n");
 
@@ -90,18 +644,43 @@ int main(int argc, const char *argv[])
 		}
 	}
 
-	printf("\nFinal memory bytes (only values != 0):\n");
-	for (i=0; i<1024; i++) {
-		if (core->data_mem[i]) {
-			printf("Mem[%d]: ", i);
-			print_byte(core->data_mem[i]);
-			printf("\n");
+	if (diff_path) {
+		printf("\nChanges from the initial state:\n");
+		if (saveDelta(core, initial_regs, initial_pc, diff_path) && strcmp(diff_path, "-") != 0) {
+			printf("Written to %s\n", diff_path);
+		}
+	} else {
+		printf("\nFinal memory bytes (only values != 0):\n");
+		print_memory(core, &core->initial.map);
+	}
+
+	// Vector registers, only if the program used the vector unit
+	if (core->vec.vl) {
+		printf("\nFinal vector registers (only registers != 0, vl = %" PRIu64 ", %s kernels):\n",
+			core->vec.vl, vectorKernelName());
+	}
+	for (i=0; i<32; i++) {
+		int j;
+		bool nonzero = false;
+		for (j=0; j<VLENB; j++) {
+			nonzero |= core->vec.vreg[i][j] != 0;
+		}
+		if (!nonzero) {
+			continue;
+		}
+		printf("v[%d] (e%d):", i, core->vec.sew);
+		for (j=0; j<VLEN/core->vec.sew; j++) {
+			printf(" %ld", vectorElement(core->vec.vreg[i], core->vec.sew, j));
 		}
+		printf("\n");
 	}
 
 
 	printf("\n");
     printf("Simulation is finished.\n");
 
-    free(core);    
+	releaseState(core);
+	arenaFree(&arena);
+	freeInstructions(&instr_mem);
+	return check_failed ? EXIT_FAILURE : 0;
 }
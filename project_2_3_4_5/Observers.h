@@ -0,0 +1,357 @@
+#ifndef __OBSERVERS_H__
+#define __OBSERVERS_H__
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "Check.h"
+#include "Core.h"
+
+/*------------------ Observers.h ---------------
+ |
+ |  Instrumentation observers for the in-order
+ |  pipelines. The run loop in Pipeline_Run.h
+ |  raises an event at each point of interest:
+ |
+ |	on_cycle(core, ps)             a cycle starts
+ |	                               (stage 0 filled)
+ |	on_stage(core, PI, s)          PI is in stage s
+ |	on_fetch(core, PI)             after fetch
+ |	on_decode(core, PI)            after decode
+ |	on_predict(core, ps, PI)       predicted taken
+ |	on_stall(core, ps, PI, cause)  PI held in EXEC
+ |	                               (or MEM or fetch,
+ |	                               for the memory
+ |	                               system)
+ |	on_forward(core, ps, PI, s, which)
+ |	                               operand bypassed
+ |	                               from stage s
+ |	on_execute(core, ps, PI)       after execute
+ |	on_flush(core, PI)             squashed
+ |	on_redirect(core, ps, PI)      mispredicted,
+ |	                               refetch at PC
+ |	on_branch(core, ps, PI)        branch taken
+ |	on_mem_access(core, PI)        after memory
+ |	on_writeback(core, PI)         after writeback
+ |	on_stage_done(core, PI, s)     stage s finished
+ |	on_retire(core, PI)            leaves WB
+ |	on_cycle_end(core, ps)         clock advanced
+ |
+ |  An observer NAME is a set of macros, one per
+ |  event, called NAME_on_fetch and so on; events
+ |  it does not care about expand to nothing. An
+ |  observer list picks which ones a run loop is
+ |  built with (see Pipeline.c), so the calls are
+ |  resolved by the preprocessor: there is no
+ |  dispatch at run time and a loop built with an
+ |  empty list contains no instrumentation at all.
+ |  The macros expand inside the run loop and may
+ |  use its P() helpers.
+ |
+ *----------------------------------------------*/
+
+// Observer lists: O(observer, event, args)
+#define OBSERVE_ALL(O, e, a) \
+	O(OBS_LOG, e, a) \
+	O(OBS_KONATA, e, a) \
+	O(OBS_PROFILE, e, a) \
+	O(OBS_LOOP, e, a) \
+	O(OBS_COUNTERS, e, a) \
+	O(OBS_CHECK, e, a)
+
+// Everything except the per-cycle log
+#define OBSERVE_SILENT(O, e, a) \
+	O(OBS_KONATA, e, a) \
+	O(OBS_PROFILE, e, a) \
+	O(OBS_LOOP, e, a) \
+	O(OBS_COUNTERS, e, a) \
+	O(OBS_CHECK, e, a)
+
+#define OBSERVE_NONE(O, e, a)
+
+/*------------------ OBS_LOG -------------------*/
+// The cycle-by-cycle log on stdout
+
+#define OBS_LOG_on_cycle(core, ps) \
+	printf("======================== Clock cycle %ld ========================\n", (core)->clk+1)
+#define OBS_LOG_on_stage(core, PI, s)
+#define OBS_LOG_on_fetch(core, PI) \
+	printf("Fetched instruction [%" PRIu64 "].\n", (PI)->seq)
+#define OBS_LOG_on_decode(core, PI) do { \
+	printf("Decoded instruction [%" PRIu64 "].\n", (PI)->seq); \
+	if ((PI)->dec->fuse != FUSE_NONE) { \
+		printf("Fused instruction [%" PRIu64 "] with the one after it.\n", (PI)->seq); \
+	} \
+} while (0)
+#define OBS_LOG_on_predict(core, ps, PI) \
+	printf("Predicted branch taken, fetching from PC %" PRIu64 ".\n", (core)->PC)
+#define OBS_LOG_on_stall(core, ps, PI, cause) \
+	printf("Inserting a bubble after instruction [%" PRIu64 "] because %s.\n", (PI)->seq, \
+		(cause) == STALL_DATA ? "of data hazard" : (cause) == STALL_UNIT ? "its functional unit is busy" \
+		: (cause) == STALL_STORE_FULL ? "the store buffer is full" \
+		: (cause) == STALL_STORE_DRAIN ? "it waits for the store buffer to drain" \
+		: (cause) == STALL_TLB ? "of a TLB miss" : "of a data cache miss")
+#define OBS_LOG_on_forward(core, ps, PI, s, which) \
+	printf("In execute stage of instruction [%" PRIu64 "], %s forwarded from %s.\n", (PI)->seq, which, P(_names)[s])
+#define OBS_LOG_on_execute(core, ps, PI) \
+	printf("Executed instruction [%" PRIu64 "].\n", (PI)->seq)
+#define OBS_LOG_on_flush(core, PI) \
+	printf("Flushed instruction [%" PRIu64 "].\n", (PI)->seq)
+#define OBS_LOG_on_redirect(core, ps, PI) \
+	printf("Branch %s, fetching from PC %" PRIu64 ".\n", (PI)->ex->branch_taken ? "taken" : "not taken", (core)->PC)
+#define OBS_LOG_on_branch(core, ps, PI)
+#define OBS_LOG_on_mem_access(core, PI) \
+	printf("Accessed memory for instruction [%" PRIu64 "].\n", (PI)->seq)
+#define OBS_LOG_on_writeback(core, PI) do { \
+	printf("Wrote back to register for instruction [%" PRIu64 "].\n", (PI)->seq); \
+	if ((PI)->dec->ctrl_signals.RegWrite) { \
+		printf("New register value: x[%ld] = %ld.\n", (PI)->dec->rd, (PI)->mem_res); \
+	} \
+} while (0)
+#define OBS_LOG_on_stage_done(core, PI, s) do { \
+	if (P(_roles)[s] != STAGE_PASS && P(_roles)[s] != STAGE_EXEC_TAIL && P(_roles)[s] != STAGE_MEM_TAIL) { \
+		printf("-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-.-\n"); \
+	} \
+} while (0)
+#define OBS_LOG_on_retire(core, PI)
+#define OBS_LOG_on_cycle_end(core, ps) printf("\n")
+
+/*------------------ OBS_KONATA ----------------*/
+// Pipeline trace, when core->konata is open
+
+#define OBS_KONATA_on_cycle(core, ps) do { \
+	if ((core)->konata) { \
+		konataCycle((core)->konata, (core)->clk); \
+	} \
+} while (0)
+// An instruction is introduced to the log the first time it shows up
+#define OBS_KONATA_enter(core, PI) do { \
+	if ((PI)->stage == NULL) { \
+		const Instruction *instr_ = instructionAt((core)->instr_mem, (PI)->pc); \
+		konataFetch((core)->konata, (PI)->seq, (PI)->pc, instr_ ? instr_->text : NULL); \
+	} \
+} while (0)
+
+#define OBS_KONATA_on_stage(core, PI, s) do { \
+	if ((core)->konata && (PI)->stage != P(_names)[s]) { \
+		OBS_KONATA_enter(core, PI); \
+		konataStage((core)->konata, (PI)->seq, (PI)->stage, P(_names)[s]); \
+		(PI)->stage = P(_names)[s]; \
+	} \
+} while (0)
+#define OBS_KONATA_on_fetch(core, PI)
+#define OBS_KONATA_on_decode(core, PI) do { \
+	if ((core)->konata && (PI)->dec->fuse != FUSE_NONE) { \
+		konataNote((core)->konata, (PI)->seq, "fused with the next instruction"); \
+	} \
+} while (0)
+#define OBS_KONATA_on_predict(core, ps, PI)
+#define OBS_KONATA_on_stall(core, ps, PI, cause) do { \
+	if ((core)->konata) { \
+		konataNote((core)->konata, (PI)->seq, \
+			(cause) == STALL_DATA ? "stalled, data hazard" : (cause) == STALL_UNIT ? "stalled, functional unit busy" \
+			: (cause) == STALL_STORE_FULL ? "stalled, store buffer full" \
+			: (cause) == STALL_STORE_DRAIN ? "stalled, store buffer draining" \
+			: (cause) == STALL_TLB ? "stalled, TLB miss" : "stalled, data cache miss"); \
+	} \
+} while (0)
+#define OBS_KONATA_on_forward(core, ps, PI, s, which)
+#define OBS_KONATA_on_execute(core, ps, PI)
+#define OBS_KONATA_on_flush(core, PI) do { \
+	if ((core)->konata) { \
+		OBS_KONATA_enter(core, PI); \
+		konataRetire((core)->konata, (PI)->seq, (PI)->stage, true); \
+	} \
+} while (0)
+#define OBS_KONATA_on_redirect(core, ps, PI)
+#define OBS_KONATA_on_branch(core, ps, PI)
+#define OBS_KONATA_on_mem_access(core, PI)
+#define OBS_KONATA_on_writeback(core, PI)
+#define OBS_KONATA_on_stage_done(core, PI, s)
+#define OBS_KONATA_on_retire(core, PI) do { \
+	if ((core)->konata) { \
+		konataRetire((core)->konata, (PI)->seq, (PI)->stage, false); \
+	} \
+} while (0)
+#define OBS_KONATA_on_cycle_end(core, ps)
+
+/*------------------ OBS_PROFILE ---------------*/
+// Per-PC profile, when core->profile is open
+
+#define OBS_PROFILE_count(core, pc, field) do { \
+	ProfileEntry *e_ = profileEntry((core)->profile, pc); \
+	if (e_) { \
+		e_->field++; \
+	} \
+} while (0)
+
+// The cycle goes to the oldest instruction in flight
+#define OBS_PROFILE_on_cycle(core, ps) do { \
+	if ((core)->profile) { \
+		int s_ = P(_DEPTH) - 1; \
+		while (s_ >= 0 && (ps)->stage[s_] == NULL) { \
+			s_--; \
+		} \
+		if (s_ >= 0) { \
+			OBS_PROFILE_count(core, (ps)->stage[s_]->pc, cycles); \
+		} \
+	} \
+} while (0)
+#define OBS_PROFILE_on_stage(core, PI, s)
+#define OBS_PROFILE_on_fetch(core, PI)
+#define OBS_PROFILE_on_decode(core, PI)
+#define OBS_PROFILE_on_predict(core, ps, PI)
+#define OBS_PROFILE_on_stall(core, ps, PI, cause) do { \
+	if ((core)->profile) { \
+		if ((cause) == STALL_DATA) { \
+			P(_blame)(core, ps, PI); \
+		} else { \
+			OBS_PROFILE_count(core, (PI)->pc, stalls); \
+		} \
+	} \
+} while (0)
+#define OBS_PROFILE_on_forward(core, ps, PI, s, which) do { \
+	if ((core)->profile) { \
+		OBS_PROFILE_count(core, (PI)->pc, forwards); \
+	} \
+} while (0)
+#define OBS_PROFILE_on_execute(core, ps, PI) do { \
+	if ((core)->profile) { \
+		OBS_PROFILE_count(core, (PI)->pc, executions); \
+		if ((PI)->dec->fuse != FUSE_NONE) { \
+			OBS_PROFILE_count(core, (PI)->pc + (PI)->dec->fuse_offset, executions); \
+		} \
+	} \
+} while (0)
+#define OBS_PROFILE_on_flush(core, PI)
+#define OBS_PROFILE_on_redirect(core, ps, PI)
+#define OBS_PROFILE_on_branch(core, ps, PI)
+#define OBS_PROFILE_on_mem_access(core, PI)
+#define OBS_PROFILE_on_writeback(core, PI)
+#define OBS_PROFILE_on_stage_done(core, PI, s)
+#define OBS_PROFILE_on_retire(core, PI)
+#define OBS_PROFILE_on_cycle_end(core, ps)
+
+/*------------------ OBS_LOOP ------------------*/
+// Steady-state loop detection, when --extrapolate is on
+
+#define OBS_LOOP_on_cycle(core, ps)
+#define OBS_LOOP_on_stage(core, PI, s)
+#define OBS_LOOP_on_fetch(core, PI)
+#define OBS_LOOP_on_decode(core, PI)
+#define OBS_LOOP_on_predict(core, ps, PI)
+#define OBS_LOOP_on_stall(core, ps, PI, cause) do { \
+	if ((core)->loop.confirm) { \
+		loopEvent(&(core)->loop, cause); \
+	} \
+} while (0)
+#define OBS_LOOP_on_forward(core, ps, PI, s, which) do { \
+	if ((core)->loop.confirm) { \
+		loopEvent(&(core)->loop, 0x100 + (s)); \
+	} \
+} while (0)
+#define OBS_LOOP_on_execute(core, ps, PI) do { \
+	if ((core)->loop.confirm) { \
+		loopExecuted(&(core)->loop, (PI)->pc); \
+		if ((PI)->dec->fuse != FUSE_NONE) { \
+			loopExecuted(&(core)->loop, (PI)->pc + (PI)->dec->fuse_offset); \
+		} \
+	} \
+} while (0)
+#define OBS_LOOP_on_flush(core, PI)
+#define OBS_LOOP_on_redirect(core, ps, PI)
+// A taken backward branch ends an iteration once the cycle is over
+#define OBS_LOOP_on_branch(core, ps, PI) do { \
+	if ((core)->loop.confirm && (PI)->ex->branch_target <= (PI)->pc) { \
+		(core)->loop.boundary = true; \
+		(core)->loop.boundary_pc = (PI)->pc + ((PI)->dec->fuse != FUSE_NONE ? (PI)->dec->fuse_offset : 0); \
+		(core)->loop.boundary_target = (PI)->ex->branch_target; \
+	} \
+} while (0)
+#define OBS_LOOP_on_mem_access(core, PI)
+#define OBS_LOOP_on_writeback(core, PI)
+#define OBS_LOOP_on_stage_done(core, PI, s)
+#define OBS_LOOP_on_retire(core, PI)
+#define OBS_LOOP_on_cycle_end(core, ps) do { \
+	if ((core)->loop.confirm) { \
+		loopEvent(&(core)->loop, 0); /* cycle boundary */ \
+		if ((core)->loop.boundary) { \
+			(core)->loop.boundary = false; \
+			P(_loop)(core, ps, (core)->loop.boundary_pc, (core)->loop.boundary_target); \
+		} \
+	} \
+} while (0)
+
+/*------------------ OBS_COUNTERS --------------*/
+// Event totals, when core->counters is set
+
+#define OBS_COUNTERS_add(core, field) do { \
+	if ((core)->counters) { \
+		(core)->counters->field++; \
+	} \
+} while (0)
+
+#define OBS_COUNTERS_on_cycle(core, ps)
+#define OBS_COUNTERS_on_stage(core, PI, s)
+#define OBS_COUNTERS_on_fetch(core, PI) OBS_COUNTERS_add(core, fetched)
+#define OBS_COUNTERS_on_decode(core, PI) OBS_COUNTERS_add(core, decoded)
+#define OBS_COUNTERS_on_predict(core, ps, PI) OBS_COUNTERS_add(core, predicted_taken)
+#define OBS_COUNTERS_on_stall(core, ps, PI, cause) do { \
+	if ((cause) == STALL_DATA) { \
+		OBS_COUNTERS_add(core, data_stalls); \
+	} else if ((cause) == STALL_UNIT) { \
+		OBS_COUNTERS_add(core, unit_stalls); \
+	} else if ((cause) == STALL_TLB) { \
+		OBS_COUNTERS_add(core, tlb_stalls); \
+	} else if ((cause) == STALL_CACHE) { \
+		OBS_COUNTERS_add(core, cache_stalls); \
+	} else { \
+		OBS_COUNTERS_add(core, store_stalls); \
+	} \
+} while (0)
+#define OBS_COUNTERS_on_forward(core, ps, PI, s, which) do { \
+	if ((core)->counters) { \
+		(core)->counters->forwarded[s]++; \
+	} \
+} while (0)
+#define OBS_COUNTERS_on_execute(core, ps, PI) OBS_COUNTERS_add(core, executed)
+#define OBS_COUNTERS_on_flush(core, PI) OBS_COUNTERS_add(core, flushed)
+#define OBS_COUNTERS_on_redirect(core, ps, PI) OBS_COUNTERS_add(core, mispredicted)
+#define OBS_COUNTERS_on_branch(core, ps, PI) OBS_COUNTERS_add(core, branches_taken)
+#define OBS_COUNTERS_on_mem_access(core, PI) do { \
+	if ((PI)->dec->ctrl_signals.MemRead) { \
+		OBS_COUNTERS_add(core, loads); \
+	} else if ((PI)->dec->ctrl_signals.MemWrite) { \
+		OBS_COUNTERS_add(core, stores); \
+	} \
+} while (0)
+#define OBS_COUNTERS_on_writeback(core, PI)
+#define OBS_COUNTERS_on_stage_done(core, PI, s)
+#define OBS_COUNTERS_on_retire(core, PI) OBS_COUNTERS_add(core, retired)
+#define OBS_COUNTERS_on_cycle_end(core, ps)
+
+/*------------------ OBS_CHECK -----------------*/
+// Retire records for the --check reference model, when core->checker is set
+
+#define OBS_CHECK_on_cycle(core, ps)
+#define OBS_CHECK_on_stage(core, PI, s)
+#define OBS_CHECK_on_fetch(core, PI)
+#define OBS_CHECK_on_decode(core, PI)
+#define OBS_CHECK_on_predict(core, ps, PI)
+#define OBS_CHECK_on_stall(core, ps, PI, cause)
+#define OBS_CHECK_on_forward(core, ps, PI, s, which)
+#define OBS_CHECK_on_execute(core, ps, PI)
+#define OBS_CHECK_on_flush(core, PI)
+#define OBS_CHECK_on_redirect(core, ps, PI)
+#define OBS_CHECK_on_branch(core, ps, PI)
+#define OBS_CHECK_on_mem_access(core, PI)
+#define OBS_CHECK_on_writeback(core, PI)
+#define OBS_CHECK_on_stage_done(core, PI, s)
+#define OBS_CHECK_on_retire(core, PI) do { \
+	if ((core)->checker) { \
+		checkRetireInstr(core, PI); \
+	} \
+} while (0)
+#define OBS_CHECK_on_cycle_end(core, ps)
+
+#endif
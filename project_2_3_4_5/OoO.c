@@ -0,0 +1,621 @@
+#include "OoO.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+/*------------------ OoO.c ---------------------
+ |
+ |  Purpose: Out-of-order timing model. Each clock
+ |		cycle runs the stages back to front:
+ |		commit, complete (wakeup), issue, rename/
+ |		dispatch and fetch. Vector instructions
+ |		bypass the issue queue and execute in
+ |		order once they reach the ROB head.
+ |
+ *----------------------------------------------*/
+
+static bool runOoO(Core *core, Tick until);
+
+void OoOConfigDefaults(OoOConfig *cfg) {
+	cfg->rob_size = 32;
+	cfg->iq_size = 16;
+	cfg->lsq_size = 16;
+	cfg->phys_regs = 64;
+	cfg->width = 2;
+	cfg->issue_width = 2;
+	cfg->num_alu = 2;
+	cfg->num_lsu = 1;
+	cfg->num_mul = 1;
+	cfg->num_div = 1;
+	cfg->alu_latency = 1;
+	cfg->load_latency = 2;
+}
+
+OoOCore *initOoO(Core *core, const OoOConfig *cfg)
+{
+	int i;
+
+	OoOCore *ooo = (OoOCore *)arenaAlloc(core->arena, sizeof(OoOCore));
+	ooo->core = core;
+	ooo->cfg = *cfg;
+
+	ooo->prf = arenaAlloc(core->arena, cfg->phys_regs * sizeof(Register));
+	ooo->prf_ready = arenaAlloc(core->arena, cfg->phys_regs * sizeof(bool));
+	ooo->free_list = arenaAlloc(core->arena, cfg->phys_regs * sizeof(int));
+	ooo->rob = arenaAlloc(core->arena, cfg->rob_size * sizeof(ROBEntry));
+	ooo->iq = arenaAlloc(core->arena, cfg->iq_size * sizeof(int));
+	ooo->lsq = arenaAlloc(core->arena, cfg->lsq_size * sizeof(LSQEntry));
+	ooo->unit_free[FU_ALU] = arenaAlloc(core->arena, cfg->num_alu * sizeof(Tick));
+	ooo->unit_free[FU_MUL] = arenaAlloc(core->arena, cfg->num_mul * sizeof(Tick));
+	ooo->unit_free[FU_DIV] = arenaAlloc(core->arena, cfg->num_div * sizeof(Tick));
+	ooo->unit_free[FU_VEC] = arenaAlloc(core->arena, sizeof(Tick));
+	ooo->fq_size = 2 * cfg->width;
+	ooo->fq_instr = arenaAlloc(core->arena, ooo->fq_size * sizeof(Signal));
+	ooo->fq_fused = arenaAlloc(core->arena, ooo->fq_size * sizeof(FusedTail));
+	ooo->fq_pc = arenaAlloc(core->arena, ooo->fq_size * sizeof(Addr));
+
+	// Architectural register i starts out mapped to physical register i,
+	// everything above 31 goes on the free list.
+	for (i=0; i<32; i++) {
+		ooo->rat[i] = i;
+		ooo->prf[i] = core->reg_file[i];
+		ooo->prf_ready[i] = true;
+	}
+	for (i=32; i<cfg->phys_regs; i++) {
+		ooo->free_list[ooo->free_count++] = i;
+	}
+	ooo->last_renamed = -1;
+
+	// core->tick and tickCycles now drive this core
+	core->ooo = ooo;
+	core->run = runOoO;
+	return ooo;
+}
+
+static int robIndex(OoOCore *ooo, int offset) {
+	return (ooo->rob_head + offset) % ooo->cfg.rob_size;
+}
+
+static int lsqIndex(OoOCore *ooo, int offset) {
+	return (ooo->lsq_head + offset) % ooo->cfg.lsq_size;
+}
+
+// Position of a ROB entry relative to the head (its age)
+static int robAge(OoOCore *ooo, int idx) {
+	return (idx - ooo->rob_head + ooo->cfg.rob_size) % ooo->cfg.rob_size;
+}
+
+static bool isMemOp(Decode *dec) {
+	return dec->ctrl_signals.MemRead || dec->ctrl_signals.MemWrite;
+}
+
+static bool isVectorMemOp(Decode *dec) {
+	return dec->ctrl_signals.Vector && (dec->opcode == OPCODE_VLOAD || dec->opcode == OPCODE_VSTORE);
+}
+
+static bool writesReg(Decode *dec) {
+	return dec->ctrl_signals.RegWrite && dec->rd != 0;
+}
+
+static bool operandsReady(OoOCore *ooo, ROBEntry *e) {
+	return (!usesRs1(&e->dec) || ooo->prf_ready[e->src1_phys])
+		&& (!usesRs2(&e->dec) || ooo->prf_ready[e->src2_phys]);
+}
+
+// Vector instructions run non-speculatively at the ROB head: the vector
+// register file is not renamed, so they execute in program order.
+static void executeVector(OoOCore *ooo, ROBEntry *e) {
+	Core *core = ooo->core;
+	PipeInstr PI;
+	Exec ex;
+	int occupancy;
+
+	if (!operandsReady(ooo, e) || ooo->unit_free[FU_VEC][0] > core->clk) {
+		return;
+	}
+	PI.instruction = e->instruction;
+	PI.dec = &e->dec;
+	PI.ex = &ex;
+	PI.seq = e->seq;
+	PI.pc = e->pc;
+
+	occupancy = vectorOccupancy(core, &e->dec);
+	execute(core, &PI, ooo->prf[e->src1_phys], ooo->prf[e->src2_phys]);
+	if (isVectorMemOp(&e->dec)) {
+		vectorMemAccess(core, &PI);
+	}
+	e->result = ex.ALU_result;
+	e->issued = true;
+	e->issue_cycle = core->clk;
+	e->complete_cycle = core->clk + occupancy;
+	ooo->unit_free[FU_VEC][0] = core->clk + occupancy;
+	if (!core->quiet) {
+		printf("Issued vector instruction [%" PRIu64 "] at the ROB head.\n", e->seq);
+	}
+	if (core->konata) {
+		konataStage(core->konata, e->seq, "Dp", "X");
+	}
+}
+
+/*------------------ Commit --------------------*/
+static void commitStage(OoOCore *ooo) {
+	Core *core = ooo->core;
+	int n;
+
+	for (n=0; n<ooo->cfg.width && ooo->rob_count > 0; n++) {
+		ROBEntry *e = &ooo->rob[ooo->rob_head];
+		if (!e->completed) {
+			if (e->dec.ctrl_signals.Vector && !e->issued) {
+				executeVector(ooo, e);
+			}
+			break;
+		}
+
+		if (e->dec.ctrl_signals.MemWrite) {
+			LSQEntry *s = &ooo->lsq[ooo->lsq_head];
+			storeDataMem(core, s->data, s->addr, e->dec.funct3);
+		}
+		if (e->lsq_idx >= 0) {
+			ooo->lsq_head = lsqIndex(ooo, 1);
+			ooo->lsq_count--;
+		}
+
+		if (core->konata) {
+			konataRetire(core->konata, e->seq, "Cm", false);
+		}
+		if (core->profile) {
+			ProfileEntry *p = profileEntry(core->profile, e->pc);
+			if (p) {
+				p->executions++;
+			}
+			if (e->dec.fuse != FUSE_NONE && (p = profileEntry(core->profile, e->pc + e->dec.fuse_offset))) {
+				p->executions++;
+			}
+		}
+		if (e->dest_phys >= 0) {
+			core->reg_file[e->dec.rd] = ooo->prf[e->dest_phys];
+			ooo->free_list[(ooo->free_head + ooo->free_count) % ooo->cfg.phys_regs] = e->old_phys;
+			ooo->free_count++;
+			if (!core->quiet) {
+				printf("Committed instruction [%" PRIu64 "]: x[%ld] = %ld.\n", e->seq, e->dec.rd, ooo->prf[e->dest_phys]);
+			}
+		} else if (!core->quiet) {
+			printf("Committed instruction [%" PRIu64 "].\n", e->seq);
+		}
+
+		ooo->rob_head = robIndex(ooo, 1);
+		ooo->rob_count--;
+		ooo->stats.committed += e->dec.fuse != FUSE_NONE ? 2 : 1;
+		ooo->stats.committed_fused += e->dec.fuse != FUSE_NONE;
+		core->retired += e->dec.fuse != FUSE_NONE ? 2 : 1;
+		core->fused_pairs += e->dec.fuse != FUSE_NONE;
+	}
+}
+
+/*------------------ Complete ------------------*/
+static void completeStage(OoOCore *ooo) {
+	Core *core = ooo->core;
+	int i;
+
+	for (i=0; i<ooo->rob_count; i++) {
+		ROBEntry *e = &ooo->rob[robIndex(ooo, i)];
+		if (!e->issued || e->completed || e->complete_cycle > core->clk) {
+			continue;
+		}
+
+		e->completed = true;
+		if (core->konata) {
+			konataStage(core->konata, e->seq, "X", "Cm");
+		}
+		if (e->dest_phys >= 0) {
+			ooo->prf[e->dest_phys] = e->result;
+			ooo->prf_ready[e->dest_phys] = true;
+		}
+		if (e->dec.ctrl_signals.Branch) {
+			// Fetch was held just past this branch, redirect if taken
+			if (e->taken) {
+				core->PC = e->target;
+			}
+			ooo->branch_pending = false;
+		}
+	}
+}
+
+/*------------------ Issue ---------------------*/
+
+// A load may issue once every older store has a known address. A store
+// to the same address at least as wide forwards its data; any other
+// overlap waits until that store has committed.
+static bool loadCanIssue(OoOCore *ooo, ROBEntry *e, Signal addr, Signal *fwd, bool *forwarded) {
+	int i;
+	int age = (e->lsq_idx - ooo->lsq_head + ooo->cfg.lsq_size) % ooo->cfg.lsq_size;
+	Signal width = memWidth(e->dec.funct3);
+
+	*forwarded = false;
+	for (i=age-1; i>=0; i--) {
+		LSQEntry *s = &ooo->lsq[lsqIndex(ooo, i)];
+		if (!s->is_store) {
+			continue;
+		}
+		if (!s->addr_valid) {
+			return false;
+		}
+		if (s->addr == addr && s->width >= width) {
+			*fwd = extendLoad(s->data, e->dec.funct3);
+			*forwarded = true;
+			return true;
+		}
+		if (s->addr < addr + width && addr < s->addr + s->width) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static int unitCount(OoOCore *ooo, FUType type) {
+	switch (type) {
+		case FU_MUL: return ooo->cfg.num_mul;
+		case FU_DIV: return ooo->cfg.num_div;
+		case FU_VEC: return 1;
+		default: return ooo->cfg.num_alu;
+	}
+}
+
+// A free unit of the given type this cycle, or -1
+static int freeUnit(OoOCore *ooo, FUType type) {
+	int u;
+
+	for (u=0; u<unitCount(ooo, type); u++) {
+		if (ooo->unit_free[type][u] <= ooo->core->clk) {
+			return u;
+		}
+	}
+	return -1;
+}
+
+static void executeEntry(OoOCore *ooo, ROBEntry *e, Signal val1, Signal val2) {
+	Signal zero, neg;
+	Signal alu_2nd = MUX(e->dec.ctrl_signals.ALUSrc, val2, e->dec.immediate);
+
+	if (e->dec.fuse != FUSE_NONE) {
+		Signal taken;
+		fusedExecute(&e->dec, e->pc, val1, val2, &e->result, &taken, &e->target);
+		e->taken = taken;
+		return;
+	}
+	ALU(val1, alu_2nd, e->dec.ALU_ctrl_signal, &e->result, &zero, &neg);
+
+	if (e->dec.ctrl_signals.Branch) {
+		e->taken = BranchUnit(e->dec.funct3, val1, val2, zero, neg);
+		e->target = e->pc + ShiftLeft1(e->dec.immediate);
+	}
+}
+
+static void issueStage(OoOCore *ooo) {
+	Core *core = ooo->core;
+	int lsu_free = ooo->cfg.num_lsu;
+	int issued = 0;
+
+	while (issued < ooo->cfg.issue_width) {
+		int pick = -1;
+		int pick_age = ooo->cfg.rob_size;
+		Signal fwd = 0;
+		bool forwarded = false;
+		int i;
+
+		// Oldest ready instruction first
+		for (i=0; i<ooo->iq_count; i++) {
+			ROBEntry *e = &ooo->rob[ooo->iq[i]];
+			int age = robAge(ooo, ooo->iq[i]);
+			bool mem = isMemOp(&e->dec);
+
+			if (age >= pick_age || !operandsReady(ooo, e)) {
+				continue;
+			}
+			if ((mem && lsu_free == 0) || (!mem && freeUnit(ooo, FunctionalUnitOf(e->dec.ALU_ctrl_signal)) < 0)) {
+				continue;
+			}
+			if (e->dec.ctrl_signals.MemRead) {
+				Signal addr = ooo->prf[e->src1_phys] + e->dec.immediate;
+				Signal f = 0;
+				bool fw;
+				if (!loadCanIssue(ooo, e, addr, &f, &fw)) {
+					continue;
+				}
+				fwd = f;
+				forwarded = fw;
+			}
+			pick = i;
+			pick_age = age;
+		}
+		if (pick < 0) {
+			break;
+		}
+
+		int rob_idx = ooo->iq[pick];
+		ROBEntry *e = &ooo->rob[rob_idx];
+		Signal val1 = ooo->prf[e->src1_phys];
+		Signal val2 = ooo->prf[e->src2_phys];
+
+		executeEntry(ooo, e, val1, val2);
+		if (isMemOp(&e->dec)) {
+			LSQEntry *m = &ooo->lsq[e->lsq_idx];
+			m->addr = e->result;
+			m->addr_valid = true;
+			if (e->dec.ctrl_signals.MemWrite) {
+				m->data = val2;
+			} else if (forwarded) {
+				e->result = fwd;
+				ooo->stats.load_forwards++;
+			} else {
+				e->result = loadDataMem(core, e->result, e->dec.funct3);
+			}
+			lsu_free--;
+			e->complete_cycle = core->clk + (e->dec.ctrl_signals.MemRead ? ooo->cfg.load_latency : 1);
+		} else {
+			FUType type = FunctionalUnitOf(e->dec.ALU_ctrl_signal);
+			int latency = type == FU_ALU ? ooo->cfg.alu_latency : core->fu[type].latency;
+			bool pipelined = type == FU_ALU || core->fu[type].pipelined;
+			ooo->unit_free[type][freeUnit(ooo, type)] = core->clk + (pipelined ? 1 : latency);
+			e->complete_cycle = core->clk + latency;
+		}
+
+		e->issued = true;
+		e->issue_cycle = core->clk;
+		if (e->load_use && ooo->issued_before_cycle > e->load_snapshot) {
+			ooo->stats.load_use_hidden++;
+		}
+		if (!core->quiet) {
+			printf("Issued instruction [%" PRIu64 "].\n", e->seq);
+		}
+		if (core->konata) {
+			konataStage(core->konata, e->seq, "Dp", "X");
+		}
+
+		ooo->iq[pick] = ooo->iq[--ooo->iq_count];
+		issued++;
+	}
+
+	// Issue counts are snapshotted per cycle for the load-use statistics,
+	// so loads stamp their consumer only after the whole cycle has issued.
+	int i;
+	for (i=0; i<ooo->rob_count; i++) {
+		ROBEntry *e = &ooo->rob[robIndex(ooo, i)];
+		if (e->issued && e->issue_cycle == core->clk && e->load_consumer >= 0) {
+			ooo->rob[e->load_consumer].load_snapshot = ooo->issued_before_cycle + issued;
+		}
+	}
+
+	ooo->issued_before_cycle += issued;
+	ooo->stats.issued += issued;
+}
+
+/*------------------ Rename/Dispatch -----------*/
+static void renameStage(OoOCore *ooo) {
+	Core *core = ooo->core;
+	int n;
+
+	for (n=0; n<ooo->cfg.width && ooo->fq_count > 0; n++) {
+		PipeInstr PI;
+		Decode dec;
+		Exec ex;
+		PI.instruction = ooo->fq_instr[ooo->fq_head];
+		PI.fused = ooo->fq_fused[ooo->fq_head];
+		PI.dec = &dec;
+		PI.ex = &ex;
+		decode(core, &PI);
+		// Vector instructions execute at the ROB head and take no IQ slot
+		bool to_iq = !dec.ctrl_signals.Vector;
+
+		if (ooo->rob_count == ooo->cfg.rob_size) {
+			ooo->stats.stall_rob_full++;
+			break;
+		}
+		if (to_iq && ooo->iq_count == ooo->cfg.iq_size) {
+			ooo->stats.stall_iq_full++;
+			break;
+		}
+		if ((isMemOp(&dec) || isVectorMemOp(&dec)) && ooo->lsq_count == ooo->cfg.lsq_size) {
+			ooo->stats.stall_lsq_full++;
+			break;
+		}
+		if (writesReg(&dec) && ooo->free_count == 0) {
+			ooo->stats.stall_no_phys++;
+			break;
+		}
+
+		int idx = robIndex(ooo, ooo->rob_count);
+		ROBEntry *e = &ooo->rob[idx];
+		memset(e, 0, sizeof(*e));
+		e->seq = ++ooo->next_seq;
+		e->pc = ooo->fq_pc[ooo->fq_head];
+		e->instruction = PI.instruction;
+		e->dec = dec;
+		e->src1_phys = ooo->rat[dec.rs1];
+		e->src2_phys = ooo->rat[dec.rs2];
+		e->dest_phys = -1;
+		e->lsq_idx = -1;
+		e->load_consumer = -1;
+
+		// Would the in-order pipeline insert a load-use bubble here?
+		int prev = ooo->last_renamed;
+		if (prev >= 0 && ooo->rob[prev].seq == e->seq - 1
+			&& ooo->rob[prev].dec.ctrl_signals.MemRead && ooo->rob[prev].dest_phys >= 0
+			&& (ooo->rob[prev].dec.rd == dec.rs1 || (usesRs2(&dec) && ooo->rob[prev].dec.rd == dec.rs2))) {
+			ooo->stats.load_use_pairs++;
+			if (robAge(ooo, prev) >= ooo->rob_count) {
+				// The load already retired before its consumer got here
+				ooo->stats.load_use_hidden++;
+			} else if (ooo->rob[prev].issued) {
+				e->load_use = true;
+				e->load_snapshot = ooo->issued_before_cycle;
+			} else {
+				e->load_use = true;
+				ooo->rob[prev].load_consumer = idx;
+			}
+		}
+
+		if (writesReg(&dec)) {
+			e->old_phys = ooo->rat[dec.rd];
+			e->dest_phys = ooo->free_list[ooo->free_head];
+			ooo->free_head = (ooo->free_head + 1) % ooo->cfg.phys_regs;
+			ooo->free_count--;
+			ooo->prf_ready[e->dest_phys] = false;
+			ooo->rat[dec.rd] = e->dest_phys;
+		}
+
+		if (isMemOp(&dec)) {
+			e->lsq_idx = lsqIndex(ooo, ooo->lsq_count);
+			LSQEntry *m = &ooo->lsq[e->lsq_idx];
+			m->rob_idx = idx;
+			m->is_store = dec.ctrl_signals.MemWrite;
+			m->width = memWidth(dec.funct3);
+			m->addr_valid = false;
+			ooo->lsq_count++;
+		} else if (isVectorMemOp(&dec)) {
+			// Stands in for the whole access: younger loads wait for it
+			e->lsq_idx = lsqIndex(ooo, ooo->lsq_count);
+			LSQEntry *m = &ooo->lsq[e->lsq_idx];
+			m->rob_idx = idx;
+			m->is_store = true;
+			m->addr_valid = false;
+			ooo->lsq_count++;
+		}
+
+		if (to_iq) {
+			ooo->iq[ooo->iq_count++] = idx;
+		}
+		ooo->rob_count++;
+		ooo->last_renamed = idx;
+		ooo->fq_head = (ooo->fq_head + 1) % ooo->fq_size;
+		ooo->fq_count--;
+		if (!core->quiet) {
+			printf("Dispatched instruction [%" PRIu64 "].\n", e->seq);
+		}
+		if (core->konata) {
+			konataStage(core->konata, e->seq, "F", "Dp");
+		}
+	}
+}
+
+/*------------------ Fetch ---------------------*/
+static void fetchStage(OoOCore *ooo) {
+	Core *core = ooo->core;
+	int n;
+
+	for (n=0; n<ooo->cfg.width; n++) {
+		if (ooo->branch_pending) {
+			ooo->stats.stall_branch++;
+			break;
+		}
+		if (ooo->fq_count == ooo->fq_size || !instructionReady(core->instr_mem, core->PC)) {
+			break;
+		}
+
+		int slot = (ooo->fq_head + ooo->fq_count) % ooo->fq_size;
+		unsigned size;
+		uint64_t block_reads = core->fetch_buf.block_reads;
+		Signal instruction = fetchInstruction(&core->fetch_buf, core->instr_mem, core->PC, &size);
+		if (core->profile && core->fetch_buf.block_reads != block_reads) {
+			ProfileEntry *p = profileEntry(core->profile, core->PC);
+			if (p) {
+				p->misses += core->fetch_buf.block_reads - block_reads;
+			}
+		}
+		ooo->fq_instr[slot] = instruction;
+		ooo->fq_pc[slot] = core->PC;
+		if (core->konata) {
+			// Rename is in order and nothing is squashed, so this is the
+			// sequence number the instruction will get there
+			const Instruction *instr = instructionAt(core->instr_mem, core->PC);
+			konataFetch(core->konata, ooo->stats.fetched + 1, core->PC, instr ? instr->text : NULL);
+			konataStage(core->konata, ooo->stats.fetched + 1, NULL, "F");
+		}
+		ooo->fq_count++;
+		ooo->stats.fetched++;
+		core->PC += size;
+		fetchFusedTail(core, instruction, size, &ooo->fq_fused[slot]);
+
+		// No speculation past branches: hold fetch until it resolves
+		if ((instruction & 0x7f) == 99 || ooo->fq_fused[slot].kind == FUSE_ADDI_BRANCH) {
+			ooo->branch_pending = true;
+		}
+	}
+}
+
+// The program has been fetched and every instruction has retired
+static bool oooDone(OoOCore *ooo)
+{
+	return !ooo->branch_pending && ooo->fq_count == 0 && ooo->rob_count == 0
+		&& !instructionReady(ooo->core->instr_mem, ooo->core->PC);
+}
+
+// Advance the out-of-order core by one clock cycle. Returns false once
+// the program has finished.
+bool tickOoO(OoOCore *ooo)
+{
+	Core *core = ooo->core;
+
+	if (oooDone(ooo)) {
+		return false;
+	}
+
+	if (!core->quiet) {
+		printf("======================== Clock cycle %ld ========================\n", core->clk+1);
+	}
+	if (core->konata) {
+		konataCycle(core->konata, core->clk);
+	}
+	if (core->profile) {
+		// The cycle goes to the ROB head, or the oldest fetched instruction
+		Addr pc = ooo->rob_count ? ooo->rob[ooo->rob_head].pc : ooo->fq_pc[ooo->fq_head];
+		ProfileEntry *p = ooo->rob_count || ooo->fq_count ? profileEntry(core->profile, pc) : NULL;
+		if (p) {
+			p->cycles++;
+		}
+	}
+	commitStage(ooo);
+	completeStage(ooo);
+	issueStage(ooo);
+	renameStage(ooo);
+	fetchStage(ooo);
+	if (!core->quiet) {
+		printf("\n");
+	}
+
+	++core->clk;
+	return true;
+}
+
+// core->run once initOoO has taken over the core
+static bool runOoO(Core *core, Tick until)
+{
+	while (core->clk < until) {
+		if (!tickOoO(core->ooo)) {
+			return false;
+		}
+	}
+	return !oooDone(core->ooo);
+}
+
+void printOoOStats(OoOCore *ooo) {
+	OoOStats *s = &ooo->stats;
+	double ipc = ooo->core->clk ? (double)s->committed / ooo->core->clk : 0.0;
+
+	printf("\nOut-of-order core: ROB %d, IQ %d, LSQ %d, PRF %d, width %d, issue %d, ALU %d, LSU %d, MUL %d, DIV %d\n",
+		ooo->cfg.rob_size, ooo->cfg.iq_size, ooo->cfg.lsq_size, ooo->cfg.phys_regs,
+		ooo->cfg.width, ooo->cfg.issue_width, ooo->cfg.num_alu, ooo->cfg.num_lsu,
+		ooo->cfg.num_mul, ooo->cfg.num_div);
+	printf("Committed instructions: %" PRIu64 "\n", s->committed);
+	if (ooo->core->fusion) {
+		printf("Committed as fused pairs: %" PRIu64 " (%" PRIu64 " macro-ops)\n",
+			s->committed_fused, s->committed - s->committed_fused);
+	}
+	printf("IPC: %.3f\n", ipc);
+	printf("Dispatch stalls: ROB full %" PRIu64 ", IQ full %" PRIu64 ", LSQ full %" PRIu64 ", no free register %" PRIu64 "\n",
+		s->stall_rob_full, s->stall_iq_full, s->stall_lsq_full, s->stall_no_phys);
+	printf("Fetch cycles held at unresolved branches: %" PRIu64 "\n", s->stall_branch);
+	printf("Store-to-load forwards: %" PRIu64 "\n", s->load_forwards);
+	printf("Load-use pairs: %" PRIu64 " (%" PRIu64 " overlapped with independent work)\n",
+		s->load_use_pairs, s->load_use_hidden);
+}
@@ -0,0 +1,142 @@
+#ifndef __OOO_H__
+#define __OOO_H__
+
+#include "Core.h"
+
+/*------------------ OoO.h ---------------------
+ |
+ |  Out-of-order timing model. Architectural
+ |  registers are renamed onto a physical register
+ |  file, instructions are dispatched into a reorder
+ |  buffer (ROB) and an issue queue, loads/stores go
+ |  through a load-store queue (LSQ), and everything
+ |  retires in program order into core->reg_file and
+ |  core->data_mem.
+ |
+ *----------------------------------------------*/
+
+typedef struct OoOConfig
+{
+	int rob_size;     // reorder buffer entries
+	int iq_size;      // issue queue entries
+	int lsq_size;     // load-store queue entries
+	int phys_regs;    // physical registers (>= 33)
+	int width;        // fetch/rename/commit width
+	int issue_width;  // instructions issued per cycle
+	int num_alu;      // ALUs (also resolve branches)
+	int num_lsu;      // load/store units
+	int num_mul;      // multipliers (latency/pipelining from core->fu)
+	int num_div;      // dividers
+	int alu_latency;
+	int load_latency;
+}OoOConfig;
+
+typedef struct ROBEntry
+{
+	uint64_t seq;      // dynamic instruction number
+	Addr pc;
+	Signal instruction;
+	Decode dec;
+
+	int dest_phys;     // -1 if the instruction writes no register
+	int old_phys;      // previous mapping of rd, freed on commit
+	int src1_phys;
+	int src2_phys;
+	int lsq_idx;       // -1 if not a load/store
+
+	bool issued;
+	bool completed;
+	Tick issue_cycle;
+	Tick complete_cycle;
+	Signal result;
+
+	// Branch outcome
+	bool taken;
+	Addr target;
+
+	// Load-use bookkeeping (see load_use_* in OoOStats)
+	int load_consumer;         // on a load: ROB index of the next instr if it uses rd
+	bool load_use;             // on a consumer: fed by the load right before it
+	uint64_t load_snapshot;    // issue count at the end of that load's issue cycle
+}ROBEntry;
+
+typedef struct LSQEntry
+{
+	int rob_idx;
+	bool is_store;
+	bool addr_valid;
+	Signal addr;
+	Signal data;
+	Signal width;      // bytes
+}LSQEntry;
+
+typedef struct OoOStats
+{
+	uint64_t fetched;
+	uint64_t committed;        // instructions, both halves of a fused pair
+	uint64_t committed_fused;  // fused pairs among them
+	uint64_t issued;
+	uint64_t stall_rob_full;
+	uint64_t stall_iq_full;
+	uint64_t stall_lsq_full;
+	uint64_t stall_no_phys;
+	uint64_t stall_branch;
+	uint64_t load_forwards;
+	uint64_t load_use_pairs;   // load immediately followed by a consumer
+	uint64_t load_use_hidden;  // ... where other work issued in the gap
+}OoOStats;
+
+typedef struct OoOCore
+{
+	Core *core;
+	OoOConfig cfg;
+
+	// Physical register file and rename table
+	Register *prf;
+	bool *prf_ready;
+	int rat[32];
+	int *free_list;
+	int free_head;
+	int free_count;
+
+	// Reorder buffer (circular)
+	ROBEntry *rob;
+	int rob_head;
+	int rob_count;
+
+	// Issue queue holds ROB indices
+	int *iq;
+	int iq_count;
+
+	// Load-store queue (circular, program order)
+	LSQEntry *lsq;
+	int lsq_head;
+	int lsq_count;
+
+	// Per functional unit: first cycle it accepts a new operation
+	Tick *unit_free[NUM_FU];
+
+	// Fetch queue between fetch and rename
+	Signal *fq_instr;
+	FusedTail *fq_fused;
+	Addr *fq_pc;
+	int fq_head;
+	int fq_count;
+	int fq_size;
+
+	uint64_t next_seq;
+	bool branch_pending;   // fetch waits for an unresolved branch
+	uint64_t issued_before_cycle;
+	int last_renamed;      // ROB index of the previous instruction renamed
+
+	OoOStats stats;
+}OoOCore;
+
+void OoOConfigDefaults(OoOConfig *cfg);
+// Allocated from core->arena, released with it. cfg must be valid: at
+// least 33 physical registers, every size, width, count and latency >= 1.
+OoOCore *initOoO(Core *core, const OoOConfig *cfg);
+bool tickOoO(OoOCore *ooo);
+void printOoOStats(OoOCore *ooo);
+
+#endif
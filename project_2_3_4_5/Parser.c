@@ -5,53 +5,128 @@
  |  Author: Justin  Ngo
  |  Written on: 1/28/2023 
  |  
- |  Purpose: Parse R-, I-, Load-, B- Type RISC-V
- |		instructions into their binary representation
+ |  Purpose: Parse R-, I-, Load-, B- Type, vector
+ |		and compressed RISC-V instructions into
+ |		their binary representation
  |		according to the RISC-V data ref card
  |
  *----------------------------------------------*/
 
-// Function to load instructions and decide which type to parse
-void loadInstructions(Instruction_Memory *i_mem, const char *trace)
+// Size instruction memory for the trace: every line takes at least one
+// byte of the file, so the file size bounds the instruction count. The
+// arrays never move, which lets the core fetch while the parser fills
+// them in (calloc'd pages are only backed once they are written).
+static void sizeInstructions(Instruction_Memory *i_mem, size_t bytes)
+{
+    memset(i_mem, 0, sizeof(*i_mem));
+    i_mem->capacity = bytes + 1;
+    i_mem->image_size = i_mem->capacity * 4 + FETCH_PAD;
+    i_mem->instructions = calloc(i_mem->capacity, sizeof(Instruction));
+    i_mem->image = calloc(i_mem->image_size, 1);
+    if (i_mem->instructions == NULL || i_mem->image == NULL)
+    {
+        printf("Not enough memory for %zu instructions.\n", i_mem->capacity);
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&i_mem->lock, NULL);
+    pthread_cond_init(&i_mem->grown, NULL);
+}
+
+static FILE *openTrace(Instruction_Memory *i_mem, const char *trace)
 {
+    struct stat st;
+
     printf("Loading trace file: %s\n", trace);
-	
+
     FILE *fd = fopen(trace, "r");
-    if (fd == NULL)
+    if (fd == NULL || fstat(fileno(fd), &st) != 0)
     {
         perror("Cannot open trace file. \n");
         exit(EXIT_FAILURE);
     }
+    sizeInstructions(i_mem, st.st_size);
+    return fd;
+}
+
+// Make everything parsed so far visible to fetch, waking it if it waits
+static void publish(Instruction_Memory *i_mem, Instruction *last, Addr end, bool complete)
+{
+    __atomic_store_n(&i_mem->published_bytes, end, __ATOMIC_RELEASE);
+    if (last) {
+        __atomic_store_n(&i_mem->last, last, __ATOMIC_SEQ_CST);
+    }
+    if (complete) {
+        __atomic_store_n(&i_mem->complete, true, __ATOMIC_SEQ_CST);
+    }
+    if (complete || __atomic_load_n(&i_mem->waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&i_mem->lock);
+        pthread_cond_broadcast(&i_mem->grown);
+        pthread_mutex_unlock(&i_mem->lock);
+    }
+}
 
+// Function to parse every line and decide which type to parse
+static void parseTrace(Instruction_Memory *i_mem, FILE *fd)
+{
     // Iterate all the assembly instructions
     char *line = NULL;
     size_t len = 0;
     ssize_t read;
 	char *raw_instr;
+	char *save;  // strtok_r state, so traces can be parsed on several threads
 
     Addr PC = 0; // program counter points to the zeroth location initially.
     int IMEM_index = 0;
     int instr_num = 1;
     while ((read = getline(&line, &len, fd)) != -1)
     {
-		printf("Instruction %d: %s\n",instr_num, line);
+		bool recognized = false;
+		if (!i_mem->quiet) {
+			printf("Instruction %d: %s\n",instr_num, line);
+		}
     instr_num++;
         // Assign program counter
         i_mem->instructions[IMEM_index].addr = PC;
+        i_mem->instructions[IMEM_index].instruction = 0;
+        i_mem->instructions[IMEM_index].size = 4;
+        i_mem->instructions[IMEM_index].line = instr_num - 1;
+        snprintf(i_mem->instructions[IMEM_index].text, sizeof(i_mem->instructions[IMEM_index].text),
+            "%.*s", (int)strcspn(line, "\r\n"), line);
 
         // Extract operation
-        raw_instr = strtok(line, " ");
+        raw_instr = strtok_r(line, " ", &save);
 
         if (strcmp(raw_instr, "add") == 0 ||
             strcmp(raw_instr, "sub") == 0 ||
             strcmp(raw_instr, "sll") == 0 ||
+            strcmp(raw_instr, "slt") == 0 ||
+            strcmp(raw_instr, "sltu") == 0 ||
             strcmp(raw_instr, "srl") == 0 ||
+            strcmp(raw_instr, "sra") == 0 ||
             strcmp(raw_instr, "xor") == 0 ||
             strcmp(raw_instr, "or")  == 0 ||
-            strcmp(raw_instr, "and") == 0) {
+            strcmp(raw_instr, "and") == 0 ||
+            strcmp(raw_instr, "mul") == 0 ||
+            strcmp(raw_instr, "mulh")  == 0 ||
+            strcmp(raw_instr, "mulhsu")== 0 ||
+            strcmp(raw_instr, "mulhu") == 0 ||
+            strcmp(raw_instr, "div") == 0 ||
+            strcmp(raw_instr, "divu")  == 0 ||
+            strcmp(raw_instr, "rem") == 0 ||
+            strcmp(raw_instr, "remu")  == 0 ||
+            strcmp(raw_instr, "addw")  == 0 ||
+            strcmp(raw_instr, "subw")  == 0 ||
+            strcmp(raw_instr, "sllw")  == 0 ||
+            strcmp(raw_instr, "srlw")  == 0 ||
+            strcmp(raw_instr, "sraw")  == 0 ||
+            strcmp(raw_instr, "mulw")  == 0 ||
+            strcmp(raw_instr, "divw")  == 0 ||
+            strcmp(raw_instr, "divuw") == 0 ||
+            strcmp(raw_instr, "remw")  == 0 ||
+            strcmp(raw_instr, "remuw") == 0) {
 			// R-Type instructions
-            parseRType(raw_instr, &(i_mem->instructions[IMEM_index]));
-            i_mem->last = &(i_mem->instructions[IMEM_index]);
+            parseRType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
 		} else if (strcmp(raw_instr, "addi") == 0 ||
 				   strcmp(raw_instr, "slli") == 0 ||
 				   strcmp(raw_instr, "slti") == 0 ||
@@ -66,8 +141,8 @@ void loadInstructions(Instruction_Memory *i_mem, const char *trace)
 				   strcmp(raw_instr, "srliw")== 0 ||
 				   strcmp(raw_instr, "sraiw")== 0) {
 			// I-Type instructions
-            parseIType(raw_instr, &(i_mem->instructions[IMEM_index]));
-            i_mem->last = &(i_mem->instructions[IMEM_index]);
+            parseIType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
 		} else if (strcmp(raw_instr, "ld") == 0 ||
 				   strcmp(raw_instr, "lb") == 0 ||	
 				   strcmp(raw_instr, "lh") == 0 ||	
@@ -76,8 +151,15 @@ void loadInstructions(Instruction_Memory *i_mem, const char *trace)
 				   strcmp(raw_instr, "lhu")== 0 ||	
 				   strcmp(raw_instr, "lwu")== 0){
 			// Load Type instructions
-            parseLoadType(raw_instr, &(i_mem->instructions[IMEM_index]));
-            i_mem->last = &(i_mem->instructions[IMEM_index]);
+            parseLoadType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
+		} else if (strcmp(raw_instr, "sd") == 0 ||
+				   strcmp(raw_instr, "sw") == 0 ||
+				   strcmp(raw_instr, "sh") == 0 ||
+				   strcmp(raw_instr, "sb") == 0){
+			// S-Type instructions
+            parseSType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
 		} else if (strcmp(raw_instr, "bne") == 0 ||
 				   strcmp(raw_instr, "beq") == 0 ||
 				   strcmp(raw_instr, "blt") == 0 ||
@@ -85,19 +167,141 @@ void loadInstructions(Instruction_Memory *i_mem, const char *trace)
 				   strcmp(raw_instr, "bltu")== 0 ||
 				   strcmp(raw_instr, "bgeu")== 0){
 			// B-Type instructions
-            parseBType(raw_instr, &(i_mem->instructions[IMEM_index]));
-            i_mem->last = &(i_mem->instructions[IMEM_index]);
+            parseBType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
+		} else if (strncmp(raw_instr, "c.", 2) == 0) {
+			// Compressed (RVC) instructions
+			parseCType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
+		} else if (raw_instr[0] == 'v') {
+			// Vector instructions
+			parseVType(raw_instr, &(i_mem->instructions[IMEM_index]), &save);
+            recognized = true;
+		}
+
+		// Lay the encoding out little-endian in the fetch image
+		Instruction *instr = &(i_mem->instructions[IMEM_index]);
+		unsigned b;
+		for (b=0; b<instr->size; b++) {
+			i_mem->image[PC + b] = (instr->instruction >> (8 * b)) & 0xff;
 		}
-		
+
         IMEM_index++;
-        PC += 4;
+        PC += instr->size;
+        publish(i_mem, recognized ? instr : NULL, PC, false);
     }
 
+    free(line);
     fclose(fd);
+    publish(i_mem, NULL, PC, true);
+}
+
+// Function to load the whole trace before simulating
+void loadInstructions(Instruction_Memory *i_mem, const char *trace)
+{
+    FILE *fd = openTrace(i_mem, trace);
+    parseTrace(i_mem, fd);
+}
+
+// Whole trace file as a string, NULL if it cannot be read
+char *readTrace(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "r");
+    char *text = NULL;
+
+    if (fp == NULL) {
+        return NULL;
+    }
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        rewind(fp);
+        if (size >= 0 && (text = malloc(size + 1)) != NULL) {
+            *len = fread(text, 1, size, fp);
+            text[*len] = '\0';
+        }
+    }
+    fclose(fp);
+    return text;
+}
+
+// Function to load a program held in memory, without the per-line echo
+void loadInstructionsText(Instruction_Memory *i_mem, const char *text, size_t len)
+{
+    sizeInstructions(i_mem, len);
+    i_mem->quiet = true;
+    FILE *fd = len ? fmemopen((void *)text, len, "r") : NULL;
+    if (fd == NULL) {
+        publish(i_mem, NULL, 0, true);
+        return;
+    }
+    parseTrace(i_mem, fd);
+}
+
+static void *parserThread(void *arg)
+{
+    Instruction_Memory *i_mem = arg;
+    parseTrace(i_mem, i_mem->trace);
+    return NULL;
+}
+
+// Function to parse the trace on its own thread while the core runs
+void startLoadInstructions(Instruction_Memory *i_mem, const char *trace)
+{
+    i_mem->trace = openTrace(i_mem, trace);
+    i_mem->quiet = true;
+    if (pthread_create(&i_mem->parser, NULL, parserThread, i_mem) != 0) {
+        perror("Cannot start the parser thread");
+        exit(EXIT_FAILURE);
+    }
+    i_mem->streaming = true;
+}
+
+// Wait for a streaming load to finish
+void finishLoadInstructions(Instruction_Memory *i_mem)
+{
+    if (i_mem->streaming) {
+        pthread_join(i_mem->parser, NULL);
+        i_mem->streaming = false;
+    }
+}
+
+// Does the program have an instruction at pc? Blocks while the parser has
+// not got that far yet.
+bool instructionReady(Instruction_Memory *i_mem, Addr pc)
+{
+    for (;;) {
+        bool complete = __atomic_load_n(&i_mem->complete, __ATOMIC_SEQ_CST);
+        Instruction *last = __atomic_load_n(&i_mem->last, __ATOMIC_SEQ_CST);
+        if (last && pc <= last->addr) {
+            return true;
+        }
+        if (complete) {
+            return false;
+        }
+
+        pthread_mutex_lock(&i_mem->lock);
+        __atomic_store_n(&i_mem->waiting, true, __ATOMIC_SEQ_CST);
+        last = __atomic_load_n(&i_mem->last, __ATOMIC_SEQ_CST);
+        if (!(last && pc <= last->addr) && !__atomic_load_n(&i_mem->complete, __ATOMIC_SEQ_CST)) {
+            i_mem->fetch_waits++;
+            pthread_cond_wait(&i_mem->grown, &i_mem->lock);
+        }
+        __atomic_store_n(&i_mem->waiting, false, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&i_mem->lock);
+    }
+}
+
+void freeInstructions(Instruction_Memory *i_mem)
+{
+    finishLoadInstructions(i_mem);
+    pthread_mutex_destroy(&i_mem->lock);
+    pthread_cond_destroy(&i_mem->grown);
+    free(i_mem->instructions);
+    free(i_mem->image);
 }
 
 // Function to parse R-Type instructions
-void parseRType(char *opr, Instruction *instr) {
+void parseRType(char *opr, Instruction *instr, char **save) {
     instr->instruction = 0;
     unsigned opcode = 0;
     unsigned funct3 = 0;
@@ -115,10 +319,22 @@ void parseRType(char *opr, Instruction *instr) {
 		opcode = 51;
 		funct3 = 1;
 		funct7 = 0;
+    } else if (strcmp(opr, "slt") == 0) {
+		opcode = 51;
+		funct3 = 2;
+		funct7 = 0;
+    } else if (strcmp(opr, "sltu") == 0) {
+		opcode = 51;
+		funct3 = 3;
+		funct7 = 0;
     } else if (strcmp(opr, "srl") == 0) {
 		opcode = 51;
 		funct3 = 5;
 		funct7 = 0;
+    } else if (strcmp(opr, "sra") == 0) {
+		opcode = 51;
+		funct3 = 5;
+		funct7 = 32;
     } else if (strcmp(opr, "xor") == 0) {
 		opcode = 51;
 		funct3 = 4;
@@ -131,16 +347,90 @@ void parseRType(char *opr, Instruction *instr) {
 		opcode = 51;
 		funct3 = 7;
 		funct7 = 0;
+	} else if (strcmp(opr, "mul") == 0) {
+		// M extension: funct7 = 1
+		opcode = 51;
+		funct3 = 0;
+		funct7 = 1;
+	} else if (strcmp(opr, "mulh") == 0) {
+		opcode = 51;
+		funct3 = 1;
+		funct7 = 1;
+	} else if (strcmp(opr, "mulhsu") == 0) {
+		opcode = 51;
+		funct3 = 2;
+		funct7 = 1;
+	} else if (strcmp(opr, "mulhu") == 0) {
+		opcode = 51;
+		funct3 = 3;
+		funct7 = 1;
+	} else if (strcmp(opr, "div") == 0) {
+		opcode = 51;
+		funct3 = 4;
+		funct7 = 1;
+	} else if (strcmp(opr, "divu") == 0) {
+		opcode = 51;
+		funct3 = 5;
+		funct7 = 1;
+	} else if (strcmp(opr, "rem") == 0) {
+		opcode = 51;
+		funct3 = 6;
+		funct7 = 1;
+	} else if (strcmp(opr, "remu") == 0) {
+		opcode = 51;
+		funct3 = 7;
+		funct7 = 1;
+	} else if (strcmp(opr, "addw") == 0) {
+		// RV64I word operations
+		opcode = 59;
+		funct3 = 0;
+		funct7 = 0;
+	} else if (strcmp(opr, "subw") == 0) {
+		opcode = 59;
+		funct3 = 0;
+		funct7 = 32;
+	} else if (strcmp(opr, "sllw") == 0) {
+		opcode = 59;
+		funct3 = 1;
+		funct7 = 0;
+	} else if (strcmp(opr, "srlw") == 0) {
+		opcode = 59;
+		funct3 = 5;
+		funct7 = 0;
+	} else if (strcmp(opr, "sraw") == 0) {
+		opcode = 59;
+		funct3 = 5;
+		funct7 = 32;
+	} else if (strcmp(opr, "mulw") == 0) {
+		// RV64M word operations
+		opcode = 59;
+		funct3 = 0;
+		funct7 = 1;
+	} else if (strcmp(opr, "divw") == 0) {
+		opcode = 59;
+		funct3 = 4;
+		funct7 = 1;
+	} else if (strcmp(opr, "divuw") == 0) {
+		opcode = 59;
+		funct3 = 5;
+		funct7 = 1;
+	} else if (strcmp(opr, "remw") == 0) {
+		opcode = 59;
+		funct3 = 6;
+		funct7 = 1;
+	} else if (strcmp(opr, "remuw") == 0) {
+		opcode = 59;
+		funct3 = 7;
+		funct7 = 1;
 	}
 
-    char *reg = strtok(NULL, ", ");
+    char *reg = strtok_r(NULL, ", ", save);
     unsigned rd = regIndex(reg);
 
-    reg = strtok(NULL, ", ");
+    reg = strtok_r(NULL, ", ", save);
     unsigned rs_1 = regIndex(reg);
 
-    reg = strtok(NULL, ", ");
-    reg[strlen(reg)-1] = '\0';
+    reg = strtok_r(NULL, " ,\n\r", save);  // the last line may have no newline
     unsigned rs_2 = regIndex(reg);
 
     // Contruct instruction
@@ -153,7 +443,7 @@ void parseRType(char *opr, Instruction *instr) {
 }
 
 // Function to parse I-Type instructions
-void parseIType(char *opr, Instruction *instr) {
+void parseIType(char *opr, Instruction *instr, char **save) {
 	instr->instruction = 0;
 	unsigned opcode = 0;
 	unsigned funct3 = 0;
@@ -191,33 +481,33 @@ void parseIType(char *opr, Instruction *instr) {
 		opcode = 19;
 		funct3 = 7;
 	} else if (strcmp(opr, "addiw") == 0) {
-		opcode = 23;
+		opcode = 27;
 		funct3 = 0;
 	} else if (strcmp(opr, "slliw") == 0) {
-		opcode = 23;
+		opcode = 27;
 		funct3 = 1;
 		imm = 0;
 	} else if (strcmp(opr, "srliw") == 0) {
-		opcode = 23;
+		opcode = 27;
 		funct3 = 5;
 		imm = 0;
 	} else if (strcmp(opr, "sraiw") == 0) {
-		opcode = 23;
+		opcode = 27;
 		funct3 = 5;
 		imm = 32 << 5;
 	}
 	
 	
 	// Take the destination register address (rd)
-	char* reg = strtok(NULL, ", ");
+	char* reg = strtok_r(NULL, ", ", save);
 	unsigned rd = regIndex(reg);
 
 	// Take the base register address (rs_1)
-	reg = strtok(NULL, ", ");
+	reg = strtok_r(NULL, ", ", save);
 	unsigned rs_1 = regIndex(reg);
 
 	// Take the immidiate value (imm)
-	reg = strtok(NULL, ", ");
+	reg = strtok_r(NULL, ", ", save);
 	imm |= atoi(reg);
 
 	// Construct instruction binary rep
@@ -225,11 +515,11 @@ void parseIType(char *opr, Instruction *instr) {
 	instr->instruction |= (rd << 7);
 	instr->instruction |= (funct3 << (7+5));
 	instr->instruction |= (rs_1 << (7+5+3));
-	instr->instruction |= (imm << (7+5+3+5));
+	instr->instruction |= ((unsigned)imm << (7+5+3+5));
 }
 
 // Function to parse Load Type instructions
-void parseLoadType(char *opr, Instruction *instr) {
+void parseLoadType(char *opr, Instruction *instr, char **save) {
 	instr->instruction = 0;
 	unsigned opcode = 0;
 	unsigned funct3 = 0;
@@ -259,15 +549,15 @@ void parseLoadType(char *opr, Instruction *instr) {
 	}
 
 	// Take the destination register address (rd)
-	char* reg = strtok(NULL, ", ");
+	char* reg = strtok_r(NULL, ", ", save);
 	unsigned rd = regIndex(reg);
 	
 	// Take the immidiate value (imm)
-	reg = strtok(NULL, "(");
+	reg = strtok_r(NULL, "(", save);
 	signed imm = atoi(reg); 
 
 	// Take the base register address (rs_1)
-	reg = strtok(NULL, ")");
+	reg = strtok_r(NULL, ")", save);
 	unsigned rs_1 = regIndex(reg);
 
 	// Construct instruction binary rep
@@ -275,11 +565,49 @@ void parseLoadType(char *opr, Instruction *instr) {
 	instr->instruction |= (rd << 7);
 	instr->instruction |= (funct3 << (7+5));
 	instr->instruction |= (rs_1 << (7+5+3));
-	instr->instruction |= (imm << (7+5+3+5));
+	instr->instruction |= ((unsigned)imm << (7+5+3+5));
+}
+
+// Function to parse S Type instructions
+void parseSType(char *opr, Instruction *instr, char **save) {
+	instr->instruction = 0;
+	unsigned opcode = 35;
+	unsigned funct3 = 0;
+
+	if (strcmp(opr, "sb") == 0) {
+		funct3 = 0;
+	} else if (strcmp(opr, "sh") == 0) {
+		funct3 = 1;
+	} else if (strcmp(opr, "sw") == 0) {
+		funct3 = 2;
+	} else if (strcmp(opr, "sd") == 0) {
+		// Example: sd x9, 8(x10)
+		funct3 = 3;
+	}
+
+	// Take the source register address (rs_2)
+	char* reg = strtok_r(NULL, ", ", save);
+	unsigned rs_2 = regIndex(reg);
+
+	// Take the immidiate value (imm)
+	reg = strtok_r(NULL, "(", save);
+	signed imm = atoi(reg);
+
+	// Take the base register address (rs_1)
+	reg = strtok_r(NULL, ")", save);
+	unsigned rs_1 = regIndex(reg);
+
+	// Construct instruction binary rep
+	instr->instruction |= opcode;
+	instr->instruction |= (kBitsFrom(imm, 5, 0) << 7);
+	instr->instruction |= (funct3 << (7+5));
+	instr->instruction |= (rs_1 << (7+5+3));
+	instr->instruction |= (rs_2 << (7+5+3+5));
+	instr->instruction |= (kBitsFrom(imm, 7, 5) << (7+5+3+5+5));
 }
 
 // Function to parse B Type instructions
-void parseBType(char *opr, Instruction *instr) {
+void parseBType(char *opr, Instruction *instr, char **save) {
 	instr->instruction = 0;
 	unsigned opcode = 0;
 	unsigned funct3 = 0;
@@ -305,15 +633,15 @@ void parseBType(char *opr, Instruction *instr) {
 	}
 
 	// Take reg addr 1 (rs_1)
-	char* reg = strtok(NULL, ", ");
+	char* reg = strtok_r(NULL, ", ", save);
 	unsigned rs_1 = regIndex(reg);
 
 	// Take reg addr 2 (rs_2)
-	reg = strtok(NULL, ", ");
+	reg = strtok_r(NULL, ", ", save);
 	unsigned rs_2 = regIndex(reg);
 
 	// Take immediate value
-	reg = strtok(NULL, ", ");
+	reg = strtok_r(NULL, ", ", save);
 	signed imm = atoi(reg);
 
 	// Construct instruction binary rep
@@ -328,6 +656,194 @@ void parseBType(char *opr, Instruction *instr) {
 	
 }
 
+// Compressed register x8-x15 as its 3-bit field
+static unsigned cregIndex(char *reg) {
+	unsigned r = regIndex(reg);
+	if (r < 8 || r > 15) {
+		printf("Compressed instruction needs x8-x15, got %s\n", reg);
+	}
+	return r & 7;
+}
+
+// Function to parse compressed (RVC) instructions into 16-bit encodings
+void parseCType(char *opr, Instruction *instr, char **save) {
+	unsigned c = 0;
+	int imm = 0;
+	unsigned rd, rs;
+
+	instr->instruction = 0;
+	instr->size = 2;
+
+	if (strncmp(opr, "c.nop", 5) == 0) {
+		instr->instruction = 0x0001;
+		return;
+	}
+
+	if (strcmp(opr, "c.addi") == 0 || strcmp(opr, "c.li") == 0 || strcmp(opr, "c.slli") == 0) {
+		// Example: c.addi x5, -3
+		rd = regIndex(strtok_r(NULL, " ,\n", save));
+		imm = atoi(strtok_r(NULL, " ,\n", save));
+		c = (kthBit(imm, 5) << 12) | (rd << 7) | (kBitsFrom(imm, 5, 0) << 2);
+		if (strcmp(opr, "c.addi") == 0) {
+			c |= (0 << 13) | 1;
+		} else if (strcmp(opr, "c.li") == 0) {
+			c |= (2 << 13) | 1;
+		} else {
+			c |= (0 << 13) | 2;
+		}
+	} else if (strcmp(opr, "c.srli") == 0 || strcmp(opr, "c.srai") == 0 || strcmp(opr, "c.andi") == 0) {
+		// Example: c.andi x8, 7
+		rd = cregIndex(strtok_r(NULL, " ,\n", save));
+		imm = atoi(strtok_r(NULL, " ,\n", save));
+		unsigned funct2 = strcmp(opr, "c.srli") == 0 ? 0 : strcmp(opr, "c.srai") == 0 ? 1 : 2;
+		c = (4 << 13) | (kthBit(imm, 5) << 12) | (funct2 << 10) | (rd << 7) | (kBitsFrom(imm, 5, 0) << 2) | 1;
+	} else if (strcmp(opr, "c.mv") == 0 || strcmp(opr, "c.add") == 0) {
+		// Example: c.add x5, x6
+		rd = regIndex(strtok_r(NULL, " ,\n", save));
+		rs = regIndex(strtok_r(NULL, " ,\n", save));
+		c = (4 << 13) | ((strcmp(opr, "c.add") == 0) << 12) | (rd << 7) | (rs << 2) | 2;
+	} else if (strcmp(opr, "c.sub") == 0 || strcmp(opr, "c.xor") == 0
+			|| strcmp(opr, "c.or") == 0 || strcmp(opr, "c.and") == 0) {
+		// Example: c.sub x8, x9
+		rd = cregIndex(strtok_r(NULL, " ,\n", save));
+		rs = cregIndex(strtok_r(NULL, " ,\n", save));
+		unsigned funct2 = strcmp(opr, "c.sub") == 0 ? 0 : strcmp(opr, "c.xor") == 0 ? 1 : strcmp(opr, "c.or") == 0 ? 2 : 3;
+		c = (4 << 13) | (3 << 10) | (rd << 7) | (funct2 << 5) | (rs << 2) | 1;
+	} else if (strcmp(opr, "c.ld") == 0 || strcmp(opr, "c.sd") == 0
+			|| strcmp(opr, "c.lw") == 0 || strcmp(opr, "c.sw") == 0) {
+		// Example: c.ld x8, 16(x9)
+		rd = cregIndex(strtok_r(NULL, " ,\n", save));
+		imm = atoi(strtok_r(NULL, " ,(", save));
+		rs = cregIndex(strtok_r(NULL, ")", save));
+		bool word = opr[3] == 'w';
+		unsigned funct3 = (opr[2] == 'l' ? 2 : 6) + !word;
+		c = (funct3 << 13) | (kBitsFrom(imm, 3, 3) << 10) | (rs << 7) | (rd << 2);
+		if (word) {
+			c |= (kthBit(imm, 2) << 6) | (kthBit(imm, 6) << 5);
+		} else {
+			c |= (kBitsFrom(imm, 2, 6) << 5);
+		}
+	} else if (strcmp(opr, "c.ldsp") == 0 || strcmp(opr, "c.sdsp") == 0) {
+		// Example: c.ldsp x5, 8(x2)
+		rd = regIndex(strtok_r(NULL, " ,\n", save));
+		imm = atoi(strtok_r(NULL, " ,(", save));
+		if (strcmp(opr, "c.ldsp") == 0) {
+			c = (3 << 13) | (kthBit(imm, 5) << 12) | (rd << 7) | (kBitsFrom(imm, 2, 3) << 5) | (kBitsFrom(imm, 3, 6) << 2) | 2;
+		} else {
+			c = (7 << 13) | (kBitsFrom(imm, 3, 3) << 10) | (kBitsFrom(imm, 3, 6) << 7) | (rd << 2) | 2;
+		}
+	} else if (strcmp(opr, "c.beqz") == 0 || strcmp(opr, "c.bnez") == 0) {
+		// Example: c.bnez x8, -6
+		rs = cregIndex(strtok_r(NULL, " ,\n", save));
+		imm = atoi(strtok_r(NULL, " ,\n", save));
+		c = ((strcmp(opr, "c.beqz") == 0 ? 6 : 7) << 13) | (kthBit(imm, 8) << 12) | (kBitsFrom(imm, 2, 3) << 10)
+			| (rs << 7) | (kBitsFrom(imm, 2, 6) << 5) | (kBitsFrom(imm, 2, 1) << 3) | (kthBit(imm, 5) << 2) | 1;
+	} else {
+		printf("Unsupported compressed instruction: %s\n", opr);
+		return;
+	}
+	instr->instruction = c;
+}
+
+// Vector instructions by mnemonic: opcode, funct3 and funct6 (for
+// loads and stores funct6 holds the mop field)
+typedef struct VTypeEntry
+{
+	const char *name;
+	unsigned opcode;
+	unsigned funct3;
+	unsigned funct6;
+}VTypeEntry;
+
+static const VTypeEntry VTYPE_TABLE[] = {
+	{"vsetvli",    87, 7, 0},
+	{"vle8.v",      7, 0, 0}, {"vle16.v",   7, 5, 0}, {"vle32.v",   7, 6, 0}, {"vle64.v",   7, 7, 0},
+	{"vse8.v",     39, 0, 0}, {"vse16.v",  39, 5, 0}, {"vse32.v",  39, 6, 0}, {"vse64.v",  39, 7, 0},
+	{"vlse8.v",     7, 0, 2}, {"vlse16.v",  7, 5, 2}, {"vlse32.v",  7, 6, 2}, {"vlse64.v",  7, 7, 2},
+	{"vsse8.v",    39, 0, 2}, {"vsse16.v", 39, 5, 2}, {"vsse32.v", 39, 6, 2}, {"vsse64.v", 39, 7, 2},
+	{"vadd.vv",    87, 0, 0}, {"vadd.vx",  87, 4, 0},
+	{"vsub.vv",    87, 0, 2}, {"vsub.vx",  87, 4, 2},
+	{"vand.vv",    87, 0, 9}, {"vand.vx",  87, 4, 9},
+	{"vor.vv",     87, 0, 10}, {"vor.vx",  87, 4, 10},
+	{"vmul.vv",    87, 2, 37}, {"vmul.vx", 87, 6, 37},
+	{"vredsum.vs", 87, 2, 0},
+	{"vredand.vs", 87, 2, 1},
+	{"vredor.vs",  87, 2, 2},
+	{"vmv.x.s",    87, 2, 16},
+};
+
+// Vector register operand, e.g. v4
+static unsigned vregIndex(char *reg) {
+	return (unsigned)atoi(reg + 1) & 0x1f;
+}
+
+// Function to parse the supported RVV instructions (LMUL=1, unmasked)
+void parseVType(char *opr, Instruction *instr, char **save) {
+	const VTypeEntry *e = NULL;
+	unsigned i;
+	unsigned rd = 0, rs_1 = 0, rs_2 = 0;
+	unsigned vm = 1; // unmasked
+	char *reg;
+
+	instr->instruction = 0;
+	for (i=0; i<sizeof(VTYPE_TABLE)/sizeof(VTYPE_TABLE[0]); i++) {
+		if (strcmp(opr, VTYPE_TABLE[i].name) == 0) {
+			e = &VTYPE_TABLE[i];
+			break;
+		}
+	}
+	if (e == NULL) {
+		printf("Unsupported vector instruction: %s\n", opr);
+		return;
+	}
+
+	if (e->opcode == 87 && e->funct3 == 7) {
+		// Example: vsetvli x5, x10, e32, m1
+		unsigned sew = 3;
+		rd = regIndex(strtok_r(NULL, " ,\n", save));
+		rs_1 = regIndex(strtok_r(NULL, " ,\n", save));
+		reg = strtok_r(NULL, " ,\n", save);
+		if (reg && reg[0] == 'e') {
+			switch (atoi(reg + 1)) {
+				case 8:  sew = 0; break;
+				case 16: sew = 1; break;
+				case 32: sew = 2; break;
+				default: sew = 3; break;
+			}
+		}
+		instr->instruction = 87 | (rd << 7) | (7 << 12) | (rs_1 << 15) | (sew << (20+3));
+		return;
+	}
+
+	if (e->opcode == 7 || e->opcode == 39) {
+		// Example: vle32.v v1, (x10) or vlse64.v v2, (x10), x11
+		rd = vregIndex(strtok_r(NULL, " ,\n", save));
+		rs_1 = regIndex(strtok_r(NULL, " ,()\n", save));
+		if (e->funct6 == 2) {
+			rs_2 = regIndex(strtok_r(NULL, " ,()\n", save));
+		}
+	} else if (strcmp(opr, "vmv.x.s") == 0) {
+		// Example: vmv.x.s x5, v3
+		rd = regIndex(strtok_r(NULL, " ,\n", save));
+		rs_2 = vregIndex(strtok_r(NULL, " ,\n", save));
+	} else {
+		// Example: vadd.vv v3, v1, v2 or vadd.vx v3, v1, x5
+		rd = vregIndex(strtok_r(NULL, " ,\n", save));
+		rs_2 = vregIndex(strtok_r(NULL, " ,\n", save));
+		reg = strtok_r(NULL, " ,\n", save);
+		rs_1 = (e->funct3 == 4 || e->funct3 == 6) ? regIndex(reg) : vregIndex(reg);
+	}
+
+	// Construct instruction binary rep
+	instr->instruction |= e->opcode;
+	instr->instruction |= (rd << 7);
+	instr->instruction |= (e->funct3 << (7+5));
+	instr->instruction |= (rs_1 << (7+5+3));
+	instr->instruction |= (rs_2 << (7+5+3+5));
+	instr->instruction |= (vm << (7+5+3+5+5));
+	instr->instruction |= (e->funct6 << (7+5+3+5+5+1));
+}
+
 // Let the rightmost bit be bit 0
 // Function to extract k bits from p position
 // and returns the extracted value as integer
@@ -1,16 +1,26 @@
 #include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "Instruction_Memory.h"
 #include "Registers.h"
 
 void loadInstructions(Instruction_Memory *i_mem, const char *trace);
-void parseRType(char *opr, Instruction *instr);
-void parseIType(char *opr, Instruction *instr);
-void parseLoadType(char *opr, Instruction *instr);
-void parseBType(char *opr, Instruction *instr);
+char *readTrace(const char *path, size_t *len);
+void loadInstructionsText(Instruction_Memory *i_mem, const char *text, size_t len);
+void startLoadInstructions(Instruction_Memory *i_mem, const char *trace);
+void finishLoadInstructions(Instruction_Memory *i_mem);
+void freeInstructions(Instruction_Memory *i_mem);
+void parseRType(char *opr, Instruction *instr, char **save);
+void parseIType(char *opr, Instruction *instr, char **save);
+void parseLoadType(char *opr, Instruction *instr, char **save);
+void parseSType(char *opr, Instruction *instr, char **save);
+void parseBType(char *opr, Instruction *instr, char **save);
+void parseVType(char *opr, Instruction *instr, char **save);
+void parseCType(char *opr, Instruction *instr, char **save);
 int kBitsFrom(int number, int k, int p);
 int kthBit(int number, int k);
 int regIndex(char *reg);
@@ -0,0 +1,140 @@
+#include "Pipeline.h"
+#include "Observers.h"
+#include "StoreBuffer.h"
+#include "VirtualMemory.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+/*------------------ Pipeline.c ----------------
+ |
+ |  Purpose: Instantiate the in-order pipeline
+ |		configurations and keep them in a
+ |		registry, looked up by name or depth.
+ |		Every configuration is its own set of
+ |		run loops, so a disabled feature is
+ |		compiled out rather than tested for.
+ |
+ *----------------------------------------------*/
+
+#define PIPE_NAME pipe5
+#define PIPE_STAGES PIPE5_STAGES
+#define PIPE_FORWARDING 1
+#define PIPE_PREDICTOR PREDICT_NOT_TAKEN
+#include "Pipeline_Config.h"
+
+#define PIPE_NAME pipe5_noforward
+#define PIPE_STAGES PIPE5_STAGES
+#define PIPE_FORWARDING 0
+#define PIPE_PREDICTOR PREDICT_NOT_TAKEN
+#include "Pipeline_Config.h"
+
+#define PIPE_NAME pipe5_btfn
+#define PIPE_STAGES PIPE5_STAGES
+#define PIPE_FORWARDING 1
+#define PIPE_PREDICTOR PREDICT_BTFN
+#include "Pipeline_Config.h"
+
+#define PIPE_NAME pipe7
+#define PIPE_STAGES PIPE7_STAGES
+#define PIPE_FORWARDING 1
+#define PIPE_PREDICTOR PREDICT_NOT_TAKEN
+#include "Pipeline_Config.h"
+
+#define PIPE_NAME pipe9
+#define PIPE_STAGES PIPE9_STAGES
+#define PIPE_FORWARDING 1
+#define PIPE_PREDICTOR PREDICT_NOT_TAKEN
+#include "Pipeline_Config.h"
+
+#define PIPE_NAME pipe12
+#define PIPE_STAGES PIPE12_STAGES
+#define PIPE_FORWARDING 1
+#define PIPE_PREDICTOR PREDICT_NOT_TAKEN
+#include "Pipeline_Config.h"
+
+#define PIPE_NAME pipe12_btfn
+#define PIPE_STAGES PIPE12_STAGES
+#define PIPE_FORWARDING 1
+#define PIPE_PREDICTOR PREDICT_BTFN
+#include "Pipeline_Config.h"
+
+#define PIPE_CONFIG(name, summary, p) \
+	{name, summary, p##_DEPTH, p##_FORWARDING, p##_PREDICTOR, \
+	 p##_run, p##_run_silent, p##_run_quiet, p##_describe, p##_names}
+
+// The first configuration of each depth is the one --stages picks
+const PipelineVariant pipeline_variants[] = {
+	PIPE_CONFIG("5-stage",           "classic 5-stage pipeline with full forwarding", pipe5),
+	PIPE_CONFIG("5-stage-noforward", "5 stages, operands only from the register file", pipe5_noforward),
+	PIPE_CONFIG("5-stage-btfn",      "5 stages, backward-taken branch prediction", pipe5_btfn),
+	PIPE_CONFIG("7-stage",           "split fetch, two-cycle memory", pipe7),
+	PIPE_CONFIG("9-stage",           "three-cycle fetch, register read stage, two-cycle memory", pipe9),
+	PIPE_CONFIG("12-stage",          "two-cycle decode and execute, three-cycle memory", pipe12),
+	PIPE_CONFIG("12-stage-btfn",     "12 stages, backward-taken branch prediction", pipe12_btfn),
+};
+
+#undef PIPE_CONFIG
+
+const int num_pipeline_variants = sizeof(pipeline_variants) / sizeof(pipeline_variants[0]);
+
+const PipelineVariant *findPipeline(int depth) {
+	int i;
+
+	for (i=0; i<num_pipeline_variants; i++) {
+		if (pipeline_variants[i].depth == depth) {
+			return &pipeline_variants[i];
+		}
+	}
+	return NULL;
+}
+
+const PipelineVariant *findConfig(const char *name) {
+	int i;
+
+	for (i=0; i<num_pipeline_variants; i++) {
+		if (strcmp(pipeline_variants[i].name, name) == 0) {
+			return &pipeline_variants[i];
+		}
+	}
+	return NULL;
+}
+
+void listConfigs(void) {
+	int i;
+
+	printf("In-order pipeline configurations:\n");
+	for (i=0; i<num_pipeline_variants; i++) {
+		printf("  %-18s %s\n", pipeline_variants[i].name, pipeline_variants[i].summary);
+	}
+}
+
+void printEventCounters(const EventCounters *ec, const PipelineVariant *pipeline) {
+	uint64_t forwarded = 0;
+	int s;
+
+	printf("Events: %" PRIu64 " fetched, %" PRIu64 " decoded, %" PRIu64 " executed, %" PRIu64 " retired, %" PRIu64 " flushed\n",
+		ec->fetched, ec->decoded, ec->executed, ec->retired, ec->flushed);
+	printf("Events: %" PRIu64 " taken branches (%" PRIu64 " predicted taken, %" PRIu64 " refetched), %" PRIu64 " loads, %" PRIu64 " stores\n",
+		ec->branches_taken, ec->predicted_taken, ec->mispredicted, ec->loads, ec->stores);
+	printf("Events: %" PRIu64 " data-hazard stalls, %" PRIu64 " functional-unit stalls",
+		ec->data_stalls, ec->unit_stalls);
+	if (ec->store_stalls) {
+		printf(", %" PRIu64 " store-buffer stalls", ec->store_stalls);
+	}
+	if (ec->tlb_stalls) {
+		printf(", %" PRIu64 " TLB stalls", ec->tlb_stalls);
+	}
+	if (ec->cache_stalls) {
+		printf(", %" PRIu64 " data-cache stalls", ec->cache_stalls);
+	}
+	printf("\n");
+	printf("Events: operands forwarded from");
+	for (s=0; s<pipeline->depth; s++) {
+		if (ec->forwarded[s]) {
+			printf(" %s %" PRIu64 ",", pipeline->stage_names[s], ec->forwarded[s]);
+		}
+		forwarded += ec->forwarded[s];
+	}
+	printf(" total %" PRIu64 "\n", forwarded);
+}
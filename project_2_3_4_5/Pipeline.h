@@ -0,0 +1,158 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include "Core.h"
+
+/*------------------ Pipeline.h ----------------
+ |
+ |  In-order pipelines described as a list of
+ |  stages. Each stage has a role; the hazard and
+ |  forwarding logic is derived from where the
+ |  roles sit in the list, so adding a stage to a
+ |  list is all it takes to build a deeper variant.
+ |  Pipeline_Template.h turns a list into its own
+ |  specialized run loop (see Pipeline.c).
+ |
+ *----------------------------------------------*/
+
+typedef enum StageRole
+{
+	STAGE_FETCH,      // read the instruction word, advance the PC
+	STAGE_DECODE,     // decode and read the register file
+	STAGE_EXEC,       // read (forwarded) operands, ALU, resolve branches
+	STAGE_EXEC_TAIL,  // execute continues, ALU result not available yet
+	STAGE_MEM,        // data memory access
+	STAGE_MEM_TAIL,   // memory access continues, load data not available yet
+	STAGE_WB,         // write the register file
+	STAGE_PASS        // no work (extra fetch, decode or register read stage)
+}StageRole;
+
+#define MAX_STAGES 16
+
+// Stage lists: S(name, role)
+#define PIPE5_STAGES(S) \
+	S(IF,   STAGE_FETCH) \
+	S(ID,   STAGE_DECODE) \
+	S(EX,   STAGE_EXEC) \
+	S(MEM,  STAGE_MEM) \
+	S(WB,   STAGE_WB)
+
+// Split fetch, two-cycle memory
+#define PIPE7_STAGES(S) \
+	S(IF1,  STAGE_FETCH) \
+	S(IF2,  STAGE_PASS) \
+	S(ID,   STAGE_DECODE) \
+	S(EX,   STAGE_EXEC) \
+	S(MEM1, STAGE_MEM) \
+	S(MEM2, STAGE_MEM_TAIL) \
+	S(WB,   STAGE_WB)
+
+// Three-cycle fetch, separate register read, two-cycle memory
+#define PIPE9_STAGES(S) \
+	S(IF1,  STAGE_FETCH) \
+	S(IF2,  STAGE_PASS) \
+	S(IF3,  STAGE_PASS) \
+	S(ID,   STAGE_DECODE) \
+	S(RR,   STAGE_PASS) \
+	S(EX,   STAGE_EXEC) \
+	S(MEM1, STAGE_MEM) \
+	S(MEM2, STAGE_MEM_TAIL) \
+	S(WB,   STAGE_WB)
+
+// Two-cycle decode and execute, three-cycle memory
+#define PIPE12_STAGES(S) \
+	S(IF1,  STAGE_FETCH) \
+	S(IF2,  STAGE_PASS) \
+	S(IF3,  STAGE_PASS) \
+	S(ID1,  STAGE_DECODE) \
+	S(ID2,  STAGE_PASS) \
+	S(RR,   STAGE_PASS) \
+	S(EX1,  STAGE_EXEC) \
+	S(EX2,  STAGE_EXEC_TAIL) \
+	S(MEM1, STAGE_MEM) \
+	S(MEM2, STAGE_MEM_TAIL) \
+	S(MEM3, STAGE_MEM_TAIL) \
+	S(WB,   STAGE_WB)
+
+// Pipeline contents between cycles. A NULL slot is a bubble.
+typedef struct PipeState
+{
+	PipeInstr *stage[MAX_STAGES];
+	uint64_t seq; // instructions fetched so far
+
+	// Hazard unit scoreboard for multi-cycle units
+	Tick reg_ready[32];     // first cycle the register's value can be used
+	Tick fu_free[NUM_FU];   // first cycle the unit accepts a new operation
+	Tick vreg_ready[32];    // same for the vector registers
+	Addr reg_writer[32];    // PC of the instruction that set reg_ready
+}PipeState;
+
+// Branch predictors. Branches resolve in EXEC either way.
+typedef enum BranchPredictor
+{
+	PREDICT_NOT_TAKEN,  // keep fetching the fall-through path
+	PREDICT_BTFN        // backward taken, forward not taken, decided in DECODE
+}BranchPredictor;
+
+// Why the instruction in EXEC is held, or with a store buffer, virtual
+// memory or a data cache the one in MEM or fetch (values double as loop
+// events)
+typedef enum StallCause
+{
+	STALL_DATA = 1,        // operand not ready
+	STALL_UNIT = 2,        // functional unit busy
+	STALL_STORE_FULL = 3,  // store buffer full, the store waits in MEM
+	STALL_STORE_DRAIN = 4, // MEM access waits for buffered stores to drain
+	STALL_TLB = 5,         // fetch or MEM waits for a page-table walk
+	STALL_CACHE = 6        // MEM waits for a data cache miss
+}StallCause;
+
+// Totals kept by the OBS_COUNTERS observer (--counters)
+typedef struct EventCounters
+{
+	uint64_t fetched;
+	uint64_t decoded;
+	uint64_t executed;
+	uint64_t retired;         // retired pipeline slots, a fused pair is one
+	uint64_t flushed;
+	uint64_t branches_taken;
+	uint64_t predicted_taken;
+	uint64_t mispredicted;    // fetch redirected from EXEC
+	uint64_t data_stalls;
+	uint64_t unit_stalls;
+	uint64_t store_stalls;    // store buffer full or draining
+	uint64_t tlb_stalls;      // cycles fetch or MEM waited for a walk
+	uint64_t cache_stalls;    // cycles MEM waited for a cache miss
+	uint64_t loads;
+	uint64_t stores;
+	uint64_t forwarded[MAX_STAGES]; // operands bypassed, by source stage
+}EventCounters;
+
+// A pipeline configuration: stage list, forwarding and predictor are
+// compile-time parameters (see Pipeline_Config.h). Each is built with
+// three run loops that differ only in the observers compiled into them
+// (see Observers.h); tickFunc picks one.
+typedef struct PipelineVariant
+{
+	const char *name;
+	const char *summary;
+	int depth;
+	bool forwarding;
+	BranchPredictor predictor;
+	bool (*run)(Core *core, Tick until);        // log, trace, profile, loops, counters
+	bool (*run_silent)(Core *core, Tick until); // the same without the log
+	bool (*run_quiet)(Core *core, Tick until);  // no instrumentation
+	void (*describe)(void);
+	const char *const *stage_names;
+}PipelineVariant;
+
+extern const PipelineVariant pipeline_variants[];
+extern const int num_pipeline_variants;
+
+// Default configuration of the given depth, or by registry name
+const PipelineVariant *findPipeline(int depth);
+const PipelineVariant *findConfig(const char *name);
+void listConfigs(void);
+void printEventCounters(const EventCounters *ec, const PipelineVariant *pipeline);
+
+#endif
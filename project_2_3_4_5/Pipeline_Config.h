@@ -0,0 +1,41 @@
+/*------------------ Pipeline_Config.h ---------
+ |
+ |  Builds one pipeline configuration. Define
+ |  PIPE_NAME, PIPE_STAGES, PIPE_FORWARDING and
+ |  PIPE_PREDICTOR (see Pipeline_Template.h) and
+ |  include this file; it instantiates the
+ |  pipeline and its three run loops, one per
+ |  trace level:
+ |
+ |	PIPE_NAME_run         OBSERVE_ALL
+ |	PIPE_NAME_run_silent  OBSERVE_SILENT
+ |	PIPE_NAME_run_quiet   OBSERVE_NONE
+ |
+ |  and undefines the parameters again.
+ |
+ *----------------------------------------------*/
+
+#include "Pipeline_Template.h"
+
+#define PIPE_RUN _run
+#define PIPE_OBSERVERS OBSERVE_ALL
+#include "Pipeline_Run.h"
+#undef PIPE_RUN
+#undef PIPE_OBSERVERS
+
+#define PIPE_RUN _run_silent
+#define PIPE_OBSERVERS OBSERVE_SILENT
+#include "Pipeline_Run.h"
+#undef PIPE_RUN
+#undef PIPE_OBSERVERS
+
+#define PIPE_RUN _run_quiet
+#define PIPE_OBSERVERS OBSERVE_NONE
+#include "Pipeline_Run.h"
+#undef PIPE_RUN
+#undef PIPE_OBSERVERS
+
+#undef PIPE_NAME
+#undef PIPE_STAGES
+#undef PIPE_FORWARDING
+#undef PIPE_PREDICTOR
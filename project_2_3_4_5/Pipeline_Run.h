@@ -0,0 +1,218 @@
+/*------------------ Pipeline_Run.h ------------
+ |
+ |  Builds one run loop for a pipeline already
+ |  instantiated by Pipeline_Template.h. Include
+ |  it after defining
+ |
+ |	PIPE_NAME       the pipeline's prefix
+ |	PIPE_RUN        suffix of the run function
+ |	PIPE_OBSERVERS  observer list, Observers.h
+ |
+ |  It generates PIPE_NAME##PIPE_RUN(core). The
+ |  observers are wired in at compile time, so
+ |  the same pipeline can have a logged loop and
+ |  a bare one side by side.
+ |
+ *----------------------------------------------*/
+
+#define PIPE_CAT_(a, b) a##b
+#define PIPE_CAT(a, b) PIPE_CAT_(a, b)
+#define P(x) PIPE_CAT(PIPE_NAME, x)
+#define R(x) PIPE_CAT(PIPE_CAT(PIPE_NAME, PIPE_RUN), x)
+
+// Raise event e with arguments a on every observer in the list
+#define PIPE_NOTIFY_ONE(obs, e, a) obs##_##e a;
+#define PIPE_NOTIFY(e, a) PIPE_OBSERVERS(PIPE_NOTIFY_ONE, e, a)
+
+static inline Signal R(_operand)(Core *core, PipeState *ps, PipeInstr *PI, Signal r, const char *which) {
+	int s = P(_producer)(ps, r);
+
+	// Without forwarding only a producer in WB can be found here, and it
+	// has already written the register file this cycle
+	if (s < 0 || !P(_FORWARDING)) {
+		return core->reg_file[r];
+	}
+	PIPE_NOTIFY(on_forward, (core, ps, PI, s, which))
+	return s > P(_MEM) ? ps->stage[s]->mem_res : ps->stage[s]->ex->ALU_result;
+}
+
+static inline void R(_flush)(Core *core, PipeState *ps, int upto) {
+	int s;
+
+	for (s=0; s<upto; s++) {
+		if (ps->stage[s]) {
+			PIPE_NOTIFY(on_flush, (core, ps->stage[s]))
+			freePipeInstr(core, ps->stage[s]);
+			ps->stage[s] = NULL;
+		}
+	}
+}
+
+// Advance the pipeline by one clock cycle
+static inline void R(_cycle)(Core *core, PipeState *ps)
+{
+	int s, cause;
+	int hold = -1; // on a stall, the last stage that holds
+	bool fetch_wait = false;
+
+	if (ps->stage[0] == NULL && instructionReady(core->instr_mem, core->PC)) {
+		ps->stage[0] = newPipeInstr(core, ++ps->seq, core->PC);
+	}
+	PIPE_NOTIFY(on_cycle, (core, ps))
+
+	// A store buffer, a D-TLB miss or a data cache miss can hold MEM,
+	// and everything behind it with it
+	PipeInstr *MEM = ps->stage[P(_MEM)];
+	PipeInstr *EX = ps->stage[P(_EXEC)];
+	if ((core->sb || core->vm || core->dcache) && MEM && MEM->done < P(_MEM) && (cause = memStageBlocks(core, MEM))) {
+		hold = P(_MEM);
+		PIPE_NOTIFY(on_stall, (core, ps, MEM, cause))
+	} else if (EX && EX->fetch_fault) {
+		hold = P(_EXEC);
+		vmFetchFault(core->vm, core, EX);
+	} else if (EX && ((usesRs1(EX->dec) && (P(_hazard)(ps, EX->dec->rs1) || P(_scoreboard)(core, ps, EX->dec->rs1)))
+		|| (usesRs2(EX->dec) && (P(_hazard)(ps, EX->dec->rs2) || P(_scoreboard)(core, ps, EX->dec->rs2)))
+		|| (EX->dec->ctrl_signals.Vector && P(_vector_hazard)(core, ps, EX->dec)))) {
+		hold = P(_EXEC);
+		PIPE_NOTIFY(on_stall, (core, ps, EX, STALL_DATA))
+	} else if (EX && ps->fu_free[FunctionalUnitOf(EX->dec->ALU_ctrl_signal)] > core->clk) {
+		hold = P(_EXEC);
+		PIPE_NOTIFY(on_stall, (core, ps, EX, STALL_UNIT))
+	}
+
+	// An I-TLB miss holds fetch
+	if (core->vm && ps->stage[0] && ps->stage[0]->done < 0 && vmFetchBlocks(core->vm, core, ps->stage[0])) {
+		fetch_wait = true;
+		if (hold < 0) {
+			hold = 0;
+		}
+		PIPE_NOTIFY(on_stall, (core, ps, ps->stage[0], STALL_TLB))
+	}
+
+	// Work is done back to front so writeback lands before the register read
+	for (s=P(_DEPTH)-1; s>=0; s--) {
+		PipeInstr *PI = ps->stage[s];
+		if (PI == NULL) {
+			continue;
+		}
+		PIPE_NOTIFY(on_stage, (core, PI, s))
+		if (PI->done >= s) {
+			continue;
+		}
+
+		switch (P(_roles)[s]) {
+			case STAGE_FETCH:
+				if (fetch_wait) {
+					continue;
+				}
+				fetch(core, PI);
+				PIPE_NOTIFY(on_fetch, (core, PI))
+				break;
+			case STAGE_DECODE:
+				decode(core, PI);
+				PIPE_NOTIFY(on_decode, (core, PI))
+				if (PIPE_PREDICTOR == PREDICT_BTFN && PI->dec->ctrl_signals.Branch) {
+					Addr target = Add(PI->pc + (PI->dec->fuse != FUSE_NONE ? PI->dec->fuse_offset : 0),
+						ShiftLeft1(PI->dec->immediate));
+					if (target <= PI->pc) {
+						R(_flush)(core, ps, s);
+						core->PC = target;
+						PI->predicted_taken = true;
+						PIPE_NOTIFY(on_predict, (core, ps, PI))
+					}
+				}
+				break;
+			case STAGE_EXEC:
+				if (hold >= P(_EXEC)) {
+					continue;
+				}
+				execute(core, PI,
+					usesRs1(PI->dec) ? R(_operand)(core, ps, PI, PI->dec->rs1, "rs1") : core->reg_file[PI->dec->rs1],
+					usesRs2(PI->dec) ? R(_operand)(core, ps, PI, PI->dec->rs2, "rs2") : core->reg_file[PI->dec->rs2]);
+				P(_occupy)(core, ps, PI);
+				PIPE_NOTIFY(on_execute, (core, ps, PI))
+				if (PI->ex->branch_taken != PI->predicted_taken) {
+					R(_flush)(core, ps, P(_EXEC));
+					core->PC = PI->ex->branch_taken ? PI->ex->branch_target : PI->next_pc;
+					PIPE_NOTIFY(on_redirect, (core, ps, PI))
+				}
+				if (PI->ex->branch_taken) {
+					PIPE_NOTIFY(on_branch, (core, ps, PI))
+				}
+				break;
+			case STAGE_MEM:
+				if (hold >= P(_MEM)) {
+					continue;
+				}
+				memAccess(core, PI);
+				PIPE_NOTIFY(on_mem_access, (core, PI))
+				break;
+			case STAGE_WB:
+				writeBack(core, PI);
+				PIPE_NOTIFY(on_writeback, (core, PI))
+				break;
+			default:
+				break;
+		}
+		PI->done = s;
+		PIPE_NOTIFY(on_stage_done, (core, PI, s))
+	}
+
+	// Retire, then move everything one stage forward. On a stall the
+	// stages up to EXEC (or MEM, or fetch) hold and a bubble enters the
+	// stage after it.
+	if (ps->stage[P(_WB)]) {
+		bool fused = ps->stage[P(_WB)]->dec->fuse != FUSE_NONE;
+		core->retired += fused ? 2 : 1;
+		core->fused_pairs += fused;
+		if (ps->stage[P(_WB)]->pc == core->break_pc
+				|| (fused && ps->stage[P(_WB)]->pc + ps->stage[P(_WB)]->dec->fuse_offset == core->break_pc)) {
+			core->break_hit = true;
+		}
+		PIPE_NOTIFY(on_retire, (core, ps->stage[P(_WB)]))
+		freePipeInstr(core, ps->stage[P(_WB)]);
+		ps->stage[P(_WB)] = NULL;
+	}
+	for (s=P(_DEPTH)-1; s>0; s--) {
+		if (hold >= 0 && s == hold+1) {
+			ps->stage[s] = NULL;
+			break;
+		}
+		ps->stage[s] = ps->stage[s-1];
+	}
+	if (hold < 0) {
+		ps->stage[0] = NULL;
+	}
+	if (core->sb) {
+		storeBufferCycle(core->sb, core, P(_empty)(ps));
+	}
+
+	++core->clk;
+	PIPE_NOTIFY(on_cycle_end, (core, ps))
+}
+
+// Run until the program finishes (and its stores have drained), the
+// clock reaches until or the breakpoint instruction retires. Returns
+// false once it has finished.
+// The pipeline lives in core->pipe, so the next call resumes it.
+static bool PIPE_CAT(PIPE_NAME, PIPE_RUN)(Core *core, Tick until)
+{
+	PipeState *ps = core->pipe;
+
+	for (;;) {
+		if (P(_empty)(ps) && !instructionReady(core->instr_mem, core->PC) && storeBufferEmpty(core->sb)) {
+			return false;
+		}
+		if (core->clk >= until || core->break_hit) {
+			return true;
+		}
+		R(_cycle)(core, ps);
+	}
+}
+
+#undef PIPE_NOTIFY
+#undef PIPE_NOTIFY_ONE
+#undef R
+#undef P
+#undef PIPE_CAT
+#undef PIPE_CAT_
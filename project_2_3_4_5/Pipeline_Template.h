@@ -0,0 +1,286 @@
+/*------------------ Pipeline_Template.h -------
+ |
+ |  Instantiates one in-order pipeline. Include
+ |  this file once per variant after defining
+ |
+ |	PIPE_NAME        prefix for the generated symbols
+ |	PIPE_STAGES      stage list, see Pipeline.h
+ |	PIPE_FORWARDING  1 to bypass results into EXEC
+ |	PIPE_PREDICTOR   a BranchPredictor
+ |
+ |  It generates the stage indices, roles and
+ |  hazard distances as compile-time constants,
+ |  the hazard and scoreboard helpers, and
+ |  PIPE_NAME_describe() which prints the derived
+ |  forwarding paths and hazard distances. The
+ |  run loops are built on top of these by
+ |  Pipeline_Run.h.
+ |
+ *----------------------------------------------*/
+
+#define PIPE_CAT_(a, b) a##b
+#define PIPE_CAT(a, b) PIPE_CAT_(a, b)
+#define P(x) PIPE_CAT(PIPE_NAME, x)
+
+// Stage indices by name: PIPE_NAME_S_IF, PIPE_NAME_S_ID, ...
+#define PIPE_ENUM(name, role) P(_S_##name),
+enum { PIPE_STAGES(PIPE_ENUM) };
+#undef PIPE_ENUM
+
+#define PIPE_COUNT(name, role) + 1
+#define PIPE_FIND_DECODE(name, role) + ((role) == STAGE_DECODE ? P(_S_##name) : 0)
+#define PIPE_FIND_EXEC(name, role) + ((role) == STAGE_EXEC ? P(_S_##name) : 0)
+#define PIPE_FIND_MEM(name, role) + ((role) == STAGE_MEM ? P(_S_##name) : 0)
+#define PIPE_COUNT_EXEC_TAIL(name, role) + ((role) == STAGE_EXEC_TAIL)
+#define PIPE_COUNT_MEM_TAIL(name, role) + ((role) == STAGE_MEM_TAIL)
+
+enum
+{
+	P(_DEPTH) = 0 PIPE_STAGES(PIPE_COUNT),
+	P(_DECODE) = 0 PIPE_STAGES(PIPE_FIND_DECODE),
+	P(_EXEC) = 0 PIPE_STAGES(PIPE_FIND_EXEC),
+	P(_MEM) = 0 PIPE_STAGES(PIPE_FIND_MEM),
+	// Last stage before an ALU result / load data can be forwarded
+	P(_ALU_READY) = P(_EXEC) + (0 PIPE_STAGES(PIPE_COUNT_EXEC_TAIL)),
+	P(_LOAD_READY) = P(_MEM) + (0 PIPE_STAGES(PIPE_COUNT_MEM_TAIL)),
+	P(_WB) = P(_DEPTH) - 1,
+	// Without forwarding, operands are read once the producer has written back
+	P(_ALU_USE) = PIPE_FORWARDING ? P(_ALU_READY) : P(_WB) - 1,
+	P(_LOAD_USE) = PIPE_FORWARDING ? P(_LOAD_READY) : P(_WB) - 1,
+	P(_FORWARDING) = PIPE_FORWARDING,
+	P(_PREDICTOR) = PIPE_PREDICTOR
+};
+
+#undef PIPE_COUNT
+#undef PIPE_FIND_DECODE
+#undef PIPE_FIND_EXEC
+#undef PIPE_FIND_MEM
+#undef PIPE_COUNT_EXEC_TAIL
+#undef PIPE_COUNT_MEM_TAIL
+
+#define PIPE_NAME_STR(name, role) #name,
+#define PIPE_ROLE(name, role) role,
+static const char *const P(_names)[] = { PIPE_STAGES(PIPE_NAME_STR) };
+static const StageRole P(_roles)[] = { PIPE_STAGES(PIPE_ROLE) };
+#undef PIPE_NAME_STR
+#undef PIPE_ROLE
+
+_Static_assert(P(_DEPTH) <= MAX_STAGES, "too many pipeline stages");
+_Static_assert(P(_EXEC) > P(_DECODE) && P(_MEM) > P(_ALU_READY) && P(_WB) > P(_LOAD_READY),
+	"stage list needs FETCH/DECODE, EXEC, MEM and WB in that order");
+
+static void P(_describe)(void) {
+	int s;
+
+	printf("Pipeline: %d stages (", P(_DEPTH));
+	for (s=0; s<P(_DEPTH); s++) {
+		printf(s ? " %s" : "%s", P(_names)[s]);
+	}
+	printf(")\n");
+	printf("ALU-use bubbles: %d, load-use bubbles: %d, taken-branch penalty: %d\n",
+		P(_ALU_USE) - P(_EXEC), P(_LOAD_USE) - P(_EXEC), P(_EXEC));
+	if (PIPE_PREDICTOR == PREDICT_BTFN) {
+		printf("Branch prediction: backward taken, forward not taken, in %s (predicted-taken penalty: %d, misprediction penalty: %d)\n",
+			P(_names)[P(_DECODE)], P(_DECODE), P(_EXEC));
+	}
+	if (!P(_FORWARDING)) {
+		printf("No forwarding: %s reads operands after the producer has written back\n", P(_names)[P(_EXEC)]);
+		return;
+	}
+	printf("Forwarding into %s from:", P(_names)[P(_EXEC)]);
+	for (s=P(_ALU_READY)+1; s<P(_DEPTH); s++) {
+		printf(" %s%s", P(_names)[s], s > P(_LOAD_READY) ? "" : " (ALU only)");
+	}
+	printf("\n");
+}
+
+// Nearest older in-flight instruction that writes register r, or -1
+static inline int P(_producer)(PipeState *ps, Signal r) {
+	int s;
+
+	if (r == 0) {
+		return -1;
+	}
+	for (s=P(_EXEC)+1; s<P(_DEPTH); s++) {
+		PipeInstr *older = ps->stage[s];
+		if (older && older->dec->ctrl_signals.RegWrite && older->dec->rd == r) {
+			return s;
+		}
+	}
+	return -1;
+}
+
+// Interlock: the instruction in EXEC waits while a producer it depends
+// on has not left the stage where its result becomes available.
+static inline bool P(_hazard)(PipeState *ps, Signal r) {
+	int s = P(_producer)(ps, r);
+
+	if (s < 0) {
+		return false;
+	}
+	if (ps->stage[s]->dec->ctrl_signals.MemRead) {
+		return s <= P(_LOAD_USE);
+	}
+	return s <= P(_ALU_USE);
+}
+
+// Multi-cycle results are tracked by the scoreboard instead
+static inline bool P(_scoreboard)(Core *core, PipeState *ps, Signal r) {
+	return r != 0 && ps->reg_ready[r] > core->clk;
+}
+
+// Vector sources and destination wait for the vector unit to finish
+static inline bool P(_vector_hazard)(Core *core, PipeState *ps, Decode *dec) {
+	Signal src[3];
+	Signal vd = vectorDest(dec);
+	int i, n = vectorSources(dec, src);
+
+	for (i=0; i<n; i++) {
+		if (ps->vreg_ready[src[i]] > core->clk) {
+			return true;
+		}
+	}
+	return vd >= 0 && ps->vreg_ready[vd] > core->clk;
+}
+
+// Book the functional unit and note when the result becomes usable
+static inline void P(_occupy)(Core *core, PipeState *ps, PipeInstr *PI) {
+	FUType type = FunctionalUnitOf(PI->dec->ALU_ctrl_signal);
+	FunctionalUnit *fu = &core->fu[type];
+
+	if (type == FU_VEC) {
+		// Busy for vl/lanes cycles. Vector memory ops also hold the unit
+		// until they have reached MEM so vl and the registers they use
+		// cannot change under them.
+		int occupancy = vectorOccupancy(core, PI->dec);
+		Signal vd = vectorDest(PI->dec);
+		bool mem = PI->dec->opcode == OPCODE_VLOAD || PI->dec->opcode == OPCODE_VSTORE;
+
+		ps->fu_free[type] = core->clk + (mem && occupancy < P(_MEM) - P(_EXEC) ? P(_MEM) - P(_EXEC) : occupancy);
+		if (vd >= 0) {
+			ps->vreg_ready[vd] = core->clk + occupancy + (PI->dec->opcode == OPCODE_VLOAD ? P(_LOAD_READY) - P(_EXEC) : 0);
+		}
+		if (PI->dec->ctrl_signals.RegWrite) {
+			ps->reg_ready[PI->dec->rd] = core->clk + occupancy;
+		}
+		return;
+	}
+
+	ps->fu_free[type] = core->clk + (fu->pipelined ? 1 : fu->latency);
+	if (PI->dec->ctrl_signals.RegWrite) {
+		ps->reg_ready[PI->dec->rd] = core->clk + fu->latency;
+		ps->reg_writer[PI->dec->rd] = PI->pc;
+	}
+}
+
+// Profiler: charge a data-hazard stall of EX to whoever produces late
+static inline void P(_blame)(Core *core, PipeState *ps, PipeInstr *EX) {
+	Signal regs[2] = { EX->dec->rs1, EX->dec->rs2 };
+	bool used[2] = { usesRs1(EX->dec), usesRs2(EX->dec) };
+	ProfileEntry *e = profileEntry(core->profile, EX->pc);
+	int i;
+
+	if (e) {
+		e->stalls++;
+	}
+	for (i=0; i<2; i++) {
+		Addr pc;
+		if (!used[i]) {
+			continue;
+		}
+		if (P(_hazard)(ps, regs[i])) {
+			pc = ps->stage[P(_producer)(ps, regs[i])]->pc;
+		} else if (P(_scoreboard)(core, ps, regs[i])) {
+			pc = ps->reg_writer[regs[i]];
+		} else {
+			continue;
+		}
+		if ((e = profileEntry(core->profile, pc))) {
+			e->bubbles++;
+		}
+		return;
+	}
+}
+
+// Loop boundary, called after a cycle in which a backward branch was
+// taken. Fingerprints the pipeline and, in a steady state, skips ahead.
+// Everything still in flight has executed by now (the branch flushed the
+// stages before EXEC), so its memory and writeback work is done up front,
+// the skipped iterations run on top of that and the values it forwards
+// are refreshed from the register file.
+static inline void P(_loop)(Core *core, PipeState *ps, Addr branch_pc, Addr target) {
+	uint64_t state = LOOP_HASH_INIT;
+	Tick skipped;
+	int s, r;
+
+	// A predicted-taken branch leaves the target's instructions in the
+	// front end, which the functional engine cannot take over
+	if (PIPE_PREDICTOR != PREDICT_NOT_TAKEN) {
+		return;
+	}
+
+	for (s=0; s<P(_DEPTH); s++) {
+		PipeInstr *PI = ps->stage[s];
+		state = loopHash(state, PI ? (PI->pc << 5) + PI->done + 2 : 0);
+	}
+	for (r=0; r<32; r++) {
+		state = loopHash(state, ps->reg_ready[r] > core->clk ? ps->reg_ready[r] - core->clk : 0);
+		state = loopHash(state, ps->vreg_ready[r] > core->clk ? ps->vreg_ready[r] - core->clk : 0);
+	}
+	for (r=0; r<NUM_FU; r++) {
+		state = loopHash(state, ps->fu_free[r] > core->clk ? ps->fu_free[r] - core->clk : 0);
+	}
+	if (!loopBoundary(core, branch_pc, state)) {
+		return;
+	}
+
+	for (s=P(_EXEC)+1; s<P(_DEPTH); s++) {
+		PipeInstr *PI = ps->stage[s];
+		if (PI == NULL) {
+			continue;
+		}
+		if (PI->done < P(_MEM)) {
+			memAccess(core, PI);
+		}
+		if (PI->done < P(_WB)) {
+			writeBack(core, PI);
+		}
+		PI->done = P(_WB);
+	}
+
+	skipped = loopExtrapolate(core, target);
+	if (skipped == 0) {
+		return;
+	}
+	for (s=P(_EXEC)+1; s<P(_DEPTH); s++) {
+		PipeInstr *PI = ps->stage[s];
+		if (PI && PI->dec->ctrl_signals.RegWrite && PI->dec->rd != 0) {
+			PI->mem_res = core->reg_file[PI->dec->rd];
+			if (!PI->dec->ctrl_signals.MemRead) {
+				PI->ex->ALU_result = PI->mem_res;
+			}
+		}
+	}
+	for (r=0; r<32; r++) {
+		ps->reg_ready[r] += skipped;
+		ps->vreg_ready[r] += skipped;
+	}
+	for (r=0; r<NUM_FU; r++) {
+		ps->fu_free[r] += skipped;
+	}
+}
+
+static inline bool P(_empty)(PipeState *ps) {
+	int s;
+
+	for (s=0; s<P(_DEPTH); s++) {
+		if (ps->stage[s]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#undef P
+#undef PIPE_CAT
+#undef PIPE_CAT_
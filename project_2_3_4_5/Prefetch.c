@@ -0,0 +1,181 @@
+#include "Prefetch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Cache.h"
+
+/*------------------ Prefetch.c ----------------
+ |
+ |  Purpose: The prefetcher kinds: training on
+ |		demand accesses and the lines each
+ |		asks for.
+ |
+ *----------------------------------------------*/
+
+#define LINE_BYTES (1 << CACHE_LINE_SHIFT)
+#define STRIDE_ENTRIES 64
+#define STRIDE_CONFIDENT 2  // repeats of a stride before it is trusted
+#define STREAMS 8
+
+static int nextLine(Prefetcher *pf, Addr pc, Addr addr, bool miss, uint64_t *lines) {
+	uint64_t line = addr >> CACHE_LINE_SHIFT;
+	int i;
+
+	(void)pc;
+	if (!miss) {
+		return 0;
+	}
+	for (i=0; i<pf->degree; i++) {
+		lines[i] = line + pf->distance + i;
+	}
+	return pf->degree;
+}
+
+typedef struct StrideEntry
+{
+	Addr pc;
+	Addr last;       // address of the previous access
+	int64_t stride;
+	int confidence;  // strides seen again in a row, saturating at 3
+}StrideEntry;
+
+static int stride(Prefetcher *pf, Addr pc, Addr addr, bool miss, uint64_t *lines) {
+	StrideEntry *e = &((StrideEntry *)pf->state)[(pc >> 1) % STRIDE_ENTRIES];
+	int64_t delta = (int64_t)(addr - e->last);
+	int64_t step;
+	uint64_t prev;
+	int i, n = 0;
+
+	(void)miss;
+	if (e->pc != pc) {
+		e->pc = pc;
+		e->last = addr;
+		e->stride = 0;
+		e->confidence = 0;
+		return 0;
+	}
+	e->last = addr;
+	if (delta == 0) {
+		return 0;
+	}
+	if (delta != e->stride) {
+		e->stride = delta;
+		e->confidence = 0;
+		return 0;
+	}
+	if (e->confidence < 3) {
+		e->confidence++;
+	}
+	if (e->confidence < STRIDE_CONFIDENT) {
+		return 0;
+	}
+
+	// Strides inside a line step a whole line, or nothing new would come
+	step = delta;
+	if (delta > -LINE_BYTES && delta < LINE_BYTES) {
+		step = delta < 0 ? -LINE_BYTES : LINE_BYTES;
+	}
+	prev = addr >> CACHE_LINE_SHIFT;
+	for (i=0; i<pf->degree; i++) {
+		uint64_t line = (addr + step * (pf->distance + i)) >> CACHE_LINE_SHIFT;
+		if (line != prev) {
+			lines[n++] = line;
+			prev = line;
+		}
+	}
+	return n;
+}
+
+typedef struct Stream
+{
+	uint64_t last;   // line of the latest access in the run
+	int dir;         // +1, -1, or 0 until the second miss
+	uint64_t used;
+	bool valid;
+}Stream;
+
+typedef struct StreamState
+{
+	Stream streams[STREAMS];
+	uint64_t clock;
+}StreamState;
+
+static int stream(Prefetcher *pf, Addr pc, Addr addr, bool miss, uint64_t *lines) {
+	StreamState *st = pf->state;
+	uint64_t line = addr >> CACHE_LINE_SHIFT;
+	int64_t window = pf->distance + pf->degree;
+	Stream *s = NULL, *victim = &st->streams[0];
+	int i;
+
+	(void)pc;
+	if (!miss) {
+		return 0;
+	}
+	st->clock++;
+	for (i=0; i<STREAMS; i++) {
+		Stream *c = &st->streams[i];
+		int64_t delta = (int64_t)(line - c->last);
+		if (c->valid && delta != 0 && delta >= -window && delta <= window
+				&& (c->dir == 0 || (delta > 0) == (c->dir > 0))) {
+			s = c;
+			break;
+		}
+		if (!c->valid || (victim->valid && c->used < victim->used)) {
+			victim = c;
+		}
+	}
+	if (s == NULL) {
+		victim->last = line;
+		victim->dir = 0;
+		victim->used = st->clock;
+		victim->valid = true;
+		return 0;
+	}
+	s->dir = line > s->last ? 1 : -1;
+	s->last = line;
+	s->used = st->clock;
+	for (i=0; i<pf->degree; i++) {
+		lines[i] = line + (int64_t)s->dir * (pf->distance + i);
+	}
+	return pf->degree;
+}
+
+const PrefetcherKind prefetcher_kinds[] = {
+	{ "next",   "next lines after a miss or a first use of a prefetched line",  0,                                    nextLine },
+	{ "stride", "per-PC stride table, 64 entries, once a stride repeats twice", STRIDE_ENTRIES * sizeof(StrideEntry), stride },
+	{ "stream", "8 sequential miss streams, up or down",                        sizeof(StreamState),                  stream },
+};
+const int num_prefetcher_kinds = sizeof(prefetcher_kinds) / sizeof(prefetcher_kinds[0]);
+
+const PrefetcherKind *findPrefetcher(const char *name) {
+	int i;
+
+	for (i=0; i<num_prefetcher_kinds; i++) {
+		if (strcmp(prefetcher_kinds[i].name, name) == 0) {
+			return &prefetcher_kinds[i];
+		}
+	}
+	return NULL;
+}
+
+void listPrefetchers(void) {
+	int i;
+
+	printf("Prefetchers:\n");
+	for (i=0; i<num_prefetcher_kinds; i++) {
+		printf("  %-8s %s\n", prefetcher_kinds[i].name, prefetcher_kinds[i].summary);
+	}
+}
+
+Prefetcher *newPrefetcher(const PrefetcherKind *kind, int degree, int distance, Arena *arena) {
+	Prefetcher *pf = arenaAlloc(arena, sizeof(Prefetcher));
+
+	pf->kind = kind;
+	pf->degree = degree < 1 ? 1 : degree > PREFETCH_MAX_DEGREE ? PREFETCH_MAX_DEGREE : degree;
+	pf->distance = distance < 1 ? 1 : distance;
+	if (kind->state_size) {
+		pf->state = arenaAlloc(arena, kind->state_size);
+	}
+	return pf;
+}
@@ -0,0 +1,72 @@
+#ifndef __PREFETCH_H__
+#define __PREFETCH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Arena.h"
+#include "Core.h"
+
+/*------------------ Prefetch.h ----------------
+ |
+ |  Hardware prefetchers for the data caches
+ |  (see Cache.h). A prefetcher is trained by
+ |  every demand access to its cache and answers
+ |  with the lines it wants brought in:
+ |
+ |	next    the lines after a miss
+ |	stride  per load/store PC, the addresses a
+ |	        stride leads to once it has
+ |	        repeated twice
+ |	stream  sequential runs of misses, up or
+ |	        down, followed ahead of the access
+ |
+ |  Degree is how many lines one trigger asks
+ |  for, distance how far ahead the first is, in
+ |  lines or strides. A new kind is a train
+ |  function and an entry in prefetcher_kinds.
+ |
+ *----------------------------------------------*/
+
+#define PREFETCH_MAX_DEGREE 16
+
+struct Prefetcher;
+
+typedef struct PrefetcherKind
+{
+	const char *name;
+	const char *summary;
+	size_t state_size;  // zeroed, from the arena
+
+	// Demand access to addr by the instruction at pc. miss is also set
+	// on the first hit to a line a prefetch brought in, so tagged
+	// schemes keep running ahead. Writes the line numbers (addr >>
+	// CACHE_LINE_SHIFT) to fetch and returns how many.
+	int (*train)(struct Prefetcher *pf, Addr pc, Addr addr, bool miss, uint64_t *lines);
+}PrefetcherKind;
+
+typedef struct Prefetcher
+{
+	const PrefetcherKind *kind;
+	int degree;
+	int distance;
+	void *state;
+
+	// Statistics, kept by the cache
+	uint64_t issued;     // prefetches that brought a line in
+	uint64_t redundant;  // asked for lines the cache already held
+	uint64_t useful;     // prefetched lines a demand access used
+	uint64_t late;       // ... before the line had arrived
+	uint64_t unused;     // prefetched lines evicted without a use
+}Prefetcher;
+
+extern const PrefetcherKind prefetcher_kinds[];
+extern const int num_prefetcher_kinds;
+
+// NULL if no kind has that name
+const PrefetcherKind *findPrefetcher(const char *name);
+void listPrefetchers(void);
+
+Prefetcher *newPrefetcher(const PrefetcherKind *kind, int degree, int distance, Arena *arena);
+
+#endif
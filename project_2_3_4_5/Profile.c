@@ -0,0 +1,151 @@
+#include "Core.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+/*------------------ Profile.c -----------------
+ |
+ |  Purpose: Per-PC counters and the annotated
+ |		listing / folded-stack output. A basic
+ |		block starts at the first instruction,
+ |		at every branch target and after every
+ |		branch.
+ |
+ *----------------------------------------------*/
+
+Profiler *openProfiler(const Instruction_Memory *i_mem) {
+	Profiler *prof = (Profiler *)malloc(sizeof(Profiler));
+
+	prof->i_mem = i_mem;
+	prof->entries = calloc(i_mem->capacity, sizeof(ProfileEntry));
+	return prof;
+}
+
+void freeProfiler(Profiler *prof) {
+	free(prof->entries);
+	free(prof);
+}
+
+ProfileEntry *profileEntry(Profiler *prof, Addr pc) {
+	const Instruction *instr = instructionAt(prof->i_mem, pc);
+
+	return instr ? &prof->entries[instr - prof->i_mem->instructions] : NULL;
+}
+
+// Mark block leaders; returns the number of instructions
+static size_t findBlocks(const Instruction_Memory *i_mem, bool *leader) {
+	const Instruction *last = i_mem->last;
+	size_t n = last ? (size_t)(last - i_mem->instructions) + 1 : 0;
+	size_t i;
+
+	if (n > 0) {
+		leader[0] = true;
+	}
+	for (i=0; i<n; i++) {
+		const Instruction *instr = &i_mem->instructions[i];
+		unsigned int word = instr->size == 2 ? expandCompressed(instr->instruction) : instr->instruction;
+
+		if ((word & 0x7f) != 99) {
+			continue;
+		}
+		if (i + 1 < n) {
+			leader[i + 1] = true;
+		}
+		const Instruction *target = instructionAt(i_mem, instr->addr + ShiftLeft1(ImmeGen(word)));
+		if (target) {
+			leader[target - i_mem->instructions] = true;
+		}
+	}
+	return n;
+}
+
+typedef struct BlockSummary
+{
+	size_t first;      // index of the leader
+	uint64_t executions;
+	uint64_t cycles;
+}BlockSummary;
+
+static int byCycles(const void *a, const void *b) {
+	const BlockSummary *x = a, *y = b;
+
+	return x->cycles < y->cycles ? 1 : x->cycles > y->cycles ? -1 : 0;
+}
+
+bool writeProfile(Profiler *prof, const char *prefix, const char *trace, Tick cycles) {
+	const Instruction_Memory *i_mem = prof->i_mem;
+	char path[1024];
+	bool *leader = calloc(i_mem->capacity, sizeof(bool));
+	BlockSummary *blocks = calloc(i_mem->capacity, sizeof(BlockSummary));
+	size_t n = findBlocks(i_mem, leader);
+	size_t num_blocks = 0;
+	size_t i, b;
+	uint64_t executed = 0;
+	FILE *ann, *folded;
+
+	snprintf(path, sizeof(path), "%s.annotated", prefix);
+	ann = fopen(path, "w");
+	snprintf(path, sizeof(path), "%s.folded", prefix);
+	folded = fopen(path, "w");
+	if (ann == NULL || folded == NULL) {
+		perror("Cannot open profile output");
+		if (ann) {
+			fclose(ann);
+		}
+		if (folded) {
+			fclose(folded);
+		}
+		free(leader);
+		free(blocks);
+		return false;
+	}
+
+	// Blocks execute as often as their leader
+	for (i=0; i<n; i++) {
+		if (leader[i]) {
+			blocks[num_blocks].first = i;
+			blocks[num_blocks].executions = prof->entries[i].executions;
+			num_blocks++;
+		}
+		blocks[num_blocks - 1].cycles += prof->entries[i].cycles;
+		executed += prof->entries[i].executions;
+	}
+
+	fprintf(ann, "# Profile of %s: %" PRIu64 " cycles, %" PRIu64 " instructions executed\n", trace, cycles, executed);
+	fprintf(ann, "# cycles: charged to the oldest instruction in flight; stalls: cycles waiting in EXEC;\n");
+	fprintf(ann, "# bubbles: stall cycles caused as a late producer; fwds: operands forwarded to it;\n");
+	fprintf(ann, "# misses: fetch-block misses\n#\n");
+	fprintf(ann, "%6s %6s %10s %10s %6s %8s %8s %8s %8s  %s\n",
+		"line", "pc", "execs", "cycles", "cyc%", "stalls", "bubbles", "fwds", "misses", "source");
+	for (i=0, b=0; i<n; i++) {
+		const Instruction *instr = &i_mem->instructions[i];
+		const ProfileEntry *e = &prof->entries[i];
+
+		if (leader[i]) {
+			const BlockSummary *blk = &blocks[b++];
+			fprintf(ann, "---- block at line %d: executed %" PRIu64 " times, %" PRIu64 " cycles\n",
+				instr->line, blk->executions, blk->cycles);
+		}
+		fprintf(ann, "%6d %6" PRIu64 " %10" PRIu64 " %10" PRIu64 " %5.1f%% %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRIu64 "  %s\n",
+			instr->line, instr->addr, e->executions, e->cycles, cycles ? 100.0 * e->cycles / cycles : 0.0,
+			e->stalls, e->bubbles, e->forwards, e->misses, instr->text);
+		if (e->cycles) {
+			fprintf(folded, "%s;block@%d;%d %s %" PRIu64 "\n",
+				trace, i_mem->instructions[blocks[b - 1].first].line, instr->line, instr->text, e->cycles);
+		}
+	}
+
+	qsort(blocks, num_blocks, sizeof(BlockSummary), byCycles);
+	fprintf(ann, "#\n# Hottest blocks\n");
+	for (b=0; b<num_blocks && b<5 && blocks[b].cycles; b++) {
+		const Instruction *first = &i_mem->instructions[blocks[b].first];
+		fprintf(ann, "#   line %d: %" PRIu64 " cycles (%.1f%%), executed %" PRIu64 " times\n",
+			first->line, blocks[b].cycles, cycles ? 100.0 * blocks[b].cycles / cycles : 0.0, blocks[b].executions);
+	}
+
+	fclose(ann);
+	fclose(folded);
+	free(leader);
+	free(blocks);
+	return true;
+}
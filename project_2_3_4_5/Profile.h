@@ -0,0 +1,48 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+
+#include "Instruction_Memory.h"
+
+/*------------------ Profile.h -----------------
+ |
+ |  Per-PC execution profile. Every static
+ |  instruction gets a set of counters; cycles
+ |  are charged to the oldest instruction in the
+ |  pipeline (the ROB head on the OoO core), so
+ |  an instruction that holds up retirement is
+ |  the one that pays for it. Basic blocks are
+ |  found from the program when the profile is
+ |  written.
+ |
+ *----------------------------------------------*/
+
+typedef struct ProfileEntry
+{
+	uint64_t executions;
+	uint64_t cycles;     // cycles as the oldest instruction in flight
+	uint64_t stalls;     // cycles it waited in EXEC
+	uint64_t bubbles;    // stall cycles it caused by producing late
+	uint64_t forwards;   // operands it received through forwarding
+	uint64_t misses;     // fetch-block misses it triggered
+}ProfileEntry;
+
+typedef struct Profiler
+{
+	const Instruction_Memory *i_mem;
+	ProfileEntry *entries;  // by instruction index
+}Profiler;
+
+Profiler *openProfiler(const Instruction_Memory *i_mem);
+void freeProfiler(Profiler *prof);
+
+// Counters of the instruction at pc, NULL if there is none
+ProfileEntry *profileEntry(Profiler *prof, Addr pc);
+
+// PREFIX.annotated: the trace listing with counters and basic blocks
+// PREFIX.folded: folded stacks (trace;block;instruction cycles) for
+// flamegraph.pl and compatible viewers
+bool writeProfile(Profiler *prof, const char *prefix, const char *trace, Tick cycles);
+
+#endif
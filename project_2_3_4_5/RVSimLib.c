@@ -0,0 +1,310 @@
+#include "rvsim.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Core.h"
+#include "Parser.h"
+#include "Pipeline.h"
+#include "State.h"
+
+/*------------------ RVSimLib.c ----------------
+ |
+ |  Purpose: The librvsim API (rvsim.h) over a
+ |		Core whose run loop stops at a cycle
+ |		limit or a breakpoint and resumes.
+ |
+ *----------------------------------------------*/
+
+struct RVSim
+{
+	Instruction_Memory i_mem;
+	bool loaded;                 // i_mem holds a program
+	Arena arena;                 // the Core and its allocations
+	Core *core;                  // NULL until a program is loaded
+	const PipelineVariant *pipeline;
+	bool started;                // a cycle has run since the load or reset
+	bool finished;
+
+	// Taken at the first step; reset returns to it
+	Register initial_regs[32];
+	Addr initial_pc;
+	VectorState initial_vec;
+
+	char error[256];
+};
+
+static bool fail(RVSim *sim, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(sim->error, sizeof(sim->error), fmt, ap);
+	va_end(ap);
+	return false;
+}
+
+static bool needProgram(RVSim *sim) {
+	if (sim->core == NULL) {
+		return fail(sim, "no program loaded");
+	}
+	return true;
+}
+
+static void dropProgram(RVSim *sim) {
+	if (sim->core) {
+		releaseState(sim->core);
+		arenaFree(&sim->arena);
+		sim->core = NULL;
+	}
+	if (sim->loaded) {
+		freeInstructions(&sim->i_mem);
+		sim->loaded = false;
+	}
+}
+
+RVSim *rvsimCreate(void) {
+	RVSim *sim = calloc(1, sizeof(RVSim));
+
+	if (sim) {
+		sim->pipeline = findPipeline(5);
+	}
+	return sim;
+}
+
+void rvsimDestroy(RVSim *sim) {
+	if (sim) {
+		dropProgram(sim);
+		free(sim);
+	}
+}
+
+static bool loadText(RVSim *sim, const char *text, size_t len) {
+	dropProgram(sim);
+	loadInstructionsText(&sim->i_mem, text, len);
+	sim->loaded = true;
+
+	// A fresh core each program: the fetch buffer is sized to the image
+	arenaInit(&sim->arena);
+	sim->core = initCore(&sim->i_mem, &sim->arena);
+	sim->core->pipeline = sim->pipeline;
+	sim->core->quiet = true;
+	sim->started = false;
+	sim->finished = false;
+	return true;
+}
+
+bool rvsimLoadProgram(RVSim *sim, const char *text) {
+	return loadText(sim, text, strlen(text));
+}
+
+bool rvsimLoadTrace(RVSim *sim, const char *path) {
+	size_t len = 0;
+	char *text = readTrace(path, &len);
+
+	if (text == NULL) {
+		return fail(sim, "cannot read trace %s", path);
+	}
+	loadText(sim, text, len);
+	free(text);
+	return true;
+}
+
+static bool beforeRun(RVSim *sim) {
+	if (!needProgram(sim)) {
+		return false;
+	}
+	if (sim->started) {
+		return fail(sim, "state files apply before the first step; reset first");
+	}
+	return true;
+}
+
+bool rvsimLoadState(RVSim *sim, const char *path) {
+	if (!beforeRun(sim)) {
+		return false;
+	}
+	if (!loadState(sim->core, path, sim->error, sizeof(sim->error))) {
+		return false;
+	}
+	return true;
+}
+
+bool rvsimLoadStateText(RVSim *sim, const char *text) {
+	if (!beforeRun(sim)) {
+		return false;
+	}
+	if (!loadStateText(sim->core, text, "state", sim->error, sizeof(sim->error))) {
+		return false;
+	}
+	return true;
+}
+
+bool rvsimSetConfig(RVSim *sim, const char *name) {
+	const PipelineVariant *pipeline = findConfig(name);
+
+	if (pipeline == NULL) {
+		return fail(sim, "unknown pipeline configuration %s", name);
+	}
+	sim->pipeline = pipeline;
+	if (sim->core && !sim->started) {
+		sim->core->pipeline = pipeline;
+	}
+	return true;
+}
+
+bool rvsimReset(RVSim *sim) {
+	Core *core = sim->core;
+
+	if (!needProgram(sim)) {
+		return false;
+	}
+	if (sim->started) {
+		memcpy(core->reg_file, sim->initial_regs, sizeof(sim->initial_regs));
+		core->PC = sim->initial_pc;
+		core->vec = sim->initial_vec;
+		// Only the lines the run wrote need to go back
+		checkpointRestore(&core->initial, core->data_mem);
+	}
+	restartCore(core);
+	core->pipeline = sim->pipeline;
+	sim->started = false;
+	sim->finished = false;
+	return true;
+}
+
+// Run to the cycle limit; the breakpoint, if any, is set by the caller
+static void run(RVSim *sim, Tick until) {
+	Core *core = sim->core;
+
+	if (!sim->started) {
+		memcpy(sim->initial_regs, core->reg_file, sizeof(sim->initial_regs));
+		sim->initial_pc = core->PC;
+		sim->initial_vec = core->vec;
+		sim->started = true;
+	}
+	if (!sim->finished && !core->run(core, until)) {
+		sim->finished = true;
+	}
+}
+
+// until = clk + cycles, saturating
+static Tick after(const Core *core, uint64_t cycles) {
+	return cycles > TICK_FOREVER - core->clk ? TICK_FOREVER : core->clk + cycles;
+}
+
+uint64_t rvsimStep(RVSim *sim, uint64_t cycles) {
+	Tick start;
+
+	if (!needProgram(sim)) {
+		return 0;
+	}
+	start = sim->core->clk;
+	run(sim, after(sim->core, cycles));
+	return sim->core->clk - start;
+}
+
+bool rvsimRunUntilPC(RVSim *sim, uint64_t pc, uint64_t max_cycles) {
+	Core *core = sim->core;
+	bool hit;
+
+	if (!needProgram(sim)) {
+		return false;
+	}
+	core->break_pc = pc;
+	core->break_hit = false;
+	run(sim, after(core, max_cycles));
+	hit = core->break_hit;
+	core->break_pc = NO_BREAK;
+	core->break_hit = false;
+	return hit;
+}
+
+bool rvsimRunUntilCycle(RVSim *sim, uint64_t cycle) {
+	if (!needProgram(sim)) {
+		return false;
+	}
+	run(sim, cycle);
+	return sim->core->clk >= cycle;
+}
+
+bool rvsimFinished(const RVSim *sim) {
+	return sim->core == NULL || sim->finished;
+}
+
+uint64_t rvsimCycles(const RVSim *sim) {
+	return sim->core ? sim->core->clk : 0;
+}
+
+uint64_t rvsimRetired(const RVSim *sim) {
+	return sim->core ? sim->core->retired : 0;
+}
+
+uint64_t rvsimPC(const RVSim *sim) {
+	return sim->core ? sim->core->PC : 0;
+}
+
+int64_t rvsimReadReg(const RVSim *sim, int reg) {
+	if (sim->core == NULL || reg < 0 || reg > 31) {
+		return 0;
+	}
+	return sim->core->reg_file[reg];
+}
+
+bool rvsimWriteReg(RVSim *sim, int reg, int64_t value) {
+	if (!needProgram(sim)) {
+		return false;
+	}
+	if (reg < 0 || reg > 31) {
+		return fail(sim, "registers are x0-x31");
+	}
+	if (reg != 0) {
+		sim->core->reg_file[reg] = value;
+	}
+	return true;
+}
+
+size_t rvsimMemSize(const RVSim *sim) {
+	return sim->core ? sim->core->mem_size : 0;
+}
+
+static bool inMemory(const Core *core, uint64_t addr, size_t len) {
+	return addr <= core->mem_size && len <= core->mem_size - addr;
+}
+
+bool rvsimReadMem(const RVSim *sim, uint64_t addr, void *buf, size_t len) {
+	if (sim->core == NULL || !inMemory(sim->core, addr, len)) {
+		return false;
+	}
+	memcpy(buf, sim->core->data_mem + addr, len);
+	return true;
+}
+
+bool rvsimWriteMem(RVSim *sim, uint64_t addr, const void *buf, size_t len) {
+	Core *core = sim->core;
+
+	if (!needProgram(sim)) {
+		return false;
+	}
+	if (!inMemory(core, addr, len)) {
+		return fail(sim, "%zu bytes at %lu are outside the %zu-byte data memory",
+			len, (unsigned long)addr, core->mem_size);
+	}
+	if (len == 0) {
+		return true;
+	}
+	// Before the first step this is initial state, like a state file;
+	// after it, a write that reset undoes
+	if (sim->started) {
+		memWrite(core, addr, len);
+	} else {
+		dirtyMark(&core->loaded, addr, len);
+	}
+	memcpy(core->data_mem + addr, buf, len);
+	return true;
+}
+
+const char *rvsimError(const RVSim *sim) {
+	return sim->error;
+}
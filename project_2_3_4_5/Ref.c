@@ -0,0 +1,262 @@
+#include "Ref.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Fetch.h"
+
+/*------------------ Ref.c ---------------------
+ |
+ |  Purpose: Reference RV64IM interpreter,
+ |		written from the ISA manual rather
+ |		than from Core.c.
+ |
+ *----------------------------------------------*/
+
+bool initRef(RefModel *ref, const Instruction_Memory *i_mem, const int64_t regs[32], Addr pc,
+	const uint8_t *mem, size_t mem_size) {
+	memset(ref, 0, sizeof(*ref));
+	ref->mem = malloc(mem_size ? mem_size : 1);
+	if (ref->mem == NULL) {
+		return false;
+	}
+	memcpy(ref->mem, mem, mem_size);
+	memcpy(ref->x, regs, sizeof(ref->x));
+	ref->x[0] = 0;
+	ref->pc = pc;
+	ref->mem_size = mem_size;
+	ref->i_mem = i_mem;
+	return true;
+}
+
+void freeRef(RefModel *ref) {
+	free(ref->mem);
+	ref->mem = NULL;
+}
+
+static int64_t sext(uint64_t value, int bits) {
+	return (int64_t)(value << (64 - bits)) >> (64 - bits);
+}
+
+// Signed immediates of each format
+static int64_t immI(uint32_t in) {
+	return sext(in >> 20, 12);
+}
+
+static int64_t immS(uint32_t in) {
+	return sext(((in >> 25) << 5) | ((in >> 7) & 0x1f), 12);
+}
+
+static int64_t immB(uint32_t in) {
+	return sext((((in >> 31) & 1) << 12) | (((in >> 7) & 1) << 11)
+		| (((in >> 25) & 0x3f) << 5) | (((in >> 8) & 0xf) << 1), 13);
+}
+
+static int64_t immJ(uint32_t in) {
+	return sext((((in >> 31) & 1) << 20) | (((in >> 12) & 0xff) << 12)
+		| (((in >> 20) & 1) << 11) | (((in >> 21) & 0x3ff) << 1), 21);
+}
+
+// RV64M; the results for division by zero and overflow are the ISA's
+static bool mulDiv(unsigned funct3, bool word, int64_t a, int64_t b, int64_t *out) {
+	uint64_t ua = a, ub = b;
+
+	if (word) {
+		int32_t wa = a, wb = b;
+		uint32_t uwa = a, uwb = b;
+		switch (funct3) {
+			case 0: *out = (int32_t)(uwa * uwb); return true;
+			case 4: *out = wb == 0 ? -1 : (wa == INT32_MIN && wb == -1) ? INT32_MIN : wa / wb; return true;
+			case 5: *out = (int32_t)(uwb == 0 ? UINT32_MAX : uwa / uwb); return true;
+			case 6: *out = wb == 0 ? wa : (wa == INT32_MIN && wb == -1) ? 0 : wa % wb; return true;
+			case 7: *out = (int32_t)(uwb == 0 ? uwa : uwa % uwb); return true;
+		}
+		return false;
+	}
+	switch (funct3) {
+		case 0: *out = (int64_t)(ua * ub); return true;
+		case 1: *out = (int64_t)(((__int128)a * b) >> 64); return true;
+		case 2: *out = (int64_t)(((__int128)a * (unsigned __int128)ub) >> 64); return true;
+		case 3: *out = (int64_t)(((unsigned __int128)ua * ub) >> 64); return true;
+		case 4: *out = b == 0 ? -1 : (a == INT64_MIN && b == -1) ? INT64_MIN : a / b; return true;
+		case 5: *out = ub == 0 ? -1 : (int64_t)(ua / ub); return true;
+		case 6: *out = b == 0 ? a : (a == INT64_MIN && b == -1) ? 0 : a % b; return true;
+		case 7: *out = ub == 0 ? a : (int64_t)(ua % ub); return true;
+	}
+	return false;
+}
+
+// OP and OP-IMM; b is rs2 or the immediate
+static bool aluOp(unsigned funct3, unsigned funct7, bool imm, int64_t a, int64_t b, int64_t *out) {
+	unsigned shamt = b & 63;
+
+	switch (funct3) {
+		case 0: *out = (!imm && funct7 == 0x20) ? (int64_t)((uint64_t)a - b) : (int64_t)((uint64_t)a + b);
+			return imm || funct7 == 0 || funct7 == 0x20;
+		case 1: *out = (uint64_t)a << shamt; return imm ? (funct7 >> 1) == 0 : funct7 == 0;
+		case 2: *out = a < b; return imm || funct7 == 0;
+		case 3: *out = (uint64_t)a < (uint64_t)b; return imm || funct7 == 0;
+		case 4: *out = a ^ b; return imm || funct7 == 0;
+		case 5:
+			// The top funct6 bit picks arithmetic; for RV64 immediates
+			// bit 25 is shamt[5]
+			if ((funct7 >> 1) == 0x10) {
+				*out = a >> shamt;
+			} else {
+				*out = (uint64_t)a >> shamt;
+			}
+			return imm ? (funct7 >> 1) == 0 || (funct7 >> 1) == 0x10 : funct7 == 0 || funct7 == 0x20;
+		case 6: *out = a | b; return imm || funct7 == 0;
+		case 7: *out = a & b; return imm || funct7 == 0;
+	}
+	return false;
+}
+
+// OP-32 and OP-IMM-32
+static bool aluOpWord(unsigned funct3, unsigned funct7, bool imm, int64_t a, int64_t b, int64_t *out) {
+	unsigned shamt = b & 31;
+	uint32_t ua = a;
+
+	switch (funct3) {
+		case 0: *out = (int32_t)((!imm && funct7 == 0x20) ? ua - (uint32_t)b : ua + (uint32_t)b);
+			return imm || funct7 == 0 || funct7 == 0x20;
+		case 1: *out = (int32_t)(ua << shamt); return funct7 == 0;
+		case 5:
+			*out = funct7 == 0x20 ? (int32_t)ua >> shamt : (int32_t)(ua >> shamt);
+			return funct7 == 0 || funct7 == 0x20;
+	}
+	return false;
+}
+
+static bool branchTaken(unsigned funct3, int64_t a, int64_t b, bool *taken) {
+	switch (funct3) {
+		case 0: *taken = a == b; return true;
+		case 1: *taken = a != b; return true;
+		case 4: *taken = a < b; return true;
+		case 5: *taken = a >= b; return true;
+		case 6: *taken = (uint64_t)a < (uint64_t)b; return true;
+		case 7: *taken = (uint64_t)a >= (uint64_t)b; return true;
+	}
+	return false;
+}
+
+static bool inMemory(const RefModel *ref, uint64_t addr, unsigned len) {
+	return addr <= ref->mem_size && len <= ref->mem_size - addr;
+}
+
+RefStatus refStep(RefModel *ref, RefEffect *eff) {
+	const Instruction_Memory *i_mem = ref->i_mem;
+	const Instruction *last = __atomic_load_n(&i_mem->last, __ATOMIC_ACQUIRE);
+	Addr pc = ref->pc;
+	uint32_t in;
+	unsigned size;
+
+	if (last == NULL || pc > last->addr || pc + 4 > i_mem->image_size) {
+		return REF_END;
+	}
+	in = i_mem->image[pc] | (i_mem->image[pc + 1] << 8);
+	if ((in & 3) != 3) {
+		size = 2;
+		in = expandCompressed(in);
+	} else {
+		size = 4;
+		in |= (uint32_t)(i_mem->image[pc + 2] | (i_mem->image[pc + 3] << 8)) << 16;
+	}
+
+	unsigned opcode = in & 0x7f;
+	unsigned rd = (in >> 7) & 0x1f;
+	unsigned funct3 = (in >> 12) & 7;
+	unsigned funct7 = in >> 25;
+	int64_t a = ref->x[(in >> 15) & 0x1f];
+	int64_t b = ref->x[(in >> 20) & 0x1f];
+	int64_t result = 0;
+	Addr next = pc + size;
+	bool writes = true, ok = true, taken;
+	uint64_t addr;
+	unsigned len;
+
+	memset(eff, 0, sizeof(*eff));
+	eff->pc = pc;
+	eff->instruction = in;
+	eff->size = size;
+	eff->rd = -1;
+
+	switch (opcode) {
+		case 0x33: // OP
+			ok = funct7 == 1 ? mulDiv(funct3, false, a, b, &result) : aluOp(funct3, funct7, false, a, b, &result);
+			break;
+		case 0x3b: // OP-32
+			ok = funct7 == 1 ? mulDiv(funct3, true, a, b, &result) : aluOpWord(funct3, funct7, false, a, b, &result);
+			break;
+		case 0x13: // OP-IMM
+			ok = aluOp(funct3, funct7, true, a, immI(in), &result);
+			break;
+		case 0x1b: // OP-IMM-32
+			ok = aluOpWord(funct3, funct3 == 0 ? 0 : funct7, true, a, immI(in), &result);
+			break;
+		case 0x37: // LUI
+			result = sext(in & 0xfffff000, 32);
+			break;
+		case 0x17: // AUIPC
+			result = pc + sext(in & 0xfffff000, 32);
+			break;
+		case 0x6f: // JAL
+			result = pc + size;
+			next = pc + immJ(in);
+			break;
+		case 0x67: // JALR
+			result = pc + size;
+			next = (a + immI(in)) & ~(Addr)1;
+			ok = funct3 == 0;
+			break;
+		case 0x63: // BRANCH
+			writes = false;
+			ok = branchTaken(funct3, a, b, &taken);
+			if (ok && taken) {
+				next = pc + immB(in);
+			}
+			break;
+		case 0x03: // LOAD
+			len = 1u << (funct3 & 3);
+			addr = a + immI(in);
+			if (funct3 == 7) {
+				return REF_UNSUPPORTED;
+			}
+			if (!inMemory(ref, addr, len)) {
+				return REF_BAD_ADDRESS;
+			}
+			uint64_t raw = 0;
+			memcpy(&raw, ref->mem + addr, len);  // little-endian host
+			result = (funct3 & 4) || len == 8 ? (int64_t)raw : sext(raw, 8 * len);
+			break;
+		case 0x23: // STORE
+			writes = false;
+			if (funct3 > 3) {
+				return REF_UNSUPPORTED;
+			}
+			len = 1u << funct3;
+			addr = a + immS(in);
+			if (!inMemory(ref, addr, len)) {
+				return REF_BAD_ADDRESS;
+			}
+			memcpy(ref->mem + addr, &b, len);
+			eff->store = true;
+			eff->store_addr = addr;
+			eff->store_len = len;
+			eff->store_data = len == 8 ? (uint64_t)b : (uint64_t)b & ((1ull << (8 * len)) - 1);
+			break;
+		default:
+			return REF_UNSUPPORTED;
+	}
+	if (!ok) {
+		return REF_UNSUPPORTED;
+	}
+	if (writes && rd != 0) {
+		ref->x[rd] = result;
+		eff->rd = rd;
+		eff->rd_val = result;
+	}
+	ref->pc = next;
+	ref->steps++;
+	return REF_OK;
+}
@@ -0,0 +1,64 @@
+#ifndef __REF_H__
+#define __REF_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Instruction_Memory.h"
+
+/*------------------ Ref.h ---------------------
+ |
+ |  Reference ISA model: a plain interpreter of
+ |  RV64IM (and RVC, through the same expansion
+ |  fetch uses), one instruction per step, with
+ |  its own registers and its own copy of the
+ |  data memory. It shares no decode, ALU or
+ |  memory code with the pipeline, so it is the
+ |  yardstick the pipeline is checked against.
+ |
+ |  Vector instructions are not modelled; a step
+ |  that meets one returns REF_UNSUPPORTED.
+ |
+ *----------------------------------------------*/
+
+typedef enum RefStatus
+{
+	REF_OK,
+	REF_END,           // no instruction at pc
+	REF_UNSUPPORTED,   // not an RV64IM instruction
+	REF_BAD_ADDRESS    // load or store outside the data memory
+}RefStatus;
+
+typedef struct RefModel
+{
+	int64_t x[32];
+	Addr pc;
+	uint8_t *mem;      // private copy
+	size_t mem_size;
+	const Instruction_Memory *i_mem;
+	uint64_t steps;
+}RefModel;
+
+// What one step did
+typedef struct RefEffect
+{
+	Addr pc;
+	uint32_t instruction;  // expanded to 32 bits
+	unsigned size;         // 2 or 4 bytes
+	int rd;                // register written, -1 if none (or x0)
+	int64_t rd_val;
+	bool store;
+	Addr store_addr;
+	unsigned store_len;
+	uint64_t store_data;   // the low store_len bytes
+}RefEffect;
+
+// Starts from a copy of regs, pc and mem; false if out of memory
+bool initRef(RefModel *ref, const Instruction_Memory *i_mem, const int64_t regs[32], Addr pc,
+	const uint8_t *mem, size_t mem_size);
+void freeRef(RefModel *ref);
+
+RefStatus refStep(RefModel *ref, RefEffect *eff);
+
+#endif
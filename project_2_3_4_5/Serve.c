@@ -0,0 +1,666 @@
+#include "Serve.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Core.h"
+#include "Parser.h"
+#include "Pipeline.h"
+#include "State.h"
+
+/*------------------ Serve.c -------------------
+ |
+ |  Purpose: Simulation daemon: socket, worker
+ |		pool, parsed-program cache and the
+ |		small JSON reader/writer it needs.
+ |
+ *----------------------------------------------*/
+
+#define MAX_WORKERS 64
+
+typedef struct Request
+{
+	const char *program;
+	const char *program_id;
+	const char *trace;
+	const char *init;
+	const char *init_file;
+	const char *config;
+	const char *fuse;
+	long long stages;
+	long long extrapolate;
+	long long max_cycles;
+	bool stats;
+}Request;
+
+typedef struct CachedProgram
+{
+	uint64_t id;               // FNV-1a of the text
+	char *text;
+	size_t len;
+	Instruction_Memory i_mem;  // read-only once parsed
+	int refs;                  // jobs using it; never evicted while > 0
+	uint64_t last_used;
+	struct CachedProgram *next;
+}CachedProgram;
+
+typedef struct ProgramCache
+{
+	pthread_mutex_t lock;
+	CachedProgram *programs;
+	int count;
+	int capacity;
+	uint64_t clock;
+	uint64_t hits, misses, evictions;
+}ProgramCache;
+
+typedef struct Server
+{
+	ProgramCache cache;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	int queue[SERVE_QUEUE];    // accepted connections
+	int head, queued;
+	int active[MAX_WORKERS];   // connection each worker serves, or -1
+	bool stopping;
+	uint64_t jobs;
+}Server;
+
+typedef struct Worker
+{
+	Server *srv;
+	int index;
+	pthread_t thread;
+}Worker;
+
+static volatile sig_atomic_t stop_requested;
+
+static void onSignal(int sig) {
+	(void)sig;
+	stop_requested = 1;
+}
+
+/* JSON: one flat object per request. Strings are decoded in place, so
+ * the request fields point into the line that was read. */
+
+static char *jsonString(char **pos, const char **error) {
+	char *s = *pos, *start, *out;
+
+	if (*s != '"') {
+		*error = "expected a string";
+		return NULL;
+	}
+	start = out = ++s;
+	while (*s != '"') {
+		if (*s == '\0') {
+			*error = "unterminated string";
+			return NULL;
+		}
+		if (*s != '\\') {
+			*out++ = *s++;
+			continue;
+		}
+		s++;
+		switch (*s++) {
+			case '"': *out++ = '"'; break;
+			case '\\': *out++ = '\\'; break;
+			case '/': *out++ = '/'; break;
+			case 'b': *out++ = '\b'; break;
+			case 'f': *out++ = '\f'; break;
+			case 'n': *out++ = '\n'; break;
+			case 'r': *out++ = '\r'; break;
+			case 't': *out++ = '\t'; break;
+			case 'u': {
+				char hex[5];
+				unsigned c;
+				int i;
+				for (i=0; i<4; i++) {
+					if (!isxdigit((unsigned char)s[i])) {
+						*error = "bad \\u escape";
+						return NULL;
+					}
+					hex[i] = s[i];
+				}
+				hex[4] = '\0';
+				s += 4;
+				c = strtoul(hex, NULL, 16);
+				// UTF-8, never longer than the six characters it replaces
+				if (c < 0x80) {
+					*out++ = c;
+				} else if (c < 0x800) {
+					*out++ = 0xc0 | (c >> 6);
+					*out++ = 0x80 | (c & 0x3f);
+				} else {
+					*out++ = 0xe0 | (c >> 12);
+					*out++ = 0x80 | ((c >> 6) & 0x3f);
+					*out++ = 0x80 | (c & 0x3f);
+				}
+				break;
+			}
+			default:
+				*error = "bad escape in string";
+				return NULL;
+		}
+	}
+	*out = '\0';
+	*pos = s + 1;
+	return start;
+}
+
+static void skipBlanks(char **pos) {
+	while (isspace((unsigned char)**pos)) {
+		(*pos)++;
+	}
+}
+
+static bool parseRequest(char *line, Request *rq, const char **error) {
+	char *p = line;
+
+	memset(rq, 0, sizeof(*rq));
+	skipBlanks(&p);
+	if (*p++ != '{') {
+		*error = "a request is one JSON object per line";
+		return false;
+	}
+	skipBlanks(&p);
+	if (*p == '}') {
+		return true;
+	}
+	for (;;) {
+		char *key, *str = NULL;
+		long long num = 0;
+
+		skipBlanks(&p);
+		if ((key = jsonString(&p, error)) == NULL) {
+			return false;
+		}
+		skipBlanks(&p);
+		if (*p++ != ':') {
+			*error = "expected ':'";
+			return false;
+		}
+		skipBlanks(&p);
+		if (*p == '"') {
+			if ((str = jsonString(&p, error)) == NULL) {
+				return false;
+			}
+		} else if (strncmp(p, "true", 4) == 0) {
+			num = 1;
+			p += 4;
+		} else if (strncmp(p, "false", 5) == 0) {
+			p += 5;
+		} else if (strncmp(p, "null", 4) == 0) {
+			p += 4;
+		} else if (*p == '-' || isdigit((unsigned char)*p)) {
+			num = strtoll(p, &p, 10);
+		} else {
+			*error = "values must be strings, integers or booleans";
+			return false;
+		}
+
+		if (strcmp(key, "program") == 0) rq->program = str;
+		else if (strcmp(key, "program_id") == 0) rq->program_id = str;
+		else if (strcmp(key, "trace") == 0) rq->trace = str;
+		else if (strcmp(key, "init") == 0) rq->init = str;
+		else if (strcmp(key, "init_file") == 0) rq->init_file = str;
+		else if (strcmp(key, "config") == 0) rq->config = str;
+		else if (strcmp(key, "fuse") == 0) rq->fuse = str;
+		else if (strcmp(key, "stages") == 0) rq->stages = num;
+		else if (strcmp(key, "extrapolate") == 0) rq->extrapolate = num;
+		else if (strcmp(key, "max_cycles") == 0) rq->max_cycles = num;
+		else if (strcmp(key, "stats") == 0) rq->stats = num != 0;
+		else {
+			*error = "unknown request field";
+			return false;
+		}
+
+		skipBlanks(&p);
+		if (*p == '}') {
+			return true;
+		}
+		if (*p++ != ',') {
+			*error = "expected ',' or '}'";
+			return false;
+		}
+	}
+}
+
+static void jsonPutString(FILE *out, const char *s) {
+	fputc('"', out);
+	for (; *s; s++) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\') {
+			fprintf(out, "\\%c", c);
+		} else if (c == '\n') {
+			fputs("\\n", out);
+		} else if (c < 0x20) {
+			fprintf(out, "\\u%04x", c);
+		} else {
+			fputc(c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+static void replyError(FILE *out, const char *error) {
+	fputs("{\"ok\":false,\"error\":", out);
+	jsonPutString(out, error);
+	fputs("}\n", out);
+}
+
+/* Parsed programs, shared by the workers */
+
+static uint64_t hashText(const char *text, size_t len) {
+	uint64_t hash = 14695981039346656037ull;
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		hash = (hash ^ (uint8_t)text[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static void freeProgram(CachedProgram *prog) {
+	freeInstructions(&prog->i_mem);
+	free(prog->text);
+	free(prog);
+}
+
+// Caller holds the lock
+static CachedProgram *findProgram(ProgramCache *cache, uint64_t id, const char *text, size_t len) {
+	CachedProgram *prog;
+
+	for (prog = cache->programs; prog; prog = prog->next) {
+		if (prog->id == id && (text == NULL || (prog->len == len && memcmp(prog->text, text, len) == 0))) {
+			prog->refs++;
+			prog->last_used = ++cache->clock;
+			return prog;
+		}
+	}
+	return NULL;
+}
+
+// Drop least recently used programs no job holds; caller holds the lock
+static void evictPrograms(ProgramCache *cache) {
+	while (cache->count > cache->capacity) {
+		CachedProgram **victim = NULL, **link;
+
+		for (link = &cache->programs; *link; link = &(*link)->next) {
+			if ((*link)->refs == 0 && (victim == NULL || (*link)->last_used < (*victim)->last_used)) {
+				victim = link;
+			}
+		}
+		if (victim == NULL) {
+			return;
+		}
+		CachedProgram *prog = *victim;
+		*victim = prog->next;
+		freeProgram(prog);
+		cache->count--;
+		cache->evictions++;
+	}
+}
+
+// The program with this text (or, without text, this id), parsing it if
+// it is not cached. NULL for an unknown id.
+static CachedProgram *acquireProgram(ProgramCache *cache, const char *text, size_t len, uint64_t id, bool *cached) {
+	CachedProgram *prog, *fresh;
+
+	if (text) {
+		id = hashText(text, len);
+	}
+	pthread_mutex_lock(&cache->lock);
+	prog = findProgram(cache, id, text, len);
+	if (prog || text == NULL) {
+		cache->hits += prog != NULL;
+		pthread_mutex_unlock(&cache->lock);
+		*cached = true;
+		return prog;
+	}
+	cache->misses++;
+	pthread_mutex_unlock(&cache->lock);
+
+	// Parse without the lock so other jobs keep going
+	fresh = calloc(1, sizeof(*fresh));
+	fresh->id = id;
+	fresh->len = len;
+	fresh->text = malloc(len + 1);
+	memcpy(fresh->text, text, len);
+	fresh->text[len] = '\0';
+	loadInstructionsText(&fresh->i_mem, fresh->text, len);
+
+	pthread_mutex_lock(&cache->lock);
+	prog = findProgram(cache, id, text, len);
+	if (prog) {
+		// Another worker parsed the same text meanwhile
+		pthread_mutex_unlock(&cache->lock);
+		freeProgram(fresh);
+		*cached = true;
+		return prog;
+	}
+	fresh->refs = 1;
+	fresh->last_used = ++cache->clock;
+	fresh->next = cache->programs;
+	cache->programs = fresh;
+	cache->count++;
+	evictPrograms(cache);
+	pthread_mutex_unlock(&cache->lock);
+	*cached = false;
+	return fresh;
+}
+
+static void releaseProgram(ProgramCache *cache, CachedProgram *prog) {
+	pthread_mutex_lock(&cache->lock);
+	prog->refs--;
+	evictPrograms(cache);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/* Jobs */
+
+static void runJob(Server *srv, const Request *rq, FILE *out) {
+	const PipelineVariant *pipeline = findPipeline(5);
+	unsigned fusion = 0;
+	char *file_text = NULL;
+	const char *text = rq->program;
+	size_t len = text ? strlen(text) : 0;
+	uint64_t id = 0;
+	bool cached;
+	int i;
+
+	if (rq->config) {
+		pipeline = findConfig(rq->config);
+	} else if (rq->stages) {
+		pipeline = findPipeline(rq->stages);
+	}
+	if (pipeline == NULL) {
+		replyError(out, "unknown pipeline configuration");
+		return;
+	}
+	if (rq->fuse && !parseFusionRules(rq->fuse, &fusion)) {
+		replyError(out, "unknown fusion pair in fuse");
+		return;
+	}
+	if (rq->extrapolate != 0 && (rq->extrapolate < 2 || pipeline->predictor != PREDICT_NOT_TAKEN)) {
+		replyError(out, "extrapolate needs N >= 2 and a configuration without branch prediction");
+		return;
+	}
+
+	if (rq->trace) {
+		text = file_text = readTrace(rq->trace, &len);
+		if (text == NULL) {
+			replyError(out, "cannot read trace");
+			return;
+		}
+	} else if (text == NULL) {
+		char *end;
+		if (rq->program_id == NULL) {
+			replyError(out, "a job needs program, program_id or trace");
+			return;
+		}
+		id = strtoull(rq->program_id, &end, 16);
+		if (*end != '\0') {
+			replyError(out, "bad program_id");
+			return;
+		}
+	}
+	CachedProgram *prog = acquireProgram(&srv->cache, text, len, id, &cached);
+	free(file_text);
+	if (prog == NULL) {
+		replyError(out, "unknown program_id (evicted or never sent)");
+		return;
+	}
+
+	// Each job gets a fresh core; only the parsed program is shared
+	Arena arena;
+	arenaInit(&arena);
+	Core *core = initCore(&prog->i_mem, &arena);
+	core->pipeline = pipeline;
+	core->fusion = fusion;
+	core->loop.confirm = rq->extrapolate;
+	core->quiet = true;
+
+	char err[256];
+	if ((rq->init_file && !loadState(core, rq->init_file, err, sizeof(err)))
+			|| (rq->init && !loadStateText(core, rq->init, "init", err, sizeof(err)))) {
+		replyError(out, err);
+	} else {
+		Register initial_regs[32];
+		Addr initial_pc = core->PC;
+		char *delta = NULL;
+		size_t delta_len = 0;
+
+		memcpy(initial_regs, core->reg_file, sizeof(initial_regs));
+		bool finished = !tickCycles(core, rq->max_cycles > 0 ? (Tick)rq->max_cycles : TICK_FOREVER)
+			|| coreFinished(core);
+
+		fprintf(out, "{\"ok\":true,\"program_id\":\"%016" PRIx64 "\",\"cached\":%s,\"config\":",
+			prog->id, cached ? "true" : "false");
+		jsonPutString(out, pipeline->name);
+		fprintf(out, ",\"finished\":%s,\"cycles\":%ld,\"retired\":%" PRIu64 ",\"fused_pairs\":%" PRIu64 ",\"regs\":{",
+			finished ? "true" : "false", core->clk, core->retired, core->fused_pairs);
+		bool first = true;
+		for (i=1; i<32; i++) {
+			if (core->reg_file[i]) {
+				fprintf(out, "%s\"x%d\":%ld", first ? "" : ",", i, core->reg_file[i]);
+				first = false;
+			}
+		}
+		fputs("},\"delta\":", out);
+		FILE *ms = open_memstream(&delta, &delta_len);
+		writeDelta(core, initial_regs, initial_pc, ms);
+		fclose(ms);
+		jsonPutString(out, delta);
+		fputs("}\n", out);
+		free(delta);
+	}
+
+	releaseState(core);
+	arenaFree(&arena);
+	releaseProgram(&srv->cache, prog);
+	__atomic_add_fetch(&srv->jobs, 1, __ATOMIC_RELAXED);
+}
+
+static void replyStats(Server *srv, FILE *out) {
+	ProgramCache *cache = &srv->cache;
+
+	pthread_mutex_lock(&cache->lock);
+	fprintf(out, "{\"ok\":true,\"jobs\":%" PRIu64 ",\"programs\":%d,\"capacity\":%d,"
+		"\"hits\":%" PRIu64 ",\"misses\":%" PRIu64 ",\"evictions\":%" PRIu64 "}\n",
+		__atomic_load_n(&srv->jobs, __ATOMIC_RELAXED), cache->count, cache->capacity,
+		cache->hits, cache->misses, cache->evictions);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+// Answer requests on one connection until the client closes it
+static void serveConnection(Server *srv, int fd) {
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(dup(fd), "w");
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+
+	while (out && (len = getline(&line, &cap, in)) != -1) {
+		Request rq;
+		const char *error;
+
+		if (len > SERVE_MAX_REQUEST) {
+			replyError(out, "request too long");
+			break;
+		}
+		if (!parseRequest(line, &rq, &error)) {
+			replyError(out, error);
+		} else if (rq.stats) {
+			replyStats(srv, out);
+		} else {
+			runJob(srv, &rq, out);
+		}
+		if (fflush(out) != 0) {
+			break;
+		}
+	}
+	free(line);
+	if (out) {
+		fclose(out);
+	}
+	fclose(in);
+}
+
+static void *workerThread(void *arg) {
+	Worker *w = arg;
+	Server *srv = w->srv;
+
+	for (;;) {
+		pthread_mutex_lock(&srv->lock);
+		while (srv->queued == 0 && !srv->stopping) {
+			pthread_cond_wait(&srv->ready, &srv->lock);
+		}
+		if (srv->queued == 0) {
+			pthread_mutex_unlock(&srv->lock);
+			return NULL;
+		}
+		int fd = srv->queue[srv->head];
+		srv->head = (srv->head + 1) % SERVE_QUEUE;
+		srv->queued--;
+		srv->active[w->index] = fd;
+		pthread_mutex_unlock(&srv->lock);
+
+		serveConnection(srv, fd);
+
+		pthread_mutex_lock(&srv->lock);
+		srv->active[w->index] = -1;
+		pthread_mutex_unlock(&srv->lock);
+	}
+}
+
+static int listenOn(const char *path) {
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		printf("Socket path too long: %s\n", path);
+		return -1;
+	}
+	// Replace a socket left by an earlier run, but nothing else
+	if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(path);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVE_QUEUE) != 0) {
+		perror("Cannot listen on the socket");
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	return fd;
+}
+
+int serve(const ServeConfig *cfg) {
+	static Server srv;
+	Worker workers[MAX_WORKERS];
+	struct sigaction sa;
+	int listen_fd, i, n = cfg->workers;
+
+	if (n < 1 || n > MAX_WORKERS || cfg->cache_size < 1) {
+		printf("--workers must be between 1 and %d and --cache at least 1.\n", MAX_WORKERS);
+		return 1;
+	}
+	listen_fd = listenOn(cfg->socket_path);
+	if (listen_fd < 0) {
+		return 1;
+	}
+
+	// No SA_RESTART: a signal has to interrupt accept()
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	memset(&srv, 0, sizeof(srv));
+	pthread_mutex_init(&srv.lock, NULL);
+	pthread_cond_init(&srv.ready, NULL);
+	pthread_mutex_init(&srv.cache.lock, NULL);
+	srv.cache.capacity = cfg->cache_size;
+	for (i=0; i<n; i++) {
+		srv.active[i] = -1;
+		workers[i].srv = &srv;
+		workers[i].index = i;
+		pthread_create(&workers[i].thread, NULL, workerThread, &workers[i]);
+	}
+	printf("Serving on %s with %d workers, caching up to %d programs\n", cfg->socket_path, n, cfg->cache_size);
+	fflush(stdout);
+
+	while (!stop_requested) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror("accept");
+			break;
+		}
+		pthread_mutex_lock(&srv.lock);
+		if (srv.queued == SERVE_QUEUE) {
+			pthread_mutex_unlock(&srv.lock);
+			FILE *out = fdopen(fd, "w");
+			replyError(out, "server busy");
+			fclose(out);
+			continue;
+		}
+		srv.queue[(srv.head + srv.queued) % SERVE_QUEUE] = fd;
+		srv.queued++;
+		pthread_cond_signal(&srv.ready);
+		pthread_mutex_unlock(&srv.lock);
+	}
+
+	// Stop taking work, end the open connections once their current
+	// job is answered, and wait for the workers
+	close(listen_fd);
+	unlink(cfg->socket_path);
+	pthread_mutex_lock(&srv.lock);
+	srv.stopping = true;
+	while (srv.queued) {
+		close(srv.queue[srv.head]);
+		srv.head = (srv.head + 1) % SERVE_QUEUE;
+		srv.queued--;
+	}
+	for (i=0; i<n; i++) {
+		if (srv.active[i] >= 0) {
+			shutdown(srv.active[i], SHUT_RD);
+		}
+	}
+	pthread_cond_broadcast(&srv.ready);
+	pthread_mutex_unlock(&srv.lock);
+	for (i=0; i<n; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+
+	printf("Served %" PRIu64 " jobs; program cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " evictions\n",
+		srv.jobs, srv.cache.hits, srv.cache.misses, srv.cache.evictions);
+	while (srv.cache.programs) {
+		CachedProgram *next = srv.cache.programs->next;
+		freeProgram(srv.cache.programs);
+		srv.cache.programs = next;
+	}
+	pthread_mutex_destroy(&srv.cache.lock);
+	pthread_cond_destroy(&srv.ready);
+	pthread_mutex_destroy(&srv.lock);
+	return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef __SERVE_H__
+#define __SERVE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------ Serve.h -------------------
+ |
+ |  --serve: a long-lived simulator that takes
+ |  jobs over a Unix domain socket, so a script
+ |  firing thousands of small runs pays process
+ |  start-up and trace parsing once.
+ |
+ |  A client sends one JSON object per line and
+ |  gets one JSON object back per line:
+ |
+ |	{"program": "addi x5, x0, 1\n...",
+ |	 "init": "x5=26\nmem40=100",
+ |	 "config": "5-stage", "fuse": "all"}
+ |
+ |	{"ok":true,"program_id":"3f9c...",
+ |	 "cached":false,"cycles":9,"retired":4,
+ |	 "regs":{"x5":26,...},"delta":"..."}
+ |
+ |  Request fields: program (trace text), or
+ |  program_id (from an earlier reply) or trace
+ |  (a file path); init (text state, see State.h)
+ |  or init_file; config or stages; fuse;
+ |  extrapolate; max_cycles, after which the
+ |  reply has "finished":false. {"stats":true}
+ |  reports on the cache. "delta" is the --diff
+ |  output.
+ |
+ |  Parsed programs stay in an LRU cache keyed
+ |  by a hash of their text. Connections are
+ |  handed to a pool of worker threads; each job
+ |  gets its own arena and Core and shares only
+ |  the read-only parsed program.
+ |
+ *----------------------------------------------*/
+
+#define SERVE_MAX_REQUEST (16 << 20)  // bytes per request line
+#define SERVE_QUEUE 64                // connections waiting for a worker
+
+typedef struct ServeConfig
+{
+	const char *socket_path;
+	int workers;
+	int cache_size;      // parsed programs kept
+}ServeConfig;
+
+// Runs until SIGINT or SIGTERM; returns the process exit status
+int serve(const ServeConfig *cfg);
+
+#endif
@@ -0,0 +1,317 @@
+#include "State.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*------------------ State.c -------------------
+ |
+ |  Purpose: Load initial state from a text or
+ |		binary state file, and write binary
+ |		images.
+ |
+ *----------------------------------------------*/
+
+// Describe what is wrong with the state in err, for the caller to report
+static bool stateError(char *err, size_t err_len, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(err, err_len, fmt, ap);
+	va_end(ap);
+	return false;
+}
+
+static bool loadBinary(Core *core, const char *path, int fd, char *err, size_t err_len) {
+	StateHeader hdr;
+	struct stat st;
+	int i;
+
+	if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || fstat(fd, &st) != 0) {
+		return stateError(err, err_len, "%s: truncated state header.", path);
+	}
+	if (hdr.mem_size < 8 || (uint64_t)st.st_size < STATE_HEADER + hdr.mem_size) {
+		return stateError(err, err_len, "%s: memory size %lu does not match the file.", path,
+			(unsigned long)hdr.mem_size);
+	}
+
+	// Copy-on-write, so the run never writes to the file. If the host
+	// cannot map at this offset (larger pages), read it in instead.
+	void *mem = mmap(NULL, hdr.mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, STATE_HEADER);
+	bool mapped = mem != MAP_FAILED;
+	if (!mapped) {
+		mem = arenaAlloc(core->arena, hdr.mem_size);
+		if (pread(fd, mem, hdr.mem_size, STATE_HEADER) != (ssize_t)hdr.mem_size) {
+			return stateError(err, err_len, "%s: cannot read the memory image.", path);
+		}
+	}
+	// Drop an image mapped by an earlier --init
+	releaseState(core);
+	setDataMemory(core, mem, hdr.mem_size);
+	core->mem_mapped = mapped;
+	core->mem_image = true;
+	core->PC = hdr.pc;
+	for (i=1; i<32; i++) {
+		core->reg_file[i] = hdr.regs[i];
+	}
+	return true;
+}
+
+// Text settings write memory directly: they are part of the initial
+// state, not writes by the program
+static void setBytes(Core *core, size_t addr, const uint8_t *bytes, size_t len) {
+	memcpy(core->data_mem + addr, bytes, len);
+	dirtyMark(&core->loaded, addr, len);
+}
+
+// name<index>=value, with optional blanks around the '='. *rest points
+// past the '=' for settings whose value is a list.
+static bool setting(const char *line, const char *name, bool indexed, long long *index, long long *value, const char **rest) {
+	size_t len = strlen(name);
+	char *end;
+
+	if (strncmp(line, name, len) != 0) {
+		return false;
+	}
+	line += len;
+	if (indexed) {
+		if (!isdigit((unsigned char)*line)) {
+			return false;
+		}
+		*index = strtoll(line, &end, 0);
+		line = end;
+	}
+	while (*line == ' ' || *line == '\t') {
+		line++;
+	}
+	if (*line++ != '=') {
+		return false;
+	}
+	if (rest) {
+		*rest = line;
+		return true;
+	}
+	while (*line == ' ' || *line == '\t') {
+		line++;
+	}
+	// Unsigned unless negative, so 64-bit patterns such as satp fit
+	*value = *line == '-' ? strtoll(line, &end, 0) : (long long)strtoull(line, &end, 0);
+	while (isspace((unsigned char)*end)) {
+		end++;
+	}
+	return end != line && *end == '\0';
+}
+
+static bool loadText(Core *core, const char *path, FILE *fp, char *err, size_t err_len) {
+	char *line = NULL;
+	size_t len = 0;
+	int number = 0;
+	bool wrote_memory = false, ok = true;
+
+	while (ok && getline(&line, &len, fp) != -1) {
+		char *hash = strchr(line, '#');
+		char *p = line;
+		const char *rest;
+		long long index = 0, value = 0;
+
+		number++;
+		if (hash) {
+			*hash = '\0';
+		}
+		while (isspace((unsigned char)*p)) {
+			p++;
+		}
+		if (*p == '\0') {
+			continue;
+		}
+
+		if (setting(p, "size", false, &index, &value, NULL)) {
+			if (wrote_memory || value < 8) {
+				ok = stateError(err, err_len, "%s:%d: size must be at least 8 and come before any memory.", path, number);
+				break;
+			}
+			releaseState(core);
+			setDataMemory(core, arenaAlloc(core->arena, value), value);
+			core->mem_image = false;
+		} else if (setting(p, "pc", false, &index, &value, NULL)) {
+			core->PC = value;
+		} else if (setting(p, "satp", false, &index, &value, NULL)) {
+			core->satp = value;
+		} else if (setting(p, "x", true, &index, &value, NULL)) {
+			if (index < 1 || index > 31) {
+				ok = stateError(err, err_len, "%s:%d: registers are x1-x31.", path, number);
+				break;
+			}
+			core->reg_file[index] = value;
+		} else if (setting(p, "mem", true, &index, &value, NULL)) {
+			if (index < 0 || index + 8 > (long long)core->mem_size) {
+				ok = stateError(err, err_len, "%s:%d: address %lld is outside the %zu-byte data memory.", path, number,
+					index, core->mem_size);
+				break;
+			}
+			uint8_t bytes[8];
+			int i;
+			for (i=0; i<8; i++) {
+				bytes[i] = (uint64_t)value >> (8 * i);
+			}
+			setBytes(core, index, bytes, 8);
+			wrote_memory = true;
+		} else if (setting(p, "bytes", true, &index, NULL, &rest)) {
+			char *end;
+			for (;;) {
+				unsigned long byte = strtoul(rest, &end, 16);
+				if (end == rest) {
+					break;
+				}
+				if (byte > 0xff || index < 0 || index >= (long long)core->mem_size) {
+					ok = stateError(err, err_len, "%s:%d: bad byte or address %lld out of range.", path, number, index);
+					break;
+				}
+				uint8_t b = byte;
+				setBytes(core, index++, &b, 1);
+				rest = end;
+			}
+			wrote_memory = true;
+		} else {
+			ok = stateError(err, err_len, "%s:%d: expected size=, pc=, satp=, xN=, memA= or bytesA=, got: %.*s", path,
+				number, (int)strcspn(p, "\r\n"), p);
+		}
+	}
+	free(line);
+	return ok;
+}
+
+bool loadState(Core *core, const char *path, char *err, size_t err_len) {
+	char magic[8];
+	bool ok;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return stateError(err, err_len, "Cannot open state file %s.", path);
+	}
+	if (pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) && memcmp(magic, STATE_MAGIC, 8) == 0) {
+		ok = loadBinary(core, path, fd, err, err_len);
+		close(fd);  // a mapping stays valid after the close
+		return ok;
+	}
+
+	FILE *fp = fdopen(fd, "r");
+	ok = loadText(core, path, fp, err, err_len);
+	fclose(fp);
+	return ok;
+}
+
+bool loadStateText(Core *core, const char *text, const char *name, char *err, size_t err_len) {
+	FILE *fp = fmemopen((void *)text, strlen(text), "r");
+	bool ok;
+
+	if (fp == NULL) {
+		// Nothing to apply
+		return text[0] == '\0' || stateError(err, err_len, "%s: cannot read the state text.", name);
+	}
+	ok = loadText(core, name, fp, err, err_len);
+	fclose(fp);
+	return ok;
+}
+
+bool saveState(const Core *core, const char *path) {
+	static uint8_t header[STATE_HEADER];
+	StateHeader *hdr = (StateHeader *)header;
+	FILE *fp = fopen(path, "wb");
+	bool ok;
+	int i;
+
+	if (fp == NULL) {
+		printf("Cannot write state file %s.\n", path);
+		return false;
+	}
+	memset(header, 0, sizeof(header));
+	memcpy(hdr->magic, STATE_MAGIC, 8);
+	hdr->mem_size = core->mem_size;
+	hdr->pc = core->PC;
+	for (i=0; i<32; i++) {
+		hdr->regs[i] = core->reg_file[i];
+	}
+	ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header)
+		&& fwrite(core->data_mem, 1, core->mem_size, fp) == core->mem_size;
+	ok &= fclose(fp) == 0;
+	if (!ok) {
+		printf("Writing state file %s failed.\n", path);
+	}
+	return ok;
+}
+
+#define DELTA_RUN 32  // bytes per bytes= line
+
+void writeDelta(const Core *core, const Register *initial_regs, Addr initial_pc, FILE *fp) {
+	const MemCheckpoint *cp = &core->initial;
+	size_t line, changed = 0, run_end = 0, run_len = 0;
+	int i;
+
+	fprintf(fp, "# Changes after %ld cycles, %zu lines written in %zu pages\n",
+		core->clk, cp->map.dirty_lines, cp->map.dirty_pages);
+	if (core->PC != initial_pc) {
+		fprintf(fp, "pc=%lu\n", core->PC);
+	}
+	for (i=1; i<32; i++) {
+		if (core->reg_file[i] != initial_regs[i]) {
+			fprintf(fp, "x%d=%ld\n", i, core->reg_file[i]);
+		}
+	}
+
+	// Only written lines can differ; bytes that were written back with
+	// their old value are left out. Runs may continue into the next line.
+	for (line = dirtyNext(&cp->map, NULL, 0); line < cp->map.num_lines; line = dirtyNext(&cp->map, NULL, line + 1)) {
+		size_t addr = line << LINE_SHIFT;
+		size_t end = addr + LINE_SIZE < core->mem_size ? addr + LINE_SIZE : core->mem_size;
+		const uint8_t *old = cp->saved;
+
+		for (; addr<end; addr++) {
+			if (core->data_mem[addr] == old[addr]) {
+				continue;
+			}
+			if (run_len == 0 || addr != run_end || run_len == DELTA_RUN) {
+				fprintf(fp, "%sbytes%zu=", run_len ? "\n" : "", addr);
+				run_len = 0;
+			}
+			fprintf(fp, "%s%02x", run_len ? " " : "", core->data_mem[addr]);
+			run_end = addr + 1;
+			run_len++;
+			changed++;
+		}
+	}
+	if (run_len) {
+		fprintf(fp, "\n");
+	}
+	fprintf(fp, "# %zu bytes changed\n", changed);
+}
+
+bool saveDelta(const Core *core, const Register *initial_regs, Addr initial_pc, const char *path) {
+	FILE *fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+
+	if (fp == NULL) {
+		printf("Cannot write delta file %s.\n", path);
+		return false;
+	}
+	writeDelta(core, initial_regs, initial_pc, fp);
+	if (fp != stdout) {
+		return fclose(fp) == 0;
+	}
+	return true;
+}
+
+void releaseState(Core *core) {
+	freeCheckpoint(&core->initial);
+	freeCheckpoint(&core->loop.undo);
+	if (core->mem_mapped) {
+		munmap(core->data_mem, core->mem_size);
+		core->mem_mapped = false;
+		core->data_mem = NULL;
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef __STATE_H__
+#define __STATE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Core.h"
+
+/*------------------ State.h -------------------
+ |
+ |  Initial register and memory state, read from
+ |  a file given with --init instead of being
+ |  compiled into initCore. Two formats:
+ |
+ |  Text, one setting per line, # comments:
+ |
+ |	size=4096          data memory bytes (first)
+ |	pc=0
+ |	x5=26              register
+ |	mem40=100          doubleword at address 40
+ |	bytes64=de ad 01   hex bytes from address 64
+ |
+ |  Binary image: a STATE_HEADER-byte header
+ |  (magic, memory size, PC, registers) followed
+ |  by the whole data memory, which is mapped
+ |  copy-on-write straight into the core, so a
+ |  large data set loads with a single mmap and
+ |  is only read as the program touches it.
+ |
+ |  Several files can be given; each applies on
+ |  top of the ones before, so a delta written by
+ |  saveDelta works as an incremental checkpoint
+ |  of a large base image.
+ |
+ *----------------------------------------------*/
+
+#define STATE_MAGIC "RVSTATE1"
+#define STATE_HEADER 4096  // memory starts here, page aligned
+
+typedef struct StateHeader
+{
+	char magic[8];
+	uint64_t mem_size;
+	uint64_t pc;
+	int64_t regs[32];
+}StateHeader;
+
+// Apply the state in path to core, detecting the format. On a bad
+// file, returns false with what is wrong (file, line, reason) in err.
+bool loadState(Core *core, const char *path, char *err, size_t err_len);
+
+// Apply text-format settings held in memory; name labels errors
+bool loadStateText(Core *core, const char *text, const char *name, char *err, size_t err_len);
+
+// Write core's registers and data memory as a binary image
+bool saveState(const Core *core, const char *path);
+
+// Write what the run changed, compared with the initial registers and
+// the initial contents of every line written, as a text state file.
+// --init can apply it on top of the initial state. "-" is stdout.
+bool saveDelta(const Core *core, const Register *initial_regs, Addr initial_pc, const char *path);
+void writeDelta(const Core *core, const Register *initial_regs, Addr initial_pc, FILE *fp);
+
+// Give back what the data memory holds outside the arena: a mapped
+// image and the pages of saved lines
+void releaseState(Core *core);
+
+#endif
@@ -0,0 +1,168 @@
+#include "StoreBuffer.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/*------------------ StoreBuffer.c -------------
+ |
+ |  Purpose: The store buffer between the MEM
+ |		stage and data memory: entry search
+ |		for loads, the drain and its policy,
+ |		and the statistics.
+ |
+ *----------------------------------------------*/
+
+StoreBuffer *initStoreBuffer(Core *core, int size, DrainPolicy policy, int watermark, int latency) {
+	StoreBuffer *sb;
+
+	if (size < 1) {
+		return NULL;
+	}
+	sb = arenaAlloc(core->arena, sizeof(StoreBuffer));
+	sb->entries = arenaAlloc(core->arena, size * sizeof(StoreEntry));
+	sb->size = size;
+	sb->policy = policy;
+	sb->watermark = watermark < 1 || watermark > size ? size : watermark;
+	sb->latency = latency < 1 ? 1 : latency;
+	return sb;
+}
+
+bool parseDrainPolicy(const char *name, DrainPolicy *policy) {
+	if (strcmp(name, "eager") == 0) {
+		*policy = DRAIN_EAGER;
+	} else if (strcmp(name, "lazy") == 0) {
+		*policy = DRAIN_LAZY;
+	} else {
+		printf("Unknown drain policy: %s (eager or lazy)\n", name);
+		return false;
+	}
+	return true;
+}
+
+static StoreEntry *entryAt(StoreBuffer *sb, int i) {
+	return &sb->entries[(sb->head + i) % sb->size];
+}
+
+// Youngest entry sharing a byte with [addr, addr + len), or NULL
+static StoreEntry *youngestOverlap(StoreBuffer *sb, Addr addr, unsigned len) {
+	int i;
+
+	for (i=sb->count-1; i>=0; i--) {
+		StoreEntry *e = entryAt(sb, i);
+		if (addr < e->addr + memWidth(e->funct3) && e->addr < addr + len) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static bool covers(const StoreEntry *e, Addr addr, unsigned len) {
+	return e->addr <= addr && addr + len <= e->addr + memWidth(e->funct3);
+}
+
+int storeBufferBlocks(StoreBuffer *sb, const Decode *dec, Addr addr) {
+	if (dec->ctrl_signals.Vector) {
+		if ((dec->opcode == OPCODE_VLOAD || dec->opcode == OPCODE_VSTORE) && sb->count > 0) {
+			sb->drain_stalls++;
+			sb->force = true;
+			return STALL_STORE_DRAIN;
+		}
+		return 0;
+	}
+	if (dec->ctrl_signals.MemWrite && sb->count == sb->size) {
+		sb->full_stalls++;
+		sb->force = true;
+		return STALL_STORE_FULL;
+	}
+	if (dec->ctrl_signals.MemRead) {
+		unsigned len = memWidth(dec->funct3);
+		StoreEntry *e = youngestOverlap(sb, addr, len);
+		if (e && !covers(e, addr, len)) {
+			sb->drain_stalls++;
+			sb->force = true;
+			return STALL_STORE_DRAIN;
+		}
+	}
+	return 0;
+}
+
+void storeBufferPush(StoreBuffer *sb, Core *core, int64_t data, Addr addr, Signal funct3, Addr pc) {
+	unsigned len = memWidth(funct3);
+	StoreEntry *e;
+
+	// storeDataMem would drop it, so nothing could ever read it back
+	if (addr > core->mem_size || len > core->mem_size - addr) {
+		return;
+	}
+	e = entryAt(sb, sb->count++);
+	e->addr = addr;
+	e->data = data;
+	e->funct3 = funct3;
+	e->pc = pc;
+	sb->stores++;
+	if (sb->count > sb->max_count) {
+		sb->max_count = sb->count;
+	}
+}
+
+// storeBufferBlocks has held a partly covered load until the overlap
+// drained, so an entry found here has all the bytes
+int64_t storeBufferLoad(StoreBuffer *sb, Core *core, Addr addr, Signal funct3) {
+	StoreEntry *e = youngestOverlap(sb, addr, memWidth(funct3));
+
+	if (e == NULL) {
+		return loadDataMem(core, addr, funct3);
+	}
+	sb->forwarded++;
+	return extendLoad(e->data >> (8 * (addr - e->addr)), funct3);
+}
+
+static void writeOldest(StoreBuffer *sb, Core *core) {
+	StoreEntry *e = entryAt(sb, 0);
+
+	storeDataMem(core, e->data, e->addr, e->funct3);
+	sb->head = (sb->head + 1) % sb->size;
+	sb->count--;
+	sb->writes++;
+}
+
+void storeBufferCycle(StoreBuffer *sb, Core *core, bool idle) {
+	sb->occupancy += sb->count;
+	sb->cycles++;
+	if (sb->draining && core->clk >= sb->drain_done
+			&& (core->dcache == NULL || dataCacheReady(core->dcache, &sb->drain_wait, core->clk) <= core->clk)) {
+		writeOldest(sb, core);
+		sb->draining = false;
+	}
+	if (!sb->draining && sb->count > 0
+			&& (sb->policy == DRAIN_EAGER || sb->count >= sb->watermark || sb->force || idle)) {
+		sb->draining = true;
+		sb->drain_done = core->clk + sb->latency;
+		if (core->dcache) {
+			StoreEntry *e = entryAt(sb, 0);
+			sb->drain_wait = dataCacheAccess(core->dcache, e->addr, e->pc, true, core->clk);
+		}
+	}
+	sb->force = false;
+}
+
+void storeBufferFlush(StoreBuffer *sb, Core *core) {
+	while (sb->count > 0) {
+		writeOldest(sb, core);
+	}
+	sb->draining = false;
+	sb->force = false;
+}
+
+void printStoreBufferStats(const StoreBuffer *sb) {
+	printf("Store buffer: %d entries, %s drain", sb->size, sb->policy == DRAIN_EAGER ? "eager" : "lazy");
+	if (sb->policy == DRAIN_LAZY) {
+		printf(" at %d", sb->watermark);
+	}
+	printf(", %d-cycle writes\n", sb->latency);
+	printf("Store buffer: %" PRIu64 " stores, %" PRIu64 " loads forwarded, %" PRIu64 " full stalls, %" PRIu64
+		" drain stalls, average occupancy %.2f (max %d)\n",
+		sb->stores, sb->forwarded, sb->full_stalls, sb->drain_stalls,
+		sb->cycles ? (double)sb->occupancy / sb->cycles : 0.0, sb->max_count);
+}
@@ -0,0 +1,104 @@
+#ifndef __STOREBUFFER_H__
+#define __STOREBUFFER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Cache.h"
+#include "Pipeline.h"
+
+/*------------------ StoreBuffer.h -------------
+ |
+ |  --store-buffer N: a FIFO between the in-order
+ |  MEM stage and data memory. A store leaves MEM
+ |  as soon as it has an entry, and the entries
+ |  are written to memory in order, one at a time,
+ |  each taking the drain latency. The policy
+ |  decides when a write starts:
+ |
+ |	eager  whenever the write port is free
+ |	lazy   once the buffer holds the watermark,
+ |	       or when something waits on it
+ |
+ |  A load in MEM searches the buffer, youngest
+ |  entry first. If the youngest store it overlaps
+ |  covers all its bytes the data is forwarded;
+ |  if it covers only part of them the load is
+ |  held in MEM until the overlapping entries
+ |  have drained. A store that finds the buffer
+ |  full is held too, and so are vector loads and
+ |  stores until the buffer is empty, since they
+ |  go to memory directly.
+ |
+ |  The run is not over until the buffer has
+ |  drained, so the final memory is complete.
+ |
+ *----------------------------------------------*/
+
+typedef enum DrainPolicy
+{
+	DRAIN_EAGER,
+	DRAIN_LAZY
+}DrainPolicy;
+
+typedef struct StoreEntry
+{
+	Addr addr;
+	uint64_t data;
+	Signal funct3;   // width, as the store had it
+	Addr pc;         // of the store, for the data cache's prefetchers
+}StoreEntry;
+
+typedef struct StoreBuffer
+{
+	StoreEntry *entries;
+	int size;
+	int head;            // oldest entry
+	int count;
+	DrainPolicy policy;
+	int watermark;       // DRAIN_LAZY starts writing at this many entries
+	int latency;         // cycles per memory write
+	bool draining;       // the oldest entry is being written
+	Tick drain_done;     // ... and is in memory at the end of this cycle
+	CacheWait drain_wait; // ... once its line is in the data cache, if any
+	bool force;          // an instruction in MEM waits for a drain
+
+	// Statistics
+	uint64_t stores;
+	uint64_t forwarded;     // loads served from the buffer
+	uint64_t full_stalls;   // cycles a store waited for an entry
+	uint64_t drain_stalls;  // cycles a load or vector access waited for a drain
+	uint64_t writes;        // entries written to memory
+	uint64_t occupancy;     // entries summed over the cycles
+	uint64_t cycles;
+	int max_count;
+}StoreBuffer;
+
+// From the arena; NULL if size < 1
+StoreBuffer *initStoreBuffer(Core *core, int size, DrainPolicy policy, int watermark, int latency);
+
+// "eager" or "lazy"; false (and a message) for anything else
+bool parseDrainPolicy(const char *name, DrainPolicy *policy);
+
+// Why the instruction in MEM cannot access memory this
+// cycle, 0 if it can. Counts the stall and asks for a drain.
+int storeBufferBlocks(StoreBuffer *sb, const Decode *dec, Addr addr);
+
+// MEM-stage accesses in place of storeDataMem/loadDataMem
+void storeBufferPush(StoreBuffer *sb, Core *core, int64_t data, Addr addr, Signal funct3, Addr pc);
+int64_t storeBufferLoad(StoreBuffer *sb, Core *core, Addr addr, Signal funct3);
+
+// End of a cycle: finish the write in progress and start the next one
+// the policy allows. idle: nothing left in the pipeline to wait for.
+void storeBufferCycle(StoreBuffer *sb, Core *core, bool idle);
+
+// Write everything out at once (the core starting over)
+void storeBufferFlush(StoreBuffer *sb, Core *core);
+
+static inline bool storeBufferEmpty(const StoreBuffer *sb) {
+	return sb == NULL || sb->count == 0;
+}
+
+void printStoreBufferStats(const StoreBuffer *sb);
+
+#endif
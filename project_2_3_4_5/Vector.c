@@ -0,0 +1,433 @@
+#include "Core.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/*------------------ Vector.c ------------------
+ |
+ |  Purpose: Functional execution of the RVV
+ |		subset. Element-wise operations and
+ |		reductions run on host AVX2 or SSE2
+ |		kernels when available and fall back
+ |		to scalar loops for the tail and for
+ |		element widths the host lacks.
+ |
+ *----------------------------------------------*/
+
+int64_t vectorElement(const uint8_t *v, int sew, uint64_t i) {
+	switch (sew) {
+		case 8:  return ((const int8_t *)v)[i];
+		case 16: return ((const int16_t *)v)[i];
+		case 32: return ((const int32_t *)v)[i];
+		default: return ((const int64_t *)v)[i];
+	}
+}
+
+void setVectorElement(uint8_t *v, int sew, uint64_t i, int64_t value) {
+	switch (sew) {
+		case 8:  ((int8_t *)v)[i] = value; break;
+		case 16: ((int16_t *)v)[i] = value; break;
+		case 32: ((int32_t *)v)[i] = value; break;
+		default: ((int64_t *)v)[i] = value; break;
+	}
+}
+
+static int64_t scalarOp(VecOp op, int64_t a, int64_t b) {
+	switch (op) {
+		case VOP_ADD: return (uint64_t)a + (uint64_t)b;
+		case VOP_SUB: return (uint64_t)a - (uint64_t)b;
+		case VOP_MUL: return (uint64_t)a * (uint64_t)b;
+		case VOP_AND: return a & b;
+		case VOP_OR:  return a | b;
+	}
+	return 0;
+}
+
+/*------------------ Host kernels --------------*/
+
+// Each kernel handles whole host registers and returns how many bytes
+// it processed; the caller finishes the rest element by element.
+typedef unsigned (*BinaryKernel)(VecOp op, int sew, uint8_t *vd, const uint8_t *a, const uint8_t *b, unsigned bytes);
+typedef unsigned (*ReduceKernel)(VecOp op, int sew, const uint8_t *a, unsigned bytes, uint8_t *acc);
+
+static unsigned binaryScalar(VecOp op, int sew, uint8_t *vd, const uint8_t *a, const uint8_t *b, unsigned bytes) {
+	return 0;
+}
+
+static unsigned reduceScalar(VecOp op, int sew, const uint8_t *a, unsigned bytes, uint8_t *acc) {
+	return 0;
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2")))
+static unsigned binaryAVX2(VecOp op, int sew, uint8_t *vd, const uint8_t *a, const uint8_t *b, unsigned bytes) {
+	unsigned i;
+
+	// No 8- or 64-bit multiply in AVX2
+	if (op == VOP_MUL && (sew == 8 || sew == 64)) {
+		return 0;
+	}
+	for (i=0; i+32<=bytes; i+=32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i r;
+		switch (op) {
+			case VOP_ADD:
+				r = sew == 8 ? _mm256_add_epi8(x, y) : sew == 16 ? _mm256_add_epi16(x, y)
+					: sew == 32 ? _mm256_add_epi32(x, y) : _mm256_add_epi64(x, y);
+				break;
+			case VOP_SUB:
+				r = sew == 8 ? _mm256_sub_epi8(x, y) : sew == 16 ? _mm256_sub_epi16(x, y)
+					: sew == 32 ? _mm256_sub_epi32(x, y) : _mm256_sub_epi64(x, y);
+				break;
+			case VOP_MUL:
+				r = sew == 16 ? _mm256_mullo_epi16(x, y) : _mm256_mullo_epi32(x, y);
+				break;
+			case VOP_AND:
+				r = _mm256_and_si256(x, y);
+				break;
+			default:
+				r = _mm256_or_si256(x, y);
+				break;
+		}
+		_mm256_storeu_si256((__m256i *)(vd + i), r);
+	}
+	return i;
+}
+
+// Lane-wise partial reduction into a 32-byte accumulator. Sums wrap per
+// lane, which gives the same result modulo 2^sew as a serial sum.
+__attribute__((target("avx2")))
+static unsigned reduceAVX2(VecOp op, int sew, const uint8_t *a, unsigned bytes, uint8_t *acc) {
+	unsigned i;
+	__m256i r;
+
+	if (op == VOP_MUL || bytes < 32) {
+		return 0;
+	}
+	r = _mm256_loadu_si256((const __m256i *)a);
+	for (i=32; i+32<=bytes; i+=32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		switch (op) {
+			case VOP_ADD:
+				r = sew == 8 ? _mm256_add_epi8(r, x) : sew == 16 ? _mm256_add_epi16(r, x)
+					: sew == 32 ? _mm256_add_epi32(r, x) : _mm256_add_epi64(r, x);
+				break;
+			case VOP_AND:
+				r = _mm256_and_si256(r, x);
+				break;
+			default:
+				r = _mm256_or_si256(r, x);
+				break;
+		}
+	}
+	_mm256_storeu_si256((__m256i *)acc, r);
+	return i;
+}
+
+static unsigned binarySSE2(VecOp op, int sew, uint8_t *vd, const uint8_t *a, const uint8_t *b, unsigned bytes) {
+	unsigned i;
+
+	// SSE2 only multiplies 16-bit lanes
+	if (op == VOP_MUL && sew != 16) {
+		return 0;
+	}
+	for (i=0; i+16<=bytes; i+=16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i r;
+		switch (op) {
+			case VOP_ADD:
+				r = sew == 8 ? _mm_add_epi8(x, y) : sew == 16 ? _mm_add_epi16(x, y)
+					: sew == 32 ? _mm_add_epi32(x, y) : _mm_add_epi64(x, y);
+				break;
+			case VOP_SUB:
+				r = sew == 8 ? _mm_sub_epi8(x, y) : sew == 16 ? _mm_sub_epi16(x, y)
+					: sew == 32 ? _mm_sub_epi32(x, y) : _mm_sub_epi64(x, y);
+				break;
+			case VOP_MUL:
+				r = _mm_mullo_epi16(x, y);
+				break;
+			case VOP_AND:
+				r = _mm_and_si128(x, y);
+				break;
+			default:
+				r = _mm_or_si128(x, y);
+				break;
+		}
+		_mm_storeu_si128((__m128i *)(vd + i), r);
+	}
+	return i;
+}
+#endif
+
+static BinaryKernel binary_kernel = binaryScalar;
+static ReduceKernel reduce_kernel = reduceScalar;
+static const char *kernel_name = "scalar";
+
+static pthread_once_t kernels_selected = PTHREAD_ONCE_INIT;
+
+static void selectKernels(void) {
+#ifdef HAVE_X86_KERNELS
+	if (__builtin_cpu_supports("avx2")) {
+		binary_kernel = binaryAVX2;
+		reduce_kernel = reduceAVX2;
+		kernel_name = "AVX2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		binary_kernel = binarySSE2;
+		kernel_name = "SSE2";
+	}
+#endif
+}
+
+void initVectorUnit(VectorState *vec) {
+	memset(vec->vreg, 0, sizeof(vec->vreg));
+	vec->vl = 0;
+	vec->sew = 64;
+	vec->lanes = 4;
+
+	// Cores may be set up on several threads at once (--serve)
+	pthread_once(&kernels_selected, selectKernels);
+}
+
+const char *vectorKernelName(void) {
+	return kernel_name;
+}
+
+void vectorBinary(VecOp op, int sew, uint8_t *vd, const uint8_t *a, const uint8_t *b, uint64_t vl) {
+	unsigned bytes = vl * (sew / 8);
+	uint64_t i = binary_kernel(op, sew, vd, a, b, bytes) / (sew / 8);
+
+	for (; i<vl; i++) {
+		setVectorElement(vd, sew, i, scalarOp(op, vectorElement(a, sew, i), vectorElement(b, sew, i)));
+	}
+}
+
+int64_t vectorReduce(VecOp op, int sew, const uint8_t *a, uint64_t vl, int64_t init) {
+	uint8_t acc[32];
+	unsigned bytes = vl * (sew / 8);
+	unsigned done = reduce_kernel(op, sew, a, bytes, acc);
+	int64_t result = init;
+	uint64_t i;
+
+	if (done > 0) {
+		for (i=0; i<32/(sew/8); i++) {
+			result = scalarOp(op, result, vectorElement(acc, sew, i));
+		}
+	}
+	for (i=done/(sew/8); i<vl; i++) {
+		result = scalarOp(op, result, vectorElement(a, sew, i));
+	}
+	// Truncate to the element width
+	setVectorElement(acc, sew, 0, result);
+	return vectorElement(acc, sew, 0);
+}
+
+/*------------------ Pipeline side -------------*/
+
+static VecOp vectorOpOf(Decode *dec, bool *valid) {
+	Signal funct6 = dec->funct7 >> 1;
+
+	*valid = true;
+	if (dec->funct3 == OPIVV || dec->funct3 == OPIVX) {
+		switch (funct6) {
+			case 0:  return VOP_ADD;
+			case 2:  return VOP_SUB;
+			case 9:  return VOP_AND;
+			case 10: return VOP_OR;
+		}
+	} else if (dec->funct3 == OPMVV || dec->funct3 == OPMVX) {
+		if (funct6 == 37) {
+			return VOP_MUL;
+		}
+	}
+	*valid = false;
+	return VOP_ADD;
+}
+
+static bool isReduction(Decode *dec) {
+	Signal funct6 = dec->funct7 >> 1;
+	return dec->opcode == OPCODE_OP_V && dec->funct3 == OPMVV && funct6 <= 2;
+}
+
+static bool isMoveToScalar(Decode *dec) {
+	return dec->opcode == OPCODE_OP_V && dec->funct3 == OPMVV && (dec->funct7 >> 1) == 16;
+}
+
+static bool isVectorMem(Decode *dec) {
+	return dec->opcode == OPCODE_VLOAD || dec->opcode == OPCODE_VSTORE;
+}
+
+static bool isStrided(Decode *dec) {
+	return isVectorMem(dec) && ((dec->funct7 >> 1) & 3) == 2;
+}
+
+// Element width of a vector load/store comes from its width field
+static int memElementWidth(Decode *dec) {
+	switch (dec->funct3) {
+		case 0: return 8;
+		case 5: return 16;
+		case 6: return 32;
+		default: return 64;
+	}
+}
+
+// vsetvli and vmv.x.s write a scalar register
+void vectorDecode(Decode *dec) {
+	dec->ctrl_signals.RegWrite = dec->opcode == OPCODE_OP_V
+		&& (dec->funct3 == OPCFG || isMoveToScalar(dec));
+}
+
+bool vectorUsesRs1(Decode *dec) {
+	return dec->opcode != OPCODE_OP_V || (dec->funct3 != OPIVV && dec->funct3 != OPMVV);
+}
+
+bool vectorUsesRs2(Decode *dec) {
+	return isStrided(dec);
+}
+
+// Vector registers read, returns how many were written to src
+int vectorSources(Decode *dec, Signal src[3]) {
+	int n = 0;
+
+	if (dec->opcode == OPCODE_VSTORE) {
+		src[n++] = dec->rd; // vs3
+	} else if (dec->opcode == OPCODE_OP_V && dec->funct3 != OPCFG) {
+		src[n++] = dec->rs2; // vs2
+		if (dec->funct3 == OPIVV || dec->funct3 == OPMVV) {
+			if (!isMoveToScalar(dec)) {
+				src[n++] = dec->rs1; // vs1
+			}
+		}
+	}
+	return n;
+}
+
+// Vector register written, or -1
+Signal vectorDest(Decode *dec) {
+	if (dec->opcode == OPCODE_VLOAD) {
+		return dec->rd;
+	}
+	if (dec->opcode == OPCODE_OP_V && dec->funct3 != OPCFG && !isMoveToScalar(dec)) {
+		return dec->rd;
+	}
+	return -1;
+}
+
+// Cycles the vector unit is busy: vl elements at lanes per cycle
+int vectorOccupancy(Core *core, Decode *dec) {
+	uint64_t vl = core->vec.vl;
+
+	if (dec->opcode == OPCODE_OP_V && (dec->funct3 == OPCFG || isMoveToScalar(dec))) {
+		return 1;
+	}
+	if (vl == 0) {
+		return 1;
+	}
+	return (vl + core->vec.lanes - 1) / core->vec.lanes;
+}
+
+void vectorExecute(Core *core, PipeInstr *PI, Signal val1, Signal val2) {
+	VectorState *vec = &core->vec;
+	Decode *dec = PI->dec;
+	uint8_t splat[VLENB] __attribute__((aligned(32)));
+	bool valid;
+
+	PI->ex->ALU_result = 0;
+	if (isVectorMem(dec)) {
+		// Base address and stride, the access itself happens in memAccess
+		PI->ex->ALU_result = val1;
+		PI->ex->ALU_2nd_val = val2;
+		return;
+	}
+
+	if (dec->funct3 == OPCFG) {
+		Signal vtype = (PI->instruction >> 20) & 0x7ff;
+		uint64_t vlmax;
+		vec->sew = 8 << ((vtype >> 3) & 7);
+		if (vec->sew > 64) {
+			vec->sew = 64;
+		}
+		vlmax = VLEN / vec->sew;
+		if (dec->rs1 != 0) {
+			vec->vl = (uint64_t)val1 < vlmax ? (uint64_t)val1 : vlmax;
+		} else if (dec->rd != 0) {
+			vec->vl = vlmax;
+		}
+		PI->ex->ALU_result = vec->vl;
+	} else if (isMoveToScalar(dec)) {
+		PI->ex->ALU_result = vectorElement(vec->vreg[dec->rs2], vec->sew, 0);
+	} else if (isReduction(dec)) {
+		VecOp op = (dec->funct7 >> 1) == 0 ? VOP_ADD : (dec->funct7 >> 1) == 1 ? VOP_AND : VOP_OR;
+		int64_t init = vectorElement(vec->vreg[dec->rs1], vec->sew, 0);
+		if (vec->vl > 0) {
+			setVectorElement(vec->vreg[dec->rd], vec->sew, 0,
+				vectorReduce(op, vec->sew, vec->vreg[dec->rs2], vec->vl, init));
+		}
+	} else {
+		VecOp op = vectorOpOf(dec, &valid);
+		const uint8_t *b = vec->vreg[dec->rs1];
+		uint64_t i;
+		if (!valid) {
+			printf("Unsupported vector instruction 0x%08x.\n", (unsigned)PI->instruction);
+			return;
+		}
+		if (dec->funct3 == OPIVX || dec->funct3 == OPMVX) {
+			for (i=0; i<vec->vl; i++) {
+				setVectorElement(splat, vec->sew, i, val1);
+			}
+			b = splat;
+		}
+		vectorBinary(op, vec->sew, vec->vreg[dec->rd], vec->vreg[dec->rs2], b, vec->vl);
+	}
+}
+
+void vectorMemAccess(Core *core, PipeInstr *PI) {
+	VectorState *vec = &core->vec;
+	Decode *dec = PI->dec;
+	int eew = memElementWidth(dec);
+	int bytes = eew / 8;
+	Signal base = PI->ex->ALU_result;
+	Signal stride = isStrided(dec) ? PI->ex->ALU_2nd_val : bytes;
+	uint8_t *v = vec->vreg[dec->rd];
+	uint64_t i;
+
+	PI->mem_res = 0;
+	if (vec->vl * bytes > VLENB) {
+		printf("Vector access with vl %" PRIu64 " does not fit EEW %d, skipped.\n", vec->vl, eew);
+		return;
+	}
+	for (i=0; i<vec->vl; i++) {
+		Signal addr = base + (Signal)i * stride;
+		if (addr < 0 || addr + bytes > (Signal)core->mem_size) {
+			printf("Vector access to address %ld is out of bounds, skipped.\n", addr);
+			return;
+		}
+	}
+
+	if (!isStrided(dec)) {
+		// Unit stride: one contiguous copy
+		if (dec->opcode == OPCODE_VLOAD) {
+			memcpy(v, &core->data_mem[base], vec->vl * bytes);
+		} else {
+			memWrite(core, base, vec->vl * bytes);
+			memcpy(&core->data_mem[base], v, vec->vl * bytes);
+		}
+		return;
+	}
+	for (i=0; i<vec->vl; i++) {
+		Signal addr = base + (Signal)i * stride;
+		if (dec->opcode == OPCODE_VLOAD) {
+			memcpy(v + i * bytes, &core->data_mem[addr], bytes);
+		} else {
+			memWrite(core, addr, bytes);
+			memcpy(&core->data_mem[addr], v + i * bytes, bytes);
+		}
+	}
+}
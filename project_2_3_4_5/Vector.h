@@ -0,0 +1,62 @@
+#ifndef __VECTOR_H__
+#define __VECTOR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------ Vector.h ------------------
+ |
+ |  State and host kernels for the RVV subset:
+ |  vsetvli, unit-stride and strided loads/stores,
+ |  vadd/vsub/vmul/vand/vor (.vv and .vx),
+ |  vredsum/vredand/vredor and vmv.x.s. Only
+ |  LMUL=1 and unmasked operations are modelled.
+ |
+ *----------------------------------------------*/
+
+#define VLEN 256             // bits per vector register
+#define VLENB (VLEN / 8)
+
+#define OPCODE_OP_V  87
+#define OPCODE_VLOAD 7
+#define OPCODE_VSTORE 39
+
+// funct3 of OP-V
+#define OPIVV 0
+#define OPMVV 2
+#define OPIVX 4
+#define OPMVX 6
+#define OPCFG 7
+
+typedef enum VecOp
+{
+	VOP_ADD,
+	VOP_SUB,
+	VOP_MUL,
+	VOP_AND,
+	VOP_OR
+}VecOp;
+
+typedef struct VectorState
+{
+	uint8_t vreg[32][VLENB] __attribute__((aligned(32)));
+	uint64_t vl;  // active vector length
+	int sew;      // element width in bits
+	int lanes;    // elements processed per cycle (timing only)
+}VectorState;
+
+void initVectorUnit(VectorState *vec);
+
+// vd[i] = a[i] op b[i] for i < vl, elements of sew bits
+void vectorBinary(VecOp op, int sew, uint8_t *vd, const uint8_t *a, const uint8_t *b, uint64_t vl);
+
+// init op a[0] op ... op a[vl-1]
+int64_t vectorReduce(VecOp op, int sew, const uint8_t *a, uint64_t vl, int64_t init);
+
+int64_t vectorElement(const uint8_t *v, int sew, uint64_t i);
+void setVectorElement(uint8_t *v, int sew, uint64_t i, int64_t value);
+
+// Name of the host kernels in use ("AVX2", "SSE2" or "scalar")
+const char *vectorKernelName(void);
+
+#endif
@@ -0,0 +1,276 @@
+#include "VirtualMemory.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/*------------------ VirtualMemory.c -----------
+ |
+ |  Purpose: Sv39 page-table walks, the host
+ |		translation cache, and the I/D TLB
+ |		and walker timing.
+ |
+ *----------------------------------------------*/
+
+#define PTE_V (1u << 0)
+#define PTE_R (1u << 1)
+#define PTE_W (1u << 2)
+#define PTE_X (1u << 3)
+#define PTE_A (1u << 6)
+#define PTE_D (1u << 7)
+#define PPN_MASK ((1ull << 44) - 1)
+#define VPN_MASK ((1ull << 27) - 1)
+
+typedef struct Walk
+{
+	Addr page;       // physical address of the 4 KiB page holding va
+	unsigned perms;  // accesses the leaf allows, A and D applied
+	int level;       // of the leaf
+	int reads;       // PTEs read, including the faulting one
+	bool ok;
+}Walk;
+
+static void initTLB(TLB *tlb, const char *name, int size, Arena *arena) {
+	memset(tlb, 0, sizeof(*tlb));
+	tlb->name = name;
+	tlb->size = size < 1 ? 1 : size;
+	tlb->entries = arenaAlloc(arena, tlb->size * sizeof(TLBEntry));
+}
+
+VirtualMemory *initVirtualMemory(Core *core, uint64_t satp, int itlb_entries, int dtlb_entries, int walk_latency) {
+	VirtualMemory *vm;
+
+	if ((satp >> 60) != SATP_MODE_SV39) {
+		printf("satp 0x%" PRIx64 " does not select Sv39 (mode 8 in bits 63:60).\n", satp);
+		return NULL;
+	}
+	vm = arenaAlloc(core->arena, sizeof(VirtualMemory));
+	vm->satp = satp;
+	vm->root = (satp & PPN_MASK) << PAGE_SHIFT;
+	initTLB(&vm->itlb, "I-TLB", itlb_entries, core->arena);
+	initTLB(&vm->dtlb, "D-TLB", dtlb_entries, core->arena);
+	vm->walk_latency = walk_latency < 1 ? 1 : walk_latency;
+	vm->pages = (core->mem_size >> PAGE_SHIFT) + 1;
+	vm->table_page = arenaAlloc(core->arena, vm->pages);
+	return vm;
+}
+
+// Bits 63:39 must copy bit 38
+static bool canonical(Addr va) {
+	return ((int64_t)(va << 25) >> 25) == (int64_t)va;
+}
+
+static void walk(VirtualMemory *vm, const Core *core, Addr va, Walk *w) {
+	Addr table = vm->root;
+	int level;
+
+	memset(w, 0, sizeof(*w));
+	for (level=2; level>=0; level--) {
+		Addr pte_addr = table + (((va >> (PAGE_SHIFT + 9 * level)) & 0x1ff) << 3);
+		uint64_t pte;
+
+		w->reads++;
+		if (pte_addr > core->mem_size || 8 > core->mem_size - pte_addr) {
+			return;
+		}
+		vm->table_page[pte_addr >> PAGE_SHIFT] = 1;
+		memcpy(&pte, core->data_mem + pte_addr, 8);  // little-endian host
+		if (!(pte & PTE_V) || ((pte & PTE_W) && !(pte & PTE_R))) {
+			return;
+		}
+		if (pte & (PTE_R | PTE_X)) {
+			uint64_t ppn = (pte >> 10) & PPN_MASK;
+			uint64_t low = (1ull << (9 * level)) - 1;
+			if (ppn & low) {
+				return;  // misaligned superpage
+			}
+			w->page = (ppn | ((va >> PAGE_SHIFT) & low)) << PAGE_SHIFT;
+			w->level = level;
+			if (pte & PTE_A) {
+				w->perms = ((pte & PTE_R) ? VM_READ : 0) | ((pte & PTE_W) && (pte & PTE_D) ? VM_WRITE : 0)
+					| ((pte & PTE_X) ? VM_EXEC : 0);
+			}
+			w->ok = true;
+			return;
+		}
+		table = ((pte >> 10) & PPN_MASK) << PAGE_SHIFT;
+	}
+}
+
+// Functional translation through the host cache; false on a fault
+static bool translate(VirtualMemory *vm, const Core *core, Addr va, unsigned access, Addr *pa) {
+	uint64_t vpn = (va >> PAGE_SHIFT) & VPN_MASK;
+	HostTranslation *h = &vm->host[vpn & (HOST_TLB_ENTRIES - 1)];
+	Walk w;
+
+	if (!canonical(va)) {
+		return false;
+	}
+	if (h->vpn_plus1 == vpn + 1 && (h->perms & access)) {
+		vm->host_hits++;
+		*pa = h->page | (va & ((1u << PAGE_SHIFT) - 1));
+		return true;
+	}
+	vm->host_misses++;
+	walk(vm, core, va, &w);
+	if (!w.ok || !(w.perms & access)) {
+		return false;
+	}
+	h->vpn_plus1 = vpn + 1;
+	h->page = w.page;
+	h->perms = w.perms;
+	*pa = w.page | (va & ((1u << PAGE_SHIFT) - 1));
+	return true;
+}
+
+void vmWrite(VirtualMemory *vm, size_t addr, size_t len) {
+	size_t page;
+
+	for (page = addr >> PAGE_SHIFT; page <= (addr + len - 1) >> PAGE_SHIFT && page < vm->pages; page++) {
+		if (vm->table_page[page]) {
+			memset(vm->host, 0, sizeof(vm->host));
+			vm->host_flushes++;
+			return;
+		}
+	}
+}
+
+static bool tlbHit(TLB *tlb, uint64_t vpn, Tick now) {
+	int i;
+
+	for (i=0; i<tlb->size; i++) {
+		TLBEntry *e = &tlb->entries[i];
+		if (e->valid && e->tag == vpn >> (9 * e->level)) {
+			e->used = now;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void tlbFill(TLB *tlb, uint64_t vpn, int level, Tick now) {
+	TLBEntry *victim = &tlb->entries[0];
+	int i;
+
+	for (i=0; i<tlb->size && victim->valid; i++) {
+		if (!tlb->entries[i].valid || tlb->entries[i].used < victim->used) {
+			victim = &tlb->entries[i];
+		}
+	}
+	victim->tag = vpn >> (9 * level);
+	victim->level = level;
+	victim->used = now;
+	victim->valid = true;
+}
+
+// True while the access waits for a walk. *fault: the walk it waited
+// for found no valid leaf.
+static bool tlbAccess(VirtualMemory *vm, const Core *core, TLB *tlb, Addr va, bool *fault) {
+	uint64_t vpn = (va >> PAGE_SHIFT) & VPN_MASK;
+	Tick start;
+	Walk w;
+
+	*fault = false;
+	if (tlb->walking && tlb->walk_vpn == vpn) {
+		if (core->clk < tlb->walk_done) {
+			return true;
+		}
+		tlb->walking = false;
+		if (tlb->walk_fault) {
+			*fault = true;
+		} else {
+			tlbFill(tlb, vpn, tlb->walk_level, core->clk);
+		}
+		return false;
+	}
+	if (!canonical(va)) {
+		*fault = true;
+		return false;
+	}
+	if (tlbHit(tlb, vpn, core->clk)) {
+		tlb->hits++;
+		return false;
+	}
+
+	// A walk left behind by a flushed fetch still holds the walker
+	walk(vm, core, va, &w);
+	start = vm->walker_free > core->clk ? vm->walker_free : core->clk;
+	tlb->misses++;
+	tlb->walking = true;
+	tlb->walk_vpn = vpn;
+	tlb->walk_level = w.level;
+	tlb->walk_fault = !w.ok;
+	tlb->walk_done = start + (Tick)w.reads * vm->walk_latency;
+	vm->walker_free = tlb->walk_done;
+	vm->walks++;
+	vm->pte_reads += w.reads;
+	vm->walk_cycles += tlb->walk_done - core->clk;
+	return true;
+}
+
+static void stop(VirtualMemory *vm, Core *core, const char *access, Addr va, Addr pc) {
+	if (!vm->faulted) {
+		vm->faulted = true;
+		vm->fault_access = access;
+		vm->fault_va = va;
+		vm->fault_pc = pc;
+	}
+	core->break_hit = true;
+}
+
+bool vmFetchBlocks(VirtualMemory *vm, Core *core, PipeInstr *PI) {
+	Addr pa;
+	bool fault;
+
+	if (tlbAccess(vm, core, &vm->itlb, PI->pc, &fault)) {
+		return true;
+	}
+	// Instruction memory stays indexed by PC; the physical address
+	// only decides whether the fetch faults
+	PI->fetch_fault = fault || !translate(vm, core, PI->pc, VM_EXEC, &pa);
+	return false;
+}
+
+void vmFetchFault(VirtualMemory *vm, Core *core, const PipeInstr *PI) {
+	stop(vm, core, "instruction fetch", PI->pc, PI->pc);
+}
+
+int vmDataBlocks(VirtualMemory *vm, Core *core, PipeInstr *PI) {
+	Addr va = PI->ex->ALU_result;
+	bool store = PI->dec->ctrl_signals.MemWrite;
+	bool fault;
+
+	if (PI->dec->ctrl_signals.Vector) {
+		stop(vm, core, "vector access (not translated)", va, PI->pc);
+		return STALL_TLB;
+	}
+	if (tlbAccess(vm, core, &vm->dtlb, va, &fault)) {
+		return STALL_TLB;
+	}
+	if (fault || !translate(vm, core, va, store ? VM_WRITE : VM_READ, &PI->mem_addr)) {
+		stop(vm, core, store ? "store" : "load", va, PI->pc);
+		return STALL_TLB;
+	}
+	return 0;
+}
+
+static void printTLB(const TLB *tlb) {
+	uint64_t accesses = tlb->hits + tlb->misses;
+
+	printf("%s: %d entries, %" PRIu64 " hits, %" PRIu64 " misses (%.2f%% miss rate)\n", tlb->name, tlb->size,
+		tlb->hits, tlb->misses, accesses ? 100.0 * tlb->misses / accesses : 0.0);
+}
+
+void printVirtualMemoryStats(const VirtualMemory *vm) {
+	printf("Sv39: root table at %" PRIu64 ", %d-cycle PTE reads\n", vm->root, vm->walk_latency);
+	printTLB(&vm->itlb);
+	printTLB(&vm->dtlb);
+	printf("Page walks: %" PRIu64 ", %" PRIu64 " PTE reads, %.1f cycles each on average from the miss\n",
+		vm->walks, vm->pte_reads, vm->walks ? (double)vm->walk_cycles / vm->walks : 0.0);
+	printf("Host translation cache: %d entries, %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " flushes\n",
+		HOST_TLB_ENTRIES, vm->host_hits, vm->host_misses, vm->host_flushes);
+	if (vm->faulted) {
+		printf("Page fault: %s at virtual address 0x%" PRIx64 " (PC %" PRIu64 "), the run stopped there\n",
+			vm->fault_access, vm->fault_va, vm->fault_pc);
+	}
+}
@@ -0,0 +1,131 @@
+#ifndef __VIRTUALMEMORY_H__
+#define __VIRTUALMEMORY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Pipeline.h"
+
+/*------------------ VirtualMemory.h -----------
+ |
+ |  --vm: Sv39 translation for the in-order
+ |  pipelines. satp (a state file's satp=, or
+ |  --satp) points at a three-level page table in
+ |  data memory, which is then physical memory;
+ |  loads, stores and instruction fetches use
+ |  virtual addresses.
+ |
+ |  Timing: an instruction TLB checked in fetch
+ |  and a data TLB checked when a load or store
+ |  reaches MEM, both fully associative with LRU
+ |  replacement. A miss starts the page-table
+ |  walker, which reads one PTE per level, each
+ |  read taking the walk latency, and serves one
+ |  walk at a time. Fetch, or MEM and everything
+ |  behind it, waits until the walk is done.
+ |
+ |  Function: translations come from a direct-
+ |  mapped host cache indexed by virtual page,
+ |  so a hit costs a compare and an add whatever
+ |  the TLB model says. A miss walks the table.
+ |  The pages the walker has read are marked,
+ |  and a store into one of them empties the
+ |  host cache, so page-table updates are seen
+ |  at once (the model has no sfence.vma).
+ |
+ |  A and D are not set by hardware: a leaf
+ |  without A, or without D for a store, faults.
+ |  Privilege is not modelled, so U is ignored.
+ |  A page fault stops the run and is reported;
+ |  a fetch fault only once its instruction
+ |  reaches EXEC, since a wrong-path fetch may
+ |  be flushed first.
+ |
+ *----------------------------------------------*/
+
+#define PAGE_SHIFT 12
+#define SATP_MODE_SV39 8ull
+#define HOST_TLB_ENTRIES 4096   // host translation cache, a power of two
+
+// Access types, also the permission bits of a host cache entry
+#define VM_READ 1
+#define VM_WRITE 2
+#define VM_EXEC 4
+
+typedef struct TLBEntry
+{
+	uint64_t tag;     // virtual page >> (9 * level)
+	int level;        // 0: 4 KiB page, 1: 2 MiB, 2: 1 GiB
+	Tick used;        // last hit, for LRU
+	bool valid;
+}TLBEntry;
+
+typedef struct TLB
+{
+	const char *name;
+	TLBEntry *entries;
+	int size;
+
+	// The walk this TLB is waiting for
+	bool walking;
+	uint64_t walk_vpn;
+	int walk_level;
+	bool walk_fault;
+	Tick walk_done;
+
+	uint64_t hits;
+	uint64_t misses;
+}TLB;
+
+typedef struct HostTranslation
+{
+	uint64_t vpn_plus1;   // 0: empty
+	Addr page;            // physical page address
+	unsigned perms;       // VM_READ | VM_WRITE | VM_EXEC
+}HostTranslation;
+
+typedef struct VirtualMemory
+{
+	uint64_t satp;
+	Addr root;            // physical address of the root table
+	TLB itlb, dtlb;
+	int walk_latency;     // cycles per PTE read
+	Tick walker_free;     // the walker takes a new walk from this cycle
+
+	HostTranslation host[HOST_TLB_ENTRIES];
+	uint8_t *table_page;  // per physical page: the walker has read a PTE there
+	size_t pages;
+
+	// Statistics
+	uint64_t walks;
+	uint64_t pte_reads;
+	uint64_t walk_cycles;  // from the miss to the end of its walk
+	uint64_t host_hits;
+	uint64_t host_misses;
+	uint64_t host_flushes;
+
+	// The fault that stopped the run
+	bool faulted;
+	const char *fault_access;
+	Addr fault_va;
+	Addr fault_pc;
+}VirtualMemory;
+
+// From the arena, for the core's current data memory; NULL (and a
+// message) if satp does not select Sv39
+VirtualMemory *initVirtualMemory(Core *core, uint64_t satp, int itlb_entries, int dtlb_entries, int walk_latency);
+
+// Fetch: true while the instruction in stage 0 waits for the I-TLB.
+// Marks it if its PC does not translate.
+bool vmFetchBlocks(VirtualMemory *vm, Core *core, PipeInstr *PI);
+
+// MEM: STALL_TLB while the load or store waits for the D-TLB, 0 once
+// PI->mem_addr holds the physical address. A fault stops the core.
+int vmDataBlocks(VirtualMemory *vm, Core *core, PipeInstr *PI);
+
+// The instruction in EXEC was fetched from a PC that faulted
+void vmFetchFault(VirtualMemory *vm, Core *core, const PipeInstr *PI);
+
+void printVirtualMemoryStats(const VirtualMemory *vm);
+
+#endif
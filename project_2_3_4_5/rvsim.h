@@ -0,0 +1,101 @@
+#ifndef __RVSIM_H__
+#define __RVSIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*------------------ rvsim.h -------------------
+ |
+ |  librvsim: the in-order simulator as a
+ |  library, for hosts that drive it in-process
+ |  instead of parsing the RVSim output.
+ |
+ |	RVSim *sim = rvsimCreate();
+ |	rvsimLoadTrace(sim, "cpu_traces/project_five");
+ |	rvsimLoadState(sim, "cpu_traces/project_five.init");
+ |	rvsimRunUntilPC(sim, 0x10, RVSIM_FOREVER);
+ |	int64_t x9 = rvsimReadReg(sim, 9);
+ |	rvsimStep(sim, 5);
+ |	rvsimReset(sim);	// same program, start over
+ |	rvsimDestroy(sim);
+ |
+ |  The pipeline keeps its contents between
+ |  calls, so stepping a cycle at a time gives
+ |  the same result as one run to the end.
+ |  Loading a program discards the state; load
+ |  state files after it and before the first
+ |  step. Reset puts back the registers and the
+ |  memory lines the run wrote, so reusing a
+ |  loaded program costs no parsing.
+ |
+ |  An RVSim may be used by one thread at a
+ |  time; separate ones run independently.
+ |
+ *----------------------------------------------*/
+
+#if defined(__GNUC__)
+#define RVSIM_API __attribute__((visibility("default")))
+#else
+#define RVSIM_API
+#endif
+
+#define RVSIM_FOREVER UINT64_MAX
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RVSim RVSim;
+
+// NULL if the host is out of memory
+RVSIM_API RVSim *rvsimCreate(void);
+RVSIM_API void rvsimDestroy(RVSim *sim);
+
+// A program as trace text or a trace file. Functions returning bool
+// leave the reason in rvsimError when they fail.
+RVSIM_API bool rvsimLoadProgram(RVSim *sim, const char *text);
+RVSIM_API bool rvsimLoadTrace(RVSim *sim, const char *path);
+
+// State files as for --init, and text in the same format
+RVSIM_API bool rvsimLoadState(RVSim *sim, const char *path);
+RVSIM_API bool rvsimLoadStateText(RVSim *sim, const char *text);
+
+// A --config name (default 5-stage); applies at once if nothing has
+// run yet, otherwise from the next reset
+RVSIM_API bool rvsimSetConfig(RVSim *sim, const char *name);
+
+// Back to cycle 0 with the registers and memory of the first step
+RVSIM_API bool rvsimReset(RVSim *sim);
+
+// Run up to cycles cycles; returns how many ran, fewer if it finished
+RVSIM_API uint64_t rvsimStep(RVSim *sim, uint64_t cycles);
+
+// Run until the instruction at pc retires (true) or the program
+// finishes or max_cycles more have run (false)
+RVSIM_API bool rvsimRunUntilPC(RVSim *sim, uint64_t pc, uint64_t max_cycles);
+
+// Run until the clock reaches cycle; false if the program finished first
+RVSIM_API bool rvsimRunUntilCycle(RVSim *sim, uint64_t cycle);
+
+RVSIM_API bool rvsimFinished(const RVSim *sim);
+RVSIM_API uint64_t rvsimCycles(const RVSim *sim);
+RVSIM_API uint64_t rvsimRetired(const RVSim *sim);
+RVSIM_API uint64_t rvsimPC(const RVSim *sim);
+
+// x0-x31; x0 reads 0 and ignores writes
+RVSIM_API int64_t rvsimReadReg(const RVSim *sim, int reg);
+RVSIM_API bool rvsimWriteReg(RVSim *sim, int reg, int64_t value);
+
+RVSIM_API size_t rvsimMemSize(const RVSim *sim);
+RVSIM_API bool rvsimReadMem(const RVSim *sim, uint64_t addr, void *buf, size_t len);
+RVSIM_API bool rvsimWriteMem(RVSim *sim, uint64_t addr, const void *buf, size_t len);
+
+// Why the last call failed
+RVSIM_API const char *rvsimError(const RVSim *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+"""ctypes binding for librvsim (see rvsim.h); build it with `make lib`.
+
+    sim = RVSim()
+    sim.load_trace("cpu_traces/project_five")
+    sim.load_state("cpu_traces/project_five.init")
+    while not sim.finished:
+        sim.step(1)
+    print(sim.cycles, sim.reg(9))
+"""
+
+import ctypes
+import os
+
+FOREVER = 2**64 - 1
+
+_lib = ctypes.CDLL(os.environ.get("RVSIM_LIB",
+                   os.path.join(os.path.dirname(os.path.abspath(__file__)), "librvsim.so")))
+
+_sig = {
+    "rvsimCreate": (ctypes.c_void_p, []),
+    "rvsimDestroy": (None, [ctypes.c_void_p]),
+    "rvsimLoadProgram": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_char_p]),
+    "rvsimLoadTrace": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_char_p]),
+    "rvsimLoadState": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_char_p]),
+    "rvsimLoadStateText": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_char_p]),
+    "rvsimSetConfig": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_char_p]),
+    "rvsimReset": (ctypes.c_bool, [ctypes.c_void_p]),
+    "rvsimStep": (ctypes.c_uint64, [ctypes.c_void_p, ctypes.c_uint64]),
+    "rvsimRunUntilPC": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_uint64]),
+    "rvsimRunUntilCycle": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_uint64]),
+    "rvsimFinished": (ctypes.c_bool, [ctypes.c_void_p]),
+    "rvsimCycles": (ctypes.c_uint64, [ctypes.c_void_p]),
+    "rvsimRetired": (ctypes.c_uint64, [ctypes.c_void_p]),
+    "rvsimPC": (ctypes.c_uint64, [ctypes.c_void_p]),
+    "rvsimReadReg": (ctypes.c_int64, [ctypes.c_void_p, ctypes.c_int]),
+    "rvsimWriteReg": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_int, ctypes.c_int64]),
+    "rvsimMemSize": (ctypes.c_size_t, [ctypes.c_void_p]),
+    "rvsimReadMem": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_size_t]),
+    "rvsimWriteMem": (ctypes.c_bool, [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_char_p, ctypes.c_size_t]),
+    "rvsimError": (ctypes.c_char_p, [ctypes.c_void_p]),
+}
+for _name, (_res, _args) in _sig.items():
+    getattr(_lib, _name).restype = _res
+    getattr(_lib, _name).argtypes = _args
+
+
+class RVSimError(Exception):
+    pass
+
+
+class RVSim:
+    def __init__(self):
+        self._sim = _lib.rvsimCreate()
+        if not self._sim:
+            raise MemoryError("rvsimCreate")
+
+    def close(self):
+        if self._sim:
+            _lib.rvsimDestroy(self._sim)
+            self._sim = None
+
+    __del__ = close
+
+    def _check(self, ok):
+        if not ok:
+            raise RVSimError(_lib.rvsimError(self._sim).decode())
+
+    def load_program(self, text):
+        self._check(_lib.rvsimLoadProgram(self._sim, text.encode()))
+
+    def load_trace(self, path):
+        self._check(_lib.rvsimLoadTrace(self._sim, os.fsencode(path)))
+
+    def load_state(self, path):
+        self._check(_lib.rvsimLoadState(self._sim, os.fsencode(path)))
+
+    def load_state_text(self, text):
+        self._check(_lib.rvsimLoadStateText(self._sim, text.encode()))
+
+    def set_config(self, name):
+        self._check(_lib.rvsimSetConfig(self._sim, name.encode()))
+
+    def reset(self):
+        self._check(_lib.rvsimReset(self._sim))
+
+    def step(self, cycles=1):
+        return _lib.rvsimStep(self._sim, cycles)
+
+    def run(self):
+        return _lib.rvsimStep(self._sim, FOREVER)
+
+    def run_until_pc(self, pc, max_cycles=FOREVER):
+        return _lib.rvsimRunUntilPC(self._sim, pc, max_cycles)
+
+    def run_until_cycle(self, cycle):
+        return _lib.rvsimRunUntilCycle(self._sim, cycle)
+
+    @property
+    def finished(self):
+        return _lib.rvsimFinished(self._sim)
+
+    @property
+    def cycles(self):
+        return _lib.rvsimCycles(self._sim)
+
+    @property
+    def retired(self):
+        return _lib.rvsimRetired(self._sim)
+
+    @property
+    def pc(self):
+        return _lib.rvsimPC(self._sim)
+
+    def reg(self, index):
+        return _lib.rvsimReadReg(self._sim, index)
+
+    def set_reg(self, index, value):
+        self._check(_lib.rvsimWriteReg(self._sim, index, value))
+
+    @property
+    def mem_size(self):
+        return _lib.rvsimMemSize(self._sim)
+
+    def read_mem(self, addr, length):
+        buf = ctypes.create_string_buffer(length)
+        if not _lib.rvsimReadMem(self._sim, addr, buf, length):
+            raise RVSimError("%d bytes at %d are outside the data memory" % (length, addr))
+        return buf.raw
+
+    def write_mem(self, addr, data):
+        self._check(_lib.rvsimWriteMem(self._sim, addr, bytes(data), len(data)))
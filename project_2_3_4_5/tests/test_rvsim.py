@@ -0,0 +1,60 @@
+"""rvsim.py against librvsim.so; `make test` builds the library first.
+RVSIM_LIB picks the library (default ../librvsim.so)."""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from rvsim import RVSim, RVSimError  # noqa: E402
+
+
+class LibraryTest(unittest.TestCase):
+    def setUp(self):
+        self.sim = RVSim()
+
+    def tearDown(self):
+        self.sim.close()
+
+    def test_program(self):
+        self.sim.load_program("addi x5, x0, 3\nadd x6, x5, x5\n")
+        self.sim.run()
+        self.assertTrue(self.sim.finished)
+        self.assertEqual(self.sim.retired, 2)
+        self.assertEqual(self.sim.reg(6), 6)
+
+    def test_program_without_trailing_newline(self):
+        self.sim.load_program("addi x10, x0, 3\nadd x11, x10, x10")
+        self.sim.run()
+        self.assertEqual(self.sim.reg(11), 6)
+        self.assertEqual(self.sim.reg(1), 0)
+
+    def test_state_text(self):
+        self.sim.load_program("add x6, x5, x5\n")
+        self.sim.load_state_text("x5=21")
+        self.sim.run()
+        self.assertEqual(self.sim.reg(6), 42)
+
+    def test_bad_state_text(self):
+        self.sim.load_program("addi x5, x0, 1\n")
+        with self.assertRaisesRegex(RVSimError, "^state:1: expected .* got: y5=1$"):
+            self.sim.load_state_text("y5=1\n")
+
+    def test_step(self):
+        self.sim.load_program("addi x5, x0, 1\n" * 10)
+        self.assertEqual(self.sim.step(3), 3)
+        self.assertFalse(self.sim.finished)
+        self.sim.run()
+        self.assertTrue(self.sim.finished)
+        self.assertEqual(self.sim.retired, 10)
+
+    def test_errors(self):
+        self.sim.load_program("addi x5, x0, 1\n")
+        with self.assertRaises(RVSimError):
+            self.sim.set_config("no-such-config")
+        with self.assertRaises(RVSimError):
+            self.sim.set_reg(32, 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,86 @@
+"""--serve jobs against a daemon started on a scratch socket; `make test`
+runs this with the other tests. RVSIM picks the binary (default ../RVSim)."""
+
+import json
+import os
+import socket
+import subprocess
+import tempfile
+import time
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+RVSIM = os.environ.get("RVSIM", os.path.join(HERE, "..", "RVSim"))
+
+
+class ServeTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.dir = tempfile.TemporaryDirectory()
+        cls.path = os.path.join(cls.dir.name, "rvsim.sock")
+        cls.daemon = subprocess.Popen([RVSIM, "--serve", cls.path, "--workers", "2"],
+                                      stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        for _ in range(100):
+            if os.path.exists(cls.path):
+                break
+            time.sleep(0.05)
+        cls.sock = socket.socket(socket.AF_UNIX)
+        cls.sock.connect(cls.path)
+        cls.conn = cls.sock.makefile("rw")
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.conn.close()
+        cls.sock.close()
+        cls.daemon.terminate()
+        cls.daemon.communicate(timeout=10)
+        cls.dir.cleanup()
+
+    def job(self, **request):
+        self.conn.write(json.dumps(request) + "\n")
+        self.conn.flush()
+        return json.loads(self.conn.readline())
+
+    def test_program(self):
+        reply = self.job(program="addi x5, x0, 3\nadd x6, x5, x5\n", init="x7=1")
+        self.assertTrue(reply["ok"], reply)
+        self.assertTrue(reply["finished"])
+        self.assertEqual(reply["retired"], 2)
+        self.assertEqual(reply["regs"]["x6"], 6)
+        self.assertEqual(reply["regs"]["x7"], 1)
+
+    def test_program_without_trailing_newline(self):
+        reply = self.job(program="addi x10, x0, 3\nadd x11, x10, x10")
+        self.assertTrue(reply["ok"], reply)
+        self.assertEqual(reply["regs"]["x11"], 6)
+        self.assertNotIn("x1", reply["regs"])
+
+    def test_program_id(self):
+        first = self.job(program="addi x5, x0, 9\n")
+        again = self.job(program_id=first["program_id"])
+        self.assertTrue(again["cached"])
+        self.assertEqual(again["regs"]["x5"], 9)
+
+    def test_max_cycles(self):
+        reply = self.job(program="addi x5, x0, 1\n" * 20, max_cycles=3)
+        self.assertTrue(reply["ok"], reply)
+        self.assertFalse(reply["finished"])
+        self.assertEqual(reply["cycles"], 3)
+
+    def test_bad_init(self):
+        reply = self.job(program="addi x5, x0, 1\n", init="x5=1\nx40=2")
+        self.assertFalse(reply["ok"])
+        self.assertEqual(reply["error"], "init:2: registers are x1-x31.")
+
+    def test_missing_init_file(self):
+        reply = self.job(program="addi x5, x0, 1\n", init_file="/nonexistent/state")
+        self.assertFalse(reply["ok"])
+        self.assertIn("/nonexistent/state", reply["error"])
+
+    def test_unknown_program_id(self):
+        reply = self.job(program_id="0000000000000000")
+        self.assertFalse(reply["ok"])
+
+
+if __name__ == "__main__":
+    unittest.main()